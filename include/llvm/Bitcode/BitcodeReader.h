@@ -40,6 +40,8 @@ namespace llvm {
     return std::move(*Val);
   }
 
+  struct BitcodeFileContents;
+
   /// Represents a module in a bitcode file.
   class BitcodeModule {
     // This covers the identification (if present) and module blocks.
@@ -58,8 +60,8 @@ namespace llvm {
           IdentificationBit(IdentificationBit), ModuleBit(ModuleBit) {}
 
     // Calls the ctor.
-    friend Expected<std::vector<BitcodeModule>>
-    getBitcodeModuleList(MemoryBufferRef Buffer);
+    friend Expected<BitcodeFileContents>
+    getBitcodeFileContents(MemoryBufferRef Buffer);
 
     Expected<std::unique_ptr<Module>> getModuleImpl(LLVMContext &Context,
                                                     bool MaterializeAll,
@@ -91,6 +93,19 @@ namespace llvm {
     Expected<std::unique_ptr<ModuleSummaryIndex>> getSummary();
   };
 
+  struct BitcodeFileContents {
+    std::vector<BitcodeModule> Mods;
+    /// The contents of the SYMTAB_BLOCK, or empty strings if the file does not
+    /// have a symbol table. See llvm/Object/IRSymtab.h.
+    StringRef Symtab, StrtabForSymtab;
+  };
+
+  /// Returns the contents of a bitcode file: its modules and the raw contents
+  /// of its symbol table. Clients which need a symbol table should use
+  /// irsymtab::readBitcode instead, which also handles files without a symbol
+  /// table or with a symbol table from another LLVM version.
+  Expected<BitcodeFileContents> getBitcodeFileContents(MemoryBufferRef Buffer);
+
   /// Returns a list of modules in the specified bitcode buffer.
   Expected<std::vector<BitcodeModule>>
   getBitcodeModuleList(MemoryBufferRef Buffer);
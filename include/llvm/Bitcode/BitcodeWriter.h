@@ -16,6 +16,7 @@
 
 #include "llvm/IR/ModuleSummaryIndex.h"
 #include <string>
+#include <vector>
 
 namespace llvm {
   class BitstreamWriter;
@@ -26,6 +27,10 @@ namespace llvm {
     SmallVectorImpl<char> &Buffer;
     std::unique_ptr<BitstreamWriter> Stream;
 
+    // The modules written so far, for the symbol table.
+    std::vector<Module *> Mods;
+    bool WroteSymtab = false;
+
    public:
     /// Create a BitcodeWriter that writes to Buffer.
     BitcodeWriter(SmallVectorImpl<char> &Buffer);
@@ -46,6 +51,15 @@ namespace llvm {
     void writeModule(const Module *M, bool ShouldPreserveUseListOrder = false,
                      const ModuleSummaryIndex *Index = nullptr,
                      bool GenerateHash = false);
+
+    /// Write the symbol table of the modules written so far, which lets
+    /// linkers and other tools read the symbols of the file without loading
+    /// its modules (see llvm/Object/IRSymtab.h). This must be called after all
+    /// the modules have been written.
+    ///
+    /// No symbol table is written if one cannot be built, for instance if a
+    /// module has module-level inline asm and its target is not registered.
+    void writeSymtab();
   };
 
   /// \brief Write the specified module to the specified raw output stream.
@@ -52,7 +52,11 @@ enum BlockIDs {
 
   OPERAND_BUNDLE_TAGS_BLOCK_ID,
 
-  METADATA_KIND_BLOCK_ID
+  METADATA_KIND_BLOCK_ID,
+
+  // Top-level block holding the symbol table of the bitcode file, see
+  // llvm/Object/IRSymtab.h.
+  SYMTAB_BLOCK_ID
 };
 
 /// Identification block contains a string that describes the producer details,
@@ -215,6 +219,26 @@ enum GlobalValueSummarySymtabCodes {
   FS_VERSION = 10,
   // The list of llvm.type.test type identifiers used by the following function.
   FS_TYPE_TESTS = 11,
+  // The virtual function slots called by the following function through a
+  // vtable pointer checked by an assumed llvm.type.test:
+  // [n x (typeid, offset)]
+  FS_TYPE_TEST_ASSUME_VCALLS = 12,
+  // The constant integer returned by the following function:
+  // [bitwidth, value]
+  FS_CONSTANT_RETURN = 13,
+  // The size of the following vtable, whether it is constant, and its type
+  // identifiers: [size, isconstant, n x (typeid, addresspoint)]
+  FS_VTABLE_TYPE_IDS = 14,
+  // The function pointers in the following vtable: [n x (valueid, offset)]
+  FS_VTABLE_FUNCS = 15,
+  // The name of a vtable or virtual function: [valueid, namechar x N]
+  FS_DEVIRT_VALUE_NAME = 16,
+  // The references of the following function to global variables that its
+  // module only loads from: [n x valueid]
+  FS_READONLY_REFS = 17,
+  // The following global variable is only loaded from, by its module in a
+  // per-module summary or by the whole program in a combined one: [size]
+  FS_READONLY_GLOBALVAR = 18,
 };
 
 enum MetadataCodes {
@@ -531,6 +555,11 @@ enum ComdatSelectionKindCodes {
   COMDAT_SELECTION_KIND_SAME_SIZE = 5,
 };
 
+enum SymtabCodes {
+  SYMTAB_BLOB = 1,        // BLOB: [symbol table]
+  SYMTAB_STRTAB_BLOB = 2, // STRTAB_BLOB: [string table of the symbol table]
+};
+
 } // End bitc namespace
 } // End llvm namespace
 
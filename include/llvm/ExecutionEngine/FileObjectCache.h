@@ -0,0 +1,114 @@
+//===- FileObjectCache.h - Persistent on-disk object cache ------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file declares FileObjectCache, an ObjectCache that keeps the objects
+// compiled by MCJIT or an ORC IRCompileLayer in a directory, so that later
+// processes compiling the same IR for the same target configuration can load
+// them instead of running the code generator again.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_FILEOBJECTCACHE_H
+#define LLVM_EXECUTIONENGINE_FILEOBJECTCACHE_H
+
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/ExecutionEngine/ObjectCache.h"
+#include "llvm/Support/CachePruning.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace llvm {
+
+class TargetMachine;
+
+/// An ObjectCache that stores objects in a directory, one file per object,
+/// named after a SHA1 hash of the module's bitcode, the LLVM version and the
+/// configuration of the code generator that compiled it. Because the key is
+/// derived from the contents of the module rather than from its identifier,
+/// entries are shared between processes and are never stale.
+///
+/// Entries are written to a temporary file in the cache directory and then
+/// renamed into place, so several processes may use the same directory at
+/// once. The directory is pruned with CachePruning after new entries are
+/// added, according to the policy set with the setters below. By default
+/// nothing is pruned.
+///
+/// The key of a module is computed when the JIT asks for its object, before
+/// code generation modifies the module, and is used again when the JIT
+/// reports the compiled object. Both calls may come from different threads.
+class FileObjectCache : public ObjectCache {
+public:
+  /// Create a cache in \p CacheDir for objects compiled by \p TM. The target
+  /// triple, CPU, features and code generation options of \p TM are part of
+  /// the key of every entry.
+  FileObjectCache(StringRef CacheDir, const TargetMachine &TM);
+
+  /// Create a cache in \p CacheDir whose keys include \p Config, which must
+  /// describe everything besides the IR that affects the compiled objects.
+  FileObjectCache(StringRef CacheDir, StringRef Config);
+
+  ~FileObjectCache() override;
+
+  /// Minimum time between two scans of the cache directory for pruning.
+  FileObjectCache &setPruningInterval(std::chrono::seconds Interval) {
+    Pruner.setPruningInterval(Interval);
+    return *this;
+  }
+
+  /// Remove entries that have not been used for \p ExpireAfter.
+  FileObjectCache &setEntryExpiration(std::chrono::seconds ExpireAfter) {
+    Pruner.setEntryExpiration(ExpireAfter);
+    return *this;
+  }
+
+  /// Keep the cache below \p Percentage of the available disk space.
+  FileObjectCache &setMaxSize(unsigned Percentage) {
+    Pruner.setMaxSize(Percentage);
+    return *this;
+  }
+
+  /// Keep the cache below \p Bytes bytes.
+  FileObjectCache &setMaxSizeBytes(uint64_t Bytes) {
+    Pruner.setMaxSizeBytes(Bytes);
+    return *this;
+  }
+
+  void notifyObjectCompiled(const Module *M, MemoryBufferRef Obj) override;
+  std::unique_ptr<MemoryBuffer> getObject(const Module *M) override;
+
+  /// Returns the key of the entry holding the object compiled from \p M.
+  std::string getKey(const Module &M) const;
+
+  /// Returns the path of the entry with key \p Key.
+  std::string getEntryPath(StringRef Key) const;
+
+  /// Prune the cache directory now, subject to the pruning interval. Returns
+  /// true if the directory was scanned.
+  bool prune();
+
+  unsigned getNumHits() const { return NumHits; }
+  unsigned getNumMisses() const { return NumMisses; }
+
+private:
+  std::string CacheDir;
+  std::string Config;
+  CachePruning Pruner;
+
+  std::mutex CacheMutex;
+  DenseMap<const Module *, std::string> PendingKeys;
+  std::atomic<unsigned> NumHits;
+  std::atomic<unsigned> NumMisses;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_FILEOBJECTCACHE_H
@@ -113,6 +113,25 @@ public:
   }
 #endif // USE_OPROFILE
 
+#if LLVM_USE_PERF
+  // Construct a PerfJITEventListener that writes a jitdump file to the
+  // directory named by $JITDUMPDIR, or ~/.debug/jit, and /tmp/perf-PID.map.
+  static JITEventListener *createPerfJITEventListener();
+
+  // Construct a PerfJITEventListener that writes its jitdump file to
+  // JITDumpDir and its perf map to PerfMapDir. Either may be empty to skip
+  // that file.
+  static JITEventListener *createPerfJITEventListener(StringRef JITDumpDir,
+                                                      StringRef PerfMapDir);
+#else
+  static JITEventListener *createPerfJITEventListener() { return nullptr; }
+
+  static JITEventListener *createPerfJITEventListener(StringRef JITDumpDir,
+                                                      StringRef PerfMapDir) {
+    return nullptr;
+  }
+#endif // USE_PERF
+
 private:
   virtual void anchor();
 };
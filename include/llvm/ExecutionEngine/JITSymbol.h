@@ -14,11 +14,15 @@
 #ifndef LLVM_EXECUTIONENGINE_JITSYMBOL_H
 #define LLVM_EXECUTIONENGINE_JITSYMBOL_H
 
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Error.h"
 #include <algorithm>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <functional>
+#include <map>
+#include <set>
 #include <string>
 
 namespace llvm {
@@ -188,6 +192,20 @@ public:
   /// for handling them manually.
   virtual JITSymbol findSymbol(const std::string &Name) = 0;
 
+  typedef std::set<StringRef> LookupSet;
+  typedef std::map<StringRef, JITEvaluatedSymbol> LookupResult;
+
+  /// This method returns the addresses of all of the given symbols at once.
+  /// RuntimeDyld uses it to resolve the external symbols of the objects it
+  /// has loaded with a single query, which resolvers that have to take a lock
+  /// or talk to another process can answer far more cheaply than one query
+  /// per symbol.
+  ///
+  /// Symbols that cannot be found are left out of the result. The default
+  /// implementation looks each symbol up with findSymbolInLogicalDylib, then
+  /// with findSymbol if that fails.
+  virtual Expected<LookupResult> lookup(const LookupSet &Symbols);
+
 private:
   virtual void anchor();
 };
@@ -19,11 +19,13 @@
 #include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/Twine.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/ExecutionEngine/Orc/IndirectionUtils.h"
 #include "llvm/ExecutionEngine/Orc/LambdaResolver.h"
 #include "llvm/IR/Attributes.h"
+#include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/IR/DataLayout.h"
 #include "llvm/IR/Function.h"
@@ -36,12 +38,17 @@
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <iterator>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <set>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
@@ -55,6 +62,18 @@ namespace orc {
 /// added to the layer below. When a stub is called it triggers the extraction
 /// of the function body from the original module. The extracted body is then
 /// compiled and executed.
+///
+///   Optionally, functions can also be compiled ahead of their first call on
+/// a background compile thread. Whenever a partition is emitted, the functions
+/// it calls are queued for speculative compilation, and the compile thread
+/// retargets their stubs as soon as their bodies are ready. Until then the
+/// stubs keep pointing at the compile callbacks, so a call that wins the race
+/// simply waits for the function to be compiled.
+///
+///   The layer serializes all of its work, including background compiles, on
+/// a single lock: partitions share the LLVMContext of their source module and
+/// the layer below is not thread-safe. Clients must not use the LLVMContext of
+/// the modules they add while background compilation is enabled.
 template <typename BaseLayerT,
           typename CompileCallbackMgrT = JITCompileCallbackManager,
           typename IndirectStubsMgrT = IndirectStubsManager>
@@ -179,10 +198,19 @@ private:
     ModuleAdderFtor ModuleAdder;
     SourceModulesList SourceModules;
     std::vector<BaseLayerModuleSetHandleT> BaseLayerHandles;
+
+    // Functions that have been queued for speculative compilation.
+    std::set<Function*> SpeculationCandidates;
   };
 
   typedef std::list<LogicalDylib> LogicalDylibList;
 
+  struct SpeculationRequest {
+    LogicalDylib *LD;
+    typename LogicalDylib::SourceModuleHandle LMId;
+    Function *F;
+  };
+
 public:
   /// @brief Handle to a set of loaded modules.
   typedef typename LogicalDylibList::iterator ModuleSetHandleT;
@@ -194,15 +222,54 @@ public:
   typedef std::function<std::unique_ptr<IndirectStubsMgrT>()>
     IndirectStubsManagerBuilderT;
 
+  /// @brief Latency statistics for the first calls of lazily compiled
+  ///        functions.
+  struct CompileStats {
+    /// Number of calls that stalled in a compile callback.
+    unsigned NumStalls = 0;
+
+    /// Number of stalls whose function had been compiled in the background by
+    /// the time the callback ran.
+    unsigned NumBackgroundHits = 0;
+
+    /// Number of functions compiled speculatively in the background.
+    unsigned NumBackgroundCompiles = 0;
+
+    /// Total and longest time spent stalled in compile callbacks.
+    std::chrono::nanoseconds TotalStallTime{0};
+    std::chrono::nanoseconds MaxStallTime{0};
+  };
+
   /// @brief Construct a compile-on-demand layer instance.
+  ///
+  ///   If CompileInBackground is true, and LLVM was built with threads, the
+  /// layer starts a compile thread to speculatively compile the callees of
+  /// emitted partitions.
   CompileOnDemandLayer(BaseLayerT &BaseLayer, PartitioningFtor Partition,
                        CompileCallbackMgrT &CallbackMgr,
                        IndirectStubsManagerBuilderT CreateIndirectStubsManager,
-                       bool CloneStubsIntoPartitions = true)
+                       bool CloneStubsIntoPartitions = true,
+                       bool CompileInBackground = false)
       : BaseLayer(BaseLayer), Partition(std::move(Partition)),
         CompileCallbackMgr(CallbackMgr),
         CreateIndirectStubsManager(std::move(CreateIndirectStubsManager)),
-        CloneStubsIntoPartitions(CloneStubsIntoPartitions) {}
+        CloneStubsIntoPartitions(CloneStubsIntoPartitions) {
+#if LLVM_ENABLE_THREADS
+    if (CompileInBackground)
+      CompileThread = std::thread([this]() { runCompileThread(); });
+#endif
+  }
+
+  ~CompileOnDemandLayer() {
+    if (!CompileThread.joinable())
+      return;
+    {
+      std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
+      StopCompileThread = true;
+    }
+    CompileThreadCV.notify_one();
+    CompileThread.join();
+  }
 
   /// @brief Add a module to the compile-on-demand layer.
   template <typename ModuleSetT, typename MemoryManagerPtrT,
@@ -210,6 +277,7 @@ public:
   ModuleSetHandleT addModuleSet(ModuleSetT Ms,
                                 MemoryManagerPtrT MemMgr,
                                 SymbolResolverPtrT Resolver) {
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
 
     LogicalDylibs.push_back(LogicalDylib());
     auto &LD = LogicalDylibs.back();
@@ -239,6 +307,13 @@ public:
   ///   This will remove all modules in the layers below that were derived from
   /// the module represented by H.
   void removeModuleSet(ModuleSetHandleT H) {
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
+    SpeculationQueue.erase(
+        std::remove_if(SpeculationQueue.begin(), SpeculationQueue.end(),
+                       [&](const SpeculationRequest &R) {
+                         return R.LD == &*H;
+                       }),
+        SpeculationQueue.end());
     LogicalDylibs.erase(H);
   }
 
@@ -247,6 +322,7 @@ public:
   /// @param ExportedSymbolsOnly If true, search only for exported symbols.
   /// @return A handle for the given named symbol, if it exists.
   JITSymbol findSymbol(StringRef Name, bool ExportedSymbolsOnly) {
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
     for (auto LDI = LogicalDylibs.begin(), LDE = LogicalDylibs.end();
          LDI != LDE; ++LDI) {
       if (auto Sym = LDI->StubsMgr->findStub(Name, ExportedSymbolsOnly))
@@ -261,11 +337,13 @@ public:
   ///        below this one.
   JITSymbol findSymbolIn(ModuleSetHandleT H, const std::string &Name,
                          bool ExportedSymbolsOnly) {
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
     return H->findSymbol(BaseLayer, Name, ExportedSymbolsOnly);
   }
 
   /// @brief Update the stub for the given function to point at FnBodyAddr.
   /// This can be used to support re-optimization.
+  /// @param MangledName The mangled name of the function, as for findSymbol.
   /// @return true if the function exists and the stub is updated, false
   ///         otherwise.
   //
@@ -273,22 +351,28 @@ public:
   //        callbacks, uncompiled IR, and no-longer-needed/reachable function
   //        implementations).
   // FIXME: Return Error once the JIT APIs are Errorized.
-  bool updatePointer(std::string FuncName, JITTargetAddress FnBodyAddr) {
-    //Find out which logical dylib contains our symbol
-    auto LDI = LogicalDylibs.begin();
-    for (auto LDE = LogicalDylibs.end(); LDI != LDE; ++LDI) {
-      if (auto LMResources = LDI->getLogicalModuleResourcesForSymbol(FuncName, false)) {
-        Module &SrcM = LMResources->SourceModule->getResource();
-        std::string CalledFnName = mangle(FuncName, SrcM.getDataLayout());
-        if (auto EC = LMResources->StubsMgr->updatePointer(CalledFnName, FnBodyAddr))
-          return false;
-        else
-          return true;
+  bool updatePointer(const std::string &MangledName,
+                     JITTargetAddress FnBodyAddr) {
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
+    // Find out which logical dylib contains our stub.
+    for (auto &LD : LogicalDylibs) {
+      if (!LD.StubsMgr->findStub(MangledName, false))
+        continue;
+      if (auto Err = LD.StubsMgr->updatePointer(MangledName, FnBodyAddr)) {
+        consumeError(std::move(Err));
+        return false;
       }
+      return true;
     }
     return false;
   }
 
+  /// @brief Get the latency statistics of the compile callbacks run so far.
+  CompileStats getCompileStats() const {
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
+    return Stats;
+  }
+
 private:
   template <typename ModulePtrT>
   void addLogicalModule(LogicalDylib &LD, ModulePtrT SrcMPtr) {
@@ -333,7 +417,7 @@ private:
           std::make_pair(CCInfo.getAddress(),
                          JITSymbolFlags::fromGlobalValue(F));
         CCInfo.setCompileAction([this, &LD, LMId, &F]() {
-          return this->extractAndCompile(LD, LMId, F);
+          return this->compileOnFirstCall(LD, LMId, F);
         });
       }
 
@@ -444,19 +528,88 @@ private:
     return MangledName;
   }
 
+  JITTargetAddress
+  compileOnFirstCall(LogicalDylib &LD,
+                     typename LogicalDylib::SourceModuleHandle LMId,
+                     Function &F) {
+    auto Start = std::chrono::steady_clock::now();
+    std::lock_guard<std::recursive_mutex> Lock(LayerMutex);
+    bool CompiledInBackground = F.isDeclaration();
+    JITTargetAddress Addr = extractAndCompile(LD, LMId, F);
+
+    auto Stall = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - Start);
+    ++Stats.NumStalls;
+    if (CompiledInBackground)
+      ++Stats.NumBackgroundHits;
+    Stats.TotalStallTime += Stall;
+    Stats.MaxStallTime = std::max(Stats.MaxStallTime, Stall);
+    return Addr;
+  }
+
+  void runCompileThread() {
+    while (true) {
+      std::unique_lock<std::recursive_mutex> Lock(LayerMutex);
+      CompileThreadCV.wait(Lock, [this]() {
+        return StopCompileThread || !SpeculationQueue.empty();
+      });
+      if (StopCompileThread)
+        return;
+
+      SpeculationRequest R = SpeculationQueue.front();
+      SpeculationQueue.pop_front();
+
+      // Skip functions that have been compiled since they were queued.
+      if (R.F->isDeclaration())
+        continue;
+
+      extractAndCompile(*R.LD, R.LMId, *R.F);
+      ++Stats.NumBackgroundCompiles;
+    }
+  }
+
+  // Queue the functions called by F that have not been compiled yet, as they
+  // are the most likely to be called next.
+  void queueCallees(LogicalDylib &LD,
+                    typename LogicalDylib::SourceModuleHandle LMId,
+                    Function &F) {
+    const DataLayout &DL = F.getParent()->getDataLayout();
+    bool Queued = false;
+    for (auto &BB : F)
+      for (auto &I : BB) {
+        CallSite CS(&I);
+        if (!CS)
+          continue;
+        auto *Callee =
+            dyn_cast<Function>(CS.getCalledValue()->stripPointerCasts());
+        if (!Callee || Callee->isDeclaration() ||
+            Callee->getParent() != F.getParent())
+          continue;
+        // Only functions with stubs are compiled lazily.
+        if (!LD.SpeculationCandidates.insert(Callee).second ||
+            !LD.StubsMgr->findStub(mangle(Callee->getName(), DL), false))
+          continue;
+        SpeculationQueue.push_back({&LD, LMId, Callee});
+        Queued = true;
+      }
+    if (Queued)
+      CompileThreadCV.notify_one();
+  }
+
   JITTargetAddress
   extractAndCompile(LogicalDylib &LD,
                     typename LogicalDylib::SourceModuleHandle LMId,
                     Function &F) {
     Module &SrcM = LD.getSourceModule(LMId);
 
-    // If F is a declaration we must already have compiled it.
-    if (F.isDeclaration())
-      return 0;
-
     // Grab the name of the function being called here.
     std::string CalledFnName = mangle(F.getName(), SrcM.getDataLayout());
 
+    // If F is a declaration we must already have compiled it, possibly on the
+    // compile thread, and its stub points at its body.
+    if (F.isDeclaration())
+      return LD.StubsMgr->findStub(CalledFnName, false).getAddress();
+
     auto Part = Partition(F);
     auto PartH = emitPartition(LD, LMId, Part);
 
@@ -536,6 +689,12 @@ private:
       return nullptr;
     });
 
+    // Look for speculation candidates before the bodies are moved out of the
+    // source module.
+    if (CompileThread.joinable())
+      for (auto *F : Part)
+        queueCallees(LD, LMId, *F);
+
     // Create decls in the new module.
     for (auto *F : Part)
       cloneFunctionDecl(*M, *F, &VMap);
@@ -565,6 +724,14 @@ private:
 
   LogicalDylibList LogicalDylibs;
   bool CloneStubsIntoPartitions;
+
+  mutable std::recursive_mutex LayerMutex;
+  CompileStats Stats;
+
+  std::deque<SpeculationRequest> SpeculationQueue;
+  std::condition_variable_any CompileThreadCV;
+  bool StopCompileThread = false;
+  std::thread CompileThread;
 };
 
 } // end namespace orc
@@ -18,6 +18,7 @@
 #include "llvm/ADT/StringMap.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/JITSymbol.h"
 #include "llvm/ExecutionEngine/RuntimeDyld.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
@@ -91,6 +92,43 @@ public:
                   const LoadResult &) {}
 };
 
+/// @brief Action to perform when loading objects: tell each of a list of
+///        JITEventListeners about each object.
+///
+///   The list is held by reference, so that listeners can be added to it
+/// after the layer is constructed, but not while objects are being loaded.
+/// Listeners are called from the threads that load the objects.
+class NotifyJITEventListeners {
+public:
+  typedef std::vector<JITEventListener *> ListenerListT;
+
+  NotifyJITEventListeners(const ListenerListT &Listeners)
+      : Listeners(&Listeners) {}
+
+  template <typename ObjSetT, typename LoadResult>
+  void operator()(ObjectLinkingLayerBase::ObjSetHandleT, const ObjSetT &Objs,
+                  const LoadResult &Infos) const {
+    assert(Objs.size() == Infos.size() &&
+           "Incorrect number of Infos for Objects.");
+    for (unsigned I = 0; I < Objs.size(); ++I)
+      for (JITEventListener *L : *Listeners)
+        L->NotifyObjectEmitted(getObject(*Objs[I]), *Infos[I]);
+  }
+
+private:
+  static const object::ObjectFile& getObject(const object::ObjectFile &Obj) {
+    return Obj;
+  }
+
+  template <typename ObjT>
+  static const object::ObjectFile&
+  getObject(const object::OwningBinary<ObjT> &Obj) {
+    return *Obj.getBinary();
+  }
+
+  const ListenerListT *Listeners;
+};
+
 /// @brief Bare bones object linking layer.
 ///
 ///   This class is intended to be used as the base layer for a JIT. It allows
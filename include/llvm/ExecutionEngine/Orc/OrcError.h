@@ -27,6 +27,7 @@ enum class OrcErrorCode : int {
   RemoteMProtectAddrUnrecognized,
   RemoteIndirectStubsOwnerDoesNotExist,
   RemoteIndirectStubsOwnerIdAlreadyInUse,
+  RPCConnectionClosed,
   RPCResponseAbandoned,
   UnexpectedRPCCall,
   UnexpectedRPCResponse,
@@ -18,6 +18,8 @@
 
 #include "IndirectionUtils.h"
 #include "OrcRemoteTargetRPCAPI.h"
+#include <cstring>
+#include <functional>
 #include <system_error>
 
 #define DEBUG_TYPE "orc-remote"
@@ -205,133 +207,40 @@ public:
     bool finalizeMemory(std::string *ErrMsg = nullptr) override {
       DEBUG(dbgs() << "Allocator " << Id << " finalizing:\n");
 
+      // Send the copies, protection changes and EH frame registrations as one
+      // batch of calls and wait for all of their results at once.
+      Error Err = Error::success();
       for (auto &ObjAllocs : Unfinalized) {
-
-        for (auto &Alloc : ObjAllocs.CodeAllocs) {
-          DEBUG(dbgs() << "  copying code: "
-                       << static_cast<void *>(Alloc.getLocalAddress()) << " -> "
-                       << format("0x%016x", Alloc.getRemoteAddress()) << " ("
-                       << Alloc.getSize() << " bytes)\n");
-          if (auto Err =
-                  Client.writeMem(Alloc.getRemoteAddress(),
-                                  Alloc.getLocalAddress(), Alloc.getSize())) {
-            // FIXME: Replace this once finalizeMemory can return an Error.
-            handleAllErrors(std::move(Err), [&](ErrorInfoBase &EIB) {
-              if (ErrMsg) {
-                raw_string_ostream ErrOut(*ErrMsg);
-                EIB.log(ErrOut);
-              }
-            });
-            return true;
-          }
-        }
-
-        if (ObjAllocs.RemoteCodeAddr) {
-          DEBUG(dbgs() << "  setting R-X permissions on code block: "
-                       << format("0x%016x", ObjAllocs.RemoteCodeAddr) << "\n");
-          if (auto Err = Client.setProtections(Id, ObjAllocs.RemoteCodeAddr,
-                                               sys::Memory::MF_READ |
-                                                   sys::Memory::MF_EXEC)) {
-            // FIXME: Replace this once finalizeMemory can return an Error.
-            handleAllErrors(std::move(Err), [&](ErrorInfoBase &EIB) {
-              if (ErrMsg) {
-                raw_string_ostream ErrOut(*ErrMsg);
-                EIB.log(ErrOut);
-              }
-            });
-            return true;
-          }
-        }
-
-        for (auto &Alloc : ObjAllocs.RODataAllocs) {
-          DEBUG(dbgs() << "  copying ro-data: "
-                       << static_cast<void *>(Alloc.getLocalAddress()) << " -> "
-                       << format("0x%016x", Alloc.getRemoteAddress()) << " ("
-                       << Alloc.getSize() << " bytes)\n");
-          if (auto Err =
-                  Client.writeMem(Alloc.getRemoteAddress(),
-                                  Alloc.getLocalAddress(), Alloc.getSize())) {
-            // FIXME: Replace this once finalizeMemory can return an Error.
-            handleAllErrors(std::move(Err), [&](ErrorInfoBase &EIB) {
-              if (ErrMsg) {
-                raw_string_ostream ErrOut(*ErrMsg);
-                EIB.log(ErrOut);
-              }
-            });
-            return true;
-          }
-        }
-
-        if (ObjAllocs.RemoteRODataAddr) {
-          DEBUG(dbgs() << "  setting R-- permissions on ro-data block: "
-                       << format("0x%016x", ObjAllocs.RemoteRODataAddr)
-                       << "\n");
-          if (auto Err = Client.setProtections(Id, ObjAllocs.RemoteRODataAddr,
-                                               sys::Memory::MF_READ)) {
-            // FIXME: Replace this once finalizeMemory can return an Error.
-            handleAllErrors(std::move(Err), [&](ErrorInfoBase &EIB) {
-              if (ErrMsg) {
-                raw_string_ostream ErrOut(*ErrMsg);
-                EIB.log(ErrOut);
-              }
-            });
-            return false;
-          }
-        }
-
-        for (auto &Alloc : ObjAllocs.RWDataAllocs) {
-          DEBUG(dbgs() << "  copying rw-data: "
-                       << static_cast<void *>(Alloc.getLocalAddress()) << " -> "
-                       << format("0x%016x", Alloc.getRemoteAddress()) << " ("
-                       << Alloc.getSize() << " bytes)\n");
-          if (auto Err =
-                  Client.writeMem(Alloc.getRemoteAddress(),
-                                  Alloc.getLocalAddress(), Alloc.getSize())) {
-            // FIXME: Replace this once finalizeMemory can return an Error.
-            handleAllErrors(std::move(Err), [&](ErrorInfoBase &EIB) {
-              if (ErrMsg) {
-                raw_string_ostream ErrOut(*ErrMsg);
-                EIB.log(ErrOut);
-              }
-            });
-            return false;
-          }
-        }
-
-        if (ObjAllocs.RemoteRWDataAddr) {
-          DEBUG(dbgs() << "  setting RW- permissions on rw-data block: "
-                       << format("0x%016x", ObjAllocs.RemoteRWDataAddr)
-                       << "\n");
-          if (auto Err = Client.setProtections(Id, ObjAllocs.RemoteRWDataAddr,
-                                               sys::Memory::MF_READ |
-                                                   sys::Memory::MF_WRITE)) {
-            // FIXME: Replace this once finalizeMemory can return an Error.
-            handleAllErrors(std::move(Err), [&](ErrorInfoBase &EIB) {
-              if (ErrMsg) {
-                raw_string_ostream ErrOut(*ErrMsg);
-                EIB.log(ErrOut);
-              }
-            });
-            return false;
-          }
-        }
+        appendWrites(Err, "code", ObjAllocs.CodeAllocs);
+        appendSetProtections(Err, "R-X", "code", ObjAllocs.RemoteCodeAddr,
+                             sys::Memory::MF_READ | sys::Memory::MF_EXEC);
+        appendWrites(Err, "ro-data", ObjAllocs.RODataAllocs);
+        appendSetProtections(Err, "R--", "ro-data", ObjAllocs.RemoteRODataAddr,
+                             sys::Memory::MF_READ);
+        appendWrites(Err, "rw-data", ObjAllocs.RWDataAllocs);
+        appendSetProtections(Err, "RW-", "rw-data", ObjAllocs.RemoteRWDataAddr,
+                             sys::Memory::MF_READ | sys::Memory::MF_WRITE);
       }
       Unfinalized.clear();
 
-      for (auto &EHFrame : UnfinalizedEHFrames) {
-        if (auto Err = Client.registerEHFrames(EHFrame.first, EHFrame.second)) {
-          // FIXME: Replace this once finalizeMemory can return an Error.
-          handleAllErrors(std::move(Err), [&](ErrorInfoBase &EIB) {
-            if (ErrMsg) {
-              raw_string_ostream ErrOut(*ErrMsg);
-              EIB.log(ErrOut);
-            }
-          });
-          return false;
-        }
-      }
+      for (auto &EHFrame : UnfinalizedEHFrames)
+        Err = joinErrors(std::move(Err),
+                         Client.template appendCall<RegisterEHFrames>(
+                             EHFrame.first, EHFrame.second));
       UnfinalizedEHFrames.clear();
 
+      Err = joinErrors(std::move(Err), Client.waitForAppendedCalls());
+      if (Err) {
+        // FIXME: Replace this once finalizeMemory can return an Error.
+        handleAllErrors(std::move(Err), [&](ErrorInfoBase &EIB) {
+          if (ErrMsg) {
+            raw_string_ostream ErrOut(*ErrMsg);
+            EIB.log(ErrOut);
+          }
+        });
+        return true;
+      }
+
       return false;
     }
 
@@ -382,6 +291,31 @@ public:
       std::vector<Alloc> CodeAllocs, RODataAllocs, RWDataAllocs;
     };
 
+    void appendWrites(Error &Err, const char *Kind,
+                      const std::vector<Alloc> &Allocs) {
+      for (auto &Alloc : Allocs) {
+        DEBUG(dbgs() << "  copying " << Kind << ": "
+                     << static_cast<void *>(Alloc.getLocalAddress()) << " -> "
+                     << format("0x%016x", Alloc.getRemoteAddress()) << " ("
+                     << Alloc.getSize() << " bytes)\n");
+        Err = joinErrors(std::move(Err),
+                         Client.writeMem(Alloc.getRemoteAddress(),
+                                         Alloc.getLocalAddress(),
+                                         Alloc.getSize()));
+      }
+    }
+
+    void appendSetProtections(Error &Err, const char *Perms, const char *Kind,
+                              JITTargetAddress Addr, unsigned Flags) {
+      if (!Addr)
+        return;
+      DEBUG(dbgs() << "  setting " << Perms << " permissions on " << Kind
+                   << " block: " << format("0x%016x", Addr) << "\n");
+      Err = joinErrors(std::move(Err),
+                       Client.template appendCall<SetProtections>(Id, Addr,
+                                                                  Flags));
+    }
+
     OrcRemoteTargetClient &Client;
     ResourceIdMgr::ResourceId Id;
     std::vector<ObjectAllocs> Unmapped;
@@ -627,6 +561,15 @@ public:
   /// Get the triple for the remote target.
   const std::string &getTargetTriple() const { return RemoteTargetTriple; }
 
+  /// Let writes to remote memory that is also mapped into this process bypass
+  /// the channel. LocalAddress returns the address at which this process sees
+  /// a range of remote memory, or null if it is not mapped here.
+  void setLocalAddressMapping(
+      std::function<char *(JITTargetAddress Addr, uint64_t Size)>
+          LocalAddress) {
+    this->LocalAddress = std::move(LocalAddress);
+  }
+
   Error terminateSession() { return callB<TerminateSession>(); }
 
 private:
@@ -634,6 +577,10 @@ private:
       : OrcRemoteTargetRPCAPI(Channel) {
     ErrorAsOutParameter EAO(&Err);
 
+    // Errors of appended calls are only collected, and returned by
+    // waitForAppendedCalls: a client that never appends any need not check.
+    (void)!!AppendedCallsError;
+
     addHandler<RequestCompile>(
         [this](JITTargetAddress Addr) -> JITTargetAddress {
           if (CallbackManager)
@@ -687,8 +634,8 @@ private:
 
   uint32_t getTrampolineSize() const { return RemoteTrampolineSize; }
 
-  Expected<std::vector<char>> readMem(char *Dst, JITTargetAddress Src,
-                                      uint64_t Size) {
+  Expected<std::vector<uint8_t>> readMem(char *Dst, JITTargetAddress Src,
+                                         uint64_t Size) {
     // Check for an 'out-of-band' error, e.g. from an MM destructor.
     if (ExistingError)
       return std::move(ExistingError);
@@ -715,12 +662,20 @@ private:
     return callB<SetProtections>(Id, RemoteSegAddr, ProtFlags);
   }
 
+  /// Copy Size bytes from Src to Addr in the remote, either directly if the
+  /// memory is mapped into this process, or as an appended call.
   Error writeMem(JITTargetAddress Addr, const char *Src, uint64_t Size) {
     // Check for an 'out-of-band' error, e.g. from an MM destructor.
     if (ExistingError)
       return std::move(ExistingError);
 
-    return callB<WriteMem>(DirectBufferWriter(Src, Addr, Size));
+    if (LocalAddress)
+      if (char *Dst = LocalAddress(Addr, Size)) {
+        memcpy(Dst, Src, Size);
+        return Error::success();
+      }
+
+    return appendCall<WriteMem>(DirectBufferWriter(Src, Addr, Size));
   }
 
   Error writePointer(JITTargetAddress Addr, JITTargetAddress PtrVal) {
@@ -731,9 +686,48 @@ private:
     return callB<WritePtr>(Addr, PtrVal);
   }
 
+  /// Append a call to the void function Func without waiting for its result.
+  /// The calls appended so far are sent by waitForAppendedCalls.
+  template <typename Func, typename... ArgTs>
+  Error appendCall(const ArgTs &... Args) {
+    // Bound the number of responses the remote may have to buffer while we
+    // are still sending calls.
+    if (NumAppendedCalls == MaxAppendedCalls)
+      if (auto Err = waitForAppendedCalls())
+        return Err;
+    ++NumAppendedCalls;
+    return appendCallAsync<Func>(
+        [this](Error Err) {
+          --NumAppendedCalls;
+          AppendedCallsError =
+              joinErrors(std::move(AppendedCallsError), std::move(Err));
+          return Error::success();
+        },
+        Args...);
+  }
+
+  /// Send the appended calls and wait until all of them have returned.
+  Error waitForAppendedCalls() {
+    if (auto Err = sendAppendedCalls())
+      return Err;
+    while (NumAppendedCalls != 0)
+      if (auto Err = handleOne()) {
+        abandonPendingResponses();
+        // The response that failed to be handled may not have run its handler,
+        // so start the next batch from scratch.
+        NumAppendedCalls = 0;
+        return joinErrors(std::move(Err), std::move(AppendedCallsError));
+      }
+    return std::move(AppendedCallsError);
+  }
+
   static Error doNothing() { return Error::success(); }
 
   Error ExistingError = Error::success();
+  Error AppendedCallsError = Error::success();
+  static const unsigned MaxAppendedCalls = 256;
+  unsigned NumAppendedCalls = 0;
+  std::function<char *(JITTargetAddress, uint64_t)> LocalAddress;
   std::string RemoteTargetTriple;
   uint32_t RemotePointerSize = 0;
   uint32_t RemotePageSize = 0;
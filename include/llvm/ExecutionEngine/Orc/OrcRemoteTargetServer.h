@@ -54,6 +54,11 @@ public:
   typedef std::function<void(uint8_t *Addr, uint32_t Size)>
       EHFrameRegistrationFtor;
 
+  typedef std::function<Expected<sys::MemoryBlock>(uint64_t Size)>
+      MemoryAllocationFtor;
+
+  typedef std::function<bool(sys::MemoryBlock &Block)> MemoryReleaseFtor;
+
   OrcRemoteTargetServer(ChannelT &Channel, SymbolLookupFtor SymbolLookup,
                         EHFrameRegistrationFtor EHFramesRegister,
                         EHFrameRegistrationFtor EHFramesDeregister)
@@ -102,26 +107,52 @@ public:
 
   bool receivedTerminate() const { return TerminateFlag; }
 
+  /// Reserve the memory requested by clients with Allocate, falling back to
+  /// freshly mapped pages when it fails. Release is given every block before
+  /// it is freed, and returns true if the block came from Allocate.
+  void setMemoryAllocator(MemoryAllocationFtor Allocate,
+                          MemoryReleaseFtor Release) {
+    MemoryAllocate = std::move(Allocate);
+    MemoryRelease = std::move(Release);
+  }
+
 private:
   struct Allocator {
     Allocator() = default;
-    Allocator(Allocator &&Other) : Allocs(std::move(Other.Allocs)) {}
+    Allocator(MemoryAllocationFtor Allocate, MemoryReleaseFtor Release)
+        : Allocate(std::move(Allocate)), Release(std::move(Release)) {}
+    Allocator(Allocator &&Other)
+        : Allocs(std::move(Other.Allocs)), Allocate(std::move(Other.Allocate)),
+          Release(std::move(Other.Release)) {}
     Allocator &operator=(Allocator &&Other) {
       Allocs = std::move(Other.Allocs);
+      Allocate = std::move(Other.Allocate);
+      Release = std::move(Other.Release);
       return *this;
     }
 
     ~Allocator() {
       for (auto &Alloc : Allocs)
-        sys::Memory::releaseMappedMemory(Alloc.second);
+        if (!Release || !Release(Alloc.second))
+          sys::Memory::releaseMappedMemory(Alloc.second);
     }
 
     Error allocate(void *&Addr, size_t Size, uint32_t Align) {
-      std::error_code EC;
-      sys::MemoryBlock MB = sys::Memory::allocateMappedMemory(
-          Size, nullptr, sys::Memory::MF_READ | sys::Memory::MF_WRITE, EC);
-      if (EC)
-        return errorCodeToError(EC);
+      sys::MemoryBlock MB;
+      if (Allocate) {
+        if (auto MBOrErr = Allocate(Size))
+          MB = *MBOrErr;
+        else
+          consumeError(MBOrErr.takeError());
+      }
+
+      if (!MB.base()) {
+        std::error_code EC;
+        MB = sys::Memory::allocateMappedMemory(
+            Size, nullptr, sys::Memory::MF_READ | sys::Memory::MF_WRITE, EC);
+        if (EC)
+          return errorCodeToError(EC);
+      }
 
       Addr = MB.base();
       assert(Allocs.find(MB.base()) == Allocs.end() && "Duplicate alloc");
@@ -139,6 +170,8 @@ private:
 
   private:
     std::map<void *, sys::MemoryBlock> Allocs;
+    MemoryAllocationFtor Allocate;
+    MemoryReleaseFtor Release;
   };
 
   static Error doNothing() { return Error::success(); }
@@ -200,7 +233,7 @@ private:
     if (I != Allocators.end())
       return orcError(OrcErrorCode::RemoteAllocatorIdAlreadyInUse);
     DEBUG(dbgs() << "  Created allocator " << Id << "\n");
-    Allocators[Id] = Allocator();
+    Allocators[Id] = Allocator(MemoryAllocate, MemoryRelease);
     return Error::success();
   }
 
@@ -412,6 +445,8 @@ private:
 
   SymbolLookupFtor SymbolLookup;
   EHFrameRegistrationFtor EHFramesRegister, EHFramesDeregister;
+  MemoryAllocationFtor MemoryAllocate;
+  MemoryReleaseFtor MemoryRelease;
   std::map<ResourceIdMgr::ResourceId, Allocator> Allocators;
   typedef std::vector<typename TargetT::IndirectStubsInfo> ISBlockOwnerList;
   std::map<ResourceIdMgr::ResourceId, ISBlockOwnerList> IndirectStubsOwners;
@@ -0,0 +1,151 @@
+//===- SharedMemoryRawChannel.h - RPC channel over shared memory -*- C++ -*-==//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// A RawByteChannel connecting a JIT to an executor process on the same host
+// through a shared memory region.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_EXECUTIONENGINE_ORC_SHAREDMEMORYRAWCHANNEL_H
+#define LLVM_EXECUTIONENGINE_ORC_SHAREDMEMORYRAWCHANNEL_H
+
+#include "RawByteChannel.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ExecutionEngine/JITSymbol.h"
+#include "llvm/Support/Error.h"
+#include "llvm/Support/Memory.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+
+namespace llvm {
+
+namespace sys {
+namespace fs {
+class mapped_file_region;
+} // end namespace fs
+} // end namespace sys
+
+namespace orc {
+namespace rpc {
+
+/// A RawByteChannel between two processes that share a memory region. Each
+/// direction of the channel is a single-producer single-consumer ring buffer
+/// in the region, so messages are copied into and out of the region rather
+/// than through the kernel.
+///
+/// Bytes appended to the channel become visible to the other side when the
+/// channel is sent, when the ring fills up, or when this side has to wait for
+/// input. Calls that are appended without waiting for their results therefore
+/// reach the other side as one batch, whose responses come back together.
+///
+/// A pipe in each direction carries wake-ups: a side that finds no input
+/// after spinning for a while sleeps reading its pipe until the other side
+/// publishes more. The pipes also report the exit of the other side.
+///
+/// The rest of the region is a heap that the executor may allocate JIT'd code
+/// and data from (see allocateSharedMemory). The JIT writes the contents of
+/// such sections into its own mapping of the heap (see getLocalAddress)
+/// instead of sending them through the channel.
+///
+/// This channel is only available on Unix hosts.
+class SharedMemoryRawChannel final : public RawByteChannel {
+public:
+  static const uint64_t DefaultRingSize = 1 << 20;
+  static const uint64_t DefaultHeapSize = 64 << 20;
+
+  /// Create a shared memory region with rings of \p RingSize bytes, which
+  /// must be a power of two, and a heap of \p HeapSize bytes, and return the
+  /// JIT's end of a channel on it. The executor attaches to the region with
+  /// the file descriptor returned by getSharedMemoryFD, which is inherited by
+  /// child processes. \p InFD and \p OutFD are the ends of the wake-up pipes
+  /// that this process reads from and writes to.
+  static Expected<std::unique_ptr<SharedMemoryRawChannel>>
+  create(int InFD, int OutFD, uint64_t RingSize = DefaultRingSize,
+         uint64_t HeapSize = DefaultHeapSize);
+
+  /// Return the executor's end of a channel on the region created by another
+  /// process and shared through \p SharedMemoryFD.
+  static Expected<std::unique_ptr<SharedMemoryRawChannel>>
+  attach(int SharedMemoryFD, int InFD, int OutFD);
+
+  ~SharedMemoryRawChannel() override;
+
+  /// The file descriptor of the shared memory region.
+  int getSharedMemoryFD() const { return SharedMemoryFD; }
+
+  /// Set how many times a side polls for input before it goes to sleep.
+  void setSpinCount(unsigned SpinCount) { this->SpinCount = SpinCount; }
+
+  Error readBytes(char *Dst, unsigned Size) override;
+  Error appendBytes(const char *Src, unsigned Size) override;
+  Error send() override;
+
+  /// Allocate \p Size bytes of readable and writable memory from the heap,
+  /// rounded up to whole pages. Only the executor may call this, and only
+  /// from one thread at a time. Fails if the heap is full, or if the executor
+  /// cannot execute code in it.
+  Expected<sys::MemoryBlock> allocateSharedMemory(uint64_t Size);
+
+  /// Return \p Block to the heap. Returns false if \p Block was not allocated
+  /// with allocateSharedMemory.
+  bool releaseSharedMemory(sys::MemoryBlock &Block);
+
+  /// Return the address at which this process sees the \p Size bytes at
+  /// \p Addr in the executor, or null if they are not in the heap. Only the
+  /// JIT may call this.
+  char *getLocalAddress(JITTargetAddress Addr, uint64_t Size) const;
+
+  /// The number of times this side went to sleep waiting for the other.
+  unsigned getNumSleeps() const { return NumSleeps; }
+
+private:
+  struct RegionHeader;
+  struct RingControl;
+
+  SharedMemoryRawChannel(std::unique_ptr<sys::fs::mapped_file_region> Region,
+                         int SharedMemoryFD, int InFD, int OutFD,
+                         bool IsExecutor);
+
+  Error waitUntil(function_ref<bool()> Ready);
+  Error publishOutput();
+  Error publishInputConsumed();
+  Error wakePeer();
+
+  std::unique_ptr<sys::fs::mapped_file_region> Region;
+  int SharedMemoryFD, InFD, OutFD;
+  unsigned Side;
+  unsigned SpinCount = 1024;
+  unsigned NumSleeps = 0;
+
+  RegionHeader *Header;
+  RingControl *OutRing, *InRing;
+  char *OutData, *InData;
+  uint64_t RingMask;
+
+  // How far we have written to the output ring, published as its Head.
+  uint64_t OutHead = 0;
+  // How far the other side had read the output ring when we last looked.
+  uint64_t OutTail = 0;
+  // How far we have read the input ring, published as its Tail.
+  uint64_t InTail = 0;
+  // How far the other side had written the input ring when we last looked.
+  uint64_t InHead = 0;
+
+  char *Heap;
+  uint64_t HeapSize;
+  // Free ranges of the heap, as offsets to sizes. Executor only.
+  std::map<uint64_t, uint64_t> FreeHeap;
+};
+
+} // end namespace rpc
+} // end namespace orc
+} // end namespace llvm
+
+#endif // LLVM_EXECUTIONENGINE_ORC_SHAREDMEMORYRAWCHANNEL_H
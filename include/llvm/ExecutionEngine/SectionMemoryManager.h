@@ -20,11 +20,86 @@
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
 #include "llvm/Support/Memory.h"
 #include <cstdint>
+#include <map>
+#include <mutex>
 #include <string>
 #include <system_error>
 
 namespace llvm {
 
+/// A pool of large memory regions ("slabs") that SectionMemoryManagers carve
+/// their memory from, instead of mapping memory from the system for every
+/// group of sections.
+///
+/// Code and data are kept in separate slabs. Code slabs can be backed by huge
+/// pages, to reduce iTLB misses when executing JITed code. Blocks are handed
+/// out at page granularity, so that the memory managers sharing a pool can
+/// apply permissions to their blocks independently. When a memory manager is
+/// destroyed, e.g. because the objects it holds were removed from the JIT, its
+/// blocks are returned to the pool, and slabs that become entirely unused are
+/// released to the system.
+///
+/// Changing the permissions of part of a huge page splits it into normal
+/// pages. So with huge pages, free code memory is kept read-execute, like
+/// finalized code, and only the blocks being written are read-write. Once all
+/// the blocks of a huge page are finalized, its permissions are uniform again.
+/// Memory managers make the whole of their code blocks executable when
+/// finalizing, rather than only the pages holding sections.
+///
+/// A pool is thread safe, and must outlive the memory managers using it.
+class SectionMemoryPool {
+public:
+  /// Create a pool that reserves memory from the system \p SlabSize bytes at a
+  /// time. If \p HugePagesForCode is true, code slabs are requested with
+  /// sys::Memory::MF_HUGE_HINT.
+  explicit SectionMemoryPool(size_t SlabSize = 16 * 1024 * 1024,
+                             bool HugePagesForCode = false)
+      : SlabSize(SlabSize), HugePagesForCode(HugePagesForCode) {}
+  SectionMemoryPool(const SectionMemoryPool &) = delete;
+  void operator=(const SectionMemoryPool &) = delete;
+  ~SectionMemoryPool();
+
+  /// Returns a read-write, page aligned block of at least \p Size bytes from
+  /// a code or data slab. On failure, returns an empty block and sets \p EC.
+  sys::MemoryBlock allocate(size_t Size, bool IsCode, std::error_code &EC);
+
+  /// Returns \p Block, obtained from allocate() with the same \p IsCode, to
+  /// the pool. Its pages are made read-write again, or read-execute for code
+  /// in huge pages.
+  std::error_code release(const sys::MemoryBlock &Block, bool IsCode);
+
+  /// Returns true if code slabs are backed by huge pages, in which case
+  /// memory managers should apply permissions to whole code blocks.
+  bool hasHugePageCode() const { return HugePagesForCode; }
+
+  /// Returns the number of slabs currently reserved from the system.
+  size_t getNumSlabs() const;
+
+  /// Returns the total size of the slabs currently reserved from the system.
+  size_t getReservedSize() const;
+
+  /// Returns the part of getReservedSize() not handed out to memory managers.
+  size_t getFreeSize() const;
+
+private:
+  struct Arena {
+    // All slabs of this arena, keyed by start address, mapping to their size.
+    std::map<uintptr_t, size_t> Slabs;
+    // Free ranges, keyed by start address, mapping to their size. Adjacent
+    // free ranges of the same slab are always merged.
+    std::map<uintptr_t, size_t> Free;
+  };
+
+  std::map<uintptr_t, size_t>::const_iterator findSlab(const Arena &A,
+                                                        uintptr_t Addr) const;
+
+  const size_t SlabSize;
+  const bool HugePagesForCode;
+  mutable std::mutex PoolMutex;
+  Arena CodeArena;
+  Arena DataArena;
+};
+
 /// This is a simple memory manager which implements the methods called by
 /// the RuntimeDyld class to allocate memory for section-based loading of
 /// objects, usually those generated by the MCJIT execution engine.
@@ -38,9 +113,14 @@ namespace llvm {
 /// in the JITed object.  Permissions can be applied either by calling
 /// MCJIT::finalizeObject or by calling SectionMemoryManager::finalizeMemory
 /// directly.  Clients of MCJIT should call MCJIT::finalizeObject.
+///
+/// By default, memory is mapped from the system as sections are allocated.
+/// Memory managers given a SectionMemoryPool take their memory from its slabs
+/// instead, and give it back to the pool when they are destroyed.
 class SectionMemoryManager : public RTDyldMemoryManager {
 public:
-  SectionMemoryManager() = default;
+  explicit SectionMemoryManager(SectionMemoryPool *Pool = nullptr)
+      : Pool(Pool) {}
   SectionMemoryManager(const SectionMemoryManager&) = delete;
   void operator=(const SectionMemoryManager&) = delete;
   ~SectionMemoryManager() override;
@@ -116,6 +196,7 @@ private:
   std::error_code applyMemoryGroupPermissions(MemoryGroup &MemGroup,
                                               unsigned Permissions);
 
+  SectionMemoryPool *Pool;
   MemoryGroup CodeMem;
   MemoryGroup RWDataMem;
   MemoryGroup RODataMem;
@@ -38,6 +38,18 @@ extern template void Calculate<Function, Inverse<BasicBlock *>>(
     DominatorTreeBaseByGraphTraits<GraphTraits<Inverse<BasicBlock *>>> &DT,
     Function &F);
 
+namespace DomTreeBuilder {
+extern template void InsertEdge<BasicBlock>(
+    DominatorTreeBase<BasicBlock> &DT, BasicBlock *From, BasicBlock *To);
+extern template void DeleteEdge<BasicBlock>(
+    DominatorTreeBase<BasicBlock> &DT, BasicBlock *From, BasicBlock *To);
+extern template void ApplyUpdates<BasicBlock>(
+    DominatorTreeBase<BasicBlock> &DT,
+    ArrayRef<DominatorTreeBase<BasicBlock>::UpdateType> Updates);
+extern template bool
+Verify<BasicBlock>(const DominatorTreeBase<BasicBlock> &DT);
+} // end namespace DomTreeBuilder
+
 typedef DomTreeNodeBase<BasicBlock> DomTreeNode;
 
 class BasicBlockEdge {
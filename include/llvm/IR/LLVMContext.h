@@ -263,6 +263,10 @@ public:
   /// \brief Access the object which manages optimization bisection for failure
   /// analysis.
   OptBisect &getOptBisect();
+
+  /// \brief Number of bytes owned by the bump pointer allocators of the
+  /// context. This memory is only released when the context is destroyed.
+  size_t getBumpAllocatedMemory() const;
 private:
   // Module needs access to the add/removeModule methods.
   friend class Module;
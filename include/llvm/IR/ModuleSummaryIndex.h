@@ -25,6 +25,7 @@
 #include "llvm/IR/Module.h"
 
 #include <array>
+#include <map>
 
 namespace llvm {
 
@@ -269,6 +270,26 @@ public:
   }
 };
 
+/// A virtual function slot: the GUID of a type identifier, and the byte offset
+/// of a function pointer from the address point of the vtables of that type.
+struct VFuncId {
+  GlobalValue::GUID TypeId;
+  uint64_t Offset;
+};
+
+/// A type identifier of a vtable, and the byte offset in the vtable of the
+/// address point for that type.
+struct VTableTypeId {
+  GlobalValue::GUID TypeId;
+  uint64_t AddressPoint;
+};
+
+/// A function pointer stored in a vtable, and its byte offset in the vtable.
+struct VTableFunc {
+  ValueInfo Func;
+  uint64_t Offset;
+};
+
 /// \brief Function summary information to aid decisions and implementation of
 /// importing.
 class FunctionSummary : public GlobalValueSummary {
@@ -287,6 +308,19 @@ private:
   /// List of type identifiers used by this function, represented as GUIDs.
   std::vector<GlobalValue::GUID> TypeIdList;
 
+  /// The virtual function slots called by this function through a vtable
+  /// pointer whose type is known from an llvm.assume of an llvm.type.test.
+  std::vector<VFuncId> TypeTestAssumeVCalls;
+
+  /// If non-zero, the function returns the ConstantReturnValue integer of
+  /// this many bits whatever its arguments, and has no side effects.
+  unsigned ConstantReturnBitWidth = 0;
+  uint64_t ConstantReturnValue = 0;
+
+  /// The global variables among the references that this function's module
+  /// only ever loads from.
+  std::vector<ValueInfo> ReadOnlyRefs;
+
 public:
   /// Summary constructors.
   FunctionSummary(GVFlags Flags, unsigned NumInsts, std::vector<ValueInfo> Refs,
@@ -309,15 +343,58 @@ public:
 
   /// Returns the list of type identifiers used by this function.
   ArrayRef<GlobalValue::GUID> type_tests() const { return TypeIdList; }
+
+  /// Returns the virtual function slots called by this function.
+  ArrayRef<VFuncId> type_test_assume_vcalls() const {
+    return TypeTestAssumeVCalls;
+  }
+
+  void setTypeTestAssumeVCalls(std::vector<VFuncId> VCalls) {
+    TypeTestAssumeVCalls = std::move(VCalls);
+  }
+
+  /// Check if the function is known to return a constant integer.
+  bool hasConstantReturn() const { return ConstantReturnBitWidth != 0; }
+  unsigned getConstantReturnBitWidth() const { return ConstantReturnBitWidth; }
+  uint64_t getConstantReturnValue() const { return ConstantReturnValue; }
+
+  void setConstantReturn(unsigned BitWidth, uint64_t Value) {
+    ConstantReturnBitWidth = BitWidth;
+    ConstantReturnValue = Value;
+  }
+
+  /// Returns the references to global variables that are only loaded from.
+  ArrayRef<ValueInfo> readonly_refs() const { return ReadOnlyRefs; }
+
+  void setReadOnlyRefs(std::vector<ValueInfo> Refs) {
+    ReadOnlyRefs = std::move(Refs);
+  }
 };
 
 /// \brief Global variable summary information to aid decisions and
 /// implementation of importing.
 ///
-/// Currently this doesn't add anything to the base \p GlobalValueSummary,
-/// but is a placeholder as additional info may be added to the summary
-/// for variables.
+/// For vtables, that is variables with type metadata, this also records the
+/// layout used by whole-program devirtualization.
 class GlobalVarSummary : public GlobalValueSummary {
+  /// The size of the vtable in bytes, its type identifiers and the function
+  /// pointers it holds; all empty unless the variable is a vtable. The
+  /// function pointers are only recorded for constant vtables.
+  uint64_t VTableSize = 0;
+  bool VTableIsConstant = false;
+  std::vector<VTableTypeId> VTableTypeIds;
+  std::vector<VTableFunc> VTableFuncs;
+
+  /// Set if the module defining the variable only ever loads from it: it is
+  /// never written and its address doesn't escape. Size is then the size of
+  /// the variable in bytes.
+  bool MaybeReadOnly = false;
+  uint64_t Size = 0;
+
+  /// Set by the thin link if no module writes to the variable or lets its
+  /// address escape, so that its copies can be imported and internalized
+  /// wherever it is referenced (see computeReadOnlyGlobals).
+  bool ReadOnly = false;
 
 public:
   /// Summary constructors.
@@ -328,6 +405,78 @@ public:
   static bool classof(const GlobalValueSummary *GVS) {
     return GVS->getSummaryKind() == GlobalVarKind;
   }
+
+  /// Check if the variable is a vtable, that is if it has type identifiers.
+  bool isVTable() const { return !VTableTypeIds.empty(); }
+
+  /// Check if the variable is a vtable that devirtualization can look into. A
+  /// vtable that may be written to could hold any function at run time.
+  bool isConstantVTable() const { return isVTable() && VTableIsConstant; }
+
+  uint64_t getVTableSize() const { return VTableSize; }
+  ArrayRef<VTableTypeId> vtable_type_ids() const { return VTableTypeIds; }
+  ArrayRef<VTableFunc> vtable_funcs() const { return VTableFuncs; }
+
+  void setVTableInfo(uint64_t Size, bool IsConstant,
+                     std::vector<VTableTypeId> TypeIds,
+                     std::vector<VTableFunc> Funcs) {
+    VTableSize = Size;
+    VTableIsConstant = IsConstant;
+    VTableTypeIds = std::move(TypeIds);
+    VTableFuncs = std::move(Funcs);
+  }
+
+  bool maybeReadOnly() const { return MaybeReadOnly; }
+  uint64_t getSize() const { return Size; }
+
+  void setMaybeReadOnly(uint64_t VarSize) {
+    MaybeReadOnly = true;
+    Size = VarSize;
+  }
+
+  bool isReadOnly() const { return ReadOnly; }
+  void setReadOnly(bool RO) { ReadOnly = RO; }
+};
+
+/// How the thin link devirtualized the calls through a virtual function slot.
+struct WholeProgramDevirtResolution {
+  enum Kind {
+    /// Call the only implementation, SingleImplName, directly.
+    SingleImpl,
+    /// Replace the calls with RetVal, which all implementations return.
+    UniformRetVal,
+    /// Load the return value from the vtable at Byte from the address point,
+    /// or for one-bit values test Bit of that byte.
+    VirtualConstProp,
+  } TheKind = SingleImpl;
+
+  std::string SingleImplName;
+  uint64_t RetVal = 0;
+  int64_t Byte = 0;
+  unsigned Bit = 0;
+  /// The width of the return value, for UniformRetVal and VirtualConstProp.
+  unsigned BitWidth = 0;
+};
+
+/// A return value that virtual constant propagation stores next to a vtable,
+/// as decided by the thin link. The backends of the modules defining the
+/// vtable lay it out again from these.
+struct VirtualConstPropValue {
+  /// The address point of the vtable that the value is stored for.
+  uint64_t AddressPoint;
+  bool IsAfter;
+  /// Where the value goes, in bits away from the address point, as computed
+  /// by wholeprogramdevirt::findLowestOffset.
+  uint64_t Pos;
+  unsigned BitWidth;
+  uint64_t Value;
+};
+
+/// The values that virtual constant propagation stores next to a vtable, and
+/// the name of the vtable after promotion.
+struct VirtualConstPropVTable {
+  std::string Name;
+  std::vector<VirtualConstPropValue> Values;
 };
 
 /// 160 bits SHA1
@@ -370,6 +519,17 @@ private:
   /// Holds strings for combined index, mapping to the corresponding module ID.
   ModulePathStringTableTy ModulePathStringTable;
 
+  /// Names of the vtables and of the functions they hold, which whole-program
+  /// devirtualization needs to refer to them from other modules.
+  std::map<GlobalValue::GUID, std::string> DevirtValueNames;
+
+  /// Devirtualization decisions of the thin link, by virtual function slot
+  /// (type identifier GUID and offset), and the values that virtual constant
+  /// propagation stores next to vtables, by vtable GUID.
+  std::map<std::pair<GlobalValue::GUID, uint64_t>, WholeProgramDevirtResolution>
+      DevirtResolutions;
+  std::map<GlobalValue::GUID, VirtualConstPropVTable> VirtualConstPropVTables;
+
 public:
   gvsummary_iterator begin() { return GlobalValueMap.begin(); }
   const_gvsummary_iterator begin() const { return GlobalValueMap.begin(); }
@@ -439,6 +599,17 @@ public:
   GlobalValueSummary *getGlobalValueSummary(GlobalValue::GUID ValueGUID,
                                             bool PerModuleIndex = true) const;
 
+  /// Returns the summary of the global variable \p ValueGUID if the thin link
+  /// found it to be read-only, or nullptr otherwise.
+  const GlobalVarSummary *
+  getReadOnlyGlobalVarSummary(GlobalValue::GUID ValueGUID) const {
+    auto Summaries = findGlobalValueSummaryList(ValueGUID);
+    if (Summaries == end() || Summaries->second.size() != 1)
+      return nullptr;
+    auto *GVS = dyn_cast<GlobalVarSummary>(Summaries->second.front().get());
+    return GVS && GVS->isReadOnly() ? GVS : nullptr;
+  }
+
   /// Table of modules, containing module hash and id.
   const StringMap<std::pair<uint64_t, ModuleHash>> &modulePaths() const {
     return ModulePathStringTable;
@@ -461,6 +632,54 @@ public:
     return It->second.second;
   }
 
+  /// Record the name of the vtable or virtual function \p ValueGUID.
+  void addDevirtValueName(GlobalValue::GUID ValueGUID, StringRef Name) {
+    DevirtValueNames[ValueGUID] = Name;
+  }
+
+  /// Get the name recorded for \p ValueGUID, or an empty string.
+  StringRef getDevirtValueName(GlobalValue::GUID ValueGUID) const {
+    auto I = DevirtValueNames.find(ValueGUID);
+    return I == DevirtValueNames.end() ? StringRef() : StringRef(I->second);
+  }
+
+  const std::map<GlobalValue::GUID, std::string> &devirtValueNames() const {
+    return DevirtValueNames;
+  }
+
+  /// Get the devirtualization of the slot at \p Offset in the vtables of
+  /// \p TypeId, or nullptr if its calls stay indirect.
+  const WholeProgramDevirtResolution *
+  getDevirtResolution(GlobalValue::GUID TypeId, uint64_t Offset) const {
+    auto I = DevirtResolutions.find({TypeId, Offset});
+    return I == DevirtResolutions.end() ? nullptr : &I->second;
+  }
+
+  void setDevirtResolution(GlobalValue::GUID TypeId, uint64_t Offset,
+                           WholeProgramDevirtResolution Res) {
+    DevirtResolutions[{TypeId, Offset}] = std::move(Res);
+  }
+
+  /// Get the values to store next to the vtable \p VTableGUID, or nullptr.
+  const VirtualConstPropVTable *
+  getVirtualConstPropVTable(GlobalValue::GUID VTableGUID) const {
+    auto I = VirtualConstPropVTables.find(VTableGUID);
+    return I == VirtualConstPropVTables.end() ? nullptr : &I->second;
+  }
+
+  VirtualConstPropVTable &getOrCreateVirtualConstPropVTable(
+      GlobalValue::GUID VTableGUID) {
+    return VirtualConstPropVTables[VTableGUID];
+  }
+
+  const std::map<GlobalValue::GUID, VirtualConstPropVTable> &
+  virtualConstPropVTables() const {
+    return VirtualConstPropVTables;
+  }
+
+  /// Check if the thin link devirtualized anything.
+  bool hasDevirtResolutions() const { return !DevirtResolutions.empty(); }
+
   /// Add the given per-module index into this module index/summary,
   /// assigning it the given module ID. Each module merged in should have
   /// a unique ID, necessary for consistent renaming of promoted
@@ -468,6 +687,11 @@ public:
   void mergeFrom(std::unique_ptr<ModuleSummaryIndex> Other,
                  uint64_t NextModuleId);
 
+  /// Add a copy of the given per-module index into this module index/summary,
+  /// like the above, but leave \p Other untouched so that it can be merged
+  /// into other combined indexes.
+  void mergeFrom(const ModuleSummaryIndex &Other, uint64_t NextModuleId);
+
   /// Convenience method for creating a promoted global name
   /// for the given value name of a local, and its original module's ID.
   static std::string getGlobalNameForLocal(StringRef Name, ModuleHash ModHash) {
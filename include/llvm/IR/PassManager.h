@@ -44,7 +44,9 @@
 #include "llvm/IR/Function.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManagerInternal.h"
+#include "llvm/IR/PassMemoryReport.h"
 #include "llvm/Support/Debug.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/TypeName.h"
 #include "llvm/Support/raw_ostream.h"
 #include "llvm/Support/type_traits.h"
@@ -279,7 +281,13 @@ public:
         dbgs() << "Running pass: " << Passes[Idx]->name() << " on "
                << IR.getName() << "\n";
 
-      PreservedAnalyses PassPA = Passes[Idx]->run(IR, AM, ExtraArgs...);
+      PreservedAnalyses PassPA;
+      {
+        TimeTraceScope PassScope(Passes[Idx]->name(),
+                                 [&]() -> std::string { return IR.getName(); });
+        PassMemoryRecorder MemoryRecorder(Passes[Idx]->name(), IR);
+        PassPA = Passes[Idx]->run(IR, AM, ExtraArgs...);
+      }
 
       // Update the analysis manager as each pass runs and potentially
       // invalidates analyses.
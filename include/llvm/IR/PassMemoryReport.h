@@ -0,0 +1,71 @@
+//===- llvm/IR/PassMemoryReport.h - Per-pass memory and IR size -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file declares the instrumentation recording, for every pass execution,
+/// the change in heap and LLVMContext memory and the IR size before and after
+/// the pass. It is enabled with -pass-memory-report=<file>, and the report is
+/// written as CSV or JSON (-pass-memory-report-format) on llvm_shutdown().
+///
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_IR_PASSMEMORYREPORT_H
+#define LLVM_IR_PASSMEMORYREPORT_H
+
+#include "llvm/ADT/StringRef.h"
+#include <cstddef>
+#include <string>
+
+namespace llvm {
+
+class Function;
+class Module;
+
+/// Returns true if pass executions should be recorded.
+bool isPassMemoryReportEnabled();
+
+/// Memory usage and IR size at a point in time.
+struct PassMemorySnapshot {
+  /// Bytes allocated with malloc by the whole process.
+  size_t MallocBytes = 0;
+  /// Bytes owned by the bump pointer allocators of the LLVMContext.
+  size_t ContextBytes = 0;
+  unsigned NumInstructions = 0;
+  unsigned NumBasicBlocks = 0;
+
+  static PassMemorySnapshot get(const Function &F);
+  static PassMemorySnapshot get(const Module &M);
+};
+
+/// Records one pass execution in the report, from construction to
+/// destruction. Nothing is done if the report is not enabled.
+///
+/// Only module and function passes are recorded. Passes running on other IR
+/// units are accounted for by the enclosing module or function pass.
+class PassMemoryRecorder {
+public:
+  PassMemoryRecorder(StringRef PassName, const Function &F);
+  PassMemoryRecorder(StringRef PassName, const Module &M);
+  template <typename IRUnitT>
+  PassMemoryRecorder(StringRef PassName, const IRUnitT &) {}
+  ~PassMemoryRecorder();
+
+private:
+  PassMemoryRecorder(const PassMemoryRecorder &) = delete;
+  void operator=(const PassMemoryRecorder &) = delete;
+
+  const Function *F = nullptr;
+  const Module *M = nullptr;
+  StringRef PassName;
+  PassMemorySnapshot Before;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_IR_PASSMEMORYREPORT_H
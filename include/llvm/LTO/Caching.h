@@ -16,20 +16,57 @@
 #define LLVM_LTO_CACHING_H
 
 #include "llvm/LTO/LTO.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include <atomic>
 #include <string>
 
 namespace llvm {
+
+class raw_ostream;
+
 namespace lto {
 
 /// This type defines the callback to add a pre-existing native object file
-/// (e.g. in a cache).
+/// (e.g. in a cache). The identifier of \p MB is the path of the file.
+///
+/// Buffer callbacks must be thread safe.
+typedef std::function<void(unsigned Task, std::unique_ptr<MemoryBuffer> MB)>
+    AddBufferFn;
+
+/// This type defines the callback to add a pre-existing native object file by
+/// its path. It predates AddBufferFn, and is only kept for compatibility: a
+/// concurrent link may prune the file before it is opened.
 ///
 /// File callbacks must be thread safe.
 typedef std::function<void(unsigned Task, StringRef Path)> AddFileFn;
 
+/// Statistics about the use of a cache by a link.
+struct CacheStats {
+  std::atomic<unsigned> Hits{0};
+  std::atomic<unsigned> Misses{0};
+  /// The size of the entries that were hit.
+  std::atomic<uint64_t> BytesHit{0};
+  /// The size of the entries that were added to the cache.
+  std::atomic<uint64_t> BytesWritten{0};
+
+  void print(raw_ostream &OS) const;
+};
+
 /// Create a local file system cache which uses the given cache directory and
-/// file callback.
-NativeObjectCache localCache(std::string CacheDirectoryPath, AddFileFn AddFile);
+/// buffer callback. Cache hits are passed to \p AddBuffer as buffers mapping
+/// the cache entries. New entries are written to temporary files in the cache
+/// directory and renamed into place, so that several processes can share the
+/// cache. Every entry created or used is recorded in the access index of the
+/// directory, from which CachePruning prunes it. If \p Stats is not null, the
+/// hits, misses and bytes of the cache are counted in it.
+NativeObjectCache localCache(std::string CacheDirectoryPath,
+                             AddBufferFn AddBuffer,
+                             CacheStats *Stats = nullptr);
+
+/// Create a local file system cache which passes the paths of the cache
+/// entries to \p AddFile. Prefer the AddBufferFn overload.
+NativeObjectCache localCache(std::string CacheDirectoryPath, AddFileFn AddFile,
+                             CacheStats *Stats = nullptr);
 
 } // namespace lto
 } // namespace llvm
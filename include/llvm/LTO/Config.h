@@ -47,6 +47,13 @@ struct Config {
   /// Disable entirely the optimizer, including importing for ThinLTO
   bool CodeGenOnly = false;
 
+  /// If greater than one, the function simplification passes of the regular
+  /// LTO pipeline run concurrently on this many partitions of the merged
+  /// module, each in its own context. The IPO passes still see the whole
+  /// module. Only used with the old pass manager pipeline, at OptLevel 2 and
+  /// above, and for modules without debug info.
+  unsigned OptParallelismLevel = 1;
+
   /// If this field is set, the set of passes run in the middle-end optimizer
   /// will be the one specified by the string. Only works with the new pass
   /// manager as the old one doesn't have this ability.
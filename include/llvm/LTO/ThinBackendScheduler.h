@@ -0,0 +1,98 @@
+//===- ThinBackendScheduler.h - ThinLTO backend job scheduling --*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the scheduler used to run the ThinLTO backend jobs of a
+// link in parallel, and the cost estimate it orders them by.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_LTO_THINBACKENDSCHEDULER_H
+#define LLVM_LTO_THINBACKENDSCHEDULER_H
+
+#include "llvm/ADT/StringRef.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/Transforms/IPO/FunctionImport.h"
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace llvm {
+
+class raw_ostream;
+class ThreadPool;
+
+namespace lto {
+
+/// Estimate the cost of the backend job of a module from the combined index:
+/// the number of instructions of the functions defined in the module, given
+/// by \p DefinedGlobals, plus those of the functions in \p ImportList.
+uint64_t estimateThinBackendCost(const ModuleSummaryIndex &Index,
+                                 const GVSummaryMapTy &DefinedGlobals,
+                                 const FunctionImporter::ImportMapTy &ImportList);
+
+/// Runs the backend jobs of a ThinLTO link on a thread pool.
+///
+/// Jobs are started most expensive first, so that a few large modules don't
+/// end up on the critical path of the link while the other threads sit idle.
+/// The threads of the pool pull jobs from a shared queue, so this order holds
+/// whatever order the pool itself runs its tasks in.
+///
+/// With -thinlto-backend-memory-limit, a job only starts while the estimated
+/// memory use of the running jobs stays within the limit, which keeps several
+/// huge backends from running at the same time. With -thinlto-backend-stats,
+/// the wall time of every job and the peak RSS of the process are printed once
+/// all jobs completed.
+class ThinBackendScheduler {
+public:
+  typedef std::function<void()> JobFn;
+
+  ThinBackendScheduler();
+
+  /// Queue the job \p Job for the module \p Name, with the cost \p Cost as
+  /// computed by estimateThinBackendCost. Jobs only start in run().
+  void addJob(StringRef Name, uint64_t Cost, JobFn Job);
+
+  /// Run the queued jobs on \p Pool and wait for them to complete. The pool
+  /// must not be running other tasks.
+  void run(ThreadPool &Pool);
+
+private:
+  struct Job {
+    std::string Name;
+    uint64_t Cost;
+    JobFn Fn;
+    double Seconds;
+    size_t PeakRSS;
+  };
+
+  /// The body of the worker tasks: run jobs until the queue is empty.
+  void runJobs();
+
+  /// Return the estimated memory use of \p J, in bytes.
+  uint64_t getMemoryEstimate(const Job &J) const;
+
+  void printStats(raw_ostream &OS, double Seconds) const;
+
+  std::vector<Job> Jobs;
+  uint64_t MemoryLimit;
+
+  /// Guards the scheduling state below.
+  std::mutex Lock;
+  std::condition_variable JobCompleted;
+  size_t NextJob;
+  unsigned NumRunning;
+  uint64_t RunningMemory;
+};
+
+} // namespace lto
+} // namespace llvm
+
+#endif
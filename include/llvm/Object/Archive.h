@@ -14,6 +14,7 @@
 #ifndef LLVM_OBJECT_ARCHIVE_H
 #define LLVM_OBJECT_ARCHIVE_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/ADT/iterator_range.h"
@@ -237,7 +238,10 @@ public:
     return v->isArchive();
   }
 
-  // check if a symbol is in the archive
+  /// Check if a symbol is in the archive, and return the member defining it.
+  /// The first call builds a hash index of the symbol table, so that this and
+  /// all later lookups take constant time. Like getBuffer() on thin archives,
+  /// this is not safe to call concurrently on the same Archive.
   Expected<Optional<Child>> findSym(StringRef name) const;
 
   bool isEmpty() const;
@@ -261,6 +265,12 @@ private:
   unsigned Format : 3;
   unsigned IsThin : 1;
   mutable std::vector<std::unique_ptr<MemoryBuffer>> ThinBuffers;
+
+  /// Maps each symbol name to its first entry in the symbol table. Built on
+  /// the first call to findSym(); the names point into the archive buffer.
+  mutable DenseMap<StringRef, Symbol> SymbolMap;
+  mutable bool HasSymbolMap = false;
+  void buildSymbolMap() const;
 };
 
 }
@@ -415,6 +415,10 @@ public:
   ArrayRef<ExpansionRecord> getExpansions() const { return Expansions; }
 };
 
+/// \brief If true, CoverageMapping::load() times each of its phases. The times
+/// are reported when llvm_shutdown() is called.
+extern bool TimeLoadIsEnabled;
+
 /// \brief The mapping of profile information to coverage data.
 ///
 /// This is the main interface to get coverage information, using a profile to
@@ -429,9 +433,11 @@ class CoverageMapping {
   CoverageMapping(const CoverageMapping &) = delete;
   const CoverageMapping &operator=(const CoverageMapping &) = delete;
 
-  /// \brief Add a function record corresponding to \p Record.
-  Error loadFunctionRecord(const CoverageMappingRecord &Record,
-                           IndexedInstrProfReader &ProfileReader);
+  /// \brief Add the function records read by \p CoverageReader. The records
+  /// are decoded and have their counters evaluated in parallel, a chunk at a
+  /// time, and are then added in the order of the reader.
+  Error loadFunctionRecords(CoverageMappingReader &CoverageReader,
+                            IndexedInstrProfReader &ProfileReader);
 
 public:
   /// \brief Load the coverage mapping using the given readers.
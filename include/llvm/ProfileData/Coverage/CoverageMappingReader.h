@@ -39,6 +39,14 @@ struct CoverageMappingRecord {
   ArrayRef<CounterMappingRegion> MappingRegions;
 };
 
+/// \brief Owns the arrays of a CoverageMappingRecord decoded by
+/// CoverageMappingReader::readRecord().
+struct CoverageMappingRecordStorage {
+  std::vector<StringRef> Filenames;
+  std::vector<CounterExpression> Expressions;
+  std::vector<CounterMappingRegion> MappingRegions;
+};
+
 /// \brief A file format agnostic iterator over coverage mapping data.
 class CoverageMappingIterator
     : public std::iterator<std::input_iterator_tag, CoverageMappingRecord> {
@@ -70,6 +78,17 @@ public:
 class CoverageMappingReader {
 public:
   virtual Error readNextRecord(CoverageMappingRecord &Record) = 0;
+
+  /// \brief Return the number of records that readRecord() can decode, or 0
+  /// if the records can only be read in sequence with readNextRecord().
+  virtual size_t getNumRecords() const { return 0; }
+
+  /// \brief Decode the record at \p Index, keeping its arrays in \p Storage.
+  /// This doesn't change the state of the reader, so several records may be
+  /// decoded concurrently.
+  virtual Error readRecord(size_t Index, CoverageMappingRecord &Record,
+                           CoverageMappingRecordStorage &Storage) const;
+
   CoverageMappingIterator begin() { return CoverageMappingIterator(this); }
   CoverageMappingIterator end() { return CoverageMappingIterator(); }
   virtual ~CoverageMappingReader() {}
@@ -170,9 +189,7 @@ private:
   std::vector<ProfileMappingRecord> MappingRecords;
   InstrProfSymtab ProfileNames;
   size_t CurrentRecord;
-  std::vector<StringRef> FunctionsFilenames;
-  std::vector<CounterExpression> Expressions;
-  std::vector<CounterMappingRegion> MappingRegions;
+  CoverageMappingRecordStorage CurrentStorage;
 
   BinaryCoverageReader(const BinaryCoverageReader &) = delete;
   BinaryCoverageReader &operator=(const BinaryCoverageReader &) = delete;
@@ -185,6 +202,10 @@ public:
          StringRef Arch);
 
   Error readNextRecord(CoverageMappingRecord &Record) override;
+
+  size_t getNumRecords() const override { return MappingRecords.size(); }
+  Error readRecord(size_t Index, CoverageMappingRecord &Record,
+                   CoverageMappingRecordStorage &Storage) const override;
 };
 
 } // end namespace coverage
@@ -18,6 +18,7 @@
 #include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/StringExtras.h"
 #include "llvm/ProfileData/InstrProf.h"
+#include "llvm/Support/Endian.h"
 #include "llvm/Support/EndianStream.h"
 #include "llvm/Support/LineIterator.h"
 #include "llvm/Support/MemoryBuffer.h"
@@ -252,6 +253,19 @@ namespace IndexedInstrProf {
 enum class HashT : uint32_t;
 }
 
+/// A view of a single function record in the indexed instrprof format. It
+/// points straight into the profile data, so it is only valid for as long as
+/// the reader that returned it.
+struct InstrProfRecordView {
+  /// The structural hash of the function.
+  uint64_t Hash = 0;
+  /// The counter values, stored little-endian and possibly unaligned.
+  ArrayRef<support::ulittle64_t> Counts;
+  /// The serialized value profile data, empty for format versions without
+  /// value profiling.
+  ArrayRef<unsigned char> ValueData;
+};
+
 /// Trait for lookups into the on-disk hash table for the binary instrprof
 /// format.
 class InstrProfLookupTrait {
@@ -293,10 +307,16 @@ public:
     return StringRef((const char *)D, N);
   }
 
-  bool readValueProfilingData(const unsigned char *&D,
-                              const unsigned char *const End);
+  bool readValueProfilingData(ArrayRef<unsigned char> ValueData,
+                              InstrProfRecord &Record);
   data_type ReadData(StringRef K, const unsigned char *D, offset_type N);
 
+  /// Parse the record starting at \p D without copying any of its data, and
+  /// advance \p D past it. \p N is the size of all the records of the key.
+  /// Return false if the record is corrupt.
+  bool readRecordView(const unsigned char *&D, const unsigned char *const End,
+                      offset_type N, InstrProfRecordView &View);
+
   // Used for testing purpose only.
   void setValueProfDataEndianness(support::endianness Endianness) {
     ValueProfDataEndianness = Endianness;
@@ -310,6 +330,13 @@ struct InstrProfReaderIndexBase {
   // Read all the profile records with the key equal to FuncName
   virtual Error getRecords(StringRef FuncName,
                                      ArrayRef<InstrProfRecord> &Data) = 0;
+  // Find the record with the key equal to FuncName and the given hash,
+  // without decoding it or any other record with the same key.
+  virtual Error getRecordView(StringRef FuncName, uint64_t FuncHash,
+                              InstrProfRecordView &View) = 0;
+  // Decode the record that View points to.
+  virtual Error readRecord(StringRef FuncName, const InstrProfRecordView &View,
+                           InstrProfRecord &Record) = 0;
   virtual void advanceToNextKey() = 0;
   virtual bool atEnd() const = 0;
   virtual void setValueProfDataEndianness(support::endianness Endianness) = 0;
@@ -339,6 +366,10 @@ public:
   Error getRecords(ArrayRef<InstrProfRecord> &Data) override;
   Error getRecords(StringRef FuncName,
                    ArrayRef<InstrProfRecord> &Data) override;
+  Error getRecordView(StringRef FuncName, uint64_t FuncHash,
+                      InstrProfRecordView &View) override;
+  Error readRecord(StringRef FuncName, const InstrProfRecordView &View,
+                   InstrProfRecord &Record) override;
   void advanceToNextKey() override { RecordIterator++; }
   bool atEnd() const override {
     return RecordIterator == HashTable->data_end();
@@ -365,6 +396,8 @@ private:
   std::unique_ptr<InstrProfReaderIndexBase> Index;
   /// Profile summary data.
   std::unique_ptr<ProfileSummary> Summary;
+  /// Index of the next record to return from the current key's records.
+  unsigned RecordIndex;
 
   IndexedInstrProfReader(const IndexedInstrProfReader &) = delete;
   IndexedInstrProfReader &operator=(const IndexedInstrProfReader &) = delete;
@@ -379,7 +412,7 @@ public:
   uint64_t getVersion() const { return Index->getVersion(); }
   bool isIRLevelProfile() const override { return Index->isIRLevelProfile(); }
   IndexedInstrProfReader(std::unique_ptr<MemoryBuffer> DataBuffer)
-      : DataBuffer(std::move(DataBuffer)), Index(nullptr) {}
+      : DataBuffer(std::move(DataBuffer)), Index(nullptr), RecordIndex(0) {}
 
   /// Return true if the given buffer is in an indexed instrprof format.
   static bool hasFormat(const MemoryBuffer &DataBuffer);
@@ -398,6 +431,13 @@ public:
   Error getFunctionCounts(StringRef FuncName, uint64_t FuncHash,
                           std::vector<uint64_t> &Counts);
 
+  /// Point Counts at the profile data for the given function name. Unlike
+  /// getFunctionCounts this neither allocates nor decodes the record, and
+  /// the counters stay valid for as long as the reader. It doesn't change the
+  /// state of the reader either, so it may be called from several threads.
+  Error getFunctionCounterView(StringRef FuncName, uint64_t FuncHash,
+                               ArrayRef<support::ulittle64_t> &Counts);
+
   /// Return the maximum of all known function counts.
   uint64_t getMaximumFunctionCount() { return Summary->getMaxFunctionCount(); }
 
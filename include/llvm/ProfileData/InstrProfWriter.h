@@ -29,7 +29,7 @@ class InstrProfRecordWriterTrait;
 
 class InstrProfWriter {
 public:
-  typedef SmallDenseMap<uint64_t, InstrProfRecord, 1> ProfilingData;
+  typedef SmallDenseMap<uint64_t, InstrProfRecord> ProfilingData;
   enum ProfKind { PF_Unknown = 0, PF_FE, PF_IRLevel };
 
 private:
@@ -17,11 +17,18 @@
 
 #include "llvm/ADT/StringRef.h"
 #include <chrono>
+#include <string>
 
 namespace llvm {
 
 /// Handle pruning a directory provided a path and some options to control what
 /// to prune.
+///
+/// Caches that call recordAccess() for every entry they create or use keep an
+/// access index in the directory, which has the size and last access time of
+/// the entries it lists. Every file in the directory is a candidate for
+/// pruning; the access time of the files that the index doesn't list is taken
+/// from the file system.
 class CachePruning {
 public:
   /// Prepare to prune \p Path.
@@ -53,16 +60,37 @@ public:
     return *this;
   }
 
+  /// Define the maximum size for the cache directory, in bytes. This can be
+  /// combined with setMaxSize(), in which case the cache is pruned until both
+  /// limits are met. A value of 0 disable this limit.
+  CachePruning &setMaxSizeBytes(uint64_t Bytes) {
+    MaxSizeBytes = Bytes;
+    return *this;
+  }
+
   /// Peform pruning using the supplied options, returns true if pruning
   /// occured, i.e. if PruningInterval was expired.
   bool prune();
 
+  /// Record in the access index of the cache directory \p Path that the entry
+  /// \p EntryName, of \p Size bytes, was just created or used. This is safe
+  /// to call from several threads and processes at once, and while the cache
+  /// is being pruned.
+  static void recordAccess(StringRef Path, StringRef EntryName, uint64_t Size);
+
+  /// Rewrite the access index of the cache directory \p Path with a single
+  /// record for each entry still in the directory. recordAccess() does this
+  /// once the index is over 1 MiB and twice its size after the last rewrite,
+  /// so that the index of a cache that is never pruned stays bounded.
+  static void compactIndex(StringRef Path);
+
 private:
   // Options that matches the setters above.
   std::string Path;
   std::chrono::seconds Expiration = std::chrono::seconds::zero();
   std::chrono::seconds Interval = std::chrono::seconds::zero();
   unsigned PercentageOfAvailableSpace = 0;
+  uint64_t MaxSizeBytes = 0;
 };
 
 } // namespace llvm
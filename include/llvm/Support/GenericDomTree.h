@@ -24,6 +24,7 @@
 #ifndef LLVM_SUPPORT_GENERICDOMTREE_H
 #define LLVM_SUPPORT_GENERICDOMTREE_H
 
+#include "llvm/ADT/ArrayRef.h"
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/DepthFirstIterator.h"
 #include "llvm/ADT/GraphTraits.h"
@@ -38,6 +39,14 @@ namespace llvm {
 
 template <class NodeT> class DominatorTreeBase;
 
+namespace DomTreeBuilder {
+template <class NodeT, bool IsPostDom> struct SemiNCAInfo;
+
+/// Returns true if dominator trees are built with the Semi-NCA algorithm
+/// instead of Lengauer-Tarjan, as selected by -dom-tree-semi-nca.
+bool useSemiNCA();
+} // end namespace DomTreeBuilder
+
 namespace detail {
 
 template <typename GT> struct DominatorTreeBaseTraits {
@@ -91,10 +100,13 @@ struct PostDominatorTree;
 template <class NodeT> class DomTreeNodeBase {
   NodeT *TheBB;
   DomTreeNodeBase<NodeT> *IDom;
+  unsigned Level;
   std::vector<DomTreeNodeBase<NodeT> *> Children;
   mutable int DFSNumIn, DFSNumOut;
 
   template <class N> friend class DominatorTreeBase;
+  template <class N, bool IsPostDom>
+  friend struct DomTreeBuilder::SemiNCAInfo;
   friend struct PostDominatorTree;
 
 public:
@@ -114,7 +126,12 @@ public:
   }
 
   DomTreeNodeBase(NodeT *BB, DomTreeNodeBase<NodeT> *iDom)
-      : TheBB(BB), IDom(iDom), DFSNumIn(-1), DFSNumOut(-1) {}
+      : TheBB(BB), IDom(iDom), Level(iDom ? iDom->Level + 1 : 0),
+        DFSNumIn(-1), DFSNumOut(-1) {}
+
+  /// getLevel - Return the depth of this node in the tree. The root node is at
+  /// level 0.
+  unsigned getLevel() const { return Level; }
 
   std::unique_ptr<DomTreeNodeBase<NodeT>>
   addChild(std::unique_ptr<DomTreeNodeBase<NodeT>> C) {
@@ -157,6 +174,8 @@ public:
       // Switch to new dominator
       IDom = NewIDom;
       IDom->Children.push_back(this);
+
+      UpdateLevel();
     }
   }
 
@@ -173,6 +192,24 @@ private:
     return this->DFSNumIn >= other->DFSNumIn &&
            this->DFSNumOut <= other->DFSNumOut;
   }
+
+  // Recompute the levels of this node and of its descendants after its
+  // immediate dominator changed.
+  void UpdateLevel() {
+    assert(IDom);
+    if (Level == IDom->Level + 1)
+      return;
+
+    SmallVector<DomTreeNodeBase<NodeT> *, 64> WorkStack = {this};
+    while (!WorkStack.empty()) {
+      DomTreeNodeBase<NodeT> *Current = WorkStack.pop_back_val();
+      Current->Level = Current->IDom->Level + 1;
+
+      for (DomTreeNodeBase<NodeT> *C : *Current)
+        if (C->Level != Current->Level + 1)
+          WorkStack.push_back(C);
+    }
+  }
 };
 
 template <class NodeT>
@@ -201,6 +238,19 @@ void PrintDomTree(const DomTreeNodeBase<NodeT> *N, raw_ostream &o,
 template <class FuncT, class N>
 void Calculate(DominatorTreeBaseByGraphTraits<GraphTraits<N>> &DT, FuncT &F);
 
+// So are the incremental update routines.
+namespace DomTreeBuilder {
+template <class NodeT>
+void InsertEdge(DominatorTreeBase<NodeT> &DT, NodeT *From, NodeT *To);
+template <class NodeT>
+void DeleteEdge(DominatorTreeBase<NodeT> &DT, NodeT *From, NodeT *To);
+template <class NodeT>
+void ApplyUpdates(
+    DominatorTreeBase<NodeT> &DT,
+    ArrayRef<typename DominatorTreeBase<NodeT>::UpdateType> Updates);
+template <class NodeT> bool Verify(const DominatorTreeBase<NodeT> &DT);
+} // end namespace DomTreeBuilder
+
 /// \brief Core dominator tree base class.
 ///
 /// This class is a generic template over graph nodes. It is instantiated for
@@ -619,6 +669,41 @@ public:
     DomTreeNodes.erase(BB);
   }
 
+  /// The kind of a CFG change passed to applyUpdates.
+  enum UpdateKind { Insert, Delete };
+
+  /// A single CFG edge insertion or deletion.
+  struct UpdateType {
+    UpdateKind Kind;
+    NodeT *From;
+    NodeT *To;
+  };
+
+  /// insertEdge - Update the tree after the edge From -> To was added to the
+  /// CFG. This may make new blocks reachable, which are added to the tree.
+  void insertEdge(NodeT *From, NodeT *To) {
+    DomTreeBuilder::InsertEdge(*this, From, To);
+  }
+
+  /// deleteEdge - Update the tree after the edge From -> To was removed from
+  /// the CFG. Blocks that are no longer reachable are removed from the tree.
+  void deleteEdge(NodeT *From, NodeT *To) {
+    DomTreeBuilder::DeleteEdge(*this, From, To);
+  }
+
+  /// applyUpdates - Update the tree after a batch of edge insertions and
+  /// deletions, all of which must already have been applied to the CFG.
+  /// Updates that cancel out are ignored, and a large batch falls back to
+  /// recalculating the tree.
+  void applyUpdates(ArrayRef<UpdateType> Updates) {
+    DomTreeBuilder::ApplyUpdates(*this, Updates);
+  }
+
+  /// verify - Check this tree, including the cached node levels, against a
+  /// tree computed from scratch. Prints both trees to errs() and returns false
+  /// if they differ. This is expensive.
+  bool verify() const { return DomTreeBuilder::Verify(*this); }
+
   /// splitBlock - BB is split and now it has one successor. Update dominator
   /// tree to reflect this change.
   void splitBlock(NodeT *NewBB) {
@@ -660,6 +745,9 @@ protected:
   friend void Calculate(DominatorTreeBaseByGraphTraits<GraphTraits<N>> &DT,
                         FuncT &F);
 
+  template <class N, bool IsPostDom>
+  friend struct DomTreeBuilder::SemiNCAInfo;
+
   DomTreeNodeBase<NodeT> *getNodeForBlock(NodeT *BB) {
     if (DomTreeNodeBase<NodeT> *Node = getNode(BB))
       return Node;
@@ -19,13 +19,31 @@
 /// out that the theoretically slower O(n*log(n)) implementation is actually
 /// faster than the almost-linear O(n*alpha(n)) version, even for large CFGs.
 ///
+/// With -dom-tree-semi-nca, trees are instead built with the Semi-NCA
+/// algorithm, which keeps its per-node data in vectors indexed by DFS number
+/// rather than in the Info map, and is faster on very large CFGs.
+///
+/// It also provides the incremental updates of DominatorTreeBase after edge
+/// insertions and deletions, based on the Depth Based Search algorithm from:
+///
+///   An Experimental Study of Dynamic Dominators
+///   L. Georgiadis, G. F. Italiano, L. Laura, F. Santaroni, ESA 2012.
+///
+/// and on the Semi-NCA algorithm from:
+///
+///   Finding Dominators in Practice
+///   L. Georgiadis, R. E. Tarjan, R. F. Werneck, JGAA 2006.
+///
 //===----------------------------------------------------------------------===//
 
 #ifndef LLVM_SUPPORT_GENERICDOMTREECONSTRUCTION_H
 #define LLVM_SUPPORT_GENERICDOMTREECONSTRUCTION_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/Support/GenericDomTree.h"
+#include <cstdlib>
+#include <queue>
 
 namespace llvm {
 
@@ -151,6 +169,14 @@ void Calculate(DominatorTreeBaseByGraphTraits<GraphTraits<NodeT>> &DT,
                 "NodeRef should be pointer type");
   typedef typename std::remove_pointer<typename GraphT::NodeRef>::type NodeType;
 
+  if (DomTreeBuilder::useSemiNCA()) {
+    if (DT.isPostDominator())
+      DomTreeBuilder::SemiNCAInfo<NodeType, true>::calculate(DT, F);
+    else
+      DomTreeBuilder::SemiNCAInfo<NodeType, false>::calculate(DT, F);
+    return;
+  }
+
   unsigned N = 0;
   bool MultipleRoots = (DT.Roots.size() > 1);
   if (MultipleRoots) {
@@ -282,6 +308,649 @@ void Calculate(DominatorTreeBaseByGraphTraits<GraphTraits<NodeT>> &DT,
 
   DT.updateDFSNumbers();
 }
+namespace DomTreeBuilder {
+
+/// The CFG seen by the incremental updates, in the direction of the tree:
+/// successors for dominator trees, predecessors for post-dominator trees.
+///
+/// When a batch of updates is applied, the CFG already reflects all of them,
+/// while the tree is updated one edge at a time. The view hides the edges
+/// inserted by the updates that were not applied to the tree yet, and adds
+/// back the edges they deleted.
+template <class NodeT, bool IsPostDom> class DomTreeCFGView {
+  typedef typename std::conditional<IsPostDom, Inverse<NodeT *>, NodeT *>::type
+      DirT;
+  typedef typename std::conditional<IsPostDom, NodeT *, Inverse<NodeT *>>::type
+      InvDirT;
+
+  // Maps a node to its pending edges, with true for insertions.
+  typedef DenseMap<NodeT *, SmallVector<std::pair<NodeT *, bool>, 2>>
+      PendingMapTy;
+  PendingMapTy PendingChildren;
+  PendingMapTy PendingInverseChildren;
+
+  template <class GraphT>
+  static SmallVector<NodeT *, 8> get(NodeT *N, const PendingMapTy &Pending) {
+    SmallVector<NodeT *, 8> Res(GraphT::child_begin(N), GraphT::child_end(N));
+    auto I = Pending.find(N);
+    if (I == Pending.end())
+      return Res;
+
+    for (const auto &Edge : I->second) {
+      if (!Edge.second) {
+        Res.push_back(Edge.first);
+        continue;
+      }
+      auto It = find(Res, Edge.first);
+      assert(It != Res.end() && "Inserted edge not in the CFG!");
+      Res.erase(It);
+    }
+    return Res;
+  }
+
+  static void removeEdge(PendingMapTy &Pending, NodeT *From, NodeT *To) {
+    auto &Edges = Pending[From];
+    auto I = find_if(Edges, [To](const std::pair<NodeT *, bool> &Edge) {
+      return Edge.first == To;
+    });
+    assert(I != Edges.end() && "Edge is not pending!");
+    Edges.erase(I);
+  }
+
+public:
+  /// Record an update, in the direction of the tree, that is in the CFG but
+  /// not yet applied to the tree.
+  void addPending(NodeT *From, NodeT *To, bool IsInsert) {
+    PendingChildren[From].push_back({To, IsInsert});
+    PendingInverseChildren[To].push_back({From, IsInsert});
+  }
+
+  /// Forget about an update when it is applied to the tree.
+  void removePending(NodeT *From, NodeT *To) {
+    removeEdge(PendingChildren, From, To);
+    removeEdge(PendingInverseChildren, To, From);
+  }
+
+  SmallVector<NodeT *, 8> getChildren(NodeT *N) const {
+    return get<GraphTraits<DirT>>(N, PendingChildren);
+  }
+
+  SmallVector<NodeT *, 8> getInverseChildren(NodeT *N) const {
+    return get<GraphTraits<InvDirT>>(N, PendingInverseChildren);
+  }
+};
+
+/// Dominator computation with the Semi-NCA algorithm over a part of the CFG,
+/// and the incremental updates built on top of it. Edges are given in the
+/// direction of the tree: for post-dominator trees, From -> To is the CFG edge
+/// To -> From.
+///
+/// Nodes are numbered in DFS preorder starting at 1, and all the per-node
+/// information is kept in vectors indexed by that number.
+template <class NodeT, bool IsPostDom> struct SemiNCAInfo {
+  typedef DomTreeNodeBase<NodeT> TreeNode;
+  typedef DominatorTreeBase<NodeT> DomTreeT;
+  typedef DomTreeCFGView<NodeT, IsPostDom> CFGViewT;
+
+  DomTreeT &DT;
+  CFGViewT View;
+
+  SmallVector<NodeT *, 64> NumToNode;
+  DenseMap<NodeT *, unsigned> NodeToNum;
+  SmallVector<unsigned, 64> Parent;
+  SmallVector<unsigned, 64> Semi;
+  SmallVector<unsigned, 64> Label;
+  SmallVector<unsigned, 64> IDom;
+  // The numbers of the predecessors of each node found by the DFS.
+  std::vector<SmallVector<unsigned, 4>> ReverseChildren;
+
+  explicit SemiNCAInfo(DomTreeT &DT) : DT(DT) {}
+
+  void clear() {
+    NumToNode.clear();
+    NodeToNum.clear();
+    Parent.clear();
+    Semi.clear();
+    Label.clear();
+    IDom.clear();
+    ReverseChildren.clear();
+  }
+
+  unsigned getNumNodes() const { return NumToNode.size() - 1; }
+
+  unsigned addNode(NodeT *N, unsigned ParentNum) {
+    unsigned Num = NumToNode.size();
+    NodeToNum[N] = Num;
+    NumToNode.push_back(N);
+    Parent.push_back(ParentNum);
+    Semi.push_back(Num);
+    Label.push_back(Num);
+    ReverseChildren.emplace_back();
+    return Num;
+  }
+
+  void reset() {
+    clear();
+    // Number 0 is reserved to mean "no node".
+    NumToNode.push_back(nullptr);
+    Parent.push_back(0);
+    Semi.push_back(0);
+    Label.push_back(0);
+    ReverseChildren.emplace_back();
+  }
+
+  /// Number the nodes reachable from Root in DFS preorder, descending from
+  /// From into To only if Descend(From, To) returns true.
+  template <class DescendCondition>
+  void runDFS(NodeT *Root, DescendCondition Descend) {
+    reset();
+    addDFSTree(Root, 0, Descend);
+  }
+
+  /// Continue the DFS numbering from Root, which becomes a child of the node
+  /// numbered ParentNum, or a new DFS root if ParentNum is 0.
+  template <class DescendCondition>
+  void addDFSTree(NodeT *Root, unsigned ParentNum, DescendCondition Descend) {
+    auto RootIt = NodeToNum.find(Root);
+    if (RootIt != NodeToNum.end()) {
+      if (ParentNum)
+        ReverseChildren[RootIt->second].push_back(ParentNum);
+      return;
+    }
+
+    struct StackEntry {
+      unsigned Num;
+      SmallVector<NodeT *, 8> Children;
+      unsigned NextChild;
+    };
+    SmallVector<StackEntry, 32> Stack;
+    unsigned RootNum = addNode(Root, ParentNum);
+    if (ParentNum)
+      ReverseChildren[RootNum].push_back(ParentNum);
+    Stack.push_back({RootNum, View.getChildren(Root), 0});
+
+    while (!Stack.empty()) {
+      StackEntry &Top = Stack.back();
+      if (Top.NextChild == Top.Children.size()) {
+        Stack.pop_back();
+        continue;
+      }
+
+      unsigned FromNum = Top.Num;
+      NodeT *Succ = Top.Children[Top.NextChild++];
+      auto I = NodeToNum.find(Succ);
+      if (I != NodeToNum.end()) {
+        ReverseChildren[I->second].push_back(FromNum);
+        continue;
+      }
+      if (!Descend(NumToNode[FromNum], Succ))
+        continue;
+
+      unsigned SuccNum = addNode(Succ, FromNum);
+      ReverseChildren[SuccNum].push_back(FromNum);
+      Stack.push_back({SuccNum, View.getChildren(Succ), 0});
+    }
+  }
+
+  // Path-compressing EVAL of the Lengauer-Tarjan algorithm. The nodes numbered
+  // LastLinked or higher have been linked into the forest.
+  unsigned eval(unsigned V, unsigned LastLinked) {
+    if (V < LastLinked)
+      return V;
+
+    SmallVector<unsigned, 32> Path;
+    for (unsigned X = V; Parent[X] >= LastLinked; X = Parent[X])
+      Path.push_back(X);
+
+    // Compress the path starting next to its top.
+    for (unsigned X : reverse(Path)) {
+      unsigned Ancestor = Parent[X];
+      if (Semi[Label[Ancestor]] < Semi[Label[X]])
+        Label[X] = Label[Ancestor];
+      Parent[X] = Parent[Ancestor];
+    }
+    return Label[V];
+  }
+
+  /// Compute the immediate dominators of the nodes numbered by runDFS, as
+  /// numbers in IDom. The root, numbered 1, has no immediate dominator.
+  void runSemiNCA() {
+    unsigned N = getNumNodes();
+    // Start from the parents in the DFS spanning tree; they are clobbered by
+    // the path compression below.
+    IDom = Parent;
+
+    // Step #1: Calculate the semidominators of all vertices.
+    for (unsigned i = N; i >= 2; --i) {
+      Semi[i] = Parent[i];
+      for (unsigned Pred : ReverseChildren[i]) {
+        unsigned SemiU = Semi[eval(Pred, i + 1)];
+        if (SemiU < Semi[i])
+          Semi[i] = SemiU;
+      }
+    }
+
+    // Step #2: The immediate dominator of each vertex is the nearest common
+    // ancestor of its semidominator and its spanning tree parent.
+    for (unsigned i = 2; i <= N; ++i) {
+      unsigned Candidate = IDom[i];
+      while (Candidate > Semi[i])
+        Candidate = IDom[Candidate];
+      IDom[i] = Candidate;
+    }
+  }
+
+  /// Build DT from scratch for the roots already set in DT.Roots. Like the
+  /// Lengauer-Tarjan Calculate, a virtual root (nullptr) is added above the
+  /// real roots if there are several, or if some nodes of a post-dominator
+  /// tree cannot reach its root.
+  template <class FuncT> static void calculate(DomTreeT &DT, FuncT &F) {
+    SemiNCAInfo SNCA(DT);
+    auto Always = [](NodeT *, NodeT *) { return true; };
+
+    SNCA.reset();
+    bool MultipleRoots = DT.Roots.size() > 1;
+    if (MultipleRoots) {
+      unsigned VirtualRootNum = SNCA.addNode(nullptr, 0);
+      for (NodeT *Root : DT.Roots)
+        SNCA.addDFSTree(Root, VirtualRootNum, Always);
+    } else if (!DT.Roots.empty()) {
+      SNCA.addDFSTree(DT.Roots[0], 0, Always);
+    }
+
+    unsigned N = SNCA.getNumNodes();
+    MultipleRoots |= IsPostDom && N != GraphTraits<FuncT *>::size(&F);
+    if (DT.Roots.empty())
+      return;
+
+    SNCA.runSemiNCA();
+
+    NodeT *Root = MultipleRoots ? nullptr : DT.Roots[0];
+    DT.RootNode =
+        (DT.DomTreeNodes[Root] = llvm::make_unique<TreeNode>(Root, nullptr))
+            .get();
+    // With a single real root that does not reach every node, the virtual
+    // root was not numbered; hang the real root below it.
+    if (SNCA.NumToNode[1] != Root) {
+      NodeT *RealRoot = SNCA.NumToNode[1];
+      DT.DomTreeNodes[RealRoot] = DT.RootNode->addChild(
+          llvm::make_unique<TreeNode>(RealRoot, DT.RootNode));
+    }
+
+    // Nodes are created in DFS preorder, so immediate dominators come first.
+    for (unsigned i = 2; i <= N; ++i) {
+      NodeT *W = SNCA.NumToNode[i];
+      TreeNode *IDomTN = DT.getNode(SNCA.NumToNode[SNCA.IDom[i]]);
+      DT.DomTreeNodes[W] =
+          IDomTN->addChild(llvm::make_unique<TreeNode>(W, IDomTN));
+    }
+
+    DT.updateDFSNumbers();
+  }
+
+  bool isRoot(NodeT *N) const { return is_contained(DT.Roots, N); }
+
+  /// Nearest common ancestor of two tree nodes, using their levels.
+  static TreeNode *getNCA(TreeNode *A, TreeNode *B) {
+    while (A != B) {
+      if (A->getLevel() < B->getLevel())
+        std::swap(A, B);
+      A = A->getIDom();
+    }
+    return A;
+  }
+
+  /// Update the tree after the edge From -> To was inserted. Returns false if
+  /// the change cannot be handled incrementally and the tree must be
+  /// recalculated.
+  bool insertEdge(NodeT *From, NodeT *To) {
+    // An exit of the function that gets a successor changes the roots of a
+    // post-dominator tree.
+    if (IsPostDom && isRoot(To))
+      return false;
+
+    // Edges out of unreachable nodes don't change anything.
+    TreeNode *FromTN = DT.getNode(From);
+    if (!FromTN)
+      return true;
+
+    TreeNode *ToTN = DT.getNode(To);
+    if (!ToTN) {
+      // For post-dominators, blocks that did not reach an exit do now, which
+      // may change whether the tree has a virtual root.
+      if (IsPostDom)
+        return false;
+      insertUnreachable(FromTN, To);
+      return true;
+    }
+
+    insertReachable(FromTN, ToTN);
+    return true;
+  }
+
+  // Depth Based Search: the nodes whose immediate dominator changes are the
+  // nodes V deeper than NCD + 1 reachable from To through nodes at least as
+  // deep as V. Their new immediate dominator is NCD.
+  void insertReachable(TreeNode *FromTN, TreeNode *ToTN) {
+    TreeNode *NCD = getNCA(FromTN, ToTN);
+    if (NCD == ToTN || NCD == ToTN->getIDom())
+      return;
+
+    auto Deeper = [](TreeNode *A, TreeNode *B) {
+      return A->getLevel() < B->getLevel();
+    };
+    std::priority_queue<TreeNode *, SmallVector<TreeNode *, 8>,
+                        decltype(Deeper)>
+        Bucket(Deeper);
+    SmallPtrSet<TreeNode *, 8> Visited;
+    SmallVector<TreeNode *, 8> Affected;
+    SmallVector<TreeNode *, 8> UnaffectedOnCurrentLevel;
+    unsigned NCDLevel = NCD->getLevel();
+
+    Bucket.push(ToTN);
+    Visited.insert(ToTN);
+    while (!Bucket.empty()) {
+      TreeNode *TN = Bucket.top();
+      Bucket.pop();
+      Affected.push_back(TN);
+
+      unsigned CurrentLevel = TN->getLevel();
+      while (true) {
+        for (NodeT *Succ : View.getChildren(TN->getBlock())) {
+          TreeNode *SuccTN = DT.getNode(Succ);
+          assert(SuccTN && "Unreachable successor of a reachable node!");
+          unsigned SuccLevel = SuccTN->getLevel();
+          if (SuccLevel <= NCDLevel + 1 || !Visited.insert(SuccTN).second)
+            continue;
+
+          // Nodes deeper than the current level are not affected, but may
+          // lead to affected nodes.
+          if (SuccLevel > CurrentLevel)
+            UnaffectedOnCurrentLevel.push_back(SuccTN);
+          else
+            Bucket.push(SuccTN);
+        }
+
+        if (UnaffectedOnCurrentLevel.empty())
+          break;
+        TN = UnaffectedOnCurrentLevel.pop_back_val();
+      }
+    }
+
+    for (TreeNode *TN : Affected)
+      TN->setIDom(NCD);
+  }
+
+  // To and the nodes only reachable through it become reachable: compute
+  // their dominators, then insert the edges from them to the rest of the tree.
+  void insertUnreachable(TreeNode *FromTN, NodeT *To) {
+    SmallVector<std::pair<NodeT *, NodeT *>, 8> DiscoveredEdges;
+    runDFS(To, [&](NodeT *From, NodeT *Succ) {
+      if (!DT.getNode(Succ))
+        return true;
+      DiscoveredEdges.push_back({From, Succ});
+      return false;
+    });
+    runSemiNCA();
+
+    for (unsigned i = 1, e = getNumNodes(); i <= e; ++i) {
+      TreeNode *IDomTN = i == 1 ? FromTN : DT.getNode(NumToNode[IDom[i]]);
+      NodeT *N = NumToNode[i];
+      DT.DomTreeNodes[N] =
+          IDomTN->addChild(llvm::make_unique<TreeNode>(N, IDomTN));
+    }
+
+    for (const auto &Edge : DiscoveredEdges)
+      insertReachable(DT.getNode(Edge.first), DT.getNode(Edge.second));
+  }
+
+  /// Update the tree after the edge From -> To was deleted. Returns false if
+  /// the change cannot be handled incrementally and the tree must be
+  /// recalculated.
+  bool deleteEdge(NodeT *From, NodeT *To) {
+    // Nothing changes if there is another copy of the edge.
+    if (is_contained(View.getChildren(From), To))
+      return true;
+
+    // A block left without successors is a new root of a post-dominator tree.
+    if (IsPostDom && View.getInverseChildren(To).empty())
+      return false;
+
+    TreeNode *FromTN = DT.getNode(From);
+    TreeNode *ToTN = DT.getNode(To);
+    if (!FromTN || !ToTN)
+      return true;
+
+    // Removing an edge to a dominator of From doesn't change anything.
+    TreeNode *NCD = getNCA(FromTN, ToTN);
+    if (NCD == ToTN)
+      return true;
+
+    // To stays reachable if From is not its immediate dominator, or if it has
+    // a predecessor it doesn't dominate.
+    if (FromTN != ToTN->getIDom() || hasProperSupport(ToTN))
+      return deleteReachable(NCD);
+
+    // For post-dominators, To no longer reaches an exit.
+    if (IsPostDom)
+      return false;
+    deleteUnreachable(ToTN);
+    return true;
+  }
+
+  bool hasProperSupport(TreeNode *TN) {
+    for (NodeT *Pred : View.getInverseChildren(TN->getBlock())) {
+      TreeNode *PredTN = DT.getNode(Pred);
+      if (PredTN && getNCA(TN, PredTN) != TN)
+        return true;
+    }
+    return false;
+  }
+
+  // Deleting an edge only changes the immediate dominators of the nodes in the
+  // subtree of the nearest common dominator of its ends, and they are still
+  // dominated by it. Recompute that subtree.
+  bool deleteReachable(TreeNode *NCD) {
+    // The virtual root of a post-dominator tree has no block to start from.
+    if (!NCD->getBlock())
+      return false;
+
+    unsigned Level = NCD->getLevel();
+    runDFS(NCD->getBlock(), [&](NodeT *, NodeT *Succ) {
+      TreeNode *SuccTN = DT.getNode(Succ);
+      return SuccTN && SuccTN->getLevel() > Level;
+    });
+    runSemiNCA();
+
+    // Immediate dominators are numbered before the nodes they dominate, so
+    // each node is attached to its final parent.
+    for (unsigned i = 2, e = getNumNodes(); i <= e; ++i) {
+      TreeNode *TN = DT.getNode(NumToNode[i]);
+      TreeNode *NewIDom = DT.getNode(NumToNode[IDom[i]]);
+      if (TN->getIDom() != NewIDom)
+        TN->setIDom(NewIDom);
+    }
+    return true;
+  }
+
+  // To became unreachable, and so did every node it dominates. Remove them,
+  // then recompute the subtree where the nodes they had edges to are, as those
+  // edges are effectively deleted.
+  void deleteUnreachable(TreeNode *ToTN) {
+    SmallPtrSet<TreeNode *, 16> Erased;
+    SmallVector<TreeNode *, 16> WorkList = {ToTN};
+    while (!WorkList.empty()) {
+      TreeNode *TN = WorkList.pop_back_val();
+      Erased.insert(TN);
+      WorkList.append(TN->begin(), TN->end());
+    }
+
+    TreeNode *IDomTN = ToTN->getIDom();
+    TreeNode *Top = IDomTN;
+    for (TreeNode *TN : Erased)
+      for (NodeT *Succ : View.getChildren(TN->getBlock())) {
+        TreeNode *SuccTN = DT.getNode(Succ);
+        if (SuccTN && !Erased.count(SuccTN))
+          Top = getNCA(Top, SuccTN);
+      }
+
+    IDomTN->Children.erase(find(IDomTN->Children, ToTN));
+    for (TreeNode *TN : Erased)
+      DT.DomTreeNodes.erase(TN->getBlock());
+
+    deleteReachable(Top);
+  }
+
+  void recalculate(NodeT *AnyNode) { DT.recalculate(*AnyNode->getParent()); }
+
+  static void insertEdge(DomTreeT &DT, NodeT *From, NodeT *To) {
+    DT.DFSInfoValid = false;
+    if (IsPostDom)
+      std::swap(From, To);
+    SemiNCAInfo SNCA(DT);
+    if (!SNCA.insertEdge(From, To))
+      SNCA.recalculate(From);
+  }
+
+  static void deleteEdge(DomTreeT &DT, NodeT *From, NodeT *To) {
+    DT.DFSInfoValid = false;
+    if (IsPostDom)
+      std::swap(From, To);
+    SemiNCAInfo SNCA(DT);
+    if (!SNCA.deleteEdge(From, To))
+      SNCA.recalculate(From);
+  }
+
+  static void applyUpdates(DomTreeT &DT,
+                           ArrayRef<typename DomTreeT::UpdateType> Updates) {
+    typedef typename DomTreeT::UpdateType UpdateT;
+    if (Updates.empty())
+      return;
+    DT.DFSInfoValid = false;
+
+    // Only keep the net effect of the updates to each edge, in the order in
+    // which the edges first appear.
+    SmallDenseMap<std::pair<NodeT *, NodeT *>, int, 8> NetEffect;
+    for (const UpdateT &U : Updates)
+      NetEffect[{U.From, U.To}] += U.Kind == DomTreeT::Insert ? 1 : -1;
+
+    SmallVector<UpdateT, 8> Legalized;
+    for (const UpdateT &U : Updates) {
+      int &Effect = NetEffect[{U.From, U.To}];
+      assert(std::abs(Effect) <= 1 && "Edge inserted or deleted twice!");
+      if (Effect == 0)
+        continue;
+      UpdateT Legal = {Effect > 0 ? DomTreeT::Insert : DomTreeT::Delete,
+                       U.From, U.To};
+      if (IsPostDom)
+        std::swap(Legal.From, Legal.To);
+      Legalized.push_back(Legal);
+      Effect = 0;
+    }
+    if (Legalized.empty())
+      return;
+
+    // Many updates are cheaper to handle by recomputing the whole tree.
+    SemiNCAInfo SNCA(DT);
+    if (Legalized.size() > 100 &&
+        Legalized.size() > DT.DomTreeNodes.size() / 40)
+      return SNCA.recalculate(Legalized.front().From);
+
+    for (const UpdateT &U : Legalized)
+      SNCA.View.addPending(U.From, U.To, U.Kind == DomTreeT::Insert);
+
+    for (const UpdateT &U : Legalized) {
+      SNCA.View.removePending(U.From, U.To);
+      bool Done = U.Kind == DomTreeT::Insert ? SNCA.insertEdge(U.From, U.To)
+                                             : SNCA.deleteEdge(U.From, U.To);
+      // A recalculation sees the final CFG, so it covers the remaining updates.
+      if (!Done)
+        return SNCA.recalculate(U.From);
+    }
+  }
+
+  static bool verify(const DomTreeT &DT) {
+    NodeT *AnyNode = nullptr;
+    for (const auto &Entry : DT.DomTreeNodes)
+      if (Entry.first) {
+        AnyNode = Entry.first;
+        break;
+      }
+    if (!AnyNode)
+      return true;
+
+    DomTreeT Fresh(DT.isPostDominator());
+    Fresh.recalculate(*AnyNode->getParent());
+
+    const TreeNode *Root = DT.getRootNode();
+    const TreeNode *FreshRoot = Fresh.getRootNode();
+    bool IsValid = Root && FreshRoot &&
+                   Root->getBlock() == FreshRoot->getBlock() &&
+                   !DT.compare(Fresh);
+
+    for (const auto &Entry : DT.DomTreeNodes) {
+      const TreeNode *TN = Entry.second.get();
+      const TreeNode *IDomTN = TN->getIDom();
+      if (TN->getLevel() != (IDomTN ? IDomTN->getLevel() + 1 : 0))
+        IsValid = false;
+      for (const TreeNode *Child : *TN)
+        if (Child->getIDom() != TN)
+          IsValid = false;
+    }
+
+    if (!IsValid) {
+      errs() << "DominatorTree is different from a freshly computed one!\n"
+             << "Current:\n";
+      DT.print(errs());
+      errs() << "\nFreshly computed:\n";
+      Fresh.print(errs());
+    }
+    return IsValid;
+  }
+};
+
+template <class NodeT>
+void InsertEdge(DominatorTreeBase<NodeT> &DT, NodeT *From, NodeT *To) {
+  if (DT.isPostDominator())
+    SemiNCAInfo<NodeT, true>::insertEdge(DT, From, To);
+  else
+    SemiNCAInfo<NodeT, false>::insertEdge(DT, From, To);
+#ifdef EXPENSIVE_CHECKS
+  assert(DT.verify() && "Incremental dominator tree update failed!");
+#endif
+}
+
+template <class NodeT>
+void DeleteEdge(DominatorTreeBase<NodeT> &DT, NodeT *From, NodeT *To) {
+  if (DT.isPostDominator())
+    SemiNCAInfo<NodeT, true>::deleteEdge(DT, From, To);
+  else
+    SemiNCAInfo<NodeT, false>::deleteEdge(DT, From, To);
+#ifdef EXPENSIVE_CHECKS
+  assert(DT.verify() && "Incremental dominator tree update failed!");
+#endif
+}
+
+template <class NodeT>
+void ApplyUpdates(
+    DominatorTreeBase<NodeT> &DT,
+    ArrayRef<typename DominatorTreeBase<NodeT>::UpdateType> Updates) {
+  if (DT.isPostDominator())
+    SemiNCAInfo<NodeT, true>::applyUpdates(DT, Updates);
+  else
+    SemiNCAInfo<NodeT, false>::applyUpdates(DT, Updates);
+#ifdef EXPENSIVE_CHECKS
+  assert(DT.verify() && "Incremental dominator tree update failed!");
+#endif
+}
+
+template <class NodeT> bool Verify(const DominatorTreeBase<NodeT> &DT) {
+  if (DT.isPostDominator())
+    return SemiNCAInfo<NodeT, true>::verify(DT);
+  return SemiNCAInfo<NodeT, false>::verify(DT);
+}
+
+} // end namespace DomTreeBuilder
 }
 
 #endif
@@ -48,7 +48,13 @@ namespace sys {
     enum ProtectionFlags {
       MF_READ  = 0x1000000,
       MF_WRITE = 0x2000000,
-      MF_EXEC  = 0x4000000
+      MF_EXEC  = 0x4000000,
+      MF_RWE_MASK = 0x7000000,
+      /// When passed to allocateMappedMemory, asks for memory backed by huge
+      /// pages where the system supports them transparently. The block is then
+      /// aligned to, and a multiple of, the huge page size. This is only a
+      /// hint: it is ignored where huge pages are not available.
+      MF_HUGE_HINT = 0x0010000
     };
 
     /// This method allocates a block of memory that is suitable for loading
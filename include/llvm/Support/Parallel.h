@@ -0,0 +1,226 @@
+//===- llvm/Support/Parallel.h - Parallel algorithms ------------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines chunked parallel versions of common algorithms, running on
+// a process-wide ThreadPool. They degrade to their serial counterparts when
+// LLVM_ENABLE_THREADS is off or when only one hardware thread is available.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_PARALLEL_H
+#define LLVM_SUPPORT_PARALLEL_H
+
+#include "llvm/Config/llvm-config.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/ThreadPool.h"
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <vector>
+
+namespace llvm {
+namespace parallel {
+
+/// Returns the pool shared by the parallel algorithms. It is created on first
+/// use with one thread per hardware thread, and destroyed by llvm_shutdown().
+ThreadPool &getDefaultPool();
+
+/// Returns true if the parallel algorithms actually run in parallel, false if
+/// they fall back to serial execution.
+bool isEnabled();
+
+/// A group of tasks spawned on the default pool. When parallelism is disabled,
+/// tasks are run synchronously by spawn(). The destructor waits for all the
+/// spawned tasks to complete.
+class TaskGroup {
+public:
+  TaskGroup();
+  ~TaskGroup();
+
+  TaskGroup(const TaskGroup &) = delete;
+  TaskGroup &operator=(const TaskGroup &) = delete;
+
+  /// Run \p F, possibly on another thread.
+  template <typename FuncTy> void spawn(FuncTy &&F) {
+    if (!Group) {
+      F();
+      return;
+    }
+    Group->async(std::forward<FuncTy>(F));
+  }
+
+  /// Wait for all the tasks spawned so far to complete.
+  void sync() {
+    if (Group)
+      Group->wait();
+  }
+
+private:
+  std::unique_ptr<ThreadPoolTaskGroup> Group;
+};
+
+namespace detail {
+
+/// Inputs with fewer elements than this are processed serially.
+enum { MinParallelSize = 1024 };
+
+/// Number of chunks to split \p NumElements elements into: enough chunks per
+/// thread for stealing to balance uneven work, each at least \p MinChunkSize
+/// elements.
+inline size_t getNumChunks(size_t NumElements, size_t MinChunkSize) {
+  size_t MaxChunks = parallel::getDefaultPool().getThreadCount() * 4;
+  return std::max<size_t>(
+      1, std::min(MaxChunks, NumElements / std::max<size_t>(MinChunkSize, 1)));
+}
+
+template <class RandomAccessIterator, class Comparator>
+RandomAccessIterator medianOf3(RandomAccessIterator Start,
+                               RandomAccessIterator End,
+                               const Comparator &Comp) {
+  RandomAccessIterator Mid = Start + (std::distance(Start, End) / 2);
+  return Comp(*Start, *(End - 1))
+             ? (Comp(*Mid, *(End - 1)) ? (Comp(*Start, *Mid) ? Mid : Start)
+                                       : End - 1)
+             : (Comp(*Mid, *Start) ? (Comp(*(End - 1), *Mid) ? Mid : End - 1)
+                                   : Start);
+}
+
+template <class RandomAccessIterator, class Comparator>
+void parallelQuickSort(RandomAccessIterator Start, RandomAccessIterator End,
+                       const Comparator &Comp, TaskGroup &TG, size_t Depth) {
+  // Do a sequential sort for small inputs, and when the partitioning is so
+  // unbalanced that recursing further is pointless.
+  if (std::distance(Start, End) < MinParallelSize || Depth == 0) {
+    std::sort(Start, End, Comp);
+    return;
+  }
+
+  // Partition around the median of three, moved out of the way at End - 1.
+  auto Pivot = medianOf3(Start, End, Comp);
+  std::swap(*(End - 1), *Pivot);
+  Pivot = std::partition(Start, End - 1, [&Comp, End](decltype(*Start) V) {
+    return Comp(V, *(End - 1));
+  });
+  std::swap(*Pivot, *(End - 1));
+
+  // Sort the two halves concurrently.
+  TG.spawn([=, &Comp, &TG] {
+    parallelQuickSort(Start, Pivot, Comp, TG, Depth - 1);
+  });
+  parallelQuickSort(Pivot + 1, End, Comp, TG, Depth - 1);
+}
+
+} // end namespace detail
+} // end namespace parallel
+
+/// Apply \p Fn to every element of [\p Begin, \p End), in no particular order.
+/// The range is split into contiguous chunks processed concurrently.
+template <class IterTy, class FuncTy>
+void parallel_for_each(IterTy Begin, IterTy End, FuncTy Fn) {
+  size_t NumElements = std::distance(Begin, End);
+  if (!parallel::isEnabled() || NumElements < 2) {
+    std::for_each(Begin, End, Fn);
+    return;
+  }
+
+  size_t NumChunks = parallel::detail::getNumChunks(NumElements, 1);
+  size_t ChunkSize = (NumElements + NumChunks - 1) / NumChunks;
+  parallel::TaskGroup TG;
+  while (NumElements > ChunkSize) {
+    IterTy ChunkEnd = std::next(Begin, ChunkSize);
+    TG.spawn([=, &Fn] { std::for_each(Begin, ChunkEnd, Fn); });
+    Begin = ChunkEnd;
+    NumElements -= ChunkSize;
+  }
+  std::for_each(Begin, End, Fn);
+}
+
+/// Call \p Fn for every index in [\p Begin, \p End), in no particular order.
+template <class IndexTy, class FuncTy>
+void parallel_for_each_n(IndexTy Begin, IndexTy End, FuncTy Fn) {
+  if (!parallel::isEnabled() || End - Begin < 2) {
+    for (IndexTy I = Begin; I != End; ++I)
+      Fn(I);
+    return;
+  }
+
+  size_t NumChunks = parallel::detail::getNumChunks(End - Begin, 1);
+  IndexTy ChunkSize = (End - Begin + NumChunks - 1) / NumChunks;
+  parallel::TaskGroup TG;
+  for (; End - Begin > ChunkSize; Begin += ChunkSize) {
+    TG.spawn([=, &Fn] {
+      for (IndexTy I = Begin, E = Begin + ChunkSize; I != E; ++I)
+        Fn(I);
+    });
+  }
+  for (IndexTy I = Begin; I != End; ++I)
+    Fn(I);
+}
+
+/// Sort [\p Start, \p End) with \p Comp. Like std::sort, this is not a stable
+/// sort.
+template <class RandomAccessIterator,
+          class Comparator = std::less<
+              typename std::iterator_traits<RandomAccessIterator>::value_type>>
+void parallel_sort(RandomAccessIterator Start, RandomAccessIterator End,
+                   const Comparator &Comp = Comparator()) {
+  if (!parallel::isEnabled()) {
+    std::sort(Start, End, Comp);
+    return;
+  }
+  parallel::TaskGroup TG;
+  parallel::detail::parallelQuickSort(Start, End, Comp, TG,
+                                      Log2_64(std::distance(Start, End)) + 1);
+}
+
+/// Compute Reduce(...Reduce(Reduce(Init, Transform(E0)), Transform(E1))...)
+/// over the elements of [\p Begin, \p End). Every chunk is reduced
+/// concurrently starting from \p Init, which must therefore be an identity of
+/// \p Reduce. The per-chunk results are combined in order, so the result is
+/// deterministic as long as \p Reduce is associative.
+template <class IterTy, class ResultTy, class ReduceFuncTy,
+          class TransformFuncTy>
+ResultTy parallel_transform_reduce(IterTy Begin, IterTy End, ResultTy Init,
+                                   ReduceFuncTy Reduce,
+                                   TransformFuncTy Transform) {
+  size_t NumElements = std::distance(Begin, End);
+  if (!parallel::isEnabled() ||
+      NumElements < size_t(parallel::detail::MinParallelSize)) {
+    for (; Begin != End; ++Begin)
+      Init = Reduce(std::move(Init), Transform(*Begin));
+    return Init;
+  }
+
+  size_t NumChunks = parallel::detail::getNumChunks(NumElements, 1);
+  size_t ChunkSize = (NumElements + NumChunks - 1) / NumChunks;
+  std::vector<ResultTy> Results(NumChunks, Init);
+  {
+    parallel::TaskGroup TG;
+    for (size_t I = 0; NumElements; ++I) {
+      size_t Size = std::min(ChunkSize, NumElements);
+      IterTy ChunkEnd = std::next(Begin, Size);
+      ResultTy *Result = &Results[I];
+      TG.spawn([=, &Reduce, &Transform] {
+        for (IterTy It = Begin; It != ChunkEnd; ++It)
+          *Result = Reduce(std::move(*Result), Transform(*It));
+      });
+      Begin = ChunkEnd;
+      NumElements -= Size;
+    }
+  }
+
+  for (ResultTy &Result : Results)
+    Init = Reduce(std::move(Init), std::move(Result));
+  return Init;
+}
+
+} // end namespace llvm
+
+#endif // LLVM_SUPPORT_PARALLEL_H
@@ -7,7 +7,8 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file defines a crude C++11 based thread pool.
+// This file defines a C++11 based thread pool with per-worker task queues,
+// work stealing and independently waitable task groups.
 //
 //===----------------------------------------------------------------------===//
 
@@ -35,19 +36,31 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <utility>
+#include <vector>
 
 namespace llvm {
 
+class ThreadPoolTaskGroup;
+
 /// A ThreadPool for asynchronous parallel execution on a defined number of
 /// threads.
 ///
-/// The pool keeps a vector of threads alive, waiting on a condition variable
-/// for some work to become available.
+/// Every worker thread owns a deque of tasks. Tasks submitted from a worker
+/// thread are pushed onto that worker's own deque and popped in LIFO order,
+/// while tasks submitted from any other thread are distributed round-robin
+/// over the workers. A worker whose deque is empty steals the oldest task of
+/// another worker before going to sleep on a condition variable, so the
+/// shared lock is only taken when a worker runs out of work.
+///
+/// Tasks can be tagged with a ThreadPoolTaskGroup, which can be waited on
+/// independently of the rest of the pool. Waiting on a group from inside a
+/// task running on the pool executes queued tasks instead of blocking, which
+/// allows a task to fork subtasks and join them without starving the pool.
 class ThreadPool {
 public:
 #ifndef _MSC_VER
@@ -101,36 +114,159 @@ public:
 #endif
   }
 
-  /// Blocking wait for all the threads to complete and the queue to be empty.
-  /// It is an error to try to add new tasks while blocking on this call.
+  /// Asynchronous submission of a task to the pool as part of \p Group. The
+  /// returned future can be used to wait for the task to finish and is
+  /// *non-blocking* on destruction.
+  template <typename Function, typename... Args>
+  inline std::shared_future<VoidTy> async(ThreadPoolTaskGroup &Group,
+                                          Function &&F, Args &&... ArgList) {
+    auto Task =
+        std::bind(std::forward<Function>(F), std::forward<Args>(ArgList)...);
+#ifndef _MSC_VER
+    return asyncImpl(std::move(Task), &Group);
+#else
+    return asyncImpl([Task](VoidTy) mutable -> VoidTy {
+      Task();
+      return VoidTy();
+    }, &Group);
+#endif
+  }
+
+  /// Asynchronous submission of a task to the pool as part of \p Group. The
+  /// returned future can be used to wait for the task to finish and is
+  /// *non-blocking* on destruction.
+  template <typename Function>
+  inline std::shared_future<VoidTy> async(ThreadPoolTaskGroup &Group,
+                                          Function &&F) {
+#ifndef _MSC_VER
+    return asyncImpl(std::forward<Function>(F), &Group);
+#else
+    return asyncImpl([F] (VoidTy) -> VoidTy { F(); return VoidTy(); }, &Group);
+#endif
+  }
+
+  /// Blocking wait for all the threads to complete and the queues to be empty.
+  /// It is an error to try to add new tasks while blocking on this call, and
+  /// it must not be called from a task running on this pool: use a
+  /// ThreadPoolTaskGroup to join subtasks instead.
   void wait();
 
+  /// Blocking wait for all the tasks of \p Group to complete. When called from
+  /// a worker thread of this pool, queued tasks are executed while waiting.
+  void wait(ThreadPoolTaskGroup &Group);
+
+  /// Returns the number of worker threads of the pool.
+  unsigned getThreadCount() const;
+
+  /// Returns true if the current thread is a worker thread of this pool.
+  bool isWorkerThread() const;
+
 private:
+  /// A task waiting for execution, along with the group it belongs to.
+  struct QueuedTask {
+    PackagedTaskTy Task;
+    ThreadPoolTaskGroup *Group = nullptr;
+  };
+
   /// Asynchronous submission of a task to the pool. The returned future can be
   /// used to wait for the task to finish and is *non-blocking* on destruction.
-  std::shared_future<VoidTy> asyncImpl(TaskTy F);
+  std::shared_future<VoidTy> asyncImpl(TaskTy F,
+                                       ThreadPoolTaskGroup *Group = nullptr);
+
+  /// Run a task that has been removed from the queues and signal its
+  /// completion to its group and to the pool.
+  void runTask(QueuedTask &Task);
+
+  /// Signal the completion of a task that has been run or discarded.
+  void taskCompleted(ThreadPoolTaskGroup *Group);
+
+#if LLVM_ENABLE_THREADS
+  /// The task deque owned by a single worker thread.
+  struct WorkerQueue {
+    std::mutex Lock;
+    std::deque<QueuedTask> Tasks;
+  };
+
+  /// Main loop of the worker thread \p Index.
+  void runWorker(unsigned Index);
+
+  /// Try to grab a task, first from the back of the deque of worker \p Index,
+  /// then from the front of the deques of the other workers.
+  bool popTask(unsigned Index, QueuedTask &Task);
 
   /// Threads in flight
   std::vector<llvm::thread> Threads;
 
-  /// Tasks waiting for execution in the pool.
-  std::queue<PackagedTaskTy> Tasks;
+  /// One task deque per worker thread.
+  std::vector<std::unique_ptr<WorkerQueue>> Queues;
+
+  /// Number of tasks sitting in the worker deques. It can transiently go
+  /// negative when a task is stolen before its submitter accounted for it.
+  std::atomic<int> PendingTasks;
+
+  /// Number of workers about to sleep or sleeping on QueueCondition.
+  std::atomic<unsigned> IdleWorkers;
+
+  /// Round-robin cursor for tasks submitted from outside the pool.
+  std::atomic<unsigned> NextQueue;
 
-  /// Locking and signaling for accessing the Tasks queue.
+  /// Locking and signaling for idle workers.
   std::mutex QueueLock;
   std::condition_variable QueueCondition;
 
+  /// Signal for the destruction of the pool, asking thread to exit.
+  bool EnableFlag;
+#else
+  /// Tasks waiting for execution in the pool.
+  std::deque<QueuedTask> Tasks;
+#endif
+
   /// Locking and signaling for job completion
   std::mutex CompletionLock;
   std::condition_variable CompletionCondition;
 
-  /// Keep track of the number of thread actually busy
-  std::atomic<unsigned> ActiveThreads;
+  /// Number of tasks submitted to the pool and not completed yet.
+  std::atomic<unsigned> OutstandingTasks;
+};
 
-#if LLVM_ENABLE_THREADS // avoids warning for unused variable
-  /// Signal for the destruction of the pool, asking thread to exit.
-  bool EnableFlag;
-#endif
+/// A group of tasks submitted to a ThreadPool, which can be waited on
+/// independently from the other tasks of the pool. Groups can be nested: a
+/// task running on the pool can create its own group, submit subtasks to it
+/// and wait for them.
+class ThreadPoolTaskGroup {
+public:
+  explicit ThreadPoolTaskGroup(ThreadPool &Pool) : Pool(Pool), Outstanding(0) {}
+
+  /// Blocking destructor: waits for all the tasks of the group to complete.
+  ~ThreadPoolTaskGroup() { wait(); }
+
+  ThreadPoolTaskGroup(const ThreadPoolTaskGroup &) = delete;
+  ThreadPoolTaskGroup &operator=(const ThreadPoolTaskGroup &) = delete;
+
+  /// Asynchronous submission of a task to the pool as part of this group.
+  template <typename Function, typename... Args>
+  inline std::shared_future<ThreadPool::VoidTy> async(Function &&F,
+                                                      Args &&... ArgList) {
+    return Pool.async(*this, std::forward<Function>(F),
+                      std::forward<Args>(ArgList)...);
+  }
+
+  /// Blocking wait for all the tasks of this group to complete.
+  void wait() { Pool.wait(*this); }
+
+  ThreadPool &getPool() const { return Pool; }
+
+private:
+  friend class ThreadPool;
+
+  ThreadPool &Pool;
+
+  /// Number of tasks of the group not completed yet.
+  std::atomic<unsigned> Outstanding;
+
+  /// Locking and signaling for the completion of the group.
+  std::mutex Lock;
+  std::condition_variable Condition;
 };
 }
 
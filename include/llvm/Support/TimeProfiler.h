@@ -0,0 +1,124 @@
+//===- llvm/Support/TimeProfiler.h - Hierarchical Time Profiler -*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a profiler recording begin/end events of nested regions,
+// such as pass executions, and writing them out in the Chrome trace_event JSON
+// format, which can be loaded in chrome://tracing or speedscope.
+//
+// The profiler is per thread: only the regions entered on the thread that
+// called timeTraceProfilerInitialize() are recorded. When it is not
+// initialized, a TimeTraceScope costs a single thread-local load.
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef LLVM_SUPPORT_TIMEPROFILER_H
+#define LLVM_SUPPORT_TIMEPROFILER_H
+
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringRef.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/Error.h"
+#include <string>
+
+namespace llvm {
+
+class raw_ostream;
+
+struct TimeTraceProfiler;
+extern LLVM_THREAD_LOCAL TimeTraceProfiler *TimeTraceProfilerInstance;
+
+/// Initialize the time trace profiler of the current thread. Regions shorter
+/// than \p TimeTraceGranularity microseconds are not recorded individually,
+/// but still account for the per-name totals. \p ProcName is the process name
+/// shown in the trace.
+void timeTraceProfilerInitialize(unsigned TimeTraceGranularity,
+                                 StringRef ProcName);
+
+/// Cleanup the time trace profiler of the current thread, if it was
+/// initialized.
+void timeTraceProfilerCleanup();
+
+/// Is the time trace profiler enabled on the current thread?
+inline bool timeTraceProfilerEnabled() {
+  return TimeTraceProfilerInstance != nullptr;
+}
+
+/// Write the recorded events to \p OS, in Chrome trace_event JSON format.
+void timeTraceProfilerWrite(raw_ostream &OS);
+
+/// Write the recorded events to the file \p FileName.
+Error timeTraceProfilerWrite(StringRef FileName);
+
+/// Manually begin a time section, with the given \p Name and \p Detail.
+/// \p Detail is only computed when the profiler is enabled.
+void timeTraceProfilerBegin(StringRef Name, StringRef Detail);
+void timeTraceProfilerBegin(StringRef Name,
+                            function_ref<std::string()> Detail);
+
+/// Manually end the last time section.
+void timeTraceProfilerEnd();
+
+/// The TimeTraceScope is a helper class to call the begin and end functions
+/// of the time trace profiler. When the object is constructed, it begins the
+/// section; and when it is destroyed, it stops it. If the time profiler is
+/// not initialized, the overhead is a single branch.
+struct TimeTraceScope {
+  TimeTraceScope(StringRef Name, StringRef Detail = StringRef())
+      : Active(TimeTraceProfilerInstance != nullptr) {
+    if (Active)
+      timeTraceProfilerBegin(Name, Detail);
+  }
+  TimeTraceScope(StringRef Name, function_ref<std::string()> Detail)
+      : Active(TimeTraceProfilerInstance != nullptr) {
+    if (Active)
+      timeTraceProfilerBegin(Name, Detail);
+  }
+  // Disambiguate string details from the function_ref constructor.
+  TimeTraceScope(StringRef Name, const char *Detail)
+      : TimeTraceScope(Name, StringRef(Detail)) {}
+  TimeTraceScope(StringRef Name, const std::string &Detail)
+      : TimeTraceScope(Name, StringRef(Detail)) {}
+  ~TimeTraceScope() {
+    if (Active && TimeTraceProfilerInstance != nullptr)
+      timeTraceProfilerEnd();
+  }
+
+private:
+  TimeTraceScope(const TimeTraceScope &) = delete;
+  void operator=(const TimeTraceScope &) = delete;
+
+  /// Whether a section was begun, in case the profiler gets initialized or
+  /// cleaned up while the scope is alive.
+  bool Active;
+};
+
+/// Enables the time trace profiler of the current thread for the lifetime of
+/// the object when -time-trace is given, and writes out the trace when
+/// destroyed. The trace goes to -time-trace-file if given, and otherwise to
+/// "<output>.time-trace.json", or "<input>.time-trace.json" when the output
+/// is empty or "-". The file names are read when the object is destroyed, so
+/// a tool may still pick its output file name after constructing it.
+class TimeTraceProfilerRAII {
+public:
+  TimeTraceProfilerRAII(StringRef ProgramName,
+                        const std::string &OutputFilename,
+                        const std::string &InputFilename);
+  ~TimeTraceProfilerRAII();
+
+private:
+  TimeTraceProfilerRAII(const TimeTraceProfilerRAII &) = delete;
+  void operator=(const TimeTraceProfilerRAII &) = delete;
+
+  const std::string &OutputFilename;
+  const std::string &InputFilename;
+};
+
+} // end namespace llvm
+
+#endif // LLVM_SUPPORT_TIMEPROFILER_H
@@ -10,6 +10,7 @@
 #ifndef LLVM_FUNCTIONIMPORT_H
 #define LLVM_FUNCTIONIMPORT_H
 
+#include "llvm/ADT/DenseSet.h"
 #include "llvm/ADT/StringMap.h"
 #include "llvm/IR/GlobalValue.h"
 #include "llvm/IR/ModuleSummaryIndex.h"
@@ -33,7 +34,8 @@ public:
   /// Set of functions to import from a source module. Each entry is a map
   /// containing all the functions to import for a source module.
   /// The keys is the GUID identifying a function to import, and the value
-  /// is the threshold applied when deciding to import it.
+  /// is the threshold applied when deciding to import it. Read-only global
+  /// variables are imported without a threshold, with a value of 0.
   typedef std::map<GlobalValue::GUID, unsigned> FunctionsToImportTy;
 
   /// The map contains an entry for every module to import from, the key being
@@ -92,6 +94,21 @@ void ComputeCrossModuleImport(
     StringMap<FunctionImporter::ImportMapTy> &ImportLists,
     StringMap<FunctionImporter::ExportSetTy> &ExportLists);
 
+/// Find the global variables of the program that are read-only: that the
+/// modules of \p Index only ever load from, and that are small enough to be
+/// imported into every module referencing them. ComputeCrossModuleImport then
+/// imports these variables instead of exporting them, and the backends
+/// internalize the imported copies as constants.
+///
+/// \p isPrevailing tells whether a summary is for the copy of a global picked
+/// by the linker. \p GUIDPreservedSymbols contains the globals referenced from
+/// outside of \p Index, which may write to them.
+void computeReadOnlyGlobals(
+    ModuleSummaryIndex &Index,
+    function_ref<bool(GlobalValue::GUID, const GlobalValueSummary *)>
+        isPrevailing,
+    const DenseSet<GlobalValue::GUID> &GUIDPreservedSymbols);
+
 /// Compute all the imports for the given module using the Index.
 ///
 /// \p ImportList will be populated with a map that can be passed to
@@ -167,7 +167,10 @@ private:
                          legacy::PassManagerBase &PM) const;
   void addInitialAliasAnalysisPasses(legacy::PassManagerBase &PM) const;
   void addLTOOptimizationPasses(legacy::PassManagerBase &PM);
+  void addLTOIPOPasses(legacy::PassManagerBase &PM);
+  void addLTOFunctionSimplificationPasses(legacy::PassManagerBase &PM);
   void addLateLTOOptimizationPasses(legacy::PassManagerBase &PM);
+  void addLTOCFIPasses(legacy::PassManagerBase &PM);
   void addPGOInstrPasses(legacy::PassManagerBase &MPM);
   void addFunctionSimplificationPasses(legacy::PassManagerBase &MPM);
   void addInstructionCombiningPass(legacy::PassManagerBase &MPM) const;
@@ -181,6 +184,17 @@ public:
   /// populateModulePassManager - This sets up the primary pass manager.
   void populateModulePassManager(legacy::PassManagerBase &MPM);
   void populateLTOPassManager(legacy::PassManagerBase &PM);
+
+  /// The three stages of populateLTOPassManager, for clients that want to run
+  /// them separately: the whole-program IPO passes, the function
+  /// simplification passes, which only look at one function at a time and may
+  /// therefore run on partitions of the module, and the late whole-program
+  /// cleanup and CFI lowering passes.
+  void populateLTOIPOPassManager(legacy::PassManagerBase &PM);
+  void
+  populateLTOFunctionSimplificationPassManager(legacy::PassManagerBase &PM);
+  void populateLTOLatePassManager(legacy::PassManagerBase &PM);
+
   void populateThinLTOPassManager(legacy::PassManagerBase &PM);
 };
 
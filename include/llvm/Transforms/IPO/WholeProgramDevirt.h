@@ -17,6 +17,7 @@
 
 #include "llvm/IR/Module.h"
 #include "llvm/IR/PassManager.h"
+#include "llvm/Transforms/IPO/FunctionImport.h"
 #include <cassert>
 #include <cstdint>
 #include <utility>
@@ -28,6 +29,7 @@ template <typename T> class ArrayRef;
 template <typename T> class MutableArrayRef;
 class Function;
 class GlobalVariable;
+class ModuleSummaryIndex;
 
 namespace wholeprogramdevirt {
 
@@ -116,7 +118,8 @@ struct TypeMemberInfo {
 struct VirtualCallTarget {
   VirtualCallTarget(Function *Fn, const TypeMemberInfo *TM);
 
-  // For testing only.
+  // For testing, and for laying out return values without the function, as
+  // done for ThinLTO.
   VirtualCallTarget(const TypeMemberInfo *TM, bool IsBigEndian)
       : Fn(nullptr), TM(TM), IsBigEndian(IsBigEndian), WasDevirt(false) {}
 
@@ -221,6 +224,25 @@ struct WholeProgramDevirtPass : public PassInfoMixin<WholeProgramDevirtPass> {
   PreservedAnalyses run(Module &M, ModuleAnalysisManager &);
 };
 
+/// Devirtualize the virtual calls of a ThinLTO link from the summaries of its
+/// modules: decide, for each virtual function slot that is called, whether
+/// the calls can go directly to the only implementation, be replaced by the
+/// value that all implementations return, or load that value from the vtable
+/// (virtual constant propagation). The decisions are recorded in \p Index for
+/// applyWholeProgramDevirtResolutions, and the functions and vtables that the
+/// backends of other modules will refer to are added to \p ExportLists.
+void runWholeProgramDevirtOnIndex(
+    ModuleSummaryIndex &Index,
+    StringMap<FunctionImporter::ExportSetTy> &ExportLists);
+
+/// Rewrite the virtual calls of the ThinLTO backend module \p M, and lay out
+/// the return values stored next to its vtables, as decided by
+/// runWholeProgramDevirtOnIndex. This runs after promotion and importing, as
+/// the decisions refer to values by their promoted names. Returns true if
+/// \p M changed.
+bool applyWholeProgramDevirtResolutions(Module &M,
+                                        const ModuleSummaryIndex &Index);
+
 } // end namespace llvm
 
 #endif // LLVM_TRANSFORMS_IPO_WHOLEPROGRAMDEVIRT_H
@@ -27,6 +27,7 @@
 #include "llvm/IR/Dominators.h"
 #include "llvm/IR/InstIterator.h"
 #include "llvm/IR/IntrinsicInst.h"
+#include "llvm/IR/Operator.h"
 #include "llvm/IR/ValueSymbolTable.h"
 #include "llvm/Object/IRObjectFile.h"
 #include "llvm/Pass.h"
@@ -80,10 +81,44 @@ static CalleeInfo::HotnessType getHotness(uint64_t ProfileCount,
   return CalleeInfo::HotnessType::None;
 }
 
-static void computeFunctionSummary(ModuleSummaryIndex &Index, const Module &M,
-                                   const Function &F, BlockFrequencyInfo *BFI,
-                                   ProfileSummaryInfo *PSI,
-                                   bool HasLocalsInUsed) {
+// Return the integer that F returns if its body is nothing but a return of
+// that constant, which lets whole-program devirtualization evaluate virtual
+// calls to it. Only functions whose address is taken, as virtual functions'
+// is by their vtables, are of interest.
+static const ConstantInt *getConstantReturnValue(const Function &F) {
+  if (F.size() != 1 || !F.hasAddressTaken())
+    return nullptr;
+  auto *RI = dyn_cast<ReturnInst>(F.getEntryBlock().getFirstNonPHIOrDbg());
+  if (!RI)
+    return nullptr;
+  auto *RetVal = dyn_cast_or_null<ConstantInt>(RI->getReturnValue());
+  if (!RetVal || RetVal->getBitWidth() > 64)
+    return nullptr;
+  return RetVal;
+}
+
+// Return true if V, a global variable or a pointer computed from one with
+// bitcasts and getelementptrs, is only ever loaded from: nothing is stored
+// through it, and it is not stored, passed to a call or compared either, which
+// could let the address of the variable escape.
+static bool isOnlyLoaded(const Value *V) {
+  for (const User *U : V->users()) {
+    if (auto *LI = dyn_cast<LoadInst>(U)) {
+      if (LI->isVolatile())
+        return false;
+      continue;
+    }
+    if ((isa<BitCastOperator>(U) || isa<GEPOperator>(U)) && isOnlyLoaded(U))
+      continue;
+    return false;
+  }
+  return true;
+}
+
+static void computeFunctionSummary(
+    ModuleSummaryIndex &Index, const Module &M, const Function &F,
+    BlockFrequencyInfo *BFI, ProfileSummaryInfo *PSI, bool HasLocalsInUsed,
+    const DenseSet<const GlobalVariable *> &ReadOnlyVars) {
   // Summary not currently supported for anonymous functions, they should
   // have been named.
   assert(F.hasName());
@@ -94,6 +129,7 @@ static void computeFunctionSummary(ModuleSummaryIndex &Index, const Module &M,
   MapVector<ValueInfo, CalleeInfo> CallGraphEdges;
   SetVector<ValueInfo> RefEdges;
   SetVector<GlobalValue::GUID> TypeTests;
+  SetVector<std::pair<GlobalValue::GUID, uint64_t>> TypeTestAssumeVCalls;
   ICallPromotionAnalysis ICallAnalysis;
 
   bool HasInlineAsmMaybeReferencingInternal = false;
@@ -142,10 +178,20 @@ static void computeFunctionSummary(ModuleSummaryIndex &Index, const Module &M,
             Function *F = AssumeCI->getCalledFunction();
             return !F || F->getIntrinsicID() != Intrinsic::assume;
           });
-          if (HasNonAssumeUses) {
-            auto *TypeMDVal = cast<MetadataAsValue>(CI->getArgOperand(1));
-            if (auto *TypeId = dyn_cast<MDString>(TypeMDVal->getMetadata()))
-              TypeTests.insert(GlobalValue::getGUID(TypeId->getString()));
+          auto *TypeMDVal = cast<MetadataAsValue>(CI->getArgOperand(1));
+          auto *TypeId = dyn_cast<MDString>(TypeMDVal->getMetadata());
+          if (HasNonAssumeUses && TypeId)
+            TypeTests.insert(GlobalValue::getGUID(TypeId->getString()));
+          // Record the virtual calls that whole-program devirtualization may
+          // rewrite, by the slot they call through.
+          if (TypeId) {
+            SmallVector<DevirtCallSite, 4> DevirtCalls;
+            SmallVector<CallInst *, 4> Assumes;
+            findDevirtualizableCallsForTypeTest(DevirtCalls, Assumes,
+                                                const_cast<CallInst *>(CI));
+            for (const DevirtCallSite &Call : DevirtCalls)
+              TypeTestAssumeVCalls.insert(
+                  {GlobalValue::getGUID(TypeId->getString()), Call.Offset});
           }
         }
         // We should have named any anonymous globals
@@ -178,23 +224,95 @@ static void computeFunctionSummary(ModuleSummaryIndex &Index, const Module &M,
       }
     }
 
+  std::vector<ValueInfo> ReadOnlyRefs;
+  for (const ValueInfo &VI : RefEdges)
+    if (auto *GV = dyn_cast<GlobalVariable>(VI.getValue()))
+      if (ReadOnlyVars.count(GV))
+        ReadOnlyRefs.push_back(VI);
+
   GlobalValueSummary::GVFlags Flags(F);
   auto FuncSummary = llvm::make_unique<FunctionSummary>(
       Flags, NumInsts, RefEdges.takeVector(), CallGraphEdges.takeVector(),
       TypeTests.takeVector());
   if (HasInlineAsmMaybeReferencingInternal)
     FuncSummary->setHasInlineAsmMaybeReferencingInternal();
+  std::vector<VFuncId> VCalls;
+  for (auto &VCall : TypeTestAssumeVCalls)
+    VCalls.push_back({VCall.first, VCall.second});
+  FuncSummary->setTypeTestAssumeVCalls(std::move(VCalls));
+  if (const ConstantInt *RetVal = getConstantReturnValue(F))
+    FuncSummary->setConstantReturn(RetVal->getBitWidth(),
+                                   RetVal->getZExtValue());
+  FuncSummary->setReadOnlyRefs(std::move(ReadOnlyRefs));
   Index.addGlobalValueSummary(F.getName(), std::move(FuncSummary));
 }
 
-static void computeVariableSummary(ModuleSummaryIndex &Index,
-                                   const GlobalVariable &V) {
+// Collect the functions whose address is stored in the initializer I, which
+// starts StartingOffset bytes into the variable.
+static void findFuncPointers(const Constant *I, uint64_t StartingOffset,
+                             const DataLayout &DL,
+                             std::vector<VTableFunc> &Funcs) {
+  if (auto *C = dyn_cast<ConstantStruct>(I)) {
+    const StructLayout *SL = DL.getStructLayout(C->getType());
+    for (unsigned Op = 0, E = C->getNumOperands(); Op != E; ++Op)
+      findFuncPointers(C->getOperand(Op),
+                       StartingOffset + SL->getElementOffset(Op), DL, Funcs);
+  } else if (auto *C = dyn_cast<ConstantArray>(I)) {
+    uint64_t EltSize = DL.getTypeAllocSize(C->getType()->getElementType());
+    for (unsigned Op = 0, E = C->getNumOperands(); Op != E; ++Op)
+      findFuncPointers(C->getOperand(Op), StartingOffset + Op * EltSize, DL,
+                       Funcs);
+  } else if (auto *F = dyn_cast<Function>(I->stripPointerCasts())) {
+    Funcs.push_back({ValueInfo(F), StartingOffset});
+  }
+}
+
+// Record the layout of V if it is a vtable, that is, a variable with type
+// metadata, for whole-program devirtualization. Vtables that are not constant
+// are recorded too, without their function pointers: the thin link must know
+// them to leave alone the slots that they are members of.
+static void computeVTableInfo(const GlobalVariable &V,
+                              GlobalVarSummary &Summary) {
+  SmallVector<MDNode *, 2> Types;
+  V.getMetadata(LLVMContext::MD_type, Types);
+  std::vector<VTableTypeId> TypeIds;
+  for (MDNode *Type : Types) {
+    // Type identifiers local to the module can't be matched up with calls in
+    // other modules.
+    auto *TypeId = dyn_cast<MDString>(Type->getOperand(1));
+    if (!TypeId)
+      continue;
+    uint64_t AddressPoint =
+        cast<ConstantInt>(
+            cast<ConstantAsMetadata>(Type->getOperand(0))->getValue())
+            ->getZExtValue();
+    TypeIds.push_back(
+        {GlobalValue::getGUID(TypeId->getString()), AddressPoint});
+  }
+  if (TypeIds.empty())
+    return;
+
+  const DataLayout &DL = V.getParent()->getDataLayout();
+  std::vector<VTableFunc> Funcs;
+  if (V.isConstant())
+    findFuncPointers(V.getInitializer(), 0, DL, Funcs);
+  Summary.setVTableInfo(DL.getTypeAllocSize(V.getInitializer()->getType()),
+                        V.isConstant(), std::move(TypeIds), std::move(Funcs));
+}
+
+static void
+computeVariableSummary(ModuleSummaryIndex &Index, const GlobalVariable &V,
+                       const DenseSet<const GlobalVariable *> &ReadOnlyVars) {
   SetVector<ValueInfo> RefEdges;
   SmallPtrSet<const User *, 8> Visited;
   findRefEdges(&V, RefEdges, Visited);
   GlobalValueSummary::GVFlags Flags(V);
   auto GVarSummary =
       llvm::make_unique<GlobalVarSummary>(Flags, RefEdges.takeVector());
+  computeVTableInfo(V, *GVarSummary);
+  if (ReadOnlyVars.count(&V))
+    GVarSummary->setMaybeReadOnly(
+        V.getParent()->getDataLayout().getTypeAllocSize(V.getValueType()));
   Index.addGlobalValueSummary(V.getName(), std::move(GVarSummary));
 }
 
@@ -231,6 +349,15 @@ ModuleSummaryIndex llvm::buildModuleSummaryIndex(
       LocalsUsed.insert(V);
   }
 
+  // Find the variables, defined in the module or not, that the module only
+  // loads from. The thin link imports and internalizes those that the whole
+  // program only loads from. Variables placed in an explicit section may be
+  // accessed through the section bounds, so they are never read-only.
+  DenseSet<const GlobalVariable *> ReadOnlyVars;
+  for (const GlobalVariable &G : M.globals())
+    if (!G.isExternallyInitialized() && !G.hasSection() && isOnlyLoaded(&G))
+      ReadOnlyVars.insert(&G);
+
   // Compute summaries for all functions defined in module, and save in the
   // index.
   for (auto &F : M) {
@@ -248,7 +375,8 @@ ModuleSummaryIndex llvm::buildModuleSummaryIndex(
       BFI = BFIPtr.get();
     }
 
-    computeFunctionSummary(Index, M, F, BFI, PSI, !LocalsUsed.empty());
+    computeFunctionSummary(Index, M, F, BFI, PSI, !LocalsUsed.empty(),
+                           ReadOnlyVars);
   }
 
   // Compute summaries for all variables defined in module, and save in the
@@ -256,7 +384,7 @@ ModuleSummaryIndex llvm::buildModuleSummaryIndex(
   for (const GlobalVariable &G : M.globals()) {
     if (G.isDeclaration())
       continue;
-    computeVariableSummary(Index, G);
+    computeVariableSummary(Index, G, ReadOnlyVars);
   }
 
   // Compute summaries for all aliases defined in module, and save in the
@@ -71,6 +71,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -4421,6 +4422,8 @@ Error BitcodeReader::materialize(GlobalValue *GV) {
   if (!F || !F->isMaterializable())
     return Error::success();
 
+  TimeTraceScope TimeScope("MaterializeFunction", F->getName());
+
   DenseMap<Function*, uint64_t>::iterator DFII = DeferredFunctionInfo.find(F);
   assert(DFII != DeferredFunctionInfo.end() && "Deferred function not found!");
   // If its position is recorded as 0, its body is somewhere in the stream
@@ -4848,6 +4851,14 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(
   GlobalValueSummary *LastSeenSummary = nullptr;
   bool Combined = false;
   std::vector<GlobalValue::GUID> PendingTypeTests;
+  std::vector<VFuncId> PendingTypeTestAssumeVCalls;
+  std::pair<unsigned, uint64_t> PendingConstantReturn;
+  uint64_t PendingVTableSize = 0;
+  bool PendingVTableIsConstant = false;
+  std::vector<VTableTypeId> PendingVTableTypeIds;
+  std::vector<VTableFunc> PendingVTableFuncs;
+  std::vector<ValueInfo> PendingReadOnlyRefs;
+  Optional<uint64_t> PendingReadOnlyGlobalVarSize;
 
   while (true) {
     BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
@@ -4916,6 +4927,13 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(
           Flags, InstCount, std::move(Refs), std::move(Calls),
           std::move(PendingTypeTests));
       PendingTypeTests.clear();
+      FS->setTypeTestAssumeVCalls(std::move(PendingTypeTestAssumeVCalls));
+      PendingTypeTestAssumeVCalls.clear();
+      FS->setConstantReturn(PendingConstantReturn.first,
+                            PendingConstantReturn.second);
+      PendingConstantReturn = {0, 0};
+      FS->setReadOnlyRefs(std::move(PendingReadOnlyRefs));
+      PendingReadOnlyRefs.clear();
       auto GUID = getGUIDFromValueId(ValueID);
       FS->setModulePath(TheIndex.addModulePath(ModulePath, 0)->first());
       FS->setOriginalName(GUID.second);
@@ -4958,6 +4976,16 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(
       std::vector<ValueInfo> Refs =
           makeRefList(ArrayRef<uint64_t>(Record).slice(2));
       auto FS = llvm::make_unique<GlobalVarSummary>(Flags, std::move(Refs));
+      FS->setVTableInfo(PendingVTableSize, PendingVTableIsConstant,
+                        std::move(PendingVTableTypeIds),
+                        std::move(PendingVTableFuncs));
+      PendingVTableSize = 0;
+      PendingVTableIsConstant = false;
+      PendingVTableTypeIds.clear();
+      PendingVTableFuncs.clear();
+      if (PendingReadOnlyGlobalVarSize)
+        FS->setMaybeReadOnly(*PendingReadOnlyGlobalVarSize);
+      PendingReadOnlyGlobalVarSize.reset();
       FS->setModulePath(TheIndex.addModulePath(ModulePath, 0)->first());
       auto GUID = getGUIDFromValueId(ValueID);
       FS->setOriginalName(GUID.second);
@@ -5031,6 +5059,11 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(
       std::vector<ValueInfo> Refs =
           makeRefList(ArrayRef<uint64_t>(Record).slice(3));
       auto FS = llvm::make_unique<GlobalVarSummary>(Flags, std::move(Refs));
+      if (PendingReadOnlyGlobalVarSize) {
+        FS->setMaybeReadOnly(*PendingReadOnlyGlobalVarSize);
+        FS->setReadOnly(true);
+      }
+      PendingReadOnlyGlobalVarSize.reset();
       LastSeenSummary = FS.get();
       FS->setModulePath(ModuleIdMap[ModuleId]);
       GlobalValue::GUID GUID = getGUIDFromValueId(ValueID).first;
@@ -5054,6 +5087,62 @@ Error ModuleSummaryIndexBitcodeReader::parseEntireSummary(
                               Record.end());
       break;
     }
+    // FS_TYPE_TEST_ASSUME_VCALLS: [n x (typeid, offset)]
+    case bitc::FS_TYPE_TEST_ASSUME_VCALLS: {
+      assert(PendingTypeTestAssumeVCalls.empty());
+      if (Record.size() % 2 != 0)
+        return error("Invalid record");
+      for (unsigned I = 0, E = Record.size(); I != E; I += 2)
+        PendingTypeTestAssumeVCalls.push_back({Record[I], Record[I + 1]});
+      break;
+    }
+    // FS_CONSTANT_RETURN: [bitwidth, value]
+    case bitc::FS_CONSTANT_RETURN: {
+      if (Record.size() != 2 || Record[0] == 0 || Record[0] > 64)
+        return error("Invalid record");
+      PendingConstantReturn = {unsigned(Record[0]), Record[1]};
+      break;
+    }
+    // FS_VTABLE_TYPE_IDS: [size, isconstant, n x (typeid, addresspoint)]
+    case bitc::FS_VTABLE_TYPE_IDS: {
+      if (Record.size() < 2 || Record.size() % 2 != 0)
+        return error("Invalid record");
+      PendingVTableSize = Record[0];
+      PendingVTableIsConstant = Record[1];
+      for (unsigned I = 2, E = Record.size(); I != E; I += 2)
+        PendingVTableTypeIds.push_back({Record[I], Record[I + 1]});
+      break;
+    }
+    // FS_VTABLE_FUNCS: [n x (valueid, offset)]
+    case bitc::FS_VTABLE_FUNCS: {
+      if (Record.size() % 2 != 0)
+        return error("Invalid record");
+      for (unsigned I = 0, E = Record.size(); I != E; I += 2)
+        PendingVTableFuncs.push_back(
+            {getGUIDFromValueId(Record[I]).first, Record[I + 1]});
+      break;
+    }
+    // FS_READONLY_REFS: [n x valueid]
+    case bitc::FS_READONLY_REFS: {
+      assert(PendingReadOnlyRefs.empty());
+      PendingReadOnlyRefs = makeRefList(Record);
+      break;
+    }
+    // FS_READONLY_GLOBALVAR: [size]
+    case bitc::FS_READONLY_GLOBALVAR: {
+      if (Record.size() != 1)
+        return error("Invalid record");
+      PendingReadOnlyGlobalVarSize = Record[0];
+      break;
+    }
+    // FS_DEVIRT_VALUE_NAME: [valueid, namechar x N]
+    case bitc::FS_DEVIRT_VALUE_NAME: {
+      if (Record.empty())
+        return error("Invalid record");
+      std::string Name(Record.begin() + 1, Record.end());
+      TheIndex.addDevirtValueName(getGUIDFromValueId(Record[0]).first, Name);
+      break;
+    }
     }
   }
   llvm_unreachable("Exit infinite loop");
@@ -5154,12 +5243,53 @@ const std::error_category &llvm::BitcodeErrorCategory() {
 
 Expected<std::vector<BitcodeModule>>
 llvm::getBitcodeModuleList(MemoryBufferRef Buffer) {
+  Expected<BitcodeFileContents> FOrErr = getBitcodeFileContents(Buffer);
+  if (!FOrErr)
+    return FOrErr.takeError();
+  return std::move(FOrErr->Mods);
+}
+
+/// Read the records of the symbol table block into \p F.
+static Error readSymtabBlock(BitstreamCursor &Stream, BitcodeFileContents &F) {
+  if (Stream.EnterSubBlock(bitc::SYMTAB_BLOCK_ID))
+    return error("Invalid record");
+
+  SmallVector<uint64_t, 1> Record;
+  while (true) {
+    BitstreamEntry Entry = Stream.advanceSkippingSubblocks();
+    switch (Entry.Kind) {
+    case BitstreamEntry::SubBlock: // Handled for us already.
+    case BitstreamEntry::Error:
+      return error("Malformed block");
+    case BitstreamEntry::EndBlock:
+      return Error::success();
+    case BitstreamEntry::Record:
+      break;
+    }
+
+    Record.clear();
+    StringRef Blob;
+    switch (Stream.readRecord(Entry.ID, Record, &Blob)) {
+    default: // Default behavior: ignore.
+      break;
+    case bitc::SYMTAB_BLOB:
+      F.Symtab = Blob;
+      break;
+    case bitc::SYMTAB_STRTAB_BLOB:
+      F.StrtabForSymtab = Blob;
+      break;
+    }
+  }
+}
+
+Expected<BitcodeFileContents>
+llvm::getBitcodeFileContents(MemoryBufferRef Buffer) {
   Expected<BitstreamCursor> StreamOrErr = initStream(Buffer);
   if (!StreamOrErr)
     return StreamOrErr.takeError();
   BitstreamCursor &Stream = *StreamOrErr;
 
-  std::vector<BitcodeModule> Modules;
+  BitcodeFileContents F;
   while (true) {
     uint64_t BCBegin = Stream.getCurrentByteNo();
 
@@ -5167,7 +5297,7 @@ llvm::getBitcodeModuleList(MemoryBufferRef Buffer) {
     // of the bitcode stream (e.g. Apple's ar tool). If we are close enough to
     // the end that there cannot possibly be another module, stop looking.
     if (BCBegin + 8 >= Stream.getBitcodeBytes().size())
-      return Modules;
+      return std::move(F);
 
     BitstreamEntry Entry = Stream.advance();
     switch (Entry.Kind) {
@@ -5193,10 +5323,16 @@ llvm::getBitcodeModuleList(MemoryBufferRef Buffer) {
         if (Stream.SkipBlock())
           return error("Malformed block");
 
-        Modules.push_back({Stream.getBitcodeBytes().slice(
-                               BCBegin, Stream.getCurrentByteNo() - BCBegin),
-                           Buffer.getBufferIdentifier(), IdentificationBit,
-                           ModuleBit});
+        F.Mods.push_back({Stream.getBitcodeBytes().slice(
+                              BCBegin, Stream.getCurrentByteNo() - BCBegin),
+                          Buffer.getBufferIdentifier(), IdentificationBit,
+                          ModuleBit});
+        continue;
+      }
+
+      if (Entry.ID == bitc::SYMTAB_BLOCK_ID) {
+        if (Error Err = readSymtabBlock(Stream, F))
+          return std::move(Err);
         continue;
       }
 
@@ -5222,6 +5358,7 @@ llvm::getBitcodeModuleList(MemoryBufferRef Buffer) {
 Expected<std::unique_ptr<Module>>
 BitcodeModule::getModuleImpl(LLVMContext &Context, bool MaterializeAll,
                              bool ShouldLazyLoadMetadata, bool IsImporting) {
+  TimeTraceScope TimeScope("ParseBitcode", ModuleIdentifier);
   BitstreamCursor Stream(Buffer);
 
   std::string ProducerIdentification;
@@ -28,10 +28,12 @@
 #include "llvm/IR/Operator.h"
 #include "llvm/IR/UseListOrder.h"
 #include "llvm/IR/ValueSymbolTable.h"
+#include "llvm/Object/IRSymtab.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Program.h"
 #include "llvm/Support/SHA1.h"
+#include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/raw_ostream.h"
 #include <cctype>
 #include <map>
@@ -3291,6 +3293,28 @@ void ModuleBitcodeWriter::writePerModuleFunctionSummaryRecord(
   if (!FS->type_tests().empty())
     Stream.EmitRecord(bitc::FS_TYPE_TESTS, FS->type_tests());
 
+  if (!FS->type_test_assume_vcalls().empty()) {
+    SmallVector<uint64_t, 8> Record;
+    for (const VFuncId &VF : FS->type_test_assume_vcalls()) {
+      Record.push_back(VF.TypeId);
+      Record.push_back(VF.Offset);
+    }
+    Stream.EmitRecord(bitc::FS_TYPE_TEST_ASSUME_VCALLS, Record);
+  }
+
+  if (FS->hasConstantReturn())
+    Stream.EmitRecord(bitc::FS_CONSTANT_RETURN,
+                      ArrayRef<uint64_t>{FS->getConstantReturnBitWidth(),
+                                         FS->getConstantReturnValue()});
+
+  if (!FS->readonly_refs().empty()) {
+    SmallVector<uint64_t, 8> Record;
+    for (auto &RI : FS->readonly_refs())
+      Record.push_back(VE.getValueID(RI.getValue()));
+    std::sort(Record.begin(), Record.end());
+    Stream.EmitRecord(bitc::FS_READONLY_REFS, Record);
+  }
+
   NameVals.push_back(getEncodedGVSummaryFlags(FS->flags()));
   NameVals.push_back(FS->instCount());
   NameVals.push_back(FS->refs().size());
@@ -3330,6 +3354,28 @@ void ModuleBitcodeWriter::writeModuleLevelReferences(
   auto *Summary = Summaries->second.front().get();
   NameVals.push_back(VE.getValueID(&V));
   GlobalVarSummary *VS = cast<GlobalVarSummary>(Summary);
+
+  if (VS->isVTable()) {
+    SmallVector<uint64_t, 8> Record;
+    Record.push_back(VS->getVTableSize());
+    Record.push_back(VS->isConstantVTable());
+    for (const VTableTypeId &TI : VS->vtable_type_ids()) {
+      Record.push_back(TI.TypeId);
+      Record.push_back(TI.AddressPoint);
+    }
+    Stream.EmitRecord(bitc::FS_VTABLE_TYPE_IDS, Record);
+    Record.clear();
+    for (const VTableFunc &VF : VS->vtable_funcs()) {
+      Record.push_back(VE.getValueID(VF.Func.getValue()));
+      Record.push_back(VF.Offset);
+    }
+    Stream.EmitRecord(bitc::FS_VTABLE_FUNCS, Record);
+  }
+
+  if (VS->maybeReadOnly())
+    Stream.EmitRecord(bitc::FS_READONLY_GLOBALVAR,
+                      ArrayRef<uint64_t>{VS->getSize()});
+
   NameVals.push_back(getEncodedGVSummaryFlags(VS->flags()));
 
   unsigned SizeBeforeRefs = NameVals.size();
@@ -3445,6 +3491,29 @@ void ModuleBitcodeWriter::writePerModuleGlobalValueSummary() {
     NameVals.clear();
   }
 
+  // Whole-program devirtualization refers to vtables and virtual functions
+  // from other modules, for which it needs their names.
+  DenseSet<const GlobalValue *> Named;
+  auto WriteName = [&](const GlobalValue *GV) {
+    if (!Named.insert(GV).second)
+      return;
+    NameVals.push_back(VE.getValueID(GV));
+    NameVals.append(GV->getName().begin(), GV->getName().end());
+    Stream.EmitRecord(bitc::FS_DEVIRT_VALUE_NAME, NameVals);
+    NameVals.clear();
+  };
+  for (const GlobalVariable &G : M.globals()) {
+    if (G.isDeclaration())
+      continue;
+    auto *VS = dyn_cast_or_null<GlobalVarSummary>(
+        Index->getGlobalValueSummary(G));
+    if (!VS || !VS->isVTable())
+      continue;
+    WriteName(&G);
+    for (const VTableFunc &VF : VS->vtable_funcs())
+      WriteName(VF.Func.getValue());
+  }
+
   Stream.ExitBlock();
 }
 
@@ -3533,6 +3602,10 @@ void IndexBitcodeWriter::writeCombinedGlobalValueSummary() {
     }
 
     if (auto *VS = dyn_cast<GlobalVarSummary>(S)) {
+      // Only the outcome of the thin link matters to the backends.
+      if (VS->isReadOnly())
+        Stream.EmitRecord(bitc::FS_READONLY_GLOBALVAR,
+                          ArrayRef<uint64_t>{VS->getSize()});
       NameVals.push_back(ValueId);
       NameVals.push_back(Index.getModuleId(VS->modulePath()));
       NameVals.push_back(getEncodedGVSummaryFlags(VS->flags()));
@@ -3800,11 +3873,59 @@ void BitcodeWriter::writeModule(const Module *M,
                                 bool ShouldPreserveUseListOrder,
                                 const ModuleSummaryIndex *Index,
                                 bool GenerateHash) {
+  assert(!WroteSymtab && "Modules must be written before the symbol table");
+  // The symbol table builder needs a non-const module for ModuleSymbolTable,
+  // but does not modify it.
+  Mods.push_back(const_cast<Module *>(M));
+
   ModuleBitcodeWriter ModuleWriter(
       M, Buffer, *Stream, ShouldPreserveUseListOrder, Index, GenerateHash);
   ModuleWriter.write();
 }
 
+/// Write a record made of a single blob.
+static void writeBlobRecord(BitstreamWriter &Stream, unsigned Code,
+                            ArrayRef<char> Blob) {
+  BitCodeAbbrev *Abbv = new BitCodeAbbrev();
+  Abbv->Add(BitCodeAbbrevOp(Code));
+  Abbv->Add(BitCodeAbbrevOp(BitCodeAbbrevOp::Blob));
+  unsigned Abbrev = Stream.EmitAbbrev(Abbv);
+
+  uint64_t Record[] = {Code};
+  Stream.EmitRecordWithBlob(Abbrev, Record, Blob.data(), Blob.size());
+}
+
+void BitcodeWriter::writeSymtab() {
+  assert(!WroteSymtab && "Symbol table already written");
+  WroteSymtab = true;
+
+  // Collecting the symbols of module-level inline asm requires the target's
+  // asm parser. Without it we cannot build an accurate symbol table, so leave
+  // it to the reader to build one.
+  for (Module *M : Mods) {
+    if (M->getModuleInlineAsm().empty())
+      continue;
+    std::string Err;
+    const Target *T = TargetRegistry::lookupTarget(M->getTargetTriple(), Err);
+    if (!T || !T->hasMCAsmParser())
+      return;
+  }
+
+  // The symbol table is only an optimization for readers, and building it
+  // fails on some malformed modules (e.g. an alias of a non-constant
+  // expression) that we still want to be able to write.
+  SmallVector<char, 0> Symtab, Strtab;
+  if (Error E = irsymtab::build(Mods, Symtab, Strtab)) {
+    consumeError(std::move(E));
+    return;
+  }
+
+  Stream->EnterSubblock(bitc::SYMTAB_BLOCK_ID, 3);
+  writeBlobRecord(*Stream, bitc::SYMTAB_BLOB, Symtab);
+  writeBlobRecord(*Stream, bitc::SYMTAB_STRTAB_BLOB, Strtab);
+  Stream->ExitBlock();
+}
+
 /// WriteBitcodeToFile - Write the specified module to the specified output
 /// stream.
 void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
@@ -3822,6 +3943,7 @@ void llvm::WriteBitcodeToFile(const Module *M, raw_ostream &Out,
 
   BitcodeWriter Writer(Buffer);
   Writer.writeModule(M, ShouldPreserveUseListOrder, Index, GenerateHash);
+  Writer.writeSymtab();
 
   if (TT.isOSDarwin() || TT.isOSBinFormatMachO())
     emitDarwinBCHeaderAndTrailer(Buffer, TT);
@@ -20,6 +20,7 @@
 #include "llvm/Support/Dwarf.h"
 #include "llvm/Support/ELF.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
@@ -60,7 +61,14 @@ void DWARFContext::dump(raw_ostream &OS, DIDumpType DumpType, bool DumpEH,
 
   if (DumpType == DIDT_All || DumpType == DIDT_Info) {
     OS << "\n.debug_info contents:\n";
-    for (const auto &CU : compile_units())
+    // Units are parsed independently of each other, so extract their DIEs
+    // concurrently before dumping them in order.
+    cu_iterator_range Units = compile_units();
+    parallel_for_each(Units.begin(), Units.end(),
+                      [](const std::unique_ptr<DWARFCompileUnit> &CU) {
+                        CU->getUnitDIE(/*ExtractUnitDIEOnly=*/false);
+                      });
+    for (const auto &CU : Units)
       CU->dump(OS);
   }
 
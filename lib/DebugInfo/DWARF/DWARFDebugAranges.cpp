@@ -12,6 +12,7 @@
 #include "llvm/DebugInfo/DWARF/DWARFContext.h"
 #include "llvm/DebugInfo/DWARF/DWARFDebugArangeSet.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
 #include <cassert>
@@ -47,14 +48,21 @@ void DWARFDebugAranges::generate(DWARFContext *CTX) {
   // Generate aranges from DIEs: even if .debug_aranges section is present,
   // it may describe only a small subset of compilation units, so we need to
   // manually build aranges for the rest of them.
-  for (const auto &CU : CTX->compile_units()) {
-    uint32_t CUOffset = CU->getOffset();
-    if (ParsedCUOffsets.insert(CUOffset).second) {
-      DWARFAddressRangesVector CURanges;
-      CU->collectAddressRanges(CURanges);
-      for (const auto &R : CURanges) {
-        appendRange(CUOffset, R.first, R.second);
-      }
+  std::vector<DWARFCompileUnit *> Units;
+  for (const auto &CU : CTX->compile_units())
+    if (ParsedCUOffsets.insert(CU->getOffset()).second)
+      Units.push_back(CU.get());
+
+  // Collecting the ranges of a unit parses its DIEs, which only touches that
+  // unit: do it concurrently, and append the ranges in unit order.
+  std::vector<DWARFAddressRangesVector> UnitRanges(Units.size());
+  parallel_for_each_n(size_t(0), Units.size(), [&](size_t I) {
+    Units[I]->collectAddressRanges(UnitRanges[I]);
+  });
+  for (size_t I = 0, E = Units.size(); I != E; ++I) {
+    uint32_t CUOffset = Units[I]->getOffset();
+    for (const auto &R : UnitRanges[I]) {
+      appendRange(CUOffset, R.first, R.second);
     }
   }
 
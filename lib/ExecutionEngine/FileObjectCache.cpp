@@ -0,0 +1,195 @@
+//===-- FileObjectCache.cpp - Persistent on-disk object cache -------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/FileObjectCache.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/StringExtras.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/SHA1.h"
+#include "llvm/Support/raw_ostream.h"
+#include "llvm/Target/TargetMachine.h"
+
+#define DEBUG_TYPE "file-object-cache"
+
+using namespace llvm;
+
+/// Describe the parts of the configuration of \p TM that affect the objects
+/// it produces.
+static std::string getTargetConfig(const TargetMachine &TM) {
+  std::string Config;
+  raw_string_ostream OS(Config);
+  const TargetOptions &Opts = TM.Options;
+  OS << TM.getTargetTriple().str() << '\0' << TM.getTargetCPU() << '\0'
+     << TM.getTargetFeatureString() << '\0' << TM.getRelocationModel() << ' '
+     << TM.getCodeModel() << ' ' << TM.getOptLevel();
+#define OPT(X) OS << ' ' << static_cast<unsigned>(Opts.X)
+  OPT(UnsafeFPMath);
+  OPT(NoInfsFPMath);
+  OPT(NoNaNsFPMath);
+  OPT(NoTrappingFPMath);
+  OPT(HonorSignDependentRoundingFPMathOption);
+  OPT(NoZerosInBSS);
+  OPT(GuaranteedTailCallOpt);
+  OPT(StackAlignmentOverride);
+  OPT(EnableFastISel);
+  OPT(UseInitArray);
+  OPT(RelaxELFRelocations);
+  OPT(FunctionSections);
+  OPT(DataSections);
+  OPT(UniqueSectionNames);
+  OPT(TrapUnreachable);
+  OPT(EmulatedTLS);
+  OPT(EnableIPRA);
+  OPT(FloatABIType);
+  OPT(AllowFPOpFusion);
+  OPT(ThreadModel);
+  OPT(EABIVersion);
+  OPT(DebuggerTuning);
+  OPT(FPDenormalMode);
+  OPT(ExceptionModel);
+#undef OPT
+  return OS.str();
+}
+
+FileObjectCache::FileObjectCache(StringRef CacheDir, const TargetMachine &TM)
+    : FileObjectCache(CacheDir, getTargetConfig(TM)) {}
+
+FileObjectCache::FileObjectCache(StringRef CacheDir, StringRef Config)
+    : CacheDir(CacheDir), Pruner(CacheDir), NumHits(0), NumMisses(0) {
+  // Objects compiled by different versions of LLVM are never shared.
+  this->Config = LLVM_VERSION_STRING;
+  this->Config += '\0';
+  this->Config += Config;
+  this->Config += '\0';
+}
+
+FileObjectCache::~FileObjectCache() {}
+
+std::string FileObjectCache::getKey(const Module &M) const {
+  SmallVector<char, 0> Bitcode;
+  {
+    raw_svector_ostream OS(Bitcode);
+    WriteBitcodeToFile(&M, OS);
+  }
+  SHA1 Hasher;
+  Hasher.update(Config);
+  Hasher.update(StringRef(Bitcode.data(), Bitcode.size()));
+  return toHex(Hasher.result());
+}
+
+std::string FileObjectCache::getEntryPath(StringRef Key) const {
+  SmallString<128> Path(CacheDir);
+  sys::path::append(Path, "llvmcache-" + Key + ".o");
+  return Path.str();
+}
+
+std::unique_ptr<MemoryBuffer> FileObjectCache::getObject(const Module *M) {
+  std::string Key = getKey(*M);
+  std::string EntryPath = getEntryPath(Key);
+  {
+    std::lock_guard<std::mutex> Lock(CacheMutex);
+    PendingKeys[M] = Key;
+  }
+
+  int FD;
+  if (sys::fs::openFileForRead(EntryPath, FD)) {
+    DEBUG(dbgs() << "Cache miss for " << M->getModuleIdentifier() << " ("
+                 << Key << ")\n");
+    ++NumMisses;
+    return nullptr;
+  }
+  ErrorOr<std::unique_ptr<MemoryBuffer>> ObjOrErr = MemoryBuffer::getOpenFile(
+      FD, EntryPath, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+  // Record the use, so that expiration-based pruning removes the entries that
+  // have not been used for the longest time.
+  sys::fs::setLastModificationAndAccessTime(
+      FD, std::chrono::system_clock::now());
+  sys::Process::SafelyCloseFileDescriptor(FD);
+
+  // An entry that is not an object file cannot have been written by this
+  // cache. Drop it and compile the module again.
+  if (!ObjOrErr ||
+      sys::fs::identify_magic((*ObjOrErr)->getBuffer()) ==
+          sys::fs::file_magic::unknown) {
+    sys::fs::remove(EntryPath);
+    ++NumMisses;
+    return nullptr;
+  }
+
+  DEBUG(dbgs() << "Cache hit for " << M->getModuleIdentifier() << " (" << Key
+               << ")\n");
+  ++NumHits;
+  CachePruning::recordAccess(CacheDir, sys::path::filename(EntryPath),
+                             (*ObjOrErr)->getBufferSize());
+  {
+    std::lock_guard<std::mutex> Lock(CacheMutex);
+    PendingKeys.erase(M);
+  }
+  // The JIT may write into the buffer it is given, while the file is mapped
+  // read-only and may be shared with other processes: return a copy.
+  return MemoryBuffer::getMemBufferCopy((*ObjOrErr)->getBuffer(), EntryPath);
+}
+
+void FileObjectCache::notifyObjectCompiled(const Module *M,
+                                           MemoryBufferRef Obj) {
+  std::string Key;
+  {
+    std::lock_guard<std::mutex> Lock(CacheMutex);
+    auto I = PendingKeys.find(M);
+    if (I != PendingKeys.end()) {
+      Key = std::move(I->second);
+      PendingKeys.erase(I);
+    }
+  }
+  // Without a prior call to getObject the key can only be computed from the
+  // module after code generation, which may have changed it. Such entries are
+  // merely never hit.
+  if (Key.empty())
+    Key = getKey(*M);
+
+  if (sys::fs::create_directories(CacheDir))
+    return;
+
+  // Write the object to a temporary file in the cache directory, then rename
+  // it into place, so that other processes never see a partial entry.
+  SmallString<128> TempModel(CacheDir), TempPath;
+  sys::path::append(TempModel, "llvmcache-tmp-%%%%%%%%.o");
+  int FD;
+  if (sys::fs::createUniqueFile(TempModel, FD, TempPath))
+    return;
+  {
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << Obj.getBuffer();
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+  std::string EntryPath = getEntryPath(Key);
+  if (sys::fs::rename(TempPath, EntryPath)) {
+    sys::fs::remove(TempPath);
+    return;
+  }
+  CachePruning::recordAccess(CacheDir, sys::path::filename(EntryPath),
+                             Obj.getBufferSize());
+  DEBUG(dbgs() << "Cached " << M->getModuleIdentifier() << " (" << Key
+               << ")\n");
+
+  prune();
+}
+
+bool FileObjectCache::prune() { return Pruner.prune(); }
@@ -40,7 +40,10 @@ static cl::opt<bool> PrintVolatile("interpreter-print-volatile", cl::Hidden,
 //===----------------------------------------------------------------------===//
 
 static void SetValue(Value *V, GenericValue Val, ExecutionContext &SF) {
-  SF.Values[V] = Val;
+  if (SF.Decoded)
+    SF.Slots[SF.Decoded->getSlot(V)] = Val;
+  else
+    SF.Values[V] = Val;
 }
 
 //===----------------------------------------------------------------------===//
@@ -931,6 +934,8 @@ void Interpreter::SwitchToNewBasicBlock(BasicBlock *Dest, ExecutionContext &SF){
   BasicBlock *PrevBB = SF.CurBB;      // Remember where we came from...
   SF.CurBB   = Dest;                  // Update CurBB to branch destination
   SF.CurInst = SF.CurBB->begin();     // Update new instruction ptr...
+  if (SF.Decoded)
+    SF.PC = SF.Decoded->BlockStarts.lookup(Dest);
 
   if (!isa<PHINode>(SF.CurInst)) return;  // Nothing fancy to do
 
@@ -1085,8 +1090,20 @@ void Interpreter::visitCallSite(CallSite CS) {
       // If it is an unknown intrinsic function, use the intrinsic lowering
       // class to transform it into hopefully tasty LLVM code.
       //
+      if (SF.Decoded) {
+        lowerDecodedIntrinsicCall(cast<CallInst>(CS.getInstruction()));
+        return;
+      }
       BasicBlock::iterator me(CS.getInstruction());
       BasicBlock *Parent = CS.getInstruction()->getParent();
+
+      // Other frames running the function resume at the call if it follows a
+      // call that has yet to return to them.
+      std::vector<ExecutionContext *> Resuming;
+      for (ExecutionContext &Frame : ECStack)
+        if (&Frame != &SF && Frame.CurInst == me)
+          Resuming.push_back(&Frame);
+
       bool atBegin(Parent->begin() == me);
       if (!atBegin)
         --me;
@@ -1100,6 +1117,8 @@ void Interpreter::visitCallSite(CallSite CS) {
         SF.CurInst = me;
         ++SF.CurInst;
       }
+      for (ExecutionContext *Frame : Resuming)
+        Frame->CurInst = SF.CurInst;
       return;
     }
 
@@ -2060,6 +2079,9 @@ GenericValue Interpreter::getOperandValue(Value *V, ExecutionContext &SF) {
     return getConstantValue(CPV);
   } else if (GlobalValue *GV = dyn_cast<GlobalValue>(V)) {
     return PTOGV(getPointerToGlobal(GV));
+  } else if (SF.Decoded) {
+    unsigned Slot = SF.Decoded->getSlot(V);
+    return Slot == DecodedFunction::NoSlot ? GenericValue() : SF.Slots[Slot];
   } else {
     return SF.Values[V];
   }
@@ -2089,6 +2111,11 @@ void Interpreter::callFunction(Function *F, ArrayRef<GenericValue> ArgVals) {
     return;
   }
 
+  if (PreDecode) {
+    StackFrame.Decoded = &getDecodedFunction(F);
+    StackFrame.Slots.resize(StackFrame.Decoded->NumSlots);
+  }
+
   // Get pointers to first LLVM BB & Instruction in function.
   StackFrame.CurBB     = &F->front();
   StackFrame.CurInst   = StackFrame.CurBB->begin();
@@ -2113,6 +2140,14 @@ void Interpreter::run() {
   while (!ECStack.empty()) {
     // Interpret a single instruction & increment the "PC".
     ExecutionContext &SF = ECStack.back();  // Current stack frame
+    if (const DecodedFunction *DF = SF.Decoded) {
+      const DecodedInst &DI = DF->Code[SF.PC++];
+      ++NumDynamicInsts;
+      DEBUG(dbgs() << "About to interpret: " << *DI.I);
+      DI.Handler(*this, SF, DI);
+      continue;
+    }
+
     Instruction &I = *SF.CurInst++;         // Increment before execute
 
     // Track the number of dynamic instructions executed.
@@ -2122,3 +2157,564 @@ void Interpreter::run() {
     visit(I);   // Dispatch to one of the visit* methods...
   }
 }
+
+//===----------------------------------------------------------------------===//
+//                        Pre-decoded Execution
+//===----------------------------------------------------------------------===//
+//
+// With -interpreter-predecode, every function is lowered on its first call to
+// a vector of DecodedInsts, each pointing at the handler implementing it.
+// Common scalar instructions get handlers working directly on the slots of the
+// frame; everything else is executed by a handler that calls back into the
+// visitor, which reads and writes slots through getOperandValue and SetValue.
+//
+
+struct Interpreter::PreDecoder {
+  Interpreter &Interp;
+  Function &F;
+  DecodedFunction &DF;
+
+  // Constants already in the constant pool, and a frame to evaluate them in.
+  DenseMap<const Value *, unsigned> ConstantIndices;
+  ExecutionContext ConstantSF;
+
+  PreDecoder(Interpreter &Interp, Function &F, DecodedFunction &DF)
+      : Interp(Interp), F(F), DF(DF) {}
+
+  void decode();
+  bool encode(Value *V, unsigned &Op);
+  unsigned getEdge(BasicBlock *From, BasicBlock *To);
+  DecodedHandler decodeInst(Instruction &I, DecodedInst &DI);
+  DecodedHandler decodeGEP(GetElementPtrInst &GEP, DecodedInst &DI);
+
+  //===--------------------------------------------------------------------===//
+  // Handlers
+
+  static const GenericValue &getOp(const ExecutionContext &SF, unsigned Op) {
+    if (Op & DecodedFunction::ConstantOperand)
+      return SF.Decoded->Constants[Op & ~DecodedFunction::ConstantOperand];
+    return SF.Slots[Op];
+  }
+
+  static void takeEdge(Interpreter &Interp, ExecutionContext &SF,
+                       unsigned EdgeIdx) {
+    const DecodedFunction &DF = *SF.Decoded;
+    const DecodedEdge &E = DF.Edges[EdgeIdx];
+    if (E.Generic) {
+      Interp.SwitchToNewBasicBlock(E.Dest, SF);
+      return;
+    }
+    SF.CurBB = E.Dest;
+    SF.PC = E.Target;
+    if (!E.Parallel) {
+      for (unsigned I = E.MovesBegin; I != E.MovesEnd; ++I)
+        SF.Slots[DF.Moves[I].first] = getOp(SF, DF.Moves[I].second);
+      return;
+    }
+    // The PHI nodes read all of their inputs before any of them is written.
+    SmallVector<GenericValue, 8> Incoming;
+    for (unsigned I = E.MovesBegin; I != E.MovesEnd; ++I)
+      Incoming.push_back(getOp(SF, DF.Moves[I].second));
+    for (unsigned I = E.MovesBegin; I != E.MovesEnd; ++I)
+      SF.Slots[DF.Moves[I].first] = std::move(Incoming[I - E.MovesBegin]);
+  }
+
+  static void execFallback(Interpreter &Interp, ExecutionContext &SF,
+                           const DecodedInst &DI) {
+    Interp.visit(*DI.I);
+  }
+
+  static void execBr(Interpreter &Interp, ExecutionContext &SF,
+                     const DecodedInst &DI) {
+    takeEdge(Interp, SF, DI.Aux);
+  }
+
+  static void execCondBr(Interpreter &Interp, ExecutionContext &SF,
+                         const DecodedInst &DI) {
+    bool Cond = getOp(SF, DI.Ops[0]).IntVal != 0;
+    takeEdge(Interp, SF, Cond ? DI.Ops[1] : DI.Ops[2]);
+  }
+
+  static void execRet(Interpreter &Interp, ExecutionContext &SF,
+                      const DecodedInst &DI) {
+    GenericValue Result;
+    if (!DI.Ty->isVoidTy())
+      Result = getOp(SF, DI.Ops[0]);
+    Interp.popStackAndReturnValueToCaller(DI.Ty, Result);
+  }
+
+  static void execCall(Interpreter &Interp, ExecutionContext &SF,
+                       const DecodedInst &DI) {
+    const DecodedFunction &DF = *SF.Decoded;
+    SmallVector<GenericValue, 8> ArgVals;
+    ArgVals.reserve(DI.Ops[2]);
+    for (unsigned I = DI.Ops[1], E = DI.Ops[1] + DI.Ops[2]; I != E; ++I)
+      ArgVals.push_back(getOp(SF, DF.CallArgs[I]));
+    SF.Caller = CallSite(DI.I);
+    // This pushes a frame, so SF must not be used afterwards.
+    Interp.callFunction((Function *)GVTOP(getOp(SF, DI.Ops[0])), ArgVals);
+  }
+
+#define DECODED_INT_BINOP(NAME, EXPR)                                          \
+  static void exec##NAME(Interpreter &, ExecutionContext &SF,                  \
+                         const DecodedInst &DI) {                              \
+    const APInt &A = getOp(SF, DI.Ops[0]).IntVal;                              \
+    const APInt &B = getOp(SF, DI.Ops[1]).IntVal;                              \
+    SF.Slots[DI.Dest].IntVal = EXPR;                                           \
+  }
+  DECODED_INT_BINOP(Add, A + B)
+  DECODED_INT_BINOP(Sub, A - B)
+  DECODED_INT_BINOP(Mul, A * B)
+  DECODED_INT_BINOP(UDiv, A.udiv(B))
+  DECODED_INT_BINOP(SDiv, A.sdiv(B))
+  DECODED_INT_BINOP(URem, A.urem(B))
+  DECODED_INT_BINOP(SRem, A.srem(B))
+  DECODED_INT_BINOP(And, A & B)
+  DECODED_INT_BINOP(Or, A | B)
+  DECODED_INT_BINOP(Xor, A ^ B)
+  DECODED_INT_BINOP(Shl, A.shl(getShiftAmount(B.getZExtValue(), A)))
+  DECODED_INT_BINOP(LShr, A.lshr(getShiftAmount(B.getZExtValue(), A)))
+  DECODED_INT_BINOP(AShr, A.ashr(getShiftAmount(B.getZExtValue(), A)))
+#undef DECODED_INT_BINOP
+
+#define DECODED_FP_BINOP(NAME)                                                 \
+  static void exec##NAME(Interpreter &, ExecutionContext &SF,                  \
+                         const DecodedInst &DI) {                              \
+    execute##NAME##Inst(SF.Slots[DI.Dest], getOp(SF, DI.Ops[0]),               \
+                        getOp(SF, DI.Ops[1]), DI.Ty);                          \
+  }
+  DECODED_FP_BINOP(FAdd)
+  DECODED_FP_BINOP(FSub)
+  DECODED_FP_BINOP(FMul)
+  DECODED_FP_BINOP(FDiv)
+  DECODED_FP_BINOP(FRem)
+#undef DECODED_FP_BINOP
+
+  static void execIntCmp(Interpreter &, ExecutionContext &SF,
+                         const DecodedInst &DI) {
+    const APInt &A = getOp(SF, DI.Ops[0]).IntVal;
+    const APInt &B = getOp(SF, DI.Ops[1]).IntVal;
+    bool R;
+    switch (DI.Aux) {
+    default: llvm_unreachable("Not an integer predicate!");
+    case ICmpInst::ICMP_EQ:  R = A == B; break;
+    case ICmpInst::ICMP_NE:  R = A != B; break;
+    case ICmpInst::ICMP_UGT: R = A.ugt(B); break;
+    case ICmpInst::ICMP_SGT: R = A.sgt(B); break;
+    case ICmpInst::ICMP_ULT: R = A.ult(B); break;
+    case ICmpInst::ICMP_SLT: R = A.slt(B); break;
+    case ICmpInst::ICMP_UGE: R = A.uge(B); break;
+    case ICmpInst::ICMP_SGE: R = A.sge(B); break;
+    case ICmpInst::ICMP_ULE: R = A.ule(B); break;
+    case ICmpInst::ICMP_SLE: R = A.sle(B); break;
+    }
+    SF.Slots[DI.Dest].IntVal = APInt(1, R);
+  }
+
+  static void execCmp(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &DI) {
+    SF.Slots[DI.Dest] = executeCmpInst(DI.Aux, getOp(SF, DI.Ops[0]),
+                                       getOp(SF, DI.Ops[1]), DI.Ty);
+  }
+
+  static void execSelect(Interpreter &, ExecutionContext &SF,
+                         const DecodedInst &DI) {
+    bool Cond = getOp(SF, DI.Ops[0]).IntVal != 0;
+    SF.Slots[DI.Dest] = getOp(SF, Cond ? DI.Ops[1] : DI.Ops[2]);
+  }
+
+  static void execTrunc(Interpreter &, ExecutionContext &SF,
+                        const DecodedInst &DI) {
+    SF.Slots[DI.Dest].IntVal = getOp(SF, DI.Ops[0]).IntVal.trunc(DI.Aux);
+  }
+
+  static void execZExt(Interpreter &, ExecutionContext &SF,
+                       const DecodedInst &DI) {
+    SF.Slots[DI.Dest].IntVal = getOp(SF, DI.Ops[0]).IntVal.zext(DI.Aux);
+  }
+
+  static void execSExt(Interpreter &, ExecutionContext &SF,
+                       const DecodedInst &DI) {
+    SF.Slots[DI.Dest].IntVal = getOp(SF, DI.Ops[0]).IntVal.sext(DI.Aux);
+  }
+
+  static void execLoad(Interpreter &Interp, ExecutionContext &SF,
+                       const DecodedInst &DI) {
+    GenericValue *Ptr = (GenericValue *)GVTOP(getOp(SF, DI.Ops[0]));
+    Interp.LoadValueFromMemory(SF.Slots[DI.Dest], Ptr, DI.Ty);
+  }
+
+  static void execStore(Interpreter &Interp, ExecutionContext &SF,
+                        const DecodedInst &DI) {
+    GenericValue *Ptr = (GenericValue *)GVTOP(getOp(SF, DI.Ops[1]));
+    Interp.StoreValueToMemory(getOp(SF, DI.Ops[0]), Ptr, DI.Ty);
+  }
+
+  static void execGEP(Interpreter &, ExecutionContext &SF,
+                      const DecodedInst &DI) {
+    const DecodedFunction &DF = *SF.Decoded;
+    const DecodedGEP &GEP = DF.GEPs[DI.Aux];
+    uint64_t Total = GEP.Offset;
+    for (unsigned I = GEP.IdxBegin; I != GEP.IdxEnd; ++I) {
+      const auto &Idx = DF.GEPIndices[I];
+      Total += Idx.second * getOp(SF, Idx.first).IntVal.getSExtValue();
+    }
+    SF.Slots[DI.Dest].PointerVal =
+        (char *)getOp(SF, GEP.Base).PointerVal + Total;
+  }
+};
+
+// Return true if C can be evaluated when decoding a function, rather than when
+// executing the instruction using it: this must not fail or depend on anything
+// that can change.
+static bool canEvaluateEarly(const Constant *C) {
+  if (isa<GlobalValue>(C))
+    return true;
+  if (isa<BlockAddress>(C))
+    return false;
+  if (auto *CE = dyn_cast<ConstantExpr>(C)) {
+    switch (CE->getOpcode()) {
+    // Cases handled by getConstantExprValue, except division by a constant
+    // that may be zero.
+    case Instruction::Trunc:    case Instruction::ZExt:
+    case Instruction::SExt:     case Instruction::FPTrunc:
+    case Instruction::FPExt:    case Instruction::UIToFP:
+    case Instruction::SIToFP:   case Instruction::FPToUI:
+    case Instruction::FPToSI:   case Instruction::PtrToInt:
+    case Instruction::IntToPtr: case Instruction::BitCast:
+    case Instruction::GetElementPtr:
+    case Instruction::FCmp:     case Instruction::ICmp:
+    case Instruction::Select:
+    case Instruction::Add:      case Instruction::Sub:
+    case Instruction::Mul:      case Instruction::FAdd:
+    case Instruction::FSub:     case Instruction::FMul:
+    case Instruction::FDiv:     case Instruction::FRem:
+    case Instruction::And:      case Instruction::Or:
+    case Instruction::Xor:      case Instruction::Shl:
+    case Instruction::LShr:     case Instruction::AShr:
+      break;
+    default:
+      return false;
+    }
+  }
+  for (const Use &Op : C->operands())
+    if (!canEvaluateEarly(cast<Constant>(Op)))
+      return false;
+  return true;
+}
+
+bool Interpreter::PreDecoder::encode(Value *V, unsigned &Op) {
+  if (isa<Instruction>(V) || isa<Argument>(V)) {
+    Op = DF.getSlot(V);
+    return Op != DecodedFunction::NoSlot;
+  }
+  auto *C = dyn_cast<Constant>(V);
+  if (!C || !canEvaluateEarly(C))
+    return false;
+  auto P = ConstantIndices.insert(std::make_pair(V, DF.Constants.size()));
+  if (P.second)
+    DF.Constants.push_back(Interp.getOperandValue(V, ConstantSF));
+  Op = P.first->second | DecodedFunction::ConstantOperand;
+  return true;
+}
+
+unsigned Interpreter::PreDecoder::getEdge(BasicBlock *From, BasicBlock *To) {
+  DecodedEdge E;
+  E.Dest = To;
+  E.Target = DF.BlockStarts[To];
+  E.MovesBegin = DF.Moves.size();
+  E.Generic = false;
+  E.Parallel = false;
+  for (Instruction &I : *To) {
+    auto *PN = dyn_cast<PHINode>(&I);
+    if (!PN)
+      break;
+    unsigned Src;
+    if (!encode(PN->getIncomingValueForBlock(From), Src)) {
+      E.Generic = true;
+      break;
+    }
+    // Moves are done in order unless one reads the result of an earlier one.
+    for (unsigned J = E.MovesBegin, JE = DF.Moves.size(); J != JE; ++J)
+      if (DF.Moves[J].first == Src)
+        E.Parallel = true;
+    DF.Moves.push_back(std::make_pair(DF.getSlot(PN), Src));
+  }
+  if (E.Generic)
+    DF.Moves.resize(E.MovesBegin);
+  E.MovesEnd = DF.Moves.size();
+  DF.Edges.push_back(E);
+  return DF.Edges.size() - 1;
+}
+
+DecodedHandler Interpreter::PreDecoder::decodeGEP(GetElementPtrInst &GEP,
+                                                  DecodedInst &DI) {
+  if (GEP.getType()->isVectorTy() ||
+      !encode(GEP.getPointerOperand(), DI.Ops[0]))
+    return nullptr;
+
+  const DataLayout &DL = Interp.getDataLayout();
+  DecodedGEP Decoded;
+  Decoded.Base = DI.Ops[0];
+  Decoded.Offset = 0;
+  Decoded.IdxBegin = DF.GEPIndices.size();
+  for (gep_type_iterator I = gep_type_begin(GEP), E = gep_type_end(GEP);
+       I != E; ++I) {
+    if (StructType *STy = I.getStructTypeOrNull()) {
+      unsigned Index = cast<ConstantInt>(I.getOperand())->getZExtValue();
+      Decoded.Offset += DL.getStructLayout(STy)->getElementOffset(Index);
+      continue;
+    }
+    // Like executeGEPOperation, only support 32 and 64 bit indices, which are
+    // sign extended.
+    unsigned BitWidth = I.getOperand()->getType()->getIntegerBitWidth();
+    if (BitWidth != 32 && BitWidth != 64)
+      return nullptr;
+    uint64_t Scale = DL.getTypeAllocSize(I.getIndexedType());
+    if (auto *CI = dyn_cast<ConstantInt>(I.getOperand())) {
+      Decoded.Offset += Scale * CI->getSExtValue();
+      continue;
+    }
+    unsigned Op;
+    if (!encode(I.getOperand(), Op))
+      return nullptr;
+    DF.GEPIndices.push_back(std::make_pair(Op, Scale));
+  }
+  Decoded.IdxEnd = DF.GEPIndices.size();
+  DI.Aux = DF.GEPs.size();
+  DF.GEPs.push_back(Decoded);
+  return execGEP;
+}
+
+DecodedHandler Interpreter::PreDecoder::decodeInst(Instruction &I,
+                                                   DecodedInst &DI) {
+  // Vectors and aggregates are left to the visitor.
+  Type *Ty = I.getType();
+  if (Ty->isVectorTy() || Ty->isAggregateType())
+    return nullptr;
+  if (I.getNumOperands() && I.getOperand(0)->getType()->isVectorTy())
+    return nullptr;
+
+  switch (I.getOpcode()) {
+  default:
+    return nullptr;
+
+  case Instruction::Ret:
+    DI.Ty = Type::getVoidTy(I.getContext());
+    if (I.getNumOperands()) {
+      DI.Ty = I.getOperand(0)->getType();
+      if (!encode(I.getOperand(0), DI.Ops[0]))
+        return nullptr;
+    }
+    return execRet;
+
+  case Instruction::Br: {
+    auto &BI = cast<BranchInst>(I);
+    if (BI.isUnconditional()) {
+      DI.Aux = getEdge(BI.getParent(), BI.getSuccessor(0));
+      return execBr;
+    }
+    if (!encode(BI.getCondition(), DI.Ops[0]))
+      return nullptr;
+    DI.Ops[1] = getEdge(BI.getParent(), BI.getSuccessor(0));
+    DI.Ops[2] = getEdge(BI.getParent(), BI.getSuccessor(1));
+    return execCondBr;
+  }
+
+  case Instruction::Call: {
+    CallSite CS(&I);
+    if (isa<InlineAsm>(CS.getCalledValue()))
+      return nullptr;
+    if (Function *Callee = CS.getCalledFunction())
+      if (Callee->isIntrinsic())
+        return nullptr;
+    if (!encode(CS.getCalledValue(), DI.Ops[0]))
+      return nullptr;
+    DI.Ops[1] = DF.CallArgs.size();
+    DI.Ops[2] = CS.arg_size();
+    for (Value *Arg : CS.args()) {
+      unsigned Op;
+      if (!encode(Arg, Op)) {
+        DF.CallArgs.resize(DI.Ops[1]);
+        return nullptr;
+      }
+      DF.CallArgs.push_back(Op);
+    }
+    return execCall;
+  }
+
+  case Instruction::Add:  case Instruction::Sub:  case Instruction::Mul:
+  case Instruction::UDiv: case Instruction::SDiv: case Instruction::URem:
+  case Instruction::SRem: case Instruction::And:  case Instruction::Or:
+  case Instruction::Xor:  case Instruction::Shl:  case Instruction::LShr:
+  case Instruction::AShr: case Instruction::FAdd: case Instruction::FSub:
+  case Instruction::FMul: case Instruction::FDiv: case Instruction::FRem:
+    if (!encode(I.getOperand(0), DI.Ops[0]) ||
+        !encode(I.getOperand(1), DI.Ops[1]))
+      return nullptr;
+    switch (I.getOpcode()) {
+    default: llvm_unreachable("Not a binary operator!");
+    case Instruction::Add:  return execAdd;
+    case Instruction::Sub:  return execSub;
+    case Instruction::Mul:  return execMul;
+    case Instruction::UDiv: return execUDiv;
+    case Instruction::SDiv: return execSDiv;
+    case Instruction::URem: return execURem;
+    case Instruction::SRem: return execSRem;
+    case Instruction::And:  return execAnd;
+    case Instruction::Or:   return execOr;
+    case Instruction::Xor:  return execXor;
+    case Instruction::Shl:  return execShl;
+    case Instruction::LShr: return execLShr;
+    case Instruction::AShr: return execAShr;
+    case Instruction::FAdd: return execFAdd;
+    case Instruction::FSub: return execFSub;
+    case Instruction::FMul: return execFMul;
+    case Instruction::FDiv: return execFDiv;
+    case Instruction::FRem: return execFRem;
+    }
+
+  case Instruction::ICmp:
+  case Instruction::FCmp:
+    if (!encode(I.getOperand(0), DI.Ops[0]) ||
+        !encode(I.getOperand(1), DI.Ops[1]))
+      return nullptr;
+    DI.Aux = cast<CmpInst>(I).getPredicate();
+    return DI.Ty->isIntegerTy() ? execIntCmp : execCmp;
+
+  case Instruction::Select:
+    for (unsigned Op = 0; Op != 3; ++Op)
+      if (!encode(I.getOperand(Op), DI.Ops[Op]))
+        return nullptr;
+    return execSelect;
+
+  case Instruction::Trunc:
+  case Instruction::ZExt:
+  case Instruction::SExt:
+    if (!encode(I.getOperand(0), DI.Ops[0]))
+      return nullptr;
+    DI.Aux = Ty->getIntegerBitWidth();
+    return I.getOpcode() == Instruction::Trunc
+               ? execTrunc
+               : I.getOpcode() == Instruction::ZExt ? execZExt : execSExt;
+
+  case Instruction::Load: {
+    auto &LI = cast<LoadInst>(I);
+    if ((LI.isVolatile() && PrintVolatile) ||
+        !encode(LI.getPointerOperand(), DI.Ops[0]))
+      return nullptr;
+    DI.Ty = Ty;
+    return execLoad;
+  }
+
+  case Instruction::Store: {
+    auto &SI = cast<StoreInst>(I);
+    if ((SI.isVolatile() && PrintVolatile) ||
+        !encode(SI.getValueOperand(), DI.Ops[0]) ||
+        !encode(SI.getPointerOperand(), DI.Ops[1]))
+      return nullptr;
+    return execStore;
+  }
+
+  case Instruction::GetElementPtr:
+    return decodeGEP(cast<GetElementPtrInst>(I), DI);
+  }
+}
+
+void Interpreter::PreDecoder::decode() {
+  // Number the arguments and the instructions producing a value.
+  for (Argument &A : F.args())
+    DF.Slots[&A] = DF.NumSlots++;
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB)
+      if (!I.getType()->isVoidTy())
+        DF.Slots[&I] = DF.NumSlots++;
+
+  // Lay out the blocks in order; PHI nodes are executed by the edges leading
+  // to their block, so they take no code.
+  unsigned NumInsts = 0;
+  for (BasicBlock &BB : F) {
+    DF.BlockStarts[&BB] = NumInsts;
+    for (Instruction &I : BB)
+      if (!isa<PHINode>(I))
+        ++NumInsts;
+  }
+
+  DF.Code.reserve(NumInsts);
+  for (BasicBlock &BB : F)
+    for (Instruction &I : BB) {
+      if (isa<PHINode>(I))
+        continue;
+      DecodedInst DI;
+      DI.I = &I;
+      DI.Ty = I.getNumOperands() ? I.getOperand(0)->getType() : I.getType();
+      DI.Dest = DF.getSlot(&I);
+      DI.Ops[0] = DI.Ops[1] = DI.Ops[2] = 0;
+      DI.Aux = 0;
+      DI.Handler = decodeInst(I, DI);
+      if (!DI.Handler)
+        DI.Handler = execFallback;
+      DF.Code.push_back(DI);
+    }
+}
+
+const DecodedFunction &Interpreter::getDecodedFunction(Function *F) {
+  std::unique_ptr<DecodedFunction> &DF = DecodedFunctions[F];
+  if (!DF) {
+    DF = llvm::make_unique<DecodedFunction>();
+    PreDecoder(*this, *F, *DF).decode();
+  }
+  return *DF;
+}
+
+void Interpreter::lowerDecodedIntrinsicCall(CallInst *CI) {
+  // As in the visitor, intrinsic calls are only lowered when they are first
+  // executed: IntrinsicLowering does not support every intrinsic, and those
+  // it cannot lower must only fail if they are reached. Lowering changes the
+  // function, so it is decoded again, and the frames running it are moved
+  // over to the new code.
+  BasicBlock *Parent = CI->getParent();
+  Function *F = Parent->getParent();
+  std::unique_ptr<DecodedFunction> OldDF = std::move(DecodedFunctions[F]);
+  Instruction *Prev = CI == &Parent->front() ? nullptr : CI->getPrevNode();
+
+  // The values of every frame running F, and the instruction it resumes at.
+  // The current frame, and any frame about to return to CI, resume at the
+  // first instruction replacing CI.
+  struct FrameState {
+    ExecutionContext *SF;
+    Instruction *Next;
+    std::vector<std::pair<const Value *, GenericValue>> Values;
+  };
+  std::vector<FrameState> Frames;
+  for (ExecutionContext &SF : ECStack) {
+    if (SF.Decoded != OldDF.get())
+      continue;
+    FrameState S;
+    S.SF = &SF;
+    S.Next = &SF == &ECStack.back() ? CI : OldDF->Code[SF.PC].I;
+    for (const auto &Slot : OldDF->Slots)
+      if (Slot.first != CI)
+        S.Values.push_back(std::make_pair(Slot.first, SF.Slots[Slot.second]));
+    Frames.push_back(std::move(S));
+  }
+
+  IL->LowerIntrinsicCall(CI);
+  Instruction *Replacement = Prev ? Prev->getNextNode() : &Parent->front();
+
+  const DecodedFunction &DF = getDecodedFunction(F);
+  DenseMap<const Instruction *, unsigned> CodeIndices;
+  for (unsigned I = 0, E = DF.Code.size(); I != E; ++I)
+    CodeIndices[DF.Code[I].I] = I;
+  for (FrameState &S : Frames) {
+    ExecutionContext &SF = *S.SF;
+    SF.Decoded = &DF;
+    SF.PC = CodeIndices.lookup(S.Next == CI ? Replacement : S.Next);
+    SF.Slots.assign(DF.NumSlots, GenericValue());
+    for (auto &V : S.Values) {
+      assert(DF.getSlot(V.first) != DecodedFunction::NoSlot &&
+             "Value lost by lowering an intrinsic call");
+      SF.Slots[DF.getSlot(V.first)] = std::move(V.second);
+    }
+  }
+}
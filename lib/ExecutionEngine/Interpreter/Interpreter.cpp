@@ -17,9 +17,15 @@
 #include "llvm/CodeGen/IntrinsicLowering.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
 #include <cstring>
 using namespace llvm;
 
+static cl::opt<bool> PreDecodeFunctions(
+    "interpreter-predecode",
+    cl::desc("Lower every function to pre-decoded code on its first call, "
+             "instead of interpreting its IR directly"));
+
 namespace {
 
 static struct RegisterInterp {
@@ -53,7 +59,7 @@ ExecutionEngine *Interpreter::create(std::unique_ptr<Module> M,
 // Interpreter ctor - Initialize stuff
 //
 Interpreter::Interpreter(std::unique_ptr<Module> M)
-    : ExecutionEngine(std::move(M)) {
+    : ExecutionEngine(std::move(M)), PreDecode(PreDecodeFunctions) {
 
   memset(&ExitValue.Untyped, 0, sizeof(ExitValue.Untyped));
   // Initialize the "backend"
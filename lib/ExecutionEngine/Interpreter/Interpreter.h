@@ -14,6 +14,7 @@
 #ifndef LLVM_LIB_EXECUTIONENGINE_INTERPRETER_INTERPRETER_H
 #define LLVM_LIB_EXECUTIONENGINE_INTERPRETER_INTERPRETER_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ExecutionEngine/ExecutionEngine.h"
 #include "llvm/ExecutionEngine/GenericValue.h"
 #include "llvm/IR/CallSite.h"
@@ -55,6 +56,71 @@ public:
 
 typedef std::vector<GenericValue> ValuePlaneTy;
 
+class Interpreter;
+struct DecodedInst;
+struct ExecutionContext;
+
+// DecodedHandler - The implementation of one kind of pre-decoded instruction.
+// Every DecodedInst points directly at its handler, so executing it needs no
+// dispatch on the opcode.
+typedef void (*DecodedHandler)(Interpreter &, ExecutionContext &,
+                               const DecodedInst &);
+
+// DecodedInst - One instruction of a pre-decoded function. Operands are either
+// slots of the executing frame, or constants of the function's constant pool
+// if DecodedFunction::ConstantOperand is set.
+struct DecodedInst {
+  DecodedHandler Handler;
+  Instruction *I;       // The instruction this was decoded from
+  Type *Ty;             // The type of the first operand, or of the result
+  unsigned Dest;        // The slot receiving the result
+  unsigned Ops[3];      // Operands, or edges of a conditional branch
+  unsigned Aux;         // Predicate, bit width, edge or side table index
+};
+
+// DecodedEdge - A control flow edge of a pre-decoded function, together with
+// the moves of its PHI nodes. Edges whose incoming values cannot be decoded
+// are Generic, and take the regular SwitchToNewBasicBlock path.
+struct DecodedEdge {
+  BasicBlock *Dest;
+  unsigned Target;              // The first instruction of Dest
+  unsigned MovesBegin, MovesEnd;
+  bool Generic;
+  bool Parallel;                // A move reads a slot written by an earlier one
+};
+
+// DecodedGEP - The constant part of a getelementptr, and the scaled variable
+// indices in [IdxBegin, IdxEnd) of DecodedFunction::GEPIndices.
+struct DecodedGEP {
+  unsigned Base;
+  uint64_t Offset;
+  unsigned IdxBegin, IdxEnd;
+};
+
+// DecodedFunction - A function lowered by -interpreter-predecode on its first
+// call. Arguments and instruction results are numbered densely, so frames keep
+// their values in a vector, constants are evaluated once, and the moves for
+// the PHI nodes of every edge are precomputed.
+struct DecodedFunction {
+  enum : unsigned { ConstantOperand = 1u << 31, NoSlot = ~0u };
+
+  unsigned NumSlots = 0;
+  DenseMap<const Value *, unsigned> Slots;
+  DenseMap<const BasicBlock *, unsigned> BlockStarts;
+  std::vector<GenericValue> Constants;
+  std::vector<DecodedInst> Code;
+  std::vector<DecodedEdge> Edges;
+  std::vector<std::pair<unsigned, unsigned>> Moves; // (Slot, Operand)
+  std::vector<unsigned> CallArgs;
+  std::vector<DecodedGEP> GEPs;
+  std::vector<std::pair<unsigned, uint64_t>> GEPIndices; // (Operand, Scale)
+
+  unsigned getSlot(const Value *V) const {
+    auto I = Slots.find(V);
+    return I == Slots.end() ? NoSlot : I->second;
+  }
+};
+
 // ExecutionContext struct - This struct represents one stack frame currently
 // executing.
 //
@@ -68,7 +134,15 @@ struct ExecutionContext {
   std::vector<GenericValue>  VarArgs; // Values passed through an ellipsis
   AllocaHolder Allocas;            // Track memory allocated by alloca
 
-  ExecutionContext() : CurFunction(nullptr), CurBB(nullptr), CurInst(nullptr) {}
+  // With -interpreter-predecode, the frame executes Decoded->Code and keeps
+  // its values in Slots instead of Values.
+  const DecodedFunction *Decoded;
+  unsigned PC;                     // The next pre-decoded instruction
+  std::vector<GenericValue> Slots;
+
+  ExecutionContext()
+      : CurFunction(nullptr), CurBB(nullptr), CurInst(nullptr),
+        Decoded(nullptr), PC(0) {}
 };
 
 // Interpreter - This class represents the entirety of the interpreter.
@@ -85,6 +159,14 @@ class Interpreter : public ExecutionEngine, public InstVisitor<Interpreter> {
   // registered with the atexit() library function.
   std::vector<Function*> AtExitHandlers;
 
+  // Functions lowered to pre-decoded code, if -interpreter-predecode is on.
+  bool PreDecode;
+  DenseMap<Function *, std::unique_ptr<DecodedFunction>> DecodedFunctions;
+
+  // PreDecoder - Lowers functions to pre-decoded code, and implements the
+  // handlers executing it.
+  struct PreDecoder;
+
 public:
   explicit Interpreter(std::unique_ptr<Module> M);
   ~Interpreter() override;
@@ -196,6 +278,14 @@ private:  // Helper functions
 
   void *getPointerToFunction(Function *F) override { return (void*)F; }
 
+  // getDecodedFunction - Return the pre-decoded code of F, decoding it if this
+  // is its first call.
+  const DecodedFunction &getDecodedFunction(Function *F);
+
+  // lowerDecodedIntrinsicCall - Lower the intrinsic call CI of a pre-decoded
+  // function, decode the function again, and move its frames to the new code.
+  void lowerDecodedIntrinsicCall(CallInst *CI);
+
   void initializeExecutionEngine() { }
   void initializeExternalFunctions();
   GenericValue getConstantExprValue(ConstantExpr *CE, ExecutionContext &SF);
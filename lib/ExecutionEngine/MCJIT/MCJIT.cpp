@@ -660,3 +660,27 @@ LinkingSymbolResolver::findSymbol(const std::string &Name) {
     return nullptr;
   return ClientResolver->findSymbol(Name);
 }
+
+Expected<JITSymbolResolver::LookupResult>
+LinkingSymbolResolver::lookup(const LookupSet &Symbols) {
+  LookupResult Result;
+  LookupSet Unresolved;
+  {
+    MutexGuard locked(ParentEngine.lock);
+    for (StringRef Name : Symbols) {
+      if (auto Sym = ParentEngine.findSymbol(Name.str(), false))
+        Result.insert(std::make_pair(
+            Name, JITEvaluatedSymbol(Sym.getAddress(), Sym.getFlags())));
+      else
+        Unresolved.insert(Name);
+    }
+    if (Unresolved.empty() || ParentEngine.isSymbolSearchingDisabled())
+      return std::move(Result);
+  }
+
+  auto ClientResult = ClientResolver->lookup(Unresolved);
+  if (!ClientResult)
+    return ClientResult.takeError();
+  Result.insert(ClientResult->begin(), ClientResult->end());
+  return std::move(Result);
+}
@@ -34,6 +34,10 @@ public:
 
   JITSymbol findSymbol(const std::string &Name) override;
 
+  // Resolves the symbols MCJIT knows about under a single acquisition of its
+  // lock and passes the rest on to the client resolver in one query.
+  Expected<LookupResult> lookup(const LookupSet &Symbols) override;
+
   // MCJIT doesn't support logical dylibs.
   JITSymbol findSymbolInLogicalDylib(const std::string &Name) override {
     return nullptr;
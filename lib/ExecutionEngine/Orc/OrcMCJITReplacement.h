@@ -147,6 +147,35 @@ class OrcMCJITReplacement : public ExecutionEngine {
       return M.ClientResolver->findSymbolInLogicalDylib(Name);
     }
 
+    Expected<LookupResult> lookup(const LookupSet &Symbols) override {
+      // Symbols that the JIT has not emitted are looked up by the client
+      // resolver in a single query before falling back on the archives.
+      LookupResult Result;
+      LookupSet Unresolved;
+      for (StringRef Name : Symbols) {
+        if (auto Sym = M.LazyEmitLayer.findSymbol(Name, false))
+          Result.insert(std::make_pair(
+              Name, JITEvaluatedSymbol(Sym.getAddress(), Sym.getFlags())));
+        else
+          Unresolved.insert(Name);
+      }
+      if (Unresolved.empty())
+        return std::move(Result);
+
+      auto ClientResult = M.ClientResolver->lookup(Unresolved);
+      if (!ClientResult)
+        return ClientResult.takeError();
+      for (StringRef Name : Unresolved) {
+        auto I = ClientResult->find(Name);
+        if (I != ClientResult->end())
+          Result.insert(*I);
+        else if (auto Sym = M.scanArchives(Name))
+          Result.insert(std::make_pair(
+              Name, JITEvaluatedSymbol(Sym.getAddress(), Sym.getFlags())));
+      }
+      return std::move(Result);
+    }
+
   private:
     OrcMCJITReplacement &M;
   };
@@ -173,7 +202,8 @@ public:
       std::unique_ptr<TargetMachine> TM)
       : ExecutionEngine(TM->createDataLayout()), TM(std::move(TM)),
         MemMgr(*this, std::move(MemMgr)), Resolver(*this),
-        ClientResolver(std::move(ClientResolver)), NotifyObjectLoaded(*this),
+        ClientResolver(std::move(ClientResolver)),
+        NotifyListeners(EventListeners), NotifyObjectLoaded(*this),
         NotifyFinalized(*this),
         ObjectLayer(NotifyObjectLoaded, NotifyFinalized),
         CompileLayer(ObjectLayer, SimpleCompiler(*this->TM)),
@@ -260,10 +290,23 @@ public:
     CompileLayer.setObjectCache(NewCache);
   }
 
+  TargetMachine *getTargetMachine() override { return TM.get(); }
+
   void setProcessAllSections(bool ProcessAllSections) override {
     ObjectLayer.setProcessAllSections(ProcessAllSections);
   }
 
+  void RegisterJITEventListener(JITEventListener *L) override {
+    if (L)
+      EventListeners.push_back(L);
+  }
+
+  void UnregisterJITEventListener(JITEventListener *L) override {
+    EventListeners.erase(
+        std::remove(EventListeners.begin(), EventListeners.end(), L),
+        EventListeners.end());
+  }
+
 private:
   JITSymbol findMangledSymbol(StringRef Name) {
     if (auto Sym = LazyEmitLayer.findSymbol(Name, false))
@@ -324,6 +367,7 @@ private:
              "Incorrect number of Infos for Objects.");
       for (unsigned I = 0; I < Objects.size(); ++I)
         M.MemMgr.notifyObjectLoaded(&M, getObject(*Objects[I]));
+      M.NotifyListeners(H, Objects, Infos);
     }
 
   private:
@@ -371,6 +415,8 @@ private:
   std::shared_ptr<JITSymbolResolver> ClientResolver;
   Mangler Mang;
 
+  std::vector<JITEventListener *> EventListeners;
+  NotifyJITEventListeners NotifyListeners;
   NotifyObjectLoadedT NotifyObjectLoaded;
   NotifyFinalizedT NotifyFinalized;
 
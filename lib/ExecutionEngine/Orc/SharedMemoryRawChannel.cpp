@@ -0,0 +1,420 @@
+//===- SharedMemoryRawChannel.cpp - RPC channel over shared memory --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/SharedMemoryRawChannel.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Config/config.h"
+#include "llvm/ExecutionEngine/Orc/OrcError.h"
+#include "llvm/Support/Errc.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MathExtras.h"
+#include "llvm/Support/Process.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+#ifdef LLVM_ON_UNIX
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+using namespace llvm;
+using namespace llvm::orc;
+using namespace llvm::orc::rpc;
+
+namespace {
+
+const uint32_t RegionMagic = 0x4f524353; // 'ORCS'
+const uint32_t RegionVersion = 1;
+
+enum { JITSide = 0, ExecutorSide = 1 };
+
+} // end anonymous namespace
+
+/// The first page of the region. The rings follow it, then the heap.
+struct SharedMemoryRawChannel::RegionHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint64_t RingSize;
+  uint64_t HeapSize;
+  /// The address of the heap in the executor, or zero until the executor has
+  /// attached, or if it cannot execute code in the heap.
+  std::atomic<uint64_t> ExecutorHeapBase;
+  /// Whether each side is asleep on its pipe, waiting for the other.
+  std::atomic<uint32_t> Sleeping[2];
+};
+
+/// The positions of a ring, as byte counts since the start of the channel.
+/// The producer advances Head and the consumer advances Tail, each on its own
+/// cache line.
+struct SharedMemoryRawChannel::RingControl {
+  alignas(64) std::atomic<uint64_t> Head;
+  alignas(64) std::atomic<uint64_t> Tail;
+};
+
+/// The ring controls live in the header page, after the header itself.
+static const uint64_t RingControlOffset = 256;
+
+#ifdef LLVM_ON_UNIX
+
+static Error errnoError() {
+  return errorCodeToError(std::error_code(errno, std::generic_category()));
+}
+
+/// Create an unlinked file for the region, which child processes inherit.
+static Expected<int> createSharedMemoryFile() {
+#if defined(__linux__) && defined(SYS_memfd_create)
+  // Prefer an anonymous memory file: unlike a file in the temporary
+  // directory, it is never on a file system mounted noexec.
+  int MemFD = ::syscall(SYS_memfd_create, "orc-shared-memory", 0);
+  if (MemFD >= 0)
+    return MemFD;
+#endif
+  int FD;
+  SmallString<64> Path;
+  if (auto EC = sys::fs::createTemporaryFile("orc-shared-memory", "", FD, Path))
+    return errorCodeToError(EC);
+  sys::fs::remove(Path);
+  return FD;
+}
+
+SharedMemoryRawChannel::SharedMemoryRawChannel(
+    std::unique_ptr<sys::fs::mapped_file_region> Region, int SharedMemoryFD,
+    int InFD, int OutFD, bool IsExecutor)
+    : Region(std::move(Region)), SharedMemoryFD(SharedMemoryFD), InFD(InFD),
+      OutFD(OutFD), Side(IsExecutor ? ExecutorSide : JITSide) {
+  char *Base = this->Region->data();
+  uint64_t PageSize = sys::Process::getPageSize();
+  Header = reinterpret_cast<RegionHeader *>(Base);
+  RingControl *Controls =
+      reinterpret_cast<RingControl *>(Base + RingControlOffset);
+  uint64_t RingSize = Header->RingSize;
+  char *Rings[2] = {Base + PageSize, Base + PageSize + RingSize};
+  // Ring 0 carries messages from the JIT to the executor.
+  OutRing = &Controls[Side];
+  OutData = Rings[Side];
+  InRing = &Controls[1 - Side];
+  InData = Rings[1 - Side];
+  RingMask = RingSize - 1;
+  Heap = Base + PageSize + 2 * RingSize;
+  HeapSize = Header->HeapSize;
+}
+
+Expected<std::unique_ptr<SharedMemoryRawChannel>>
+SharedMemoryRawChannel::create(int InFD, int OutFD, uint64_t RingSize,
+                               uint64_t HeapSize) {
+  uint64_t PageSize = sys::Process::getPageSize();
+  if (!isPowerOf2_64(RingSize) || RingSize < PageSize)
+    return errorCodeToError(make_error_code(errc::invalid_argument));
+  HeapSize = alignTo(HeapSize, PageSize);
+  uint64_t Size = PageSize + 2 * RingSize + HeapSize;
+
+  auto FDOrErr = createSharedMemoryFile();
+  if (!FDOrErr)
+    return FDOrErr.takeError();
+  int FD = *FDOrErr;
+  std::error_code EC = sys::fs::resize_file(FD, Size);
+  std::unique_ptr<sys::fs::mapped_file_region> Region;
+  if (!EC)
+    Region = llvm::make_unique<sys::fs::mapped_file_region>(
+        FD, sys::fs::mapped_file_region::readwrite, Size, 0, EC);
+  if (EC) {
+    ::close(FD);
+    return errorCodeToError(EC);
+  }
+
+  // The file is zero-filled, so the positions and flags start out as zero.
+  auto *Header = reinterpret_cast<RegionHeader *>(Region->data());
+  static_assert(sizeof(RegionHeader) <= RingControlOffset &&
+                    RingControlOffset + 2 * sizeof(RingControl) <= 4096,
+                "Region header does not fit in a page");
+  Header->Magic = RegionMagic;
+  Header->Version = RegionVersion;
+  Header->RingSize = RingSize;
+  Header->HeapSize = HeapSize;
+
+  return std::unique_ptr<SharedMemoryRawChannel>(new SharedMemoryRawChannel(
+      std::move(Region), FD, InFD, OutFD, /*IsExecutor=*/false));
+}
+
+Expected<std::unique_ptr<SharedMemoryRawChannel>>
+SharedMemoryRawChannel::attach(int SharedMemoryFD, int InFD, int OutFD) {
+  sys::fs::file_status Status;
+  if (auto EC = sys::fs::status(SharedMemoryFD, Status))
+    return errorCodeToError(EC);
+  uint64_t Size = Status.getSize();
+  uint64_t PageSize = sys::Process::getPageSize();
+  if (Size < PageSize)
+    return errorCodeToError(make_error_code(errc::invalid_argument));
+
+  std::error_code EC;
+  auto Region = llvm::make_unique<sys::fs::mapped_file_region>(
+      SharedMemoryFD, sys::fs::mapped_file_region::readwrite, Size, 0, EC);
+  if (EC)
+    return errorCodeToError(EC);
+  auto *Header = reinterpret_cast<RegionHeader *>(Region->data());
+  if (Header->Magic != RegionMagic || Header->Version != RegionVersion ||
+      !isPowerOf2_64(Header->RingSize) || Header->RingSize < PageSize ||
+      Header->HeapSize % PageSize != 0 ||
+      PageSize + 2 * Header->RingSize + Header->HeapSize != Size)
+    return errorCodeToError(make_error_code(errc::invalid_argument));
+
+  std::unique_ptr<SharedMemoryRawChannel> Channel(new SharedMemoryRawChannel(
+      std::move(Region), SharedMemoryFD, InFD, OutFD, /*IsExecutor=*/true));
+
+  // Offer the heap to the JIT only if code can run from it: mappings of
+  // files may not be executable.
+  if (Channel->HeapSize != 0) {
+    sys::MemoryBlock Probe(Channel->Heap, PageSize);
+    if (!sys::Memory::protectMappedMemory(Probe, sys::Memory::MF_READ |
+                                                     sys::Memory::MF_EXEC) &&
+        !sys::Memory::protectMappedMemory(Probe, sys::Memory::MF_READ |
+                                                     sys::Memory::MF_WRITE)) {
+      Channel->FreeHeap[0] = Channel->HeapSize;
+      Header->ExecutorHeapBase.store(static_cast<uint64_t>(
+          reinterpret_cast<uintptr_t>(Channel->Heap)));
+    }
+  }
+
+  return std::move(Channel);
+}
+
+SharedMemoryRawChannel::~SharedMemoryRawChannel() {
+  consumeError(publishOutput());
+  Region.reset();
+  ::close(SharedMemoryFD);
+}
+
+Error SharedMemoryRawChannel::wakePeer() {
+  std::atomic<uint32_t> &PeerSleeping = Header->Sleeping[1 - Side];
+  if (!PeerSleeping.load() || !PeerSleeping.exchange(0))
+    return Error::success();
+  char C = 0;
+  while (true) {
+    ssize_t Written = ::write(OutFD, &C, 1);
+    if (Written == 1)
+      return Error::success();
+    if (Written < 0 && errno != EAGAIN && errno != EINTR)
+      return errnoError();
+  }
+}
+
+Error SharedMemoryRawChannel::publishOutput() {
+  if (OutRing->Head.load(std::memory_order_relaxed) == OutHead)
+    return Error::success();
+  OutRing->Head.store(OutHead);
+  return wakePeer();
+}
+
+Error SharedMemoryRawChannel::publishInputConsumed() {
+  if (InRing->Tail.load(std::memory_order_relaxed) == InTail)
+    return Error::success();
+  InRing->Tail.store(InTail);
+  return wakePeer();
+}
+
+Error SharedMemoryRawChannel::waitUntil(function_ref<bool()> Ready) {
+  // The other side may be waiting for what we have written or read so far.
+  if (auto Err = publishOutput())
+    return Err;
+  if (auto Err = publishInputConsumed())
+    return Err;
+
+  for (unsigned I = 0; I != SpinCount; ++I) {
+    if (Ready())
+      return Error::success();
+    std::this_thread::yield();
+  }
+
+  std::atomic<uint32_t> &Sleeping = Header->Sleeping[Side];
+  while (true) {
+    Sleeping.store(1);
+    bool IsReady = Ready();
+    // If the other side has seen us asleep, it has sent or is about to send
+    // a wake-up byte, which must be consumed even if we no longer need it.
+    if (IsReady && Sleeping.exchange(0))
+      return Error::success();
+    if (!IsReady)
+      ++NumSleeps;
+    char C;
+    ssize_t Read = ::read(InFD, &C, 1);
+    while (Read < 0 && (errno == EAGAIN || errno == EINTR))
+      Read = ::read(InFD, &C, 1);
+    if (Read < 0)
+      return errnoError();
+    if (Read == 0)
+      return orcError(OrcErrorCode::RPCConnectionClosed);
+    if (IsReady)
+      return Error::success();
+  }
+}
+
+Error SharedMemoryRawChannel::readBytes(char *Dst, unsigned Size) {
+  uint64_t RingSize = RingMask + 1;
+  while (Size != 0) {
+    if (InHead == InTail) {
+      InHead = InRing->Head.load(std::memory_order_acquire);
+      if (InHead == InTail) {
+        if (auto Err = waitUntil([this]() {
+              InHead = InRing->Head.load();
+              return InHead != InTail;
+            }))
+          return Err;
+        continue;
+      }
+    }
+    uint64_t Offset = InTail & RingMask;
+    uint64_t N = std::min<uint64_t>(
+        std::min<uint64_t>(Size, InHead - InTail), RingSize - Offset);
+    memcpy(Dst, InData + Offset, N);
+    Dst += N;
+    Size -= N;
+    InTail += N;
+    // Hand space back to the writer before the ring runs dry, in case it is
+    // waiting for some.
+    if (InTail - InRing->Tail.load(std::memory_order_relaxed) >= RingSize / 4)
+      if (auto Err = publishInputConsumed())
+        return Err;
+  }
+  return Error::success();
+}
+
+Error SharedMemoryRawChannel::appendBytes(const char *Src, unsigned Size) {
+  uint64_t RingSize = RingMask + 1;
+  while (Size != 0) {
+    if (OutHead - OutTail == RingSize) {
+      OutTail = OutRing->Tail.load(std::memory_order_acquire);
+      if (OutHead - OutTail == RingSize) {
+        if (auto Err = waitUntil([this, RingSize]() {
+              OutTail = OutRing->Tail.load();
+              return OutHead - OutTail != RingSize;
+            }))
+          return Err;
+        continue;
+      }
+    }
+    uint64_t Offset = OutHead & RingMask;
+    uint64_t N = std::min<uint64_t>(
+        std::min<uint64_t>(Size, RingSize - (OutHead - OutTail)),
+        RingSize - Offset);
+    memcpy(OutData + Offset, Src, N);
+    Src += N;
+    Size -= N;
+    OutHead += N;
+  }
+  return Error::success();
+}
+
+Error SharedMemoryRawChannel::send() { return publishOutput(); }
+
+Expected<sys::MemoryBlock>
+SharedMemoryRawChannel::allocateSharedMemory(uint64_t Size) {
+  assert(Side == ExecutorSide && "Only the executor allocates shared memory");
+  if (!Header->ExecutorHeapBase.load(std::memory_order_relaxed))
+    return errorCodeToError(make_error_code(errc::function_not_supported));
+  Size = alignTo(std::max<uint64_t>(Size, 1), sys::Process::getPageSize());
+  for (auto I = FreeHeap.begin(), E = FreeHeap.end(); I != E; ++I) {
+    if (I->second < Size)
+      continue;
+    uint64_t Offset = I->first;
+    uint64_t Remaining = I->second - Size;
+    FreeHeap.erase(I);
+    if (Remaining != 0)
+      FreeHeap[Offset + Size] = Remaining;
+    return sys::MemoryBlock(Heap + Offset, Size);
+  }
+  return errorCodeToError(make_error_code(errc::not_enough_memory));
+}
+
+bool SharedMemoryRawChannel::releaseSharedMemory(sys::MemoryBlock &Block) {
+  assert(Side == ExecutorSide && "Only the executor allocates shared memory");
+  char *Base = static_cast<char *>(Block.base());
+  if (Base < Heap || Base >= Heap + HeapSize)
+    return false;
+  sys::Memory::protectMappedMemory(Block, sys::Memory::MF_READ |
+                                              sys::Memory::MF_WRITE);
+  uint64_t Offset = Base - Heap;
+  uint64_t Size = Block.size();
+  auto Next = FreeHeap.lower_bound(Offset);
+  if (Next != FreeHeap.end() && Offset + Size == Next->first) {
+    Size += Next->second;
+    Next = FreeHeap.erase(Next);
+  }
+  if (Next != FreeHeap.begin()) {
+    auto Prev = std::prev(Next);
+    if (Prev->first + Prev->second == Offset) {
+      Prev->second += Size;
+      return true;
+    }
+  }
+  FreeHeap[Offset] = Size;
+  return true;
+}
+
+char *SharedMemoryRawChannel::getLocalAddress(JITTargetAddress Addr,
+                                              uint64_t Size) const {
+  assert(Side == JITSide && "Only the JIT translates executor addresses");
+  uint64_t Base = Header->ExecutorHeapBase.load(std::memory_order_acquire);
+  if (!Base || Addr < Base || Size > HeapSize ||
+      Addr - Base > HeapSize - Size)
+    return nullptr;
+  return Heap + (Addr - Base);
+}
+
+#else // !LLVM_ON_UNIX
+
+SharedMemoryRawChannel::SharedMemoryRawChannel(
+    std::unique_ptr<sys::fs::mapped_file_region> Region, int SharedMemoryFD,
+    int InFD, int OutFD, bool IsExecutor) {
+  llvm_unreachable("Shared memory channels are only supported on Unix");
+}
+
+Expected<std::unique_ptr<SharedMemoryRawChannel>>
+SharedMemoryRawChannel::create(int InFD, int OutFD, uint64_t RingSize,
+                               uint64_t HeapSize) {
+  return errorCodeToError(make_error_code(errc::function_not_supported));
+}
+
+Expected<std::unique_ptr<SharedMemoryRawChannel>>
+SharedMemoryRawChannel::attach(int SharedMemoryFD, int InFD, int OutFD) {
+  return errorCodeToError(make_error_code(errc::function_not_supported));
+}
+
+SharedMemoryRawChannel::~SharedMemoryRawChannel() {}
+
+Error SharedMemoryRawChannel::readBytes(char *Dst, unsigned Size) {
+  llvm_unreachable("Shared memory channels are only supported on Unix");
+}
+
+Error SharedMemoryRawChannel::appendBytes(const char *Src, unsigned Size) {
+  llvm_unreachable("Shared memory channels are only supported on Unix");
+}
+
+Error SharedMemoryRawChannel::send() {
+  llvm_unreachable("Shared memory channels are only supported on Unix");
+}
+
+Expected<sys::MemoryBlock>
+SharedMemoryRawChannel::allocateSharedMemory(uint64_t Size) {
+  llvm_unreachable("Shared memory channels are only supported on Unix");
+}
+
+bool SharedMemoryRawChannel::releaseSharedMemory(sys::MemoryBlock &Block) {
+  llvm_unreachable("Shared memory channels are only supported on Unix");
+}
+
+char *SharedMemoryRawChannel::getLocalAddress(JITTargetAddress Addr,
+                                              uint64_t Size) const {
+  llvm_unreachable("Shared memory channels are only supported on Unix");
+}
+
+#endif // LLVM_ON_UNIX
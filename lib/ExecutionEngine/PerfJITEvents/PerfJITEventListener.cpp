@@ -0,0 +1,378 @@
+//===-- PerfJITEventListener.cpp - Tell Linux's perf about JITted code ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines a JITEventListener object that tells perf about JITted
+// functions, through the jitdump format read by 'perf inject --jit' and the
+// /tmp/perf-PID.map files read by 'perf report'.
+//
+// The jitdump format is described in
+// tools/perf/Documentation/jitdump-specification.txt in the Linux sources.
+// Both formats identify code by its address in this process, so the listener
+// must only be used by JITs that run code in-process.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ADT/SmallString.h"
+#include "llvm/ADT/Triple.h"
+#include "llvm/Config/config.h"
+#include "llvm/DebugInfo/DIContext.h"
+#include "llvm/DebugInfo/DWARF/DWARFContext.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Object/ObjectFile.h"
+#include "llvm/Object/SymbolSize.h"
+#include "llvm/Support/Debug.h"
+#include "llvm/Support/ELF.h"
+#include "llvm/Support/Errno.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Host.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+using namespace llvm;
+using namespace llvm::object;
+
+#define DEBUG_TYPE "perf-jit-event-listener"
+
+namespace {
+
+// The jitdump file header and records.
+const uint32_t JITDumpMagic = 0x4A695444; // "JiTD"
+const uint32_t JITDumpVersion = 1;
+
+enum JITDumpRecordType : uint32_t {
+  JIT_CODE_LOAD = 0,
+  JIT_CODE_DEBUG_INFO = 2,
+  JIT_CODE_CLOSE = 3
+};
+
+struct JITDumpHeader {
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t TotalSize;
+  uint32_t ElfMach;
+  uint32_t Pad1;
+  uint32_t Pid;
+  uint64_t Timestamp;
+  uint64_t Flags;
+};
+
+struct JITDumpRecordPrefix {
+  uint32_t Id;
+  uint32_t TotalSize;
+  uint64_t Timestamp;
+};
+
+// Followed by the function name and its code.
+struct JITDumpCodeLoad {
+  JITDumpRecordPrefix Prefix;
+  uint32_t Pid;
+  uint32_t Tid;
+  uint64_t Vma;
+  uint64_t CodeAddr;
+  uint64_t CodeSize;
+  uint64_t CodeIndex;
+};
+
+// Followed by NrEntry line table entries.
+struct JITDumpDebugInfo {
+  JITDumpRecordPrefix Prefix;
+  uint64_t CodeAddr;
+  uint64_t NrEntry;
+};
+
+// Followed by the source file name.
+struct JITDumpDebugEntry {
+  uint64_t Addr;
+  int32_t Line;
+  int32_t Discrim;
+};
+
+class PerfJITEventListener : public JITEventListener {
+public:
+  PerfJITEventListener(StringRef JITDumpDir, StringRef PerfMapDir);
+  ~PerfJITEventListener() override;
+
+  void NotifyObjectEmitted(const ObjectFile &Obj,
+                           const RuntimeDyld::LoadedObjectInfo &L) override;
+
+private:
+  bool openJITDump(StringRef Dir);
+  bool openPerfMap(StringRef Dir);
+
+  void writeCodeLoad(StringRef Name, uint64_t Addr, uint64_t Size);
+  void writeDebugInfo(uint64_t Addr, const DILineInfoTable &Lines);
+
+  // Both files are written and flushed under this lock, so that records of
+  // objects emitted by different threads are not interleaved.
+  std::mutex Mutex;
+  std::unique_ptr<raw_fd_ostream> JITDump;
+  std::unique_ptr<raw_fd_ostream> PerfMap;
+  // perf recognizes the jitdump file of a process by an executable mapping
+  // of it in the process.
+  void *JITDumpMarker = nullptr;
+  size_t JITDumpMarkerSize = 0;
+  uint32_t Pid;
+  uint64_t CodeIndex = 0;
+};
+
+// perf timestamps samples with CLOCK_MONOTONIC when run with '-k mono'.
+static uint64_t getTimestamp() {
+  struct timespec TS;
+  if (clock_gettime(CLOCK_MONOTONIC, &TS))
+    return 0;
+  return static_cast<uint64_t>(TS.tv_sec) * 1000000000 + TS.tv_nsec;
+}
+
+static uint32_t getElfMachine() {
+  switch (Triple(sys::getProcessTriple()).getArch()) {
+  case Triple::x86:
+    return ELF::EM_386;
+  case Triple::x86_64:
+    return ELF::EM_X86_64;
+  case Triple::arm:
+  case Triple::armeb:
+  case Triple::thumb:
+  case Triple::thumbeb:
+    return ELF::EM_ARM;
+  case Triple::aarch64:
+  case Triple::aarch64_be:
+    return ELF::EM_AARCH64;
+  case Triple::ppc:
+    return ELF::EM_PPC;
+  case Triple::ppc64:
+  case Triple::ppc64le:
+    return ELF::EM_PPC64;
+  case Triple::mips:
+  case Triple::mipsel:
+  case Triple::mips64:
+  case Triple::mips64el:
+    return ELF::EM_MIPS;
+  case Triple::systemz:
+    return ELF::EM_S390;
+  default:
+    return ELF::EM_NONE;
+  }
+}
+
+template <typename T> static void writeStruct(raw_ostream &OS, const T &S) {
+  OS.write(reinterpret_cast<const char *>(&S), sizeof(S));
+}
+
+static void writeString(raw_ostream &OS, StringRef S) {
+  OS << S;
+  OS.write('\0');
+}
+
+PerfJITEventListener::PerfJITEventListener(StringRef JITDumpDir,
+                                           StringRef PerfMapDir)
+    : Pid(::getpid()) {
+  if (!JITDumpDir.empty() && !openJITDump(JITDumpDir))
+    DEBUG(dbgs() << "Failed to open a jitdump file in " << JITDumpDir << ": "
+                 << sys::StrError() << "\n");
+  if (!PerfMapDir.empty() && !openPerfMap(PerfMapDir))
+    DEBUG(dbgs() << "Failed to open a perf map file in " << PerfMapDir << ": "
+                 << sys::StrError() << "\n");
+}
+
+PerfJITEventListener::~PerfJITEventListener() {
+  if (JITDump) {
+    JITDumpRecordPrefix Close;
+    Close.Id = JIT_CODE_CLOSE;
+    Close.TotalSize = sizeof(Close);
+    Close.Timestamp = getTimestamp();
+    writeStruct(*JITDump, Close);
+    JITDump->flush();
+  }
+  if (JITDumpMarker)
+    ::munmap(JITDumpMarker, JITDumpMarkerSize);
+}
+
+bool PerfJITEventListener::openJITDump(StringRef Dir) {
+  if (sys::fs::create_directories(Dir))
+    return false;
+
+  // 'perf inject' finds the file by this name.
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, "jit-" + Twine(Pid) + ".dump");
+  int FD;
+  if (sys::fs::openFileForWrite(Path, FD, sys::fs::F_RW))
+    return false;
+
+  JITDumpMarkerSize = sys::Process::getPageSize();
+  JITDumpMarker =
+      ::mmap(nullptr, JITDumpMarkerSize, PROT_READ | PROT_EXEC, MAP_PRIVATE,
+             FD, 0);
+  if (JITDumpMarker == MAP_FAILED) {
+    JITDumpMarker = nullptr;
+    ::close(FD);
+    return false;
+  }
+
+  JITDump = llvm::make_unique<raw_fd_ostream>(FD, /*shouldClose=*/true);
+  JITDumpHeader Header;
+  Header.Magic = JITDumpMagic;
+  Header.Version = JITDumpVersion;
+  Header.TotalSize = sizeof(Header);
+  Header.ElfMach = getElfMachine();
+  Header.Pad1 = 0;
+  Header.Pid = Pid;
+  Header.Timestamp = getTimestamp();
+  Header.Flags = 0;
+  writeStruct(*JITDump, Header);
+  JITDump->flush();
+  return true;
+}
+
+bool PerfJITEventListener::openPerfMap(StringRef Dir) {
+  // 'perf report' looks for /tmp/perf-PID.map.
+  SmallString<128> Path(Dir);
+  sys::path::append(Path, "perf-" + Twine(Pid) + ".map");
+  int FD;
+  if (sys::fs::openFileForWrite(Path, FD, sys::fs::F_Append))
+    return false;
+  PerfMap = llvm::make_unique<raw_fd_ostream>(FD, /*shouldClose=*/true);
+  return true;
+}
+
+void PerfJITEventListener::writeCodeLoad(StringRef Name, uint64_t Addr,
+                                         uint64_t Size) {
+  JITDumpCodeLoad Record;
+  Record.Prefix.Id = JIT_CODE_LOAD;
+  Record.Prefix.TotalSize = sizeof(Record) + Name.size() + 1 + Size;
+  Record.Prefix.Timestamp = getTimestamp();
+  Record.Pid = Pid;
+  Record.Tid = static_cast<uint32_t>(::syscall(SYS_gettid));
+  Record.Vma = Addr;
+  Record.CodeAddr = Addr;
+  Record.CodeSize = Size;
+  Record.CodeIndex = CodeIndex++;
+  writeStruct(*JITDump, Record);
+  writeString(*JITDump, Name);
+  JITDump->write(reinterpret_cast<const char *>(Addr), Size);
+}
+
+void PerfJITEventListener::writeDebugInfo(uint64_t Addr,
+                                          const DILineInfoTable &Lines) {
+  JITDumpDebugInfo Record;
+  Record.Prefix.Id = JIT_CODE_DEBUG_INFO;
+  Record.Prefix.TotalSize = sizeof(Record);
+  for (const auto &Line : Lines)
+    Record.Prefix.TotalSize +=
+        sizeof(JITDumpDebugEntry) + Line.second.FileName.size() + 1;
+  Record.Prefix.Timestamp = getTimestamp();
+  Record.CodeAddr = Addr;
+  Record.NrEntry = Lines.size();
+  writeStruct(*JITDump, Record);
+
+  for (const auto &Line : Lines) {
+    JITDumpDebugEntry Entry;
+    Entry.Addr = Line.first;
+    Entry.Line = Line.second.Line;
+    Entry.Discrim = Line.second.Discriminator;
+    writeStruct(*JITDump, Entry);
+    writeString(*JITDump, Line.second.FileName);
+  }
+}
+
+void PerfJITEventListener::NotifyObjectEmitted(
+                                       const ObjectFile &Obj,
+                                       const RuntimeDyld::LoadedObjectInfo &L) {
+  if (!JITDump && !PerfMap)
+    return;
+
+  OwningBinary<ObjectFile> DebugObjOwner = L.getObjectForDebug(Obj);
+  const ObjectFile &DebugObj = *DebugObjOwner.getBinary();
+  // Line tables are only read for the jitdump file.
+  std::unique_ptr<DIContext> Context;
+  if (JITDump)
+    Context = llvm::make_unique<DWARFContextInMemory>(DebugObj);
+
+  std::lock_guard<std::mutex> Lock(Mutex);
+
+  // Use symbol info to iterate functions in the object.
+  for (const std::pair<SymbolRef, uint64_t> &P : computeSymbolSizes(DebugObj)) {
+    SymbolRef Sym = P.first;
+    uint64_t Size = P.second;
+
+    Expected<SymbolRef::Type> SymTypeOrErr = Sym.getType();
+    if (!SymTypeOrErr) {
+      consumeError(SymTypeOrErr.takeError());
+      continue;
+    }
+    if (*SymTypeOrErr != SymbolRef::ST_Function || Size == 0)
+      continue;
+
+    Expected<StringRef> Name = Sym.getName();
+    if (!Name) {
+      consumeError(Name.takeError());
+      continue;
+    }
+
+    Expected<uint64_t> AddrOrErr = Sym.getAddress();
+    if (!AddrOrErr) {
+      consumeError(AddrOrErr.takeError());
+      continue;
+    }
+    uint64_t Addr = *AddrOrErr;
+
+    if (JITDump) {
+      // perf attaches a function's line table to the next code load record.
+      DILineInfoTable Lines = Context->getLineInfoForAddressRange(
+          Addr, Size,
+          DILineInfoSpecifier(
+              DILineInfoSpecifier::FileLineInfoKind::AbsoluteFilePath));
+      if (!Lines.empty())
+        writeDebugInfo(Addr, Lines);
+      writeCodeLoad(*Name, Addr, Size);
+    }
+
+    if (PerfMap)
+      *PerfMap << format_hex_no_prefix(Addr, 1) << " "
+               << format_hex_no_prefix(Size, 1) << " " << *Name << "\n";
+  }
+
+  // Make the object's functions visible to a perf session that is already
+  // running.
+  if (JITDump)
+    JITDump->flush();
+  if (PerfMap)
+    PerfMap->flush();
+}
+
+} // end anonymous namespace
+
+namespace llvm {
+
+JITEventListener *JITEventListener::createPerfJITEventListener() {
+  // Put the jitdump file where 'perf inject' expects it by default, unless
+  // JITDUMPDIR says otherwise.
+  SmallString<128> JITDumpDir;
+  if (const char *Dir = ::getenv("JITDUMPDIR"))
+    JITDumpDir = Dir;
+  else if (sys::path::home_directory(JITDumpDir))
+    sys::path::append(JITDumpDir, ".debug", "jit");
+  else
+    JITDumpDir = "/tmp";
+  return createPerfJITEventListener(JITDumpDir, "/tmp");
+}
+
+JITEventListener *
+JITEventListener::createPerfJITEventListener(StringRef JITDumpDir,
+                                             StringRef PerfMapDir) {
+  return new PerfJITEventListener(JITDumpDir, PerfMapDir);
+}
+
+} // end namespace llvm
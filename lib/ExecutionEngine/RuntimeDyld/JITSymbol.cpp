@@ -39,3 +39,18 @@ llvm::JITSymbolFlags::fromObjectSymbol(const object::BasicSymbolRef &Symbol) {
     Flags |= JITSymbolFlags::Exported;
   return Flags;
 }
+
+Expected<JITSymbolResolver::LookupResult>
+JITSymbolResolver::lookup(const LookupSet &Symbols) {
+  LookupResult Result;
+  for (StringRef Name : Symbols) {
+    std::string NameStr = Name.str();
+    auto Sym = findSymbolInLogicalDylib(NameStr);
+    if (!Sym)
+      Sym = findSymbol(NameStr);
+    if (auto Addr = Sym.getAddress())
+      Result.insert(std::make_pair(Name, JITEvaluatedSymbol(Addr,
+                                                            Sym.getFlags())));
+  }
+  return std::move(Result);
+}
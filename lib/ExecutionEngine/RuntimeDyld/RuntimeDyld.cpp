@@ -17,19 +17,50 @@
 #include "RuntimeDyldELF.h"
 #include "RuntimeDyldImpl.h"
 #include "RuntimeDyldMachO.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Object/ELFObjectFile.h"
 #include "llvm/Object/COFF.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/MutexGuard.h"
+#include <chrono>
 
 using namespace llvm;
 using namespace llvm::object;
 
 #define DEBUG_TYPE "dyld"
 
+STATISTIC(NumRelocations, "Number of relocations processed");
+STATISTIC(NumExternalSymbols, "Number of external symbols resolved");
+STATISTIC(NumResolverLookups, "Number of bulk symbol resolver lookups");
+
+static cl::opt<bool> PrintRelocationStats(
+    "rtdyld-relocation-stats", cl::Hidden,
+    cl::desc("Print the time spent processing and resolving relocations for "
+             "each object loaded by RuntimeDyld"));
+
 namespace {
 
+// Measures the wall time of a region, but only when relocation statistics
+// have been requested.
+class RelocationTimer {
+public:
+  RelocationTimer() {
+    if (PrintRelocationStats)
+      Start = std::chrono::steady_clock::now();
+  }
+
+  double elapsedMS() const {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - Start)
+        .count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point Start;
+};
+
 enum RuntimeDyldErrorCode {
   GenericRTDyldError = 1
 };
@@ -125,6 +156,11 @@ void RuntimeDyldImpl::resolveRelocations() {
       dumpSectionMemory(Sections[i], "before relocations");
   );
 
+  RelocationTimer Timer;
+  uint64_t StartRelocations = RelocationsResolved;
+  uint64_t StartExternalSymbols = ExternalSymbolsResolved;
+  uint64_t StartLookups = ResolverLookups;
+
   // First, resolve relocations associated with external symbols.
   resolveExternalSymbols();
 
@@ -141,6 +177,14 @@ void RuntimeDyldImpl::resolveRelocations() {
   }
   Relocations.clear();
 
+  if (PrintRelocationStats)
+    errs() << "rtdyld: resolved "
+           << RelocationsResolved - StartRelocations << " relocations ("
+           << ExternalSymbolsResolved - StartExternalSymbols
+           << " external symbols, " << ResolverLookups - StartLookups
+           << " resolver lookups) in " << format("%.3f", Timer.elapsedMS())
+           << " ms\n";
+
   // Print out sections after relocation.
   DEBUG(
     for (int i = 0, e = Sections.size(); i != e; ++i)
@@ -307,6 +351,9 @@ RuntimeDyldImpl::loadObjectImpl(const object::ObjectFile &Obj) {
 
   // Parse and process relocations
   DEBUG(dbgs() << "Parse relocations:\n");
+  RelocationTimer Timer;
+  uint64_t StartRelocations = RelocationsAdded;
+  uint64_t StartExternalSymbols = ExternalSymbolsAdded;
   for (section_iterator SI = Obj.section_begin(), SE = Obj.section_end();
        SI != SE; ++SI) {
     StubMap Stubs;
@@ -347,6 +394,13 @@ RuntimeDyldImpl::loadObjectImpl(const object::ObjectFile &Obj) {
   if (auto Err = finalizeLoad(Obj, LocalSections))
     return std::move(Err);
 
+  if (PrintRelocationStats)
+    errs() << "rtdyld: " << Obj.getFileName() << ": processed "
+           << RelocationsAdded - StartRelocations << " relocations ("
+           << ExternalSymbolsAdded - StartExternalSymbols
+           << " new external symbols) in "
+           << format("%.3f", Timer.elapsedMS()) << " ms\n";
+
 //   for (auto E : LocalSections)
 //     llvm::dbgs() << "Added: " << E.first.getRawDataRefImpl() << " -> " << E.second << "\n";
 
@@ -790,17 +844,19 @@ RuntimeDyldImpl::findOrEmitSection(const ObjectFile &Obj,
 
 void RuntimeDyldImpl::addRelocationForSection(const RelocationEntry &RE,
                                               unsigned SectionID) {
+  ++RelocationsAdded;
   Relocations[SectionID].push_back(RE);
 }
 
 void RuntimeDyldImpl::addRelocationForSymbol(const RelocationEntry &RE,
                                              StringRef SymbolName) {
   // Relocation by symbol.  If the symbol is found in the global symbol table,
-  // create an appropriate section relocation.  Otherwise, add it to
-  // ExternalSymbolRelocations.
+  // create an appropriate section relocation.  Otherwise, add it to the
+  // relocation list of the external symbol.
+  ++RelocationsAdded;
   RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(SymbolName);
   if (Loc == GlobalSymbolTable.end()) {
-    ExternalSymbolRelocations[SymbolName].push_back(RE);
+    ExternalSymbols[getExternalSymbolID(SymbolName)].Relocs.push_back(RE);
   } else {
     // Copy the RE since we want to modify its addend.
     RelocationEntry RECopy = RE;
@@ -918,65 +974,99 @@ void RuntimeDyldImpl::resolveRelocationList(const RelocationList &Relocs,
     if (Sections[RE.SectionID].getAddress() == nullptr)
       continue;
     resolveRelocation(RE, Value);
+    ++RelocationsResolved;
+    ++NumRelocations;
+  }
+}
+
+unsigned RuntimeDyldImpl::getExternalSymbolID(StringRef Name) {
+  auto I = ExternalSymbolIDs.insert(
+      std::make_pair(Name, static_cast<unsigned>(ExternalSymbols.size())));
+  if (I.second) {
+    ExternalSymbols.push_back(ExternalSymbol(I.first->first()));
+    ++ExternalSymbolsAdded;
   }
+  return I.first->second;
 }
 
 void RuntimeDyldImpl::resolveExternalSymbols() {
-  while (!ExternalSymbolRelocations.empty()) {
-    StringMap<RelocationList>::iterator i = ExternalSymbolRelocations.begin();
-
-    StringRef Name = i->first();
-    if (Name.size() == 0) {
-      // This is an absolute symbol, use an address of zero.
-      DEBUG(dbgs() << "Resolving absolute relocations."
-                   << "\n");
-      RelocationList &Relocs = i->second;
-      resolveRelocationList(Relocs, 0);
-    } else {
+  // Resolve the external symbols in batches. Each batch covers the symbols
+  // added since the previous one and asks the resolver for all of them with a
+  // single lookup call. That call may cause additional objects to be loaded,
+  // which can add new symbols to the end of ExternalSymbols (picked up by the
+  // next batch) and new relocations to symbols in this batch, so relocation
+  // lists are only read once the lookup has returned, and ExternalSymbols is
+  // always indexed rather than iterated.
+  unsigned Begin = 0;
+  while (Begin != ExternalSymbols.size()) {
+    unsigned End = ExternalSymbols.size();
+
+    JITSymbolResolver::LookupSet Names;
+    for (unsigned I = Begin; I != End; ++I) {
+      StringRef Name = ExternalSymbols[I].Name;
+      if (!Name.empty() && !GlobalSymbolTable.count(Name))
+        Names.insert(Name);
+    }
+
+    JITSymbolResolver::LookupResult Resolved;
+    if (!Names.empty()) {
+      ++ResolverLookups;
+      ++NumResolverLookups;
+      auto ResolvedOrErr = Resolver.lookup(Names);
+      // FIXME: Implement error handling that doesn't kill the host program!
+      if (!ResolvedOrErr)
+        report_fatal_error(ResolvedOrErr.takeError());
+      Resolved = std::move(*ResolvedOrErr);
+    }
+    assert(ExternalSymbols.size() >= End &&
+           "External symbols resolved re-entrantly");
+
+    for (unsigned I = Begin; I != End; ++I) {
+      StringRef Name = ExternalSymbols[I].Name;
       uint64_t Addr = 0;
-      RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(Name);
-      if (Loc == GlobalSymbolTable.end()) {
-        // This is an external symbol, try to get its address from the symbol
-        // resolver.
-        // First search for the symbol in this logical dylib.
-        Addr = Resolver.findSymbolInLogicalDylib(Name.data()).getAddress();
-        // If that fails, try searching for an external symbol.
-        if (!Addr)
-          Addr = Resolver.findSymbol(Name.data()).getAddress();
-        // The call to getSymbolAddress may have caused additional modules to
-        // be loaded, which may have added new entries to the
-        // ExternalSymbolRelocations map.  Consquently, we need to update our
-        // iterator.  This is also why retrieval of the relocation list
-        // associated with this symbol is deferred until below this point.
-        // New entries may have been added to the relocation list.
-        i = ExternalSymbolRelocations.find(Name);
+      if (Name.empty()) {
+        // This is an absolute symbol, use an address of zero.
+        DEBUG(dbgs() << "Resolving absolute relocations."
+                     << "\n");
       } else {
-        // We found the symbol in our global table.  It was probably in a
-        // Module that we loaded previously.
-        const auto &SymInfo = Loc->second;
-        Addr = getSectionLoadAddress(SymInfo.getSectionID()) +
-               SymInfo.getOffset();
-      }
+        RTDyldSymbolTable::const_iterator Loc = GlobalSymbolTable.find(Name);
+        if (Loc != GlobalSymbolTable.end()) {
+          // We found the symbol in our global table.  It was probably in a
+          // Module that we loaded previously, or in one that the lookup above
+          // has just loaded.
+          const auto &SymInfo = Loc->second;
+          Addr = getSectionLoadAddress(SymInfo.getSectionID()) +
+                 SymInfo.getOffset();
+        } else {
+          auto ResI = Resolved.find(Name);
+          if (ResI != Resolved.end())
+            Addr = ResI->second.getAddress();
+        }
+
+        // FIXME: Implement error handling that doesn't kill the host program!
+        if (!Addr)
+          report_fatal_error("Program used external function '" + Name +
+                             "' which could not be resolved!");
 
-      // FIXME: Implement error handling that doesn't kill the host program!
-      if (!Addr)
-        report_fatal_error("Program used external function '" + Name +
-                           "' which could not be resolved!");
+        // If Resolver returned UINT64_MAX, the client wants to handle this
+        // symbol manually and we shouldn't resolve its relocations.
+        if (Addr == UINT64_MAX)
+          continue;
 
-      // If Resolver returned UINT64_MAX, the client wants to handle this symbol
-      // manually and we shouldn't resolve its relocations.
-      if (Addr != UINT64_MAX) {
         DEBUG(dbgs() << "Resolving relocations Name: " << Name << "\t"
                      << format("0x%lx", Addr) << "\n");
-        // This list may have been updated when we called getSymbolAddress, so
-        // don't change this code to get the list earlier.
-        RelocationList &Relocs = i->second;
-        resolveRelocationList(Relocs, Addr);
       }
+
+      ++ExternalSymbolsResolved;
+      ++NumExternalSymbols;
+      resolveRelocationList(ExternalSymbols[I].Relocs, Addr);
     }
 
-    ExternalSymbolRelocations.erase(i);
+    Begin = End;
   }
+
+  ExternalSymbols.clear();
+  ExternalSymbolIDs.clear();
 }
 
 //===----------------------------------------------------------------------===//
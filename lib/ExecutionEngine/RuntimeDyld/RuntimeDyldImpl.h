@@ -281,8 +281,24 @@ protected:
 
   // Relocations to external symbols that are not yet resolved.  Symbols are
   // external when they aren't found in the global symbol table of all loaded
-  // modules.  This map is indexed by symbol name.
-  StringMap<RelocationList> ExternalSymbolRelocations;
+  // modules.  Each symbol name is interned once in ExternalSymbolIDs, which
+  // maps it to an index into ExternalSymbols; relocations against the same
+  // symbol are then appended to its list without further string lookups.
+  struct ExternalSymbol {
+    ExternalSymbol(StringRef Name) : Name(Name) {}
+    // Points at the key of the corresponding ExternalSymbolIDs entry.
+    StringRef Name;
+    RelocationList Relocs;
+  };
+  StringMap<unsigned> ExternalSymbolIDs;
+  std::vector<ExternalSymbol> ExternalSymbols;
+
+  // Running totals behind -rtdyld-relocation-stats.
+  uint64_t RelocationsAdded = 0;
+  uint64_t RelocationsResolved = 0;
+  uint64_t ExternalSymbolsAdded = 0;
+  uint64_t ExternalSymbolsResolved = 0;
+  uint64_t ResolverLookups = 0;
 
 
   typedef std::map<RelocationValueRef, uintptr_t> StubMap;
@@ -419,6 +435,10 @@ protected:
   /// \brief Resolve relocations to external symbols.
   void resolveExternalSymbols();
 
+  /// \brief Return the ID of the given external symbol, interning it if it
+  ///        has not been seen since the last call to resolveExternalSymbols.
+  unsigned getExternalSymbolID(StringRef Name);
+
   // \brief Compute an upper bound of the memory that is required to load all
   // sections
   Error computeTotalAllocSize(const ObjectFile &Obj,
@@ -14,11 +14,162 @@
 
 #include "llvm/Config/config.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/MathExtras.h"
 #include "llvm/Support/Process.h"
+#include <algorithm>
+#include <tuple>
+
+#define DEBUG_TYPE "section-memory-manager"
+
+STATISTIC(NumProtectCalls, "Number of calls to change memory permissions");
+STATISTIC(NumSlabs, "Number of slabs reserved by SectionMemoryPools");
 
 namespace llvm {
 
+SectionMemoryPool::~SectionMemoryPool() {
+  for (Arena *A : {&CodeArena, &DataArena})
+    for (auto &Slab : A->Slabs) {
+      sys::MemoryBlock MB(reinterpret_cast<void *>(Slab.first), Slab.second);
+      sys::Memory::releaseMappedMemory(MB);
+    }
+}
+
+std::map<uintptr_t, size_t>::const_iterator
+SectionMemoryPool::findSlab(const Arena &A, uintptr_t Addr) const {
+  auto I = A.Slabs.upper_bound(Addr);
+  if (I == A.Slabs.begin())
+    return A.Slabs.end();
+  --I;
+  if (Addr >= I->first + I->second)
+    return A.Slabs.end();
+  return I;
+}
+
+/// The permissions of free memory in the slabs of an arena.
+static unsigned getFreePermissions(bool IsCode, bool HugePagesForCode) {
+  if (IsCode && HugePagesForCode)
+    return sys::Memory::MF_READ | sys::Memory::MF_EXEC;
+  return sys::Memory::MF_READ | sys::Memory::MF_WRITE;
+}
+
+sys::MemoryBlock SectionMemoryPool::allocate(size_t Size, bool IsCode,
+                                             std::error_code &EC) {
+  static const size_t PageSize = sys::Process::getPageSize();
+  EC = std::error_code();
+  Size = alignTo(Size, PageSize);
+
+  std::lock_guard<std::mutex> Lock(PoolMutex);
+  Arena &A = IsCode ? CodeArena : DataArena;
+  unsigned FreePermissions = getFreePermissions(IsCode, HugePagesForCode);
+
+  // Take the first free range that is large enough, which keeps the memory in
+  // use packed at the start of the slabs.
+  auto I = find_if(A.Free, [&](const std::pair<const uintptr_t, size_t> &R) {
+    return R.second >= Size;
+  });
+  if (I == A.Free.end()) {
+    unsigned Flags = FreePermissions;
+    if (IsCode && HugePagesForCode)
+      Flags |= sys::Memory::MF_HUGE_HINT;
+    sys::MemoryBlock Slab = sys::Memory::allocateMappedMemory(
+        std::max(Size, SlabSize), nullptr, Flags, EC);
+    if (EC)
+      return sys::MemoryBlock();
+    ++NumSlabs;
+    uintptr_t Base = reinterpret_cast<uintptr_t>(Slab.base());
+    A.Slabs[Base] = Slab.size();
+    I = A.Free.insert(std::make_pair(Base, Slab.size())).first;
+  }
+
+  uintptr_t Addr = I->first;
+  sys::MemoryBlock Block(reinterpret_cast<void *>(Addr), Size);
+  if (!(FreePermissions & sys::Memory::MF_WRITE)) {
+    EC = sys::Memory::protectMappedMemory(
+        Block, sys::Memory::MF_READ | sys::Memory::MF_WRITE);
+    if (EC)
+      return sys::MemoryBlock();
+  }
+  size_t Remaining = I->second - Size;
+  A.Free.erase(I);
+  if (Remaining)
+    A.Free[Addr + Size] = Remaining;
+  return Block;
+}
+
+std::error_code SectionMemoryPool::release(const sys::MemoryBlock &Block,
+                                           bool IsCode) {
+  if (Block.size() == 0)
+    return std::error_code();
+
+  // The block may have been made executable or read-only by its memory
+  // manager. If it cannot be given the permissions of free memory, it is never
+  // reused.
+  if (std::error_code EC = sys::Memory::protectMappedMemory(
+          Block, getFreePermissions(IsCode, HugePagesForCode)))
+    return EC;
+
+  std::lock_guard<std::mutex> Lock(PoolMutex);
+  Arena &A = IsCode ? CodeArena : DataArena;
+  uintptr_t Start = reinterpret_cast<uintptr_t>(Block.base());
+  size_t Size = Block.size();
+  auto Slab = findSlab(A, Start);
+  assert(Slab != A.Slabs.end() && "Block was not allocated from this pool");
+  uintptr_t SlabStart = Slab->first;
+  uintptr_t SlabEnd = Slab->first + Slab->second;
+
+  // Merge the block with the free ranges around it, within the same slab.
+  auto Next = A.Free.lower_bound(Start);
+  if (Next != A.Free.end() && Next->first == Start + Size &&
+      Next->first < SlabEnd) {
+    Size += Next->second;
+    Next = A.Free.erase(Next);
+  }
+  if (Next != A.Free.begin()) {
+    auto Prev = std::prev(Next);
+    if (Prev->first >= SlabStart && Prev->first + Prev->second == Start) {
+      Start = Prev->first;
+      Size += Prev->second;
+      A.Free.erase(Prev);
+    }
+  }
+
+  // Give slabs that are no longer used back to the system, but keep the last
+  // one to serve the next allocations.
+  if (Start == SlabStart && Size == Slab->second && A.Slabs.size() > 1) {
+    sys::MemoryBlock MB(reinterpret_cast<void *>(SlabStart), Size);
+    A.Slabs.erase(Slab);
+    return sys::Memory::releaseMappedMemory(MB);
+  }
+
+  A.Free[Start] = Size;
+  return std::error_code();
+}
+
+size_t SectionMemoryPool::getNumSlabs() const {
+  std::lock_guard<std::mutex> Lock(PoolMutex);
+  return CodeArena.Slabs.size() + DataArena.Slabs.size();
+}
+
+size_t SectionMemoryPool::getReservedSize() const {
+  std::lock_guard<std::mutex> Lock(PoolMutex);
+  size_t Size = 0;
+  for (const Arena *A : {&CodeArena, &DataArena})
+    for (auto &Slab : A->Slabs)
+      Size += Slab.second;
+  return Size;
+}
+
+size_t SectionMemoryPool::getFreeSize() const {
+  std::lock_guard<std::mutex> Lock(PoolMutex);
+  size_t Size = 0;
+  for (const Arena *A : {&CodeArena, &DataArena})
+    for (auto &Range : A->Free)
+      Size += Range.second;
+  return Size;
+}
+
 uint8_t *SectionMemoryManager::allocateDataSection(uintptr_t Size,
                                                    unsigned Alignment,
                                                    unsigned SectionID,
@@ -74,21 +225,22 @@ uint8_t *SectionMemoryManager::allocateSection(MemoryGroup &MemGroup,
     }
   }
 
-  // No pre-allocated free block was large enough. Allocate a new memory region.
-  // Note that all sections get allocated as read-write.  The permissions will
-  // be updated later based on memory group.
-  //
-  // FIXME: It would be useful to define a default allocation size (or add
-  // it as a constructor parameter) to minimize the number of allocations.
+  // No pre-allocated free block was large enough. Allocate a new memory region,
+  // from the pool's slabs if there is one, which avoids a system call for most
+  // allocations. Note that all sections get allocated as read-write.  The
+  // permissions will be updated later based on memory group.
   //
   // FIXME: Initialize the Near member for each memory group to avoid
   // interleaving.
   std::error_code ec;
-  sys::MemoryBlock MB = sys::Memory::allocateMappedMemory(RequiredSize,
-                                                          &MemGroup.Near,
-                                                          sys::Memory::MF_READ |
-                                                            sys::Memory::MF_WRITE,
-                                                          ec);
+  sys::MemoryBlock MB;
+  if (Pool)
+    MB = Pool->allocate(RequiredSize, &MemGroup == &CodeMem, ec);
+  else
+    MB = sys::Memory::allocateMappedMemory(RequiredSize, &MemGroup.Near,
+                                           sys::Memory::MF_READ |
+                                             sys::Memory::MF_WRITE,
+                                           ec);
   if (ec) {
     // FIXME: Add error propagation to the interface.
     return nullptr;
@@ -180,12 +332,72 @@ static sys::MemoryBlock trimBlockToPageSize(sys::MemoryBlock M) {
 std::error_code
 SectionMemoryManager::applyMemoryGroupPermissions(MemoryGroup &MemGroup,
                                                   unsigned Permissions) {
-  for (sys::MemoryBlock &MB : MemGroup.PendingMem)
+  static const size_t PageSize = sys::Process::getPageSize();
+
+  // Code in huge pages is protected one whole allocated region at a time, so
+  // that the free tail of the region gets the same permissions, as the pool
+  // expects. The tail can then no longer be allocated from.
+  bool WholeRegions = Pool && Pool->hasHugePageCode() && &MemGroup == &CodeMem;
+
+  // Sections are mostly allocated one after the other, so the pending blocks
+  // of a group usually form a few runs of adjacent pages. Change the
+  // permissions of each run at once rather than block by block. Runs do not
+  // cross allocated regions, which need not be mapped contiguously.
+  struct PageRun {
+    unsigned Region;
+    uintptr_t Start, End;
+  };
+  SmallVector<PageRun, 16> Runs;
+  for (sys::MemoryBlock &MB : MemGroup.PendingMem) {
+    if (MB.size() == 0)
+      continue;
+    uintptr_t Base = reinterpret_cast<uintptr_t>(MB.base());
+    auto Contains = [&](const sys::MemoryBlock &Region) {
+      uintptr_t RegionBase = reinterpret_cast<uintptr_t>(Region.base());
+      return Base >= RegionBase && Base < RegionBase + Region.size();
+    };
+    unsigned Region = find_if(MemGroup.AllocatedMem, Contains) -
+                      MemGroup.AllocatedMem.begin();
+    PageRun Run;
+    Run.Region = Region;
+    Run.Start = alignDown(Base, PageSize);
+    Run.End = alignTo(Base + MB.size(), PageSize);
+    if (WholeRegions) {
+      const sys::MemoryBlock &R = MemGroup.AllocatedMem[Region];
+      Run.Start = reinterpret_cast<uintptr_t>(R.base());
+      Run.End = Run.Start + R.size();
+    }
+    Runs.push_back(Run);
+  }
+  std::sort(Runs.begin(), Runs.end(), [](const PageRun &L, const PageRun &R) {
+    return std::tie(L.Region, L.Start) < std::tie(R.Region, R.Start);
+  });
+  unsigned NumRuns = 0;
+  for (const PageRun &Run : Runs) {
+    if (NumRuns && Runs[NumRuns - 1].Region == Run.Region &&
+        Run.Start <= Runs[NumRuns - 1].End) {
+      Runs[NumRuns - 1].End = std::max(Runs[NumRuns - 1].End, Run.End);
+      continue;
+    }
+    Runs[NumRuns++] = Run;
+  }
+  Runs.resize(NumRuns);
+
+  for (const PageRun &Run : Runs) {
+    ++NumProtectCalls;
+    sys::MemoryBlock MB(reinterpret_cast<void *>(Run.Start),
+                        Run.End - Run.Start);
     if (std::error_code EC = sys::Memory::protectMappedMemory(MB, Permissions))
       return EC;
+  }
 
   MemGroup.PendingMem.clear();
 
+  if (WholeRegions) {
+    MemGroup.FreeMem.clear();
+    return std::error_code();
+  }
+
   // Now go through free blocks and trim any of them that don't span the entire
   // page because one of the pending blocks may have overlapped it.
   for (FreeMemBlock &FreeMB : MemGroup.FreeMem) {
@@ -211,7 +423,10 @@ void SectionMemoryManager::invalidateInstructionCache() {
 SectionMemoryManager::~SectionMemoryManager() {
   for (MemoryGroup *Group : {&CodeMem, &RWDataMem, &RODataMem}) {
     for (sys::MemoryBlock &Block : Group->AllocatedMem)
-      sys::Memory::releaseMappedMemory(Block);
+      if (Pool)
+        Pool->release(Block, Group == &CodeMem);
+      else
+        sys::Memory::releaseMappedMemory(Block);
   }
 }
 
@@ -73,6 +73,16 @@ template void llvm::Calculate<Function, Inverse<BasicBlock *>>(
         GraphTraits<Inverse<BasicBlock *>>::NodeRef>::type> &DT,
     Function &F);
 
+template void llvm::DomTreeBuilder::InsertEdge<BasicBlock>(
+    DominatorTreeBase<BasicBlock> &DT, BasicBlock *From, BasicBlock *To);
+template void llvm::DomTreeBuilder::DeleteEdge<BasicBlock>(
+    DominatorTreeBase<BasicBlock> &DT, BasicBlock *From, BasicBlock *To);
+template void llvm::DomTreeBuilder::ApplyUpdates<BasicBlock>(
+    DominatorTreeBase<BasicBlock> &DT,
+    ArrayRef<DominatorTreeBase<BasicBlock>::UpdateType> Updates);
+template bool llvm::DomTreeBuilder::Verify<BasicBlock>(
+    const DominatorTreeBase<BasicBlock> &DT);
+
 // dominates - Return true if Def dominates a use in User. This performs
 // the special checks necessary if Def and User are in the same basic block.
 // Note that Def doesn't dominate a use in Def itself!
@@ -287,3 +287,8 @@ void LLVMContext::setDiscardValueNames(bool Discard) {
 OptBisect &LLVMContext::getOptBisect() {
   return pImpl->getOptBisect();
 }
+
+size_t LLVMContext::getBumpAllocatedMemory() const {
+  return pImpl->TypeAllocator.getTotalMemory() +
+         pImpl->MDStringCache.getAllocator().getTotalMemory();
+}
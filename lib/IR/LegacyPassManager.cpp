@@ -17,6 +17,7 @@
 #include "llvm/IR/LegacyPassManagers.h"
 #include "llvm/IR/LegacyPassNameParser.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/PassMemoryReport.h"
 #include "llvm/Support/Chrono.h"
 #include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
@@ -24,6 +25,7 @@
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
 #include "llvm/Support/Mutex.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
@@ -1292,6 +1294,7 @@ bool BBPassManager::runOnFunction(Function &F) {
         // If the pass crashes, remember this.
         PassManagerPrettyStackEntry X(BP, *I);
         TimeRegion PassTimer(getPassTimer(BP));
+        TimeTraceScope PassScope(BP->getPassName(), F.getName());
 
         LocalChanged |= BP->runOnBasicBlock(*I);
       }
@@ -1497,6 +1500,8 @@ bool FPPassManager::runOnFunction(Function &F) {
   // Collect inherited analysis from Module level pass manager.
   populateInheritedAnalysis(TPM->activeStack);
 
+  TimeTraceScope FunctionScope("RunFunctionPasses", F.getName());
+
   for (unsigned Index = 0; Index < getNumContainedPasses(); ++Index) {
     FunctionPass *FP = getContainedPass(Index);
     bool LocalChanged = false;
@@ -1509,6 +1514,8 @@ bool FPPassManager::runOnFunction(Function &F) {
     {
       PassManagerPrettyStackEntry X(FP, F);
       TimeRegion PassTimer(getPassTimer(FP));
+      TimeTraceScope PassScope(FP->getPassName(), F.getName());
+      PassMemoryRecorder MemoryRecorder(FP->getPassName(), F);
 
       LocalChanged |= FP->runOnFunction(F);
     }
@@ -1586,6 +1593,8 @@ MPPassManager::runOnModule(Module &M) {
     {
       PassManagerPrettyStackEntry X(MP, M);
       TimeRegion PassTimer(getPassTimer(MP));
+      TimeTraceScope PassScope(MP->getPassName(), M.getModuleIdentifier());
+      PassMemoryRecorder MemoryRecorder(MP->getPassName(), M);
 
       LocalChanged |= MP->runOnModule(M);
     }
@@ -13,6 +13,8 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/IR/ModuleSummaryIndex.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/STLExtras.h"
 #include "llvm/ADT/StringMap.h"
 using namespace llvm;
 
@@ -50,6 +52,59 @@ void ModuleSummaryIndex::mergeFrom(std::unique_ptr<ModuleSummaryIndex> Other,
     // values were given unique global IDs.
     addGlobalValueSummary(ValueGUID, std::move(Summary));
   }
+  DevirtValueNames.insert(Other->DevirtValueNames.begin(),
+                          Other->DevirtValueNames.end());
+}
+
+// Copy the summaries of a per-module index into the combined index.
+void ModuleSummaryIndex::mergeFrom(const ModuleSummaryIndex &Other,
+                                   uint64_t NextModuleId) {
+  if (Other.modulePaths().empty())
+    return;
+
+  assert(Other.modulePaths().size() == 1 &&
+         "Can only merge from an single-module index at that time");
+
+  StringRef OtherModPath = Other.modulePaths().begin()->first();
+  StringRef ModPath = addModulePath(OtherModPath, NextModuleId,
+                                    Other.getModuleHash(OtherModPath))
+                          ->first();
+
+  // Aliases point to the summary of their aliasee, which needs to be redirected
+  // to its copy once everything is copied.
+  DenseMap<const GlobalValueSummary *, GlobalValueSummary *> Copies;
+  std::vector<AliasSummary *> Aliases;
+  for (auto &OtherGlobalValSummaryLists : Other) {
+    GlobalValue::GUID ValueGUID = OtherGlobalValSummaryLists.first;
+    for (auto &OtherSummary : OtherGlobalValSummaryLists.second) {
+      std::unique_ptr<GlobalValueSummary> Summary;
+      switch (OtherSummary->getSummaryKind()) {
+      case GlobalValueSummary::AliasKind: {
+        auto *AS = new AliasSummary(cast<AliasSummary>(*OtherSummary));
+        Aliases.push_back(AS);
+        Summary.reset(AS);
+        break;
+      }
+      case GlobalValueSummary::FunctionKind:
+        Summary = llvm::make_unique<FunctionSummary>(
+            cast<FunctionSummary>(*OtherSummary));
+        break;
+      case GlobalValueSummary::GlobalVarKind:
+        Summary = llvm::make_unique<GlobalVarSummary>(
+            cast<GlobalVarSummary>(*OtherSummary));
+        break;
+      }
+      Summary->setModulePath(ModPath);
+      Copies[OtherSummary.get()] = Summary.get();
+      addGlobalValueSummary(ValueGUID, std::move(Summary));
+    }
+  }
+  for (AliasSummary *AS : Aliases) {
+    assert(Copies.count(&AS->getAliasee()) && "Aliasee not in the module");
+    AS->setAliasee(Copies.lookup(&AS->getAliasee()));
+  }
+  DevirtValueNames.insert(Other.DevirtValueNames.begin(),
+                          Other.DevirtValueNames.end());
 }
 
 void ModuleSummaryIndex::removeEmptySummaryEntries() {
@@ -0,0 +1,228 @@
+//===- PassMemoryReport.cpp - Per-pass memory and IR size report ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+///
+/// \file
+/// This file implements the per-pass memory and IR size report.
+///
+//===----------------------------------------------------------------------===//
+
+#include "llvm/IR/PassMemoryReport.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Mutex.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/raw_ostream.h"
+#include <vector>
+
+using namespace llvm;
+
+namespace {
+enum class ReportFormat { CSV, JSON };
+
+/// The -pass-memory-report file. Giving it creates the report, so that the
+/// file is written even if no pass runs.
+struct ReportFileOption {
+  std::string FileName;
+  void operator=(const std::string &Val);
+};
+}
+
+static ReportFileOption ReportFile;
+
+static cl::opt<ReportFileOption, true, cl::parser<std::string>>
+    PassMemoryReportFile(
+        "pass-memory-report", cl::Hidden, cl::value_desc("filename"),
+        cl::desc("Record the memory usage and IR size change of every pass "
+                 "execution in the given file"),
+        cl::location(ReportFile));
+
+static cl::opt<ReportFormat> PassMemoryReportFormat(
+    "pass-memory-report-format", cl::Hidden,
+    cl::desc("Format of the -pass-memory-report file"),
+    cl::init(ReportFormat::CSV),
+    cl::values(clEnumValN(ReportFormat::CSV, "csv", "Comma separated values"),
+               clEnumValN(ReportFormat::JSON, "json", "JSON array")));
+
+bool llvm::isPassMemoryReportEnabled() {
+  return !ReportFile.FileName.empty();
+}
+
+PassMemorySnapshot PassMemorySnapshot::get(const Function &F) {
+  PassMemorySnapshot S;
+  S.MallocBytes = sys::Process::GetMallocUsage();
+  S.ContextBytes = F.getContext().getBumpAllocatedMemory();
+  for (const BasicBlock &BB : F) {
+    ++S.NumBasicBlocks;
+    S.NumInstructions += BB.size();
+  }
+  return S;
+}
+
+PassMemorySnapshot PassMemorySnapshot::get(const Module &M) {
+  PassMemorySnapshot S;
+  S.MallocBytes = sys::Process::GetMallocUsage();
+  S.ContextBytes = M.getContext().getBumpAllocatedMemory();
+  for (const Function &F : M)
+    for (const BasicBlock &BB : F) {
+      ++S.NumBasicBlocks;
+      S.NumInstructions += BB.size();
+    }
+  return S;
+}
+
+namespace {
+/// One pass execution.
+struct PassMemoryRecord {
+  std::string PassName;
+  std::string IRName;
+  bool IsModule;
+  PassMemorySnapshot Before;
+  PassMemorySnapshot After;
+};
+
+/// The records of the process, written out when destroyed.
+class PassMemoryReport {
+  sys::SmartMutex<true> Lock;
+  std::vector<PassMemoryRecord> Records;
+
+  void writeCSV(raw_ostream &OS) const;
+  void writeJSON(raw_ostream &OS) const;
+
+public:
+  ~PassMemoryReport();
+
+  void add(PassMemoryRecord Record) {
+    sys::SmartScopedLock<true> Guard(Lock);
+    Records.push_back(std::move(Record));
+  }
+};
+} // end anonymous namespace
+
+static ManagedStatic<PassMemoryReport> TheReport;
+
+void ReportFileOption::operator=(const std::string &Val) {
+  FileName = Val;
+  if (!FileName.empty())
+    (void)*TheReport;
+}
+
+static int64_t getDelta(size_t Before, size_t After) {
+  return int64_t(After) - int64_t(Before);
+}
+
+static void writeCSVString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (char C : Str) {
+    if (C == '"')
+      OS << '"';
+    OS << C;
+  }
+  OS << '"';
+}
+
+void PassMemoryReport::writeCSV(raw_ostream &OS) const {
+  OS << "pass,unit,name,malloc_delta,context_delta,instructions_before,"
+        "instructions_after,blocks_before,blocks_after\n";
+  for (const PassMemoryRecord &R : Records) {
+    writeCSVString(OS, R.PassName);
+    OS << ',' << (R.IsModule ? "module" : "function") << ',';
+    writeCSVString(OS, R.IRName);
+    OS << ',' << getDelta(R.Before.MallocBytes, R.After.MallocBytes) << ','
+       << getDelta(R.Before.ContextBytes, R.After.ContextBytes) << ','
+       << R.Before.NumInstructions << ',' << R.After.NumInstructions << ','
+       << R.Before.NumBasicBlocks << ',' << R.After.NumBasicBlocks << '\n';
+  }
+}
+
+static void writeJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned char C : Str) {
+    if (C == '"' || C == '\\')
+      OS << '\\' << C;
+    else if (C < 0x20)
+      OS << format("\\u%04x", C);
+    else
+      OS << C;
+  }
+  OS << '"';
+}
+
+void PassMemoryReport::writeJSON(raw_ostream &OS) const {
+  OS << "[";
+  bool First = true;
+  for (const PassMemoryRecord &R : Records) {
+    OS << (First ? "\n" : ",\n") << "{\"pass\":";
+    First = false;
+    writeJSONString(OS, R.PassName);
+    OS << ",\"unit\":\"" << (R.IsModule ? "module" : "function")
+       << "\",\"name\":";
+    writeJSONString(OS, R.IRName);
+    OS << ",\"malloc_delta\":"
+       << getDelta(R.Before.MallocBytes, R.After.MallocBytes)
+       << ",\"context_delta\":"
+       << getDelta(R.Before.ContextBytes, R.After.ContextBytes)
+       << ",\"instructions_before\":" << R.Before.NumInstructions
+       << ",\"instructions_after\":" << R.After.NumInstructions
+       << ",\"blocks_before\":" << R.Before.NumBasicBlocks
+       << ",\"blocks_after\":" << R.After.NumBasicBlocks << "}";
+  }
+  OS << "\n]\n";
+}
+
+PassMemoryReport::~PassMemoryReport() {
+  std::error_code EC;
+  raw_fd_ostream OS(ReportFile.FileName, EC, sys::fs::F_Text);
+  if (EC) {
+    errs() << "error opening pass memory report '" << ReportFile.FileName
+           << "': " << EC.message() << '\n';
+    return;
+  }
+  if (PassMemoryReportFormat == ReportFormat::JSON)
+    writeJSON(OS);
+  else
+    writeCSV(OS);
+}
+
+PassMemoryRecorder::PassMemoryRecorder(StringRef PassName, const Function &F)
+    : PassName(PassName) {
+  if (!isPassMemoryReportEnabled())
+    return;
+  this->F = &F;
+  Before = PassMemorySnapshot::get(F);
+}
+
+PassMemoryRecorder::PassMemoryRecorder(StringRef PassName, const Module &M)
+    : PassName(PassName) {
+  if (!isPassMemoryReportEnabled())
+    return;
+  this->M = &M;
+  Before = PassMemorySnapshot::get(M);
+}
+
+PassMemoryRecorder::~PassMemoryRecorder() {
+  if (!F && !M)
+    return;
+  PassMemoryRecord Record;
+  Record.PassName = PassName;
+  Record.IsModule = M != nullptr;
+  if (F) {
+    Record.IRName = F->getName();
+    Record.After = PassMemorySnapshot::get(*F);
+  } else {
+    Record.IRName = M->getModuleIdentifier();
+    Record.After = PassMemorySnapshot::get(*M);
+  }
+  Record.Before = Before;
+  TheReport->add(std::move(Record));
+}
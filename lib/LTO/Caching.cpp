@@ -13,78 +13,121 @@
 
 #include "llvm/LTO/Caching.h"
 #include "llvm/ADT/StringExtras.h"
+#include "llvm/Support/CachePruning.h"
+#include "llvm/Support/Errc.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 using namespace llvm::lto;
 
-static void commitEntry(StringRef TempFilename, StringRef EntryPath) {
-  // Rename to final destination (hopefully race condition won't matter here)
-  auto EC = sys::fs::rename(TempFilename, EntryPath);
-  if (EC) {
-    // Renaming failed, probably not the same filesystem, copy and delete.
-    // FIXME: Avoid needing to do this by creating the temporary file in the
-    // cache directory.
-    {
-      auto ReloadedBufferOrErr = MemoryBuffer::getFile(TempFilename);
-      if (auto EC = ReloadedBufferOrErr.getError())
-        report_fatal_error(Twine("Failed to open temp file '") + TempFilename +
-                           "': " + EC.message() + "\n");
+void CacheStats::print(raw_ostream &OS) const {
+  OS << "ThinLTO cache hits: " << Hits << " (" << BytesHit
+     << " bytes), misses: " << Misses << " (" << BytesWritten
+     << " bytes written)\n";
+}
 
-      raw_fd_ostream OS(EntryPath, EC, sys::fs::F_None);
-      if (EC)
-        report_fatal_error(Twine("Failed to open ") + EntryPath +
-                           " to save cached entry\n");
-      // I'm not sure what are the guarantee if two processes are doing this
-      // at the same time.
-      OS << (*ReloadedBufferOrErr)->getBuffer();
-    }
-    sys::fs::remove(TempFilename);
-  }
+/// Open \p Path as a buffer whose identifier is \p Name.
+static ErrorOr<std::unique_ptr<MemoryBuffer>> openEntry(const Twine &Path,
+                                                        const Twine &Name) {
+  int FD;
+  if (std::error_code EC = sys::fs::openFileForRead(Path, FD))
+    return EC;
+  auto MBOrErr = MemoryBuffer::getOpenFile(FD, Name, /*FileSize=*/-1,
+                                           /*RequiresNullTerminator=*/false);
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  return MBOrErr;
 }
 
 NativeObjectCache lto::localCache(std::string CacheDirectoryPath,
-                                  AddFileFn AddFile) {
+                                  AddBufferFn AddBuffer, CacheStats *Stats) {
   return [=](unsigned Task, StringRef Key) -> AddStreamFn {
-    // First, see if we have a cache hit.
+    // First, see if we have a cache hit. The entry is mapped right away, so
+    // that it stays usable if a concurrent link prunes it.
     SmallString<64> EntryPath;
     sys::path::append(EntryPath, CacheDirectoryPath, Key);
-    if (sys::fs::exists(EntryPath)) {
-      AddFile(Task, EntryPath);
+    ErrorOr<std::unique_ptr<MemoryBuffer>> MBOrErr =
+        openEntry(EntryPath, EntryPath);
+    if (MBOrErr) {
+      uint64_t Size = (*MBOrErr)->getBufferSize();
+      CachePruning::recordAccess(CacheDirectoryPath, Key, Size);
+      if (Stats) {
+        ++Stats->Hits;
+        Stats->BytesHit += Size;
+      }
+      AddBuffer(Task, std::move(*MBOrErr));
       return AddStreamFn();
     }
+    if (Stats)
+      ++Stats->Misses;
 
     // This native object stream is responsible for commiting the resulting
-    // file to the cache and calling AddFile to add it to the link.
+    // file to the cache and calling AddBuffer to add it to the link.
     struct CacheStream : NativeObjectStream {
-      AddFileFn AddFile;
+      AddBufferFn AddBuffer;
+      CacheStats *Stats;
+      std::string CacheDirectoryPath;
+      std::string Key;
       std::string TempFilename;
       std::string EntryPath;
       unsigned Task;
 
-      CacheStream(std::unique_ptr<raw_pwrite_stream> OS, AddFileFn AddFile,
-                  std::string TempFilename, std::string EntryPath,
-                  unsigned Task)
-          : NativeObjectStream(std::move(OS)), AddFile(AddFile),
-            TempFilename(TempFilename), EntryPath(EntryPath), Task(Task) {}
+      CacheStream(std::unique_ptr<raw_pwrite_stream> OS, AddBufferFn AddBuffer,
+                  CacheStats *Stats, std::string CacheDirectoryPath,
+                  std::string Key, std::string TempFilename,
+                  std::string EntryPath, unsigned Task)
+          : NativeObjectStream(std::move(OS)), AddBuffer(std::move(AddBuffer)),
+            Stats(Stats), CacheDirectoryPath(std::move(CacheDirectoryPath)),
+            Key(std::move(Key)), TempFilename(std::move(TempFilename)),
+            EntryPath(std::move(EntryPath)), Task(Task) {}
 
       ~CacheStream() {
         // Make sure the file is closed before committing it.
         OS.reset();
-        commitEntry(TempFilename, EntryPath);
-        AddFile(Task, EntryPath);
+
+        // Open the new entry before renaming it into place, so that the link
+        // gets it even if a concurrent link prunes it right away.
+        ErrorOr<std::unique_ptr<MemoryBuffer>> MBOrErr =
+            openEntry(TempFilename, EntryPath);
+        if (!MBOrErr)
+          report_fatal_error(Twine("Failed to open new cache file ") +
+                             TempFilename + ": " +
+                             MBOrErr.getError().message() + "\n");
+
+        // The temporary file is in the cache directory, so this is atomic on
+        // POSIX systems: other links see either no entry or a complete one. If
+        // another link added the same entry concurrently, either one wins;
+        // both are identical.
+        if (std::error_code EC = sys::fs::rename(TempFilename, EntryPath)) {
+          sys::fs::remove(TempFilename);
+          // Replacing an entry that is in use may fail on Windows.
+          if (!sys::fs::exists(EntryPath))
+            report_fatal_error(Twine("Failed to rename temporary file ") +
+                               TempFilename + " to " + EntryPath + ": " +
+                               EC.message() + "\n");
+        }
+
+        uint64_t Size = (*MBOrErr)->getBufferSize();
+        CachePruning::recordAccess(CacheDirectoryPath, Key, Size);
+        if (Stats)
+          Stats->BytesWritten += Size;
+        AddBuffer(Task, std::move(*MBOrErr));
       }
     };
 
     return [=](size_t Task) -> std::unique_ptr<NativeObjectStream> {
-      // Write to a temporary to avoid race condition
+      // Write to a temporary in the cache directory to avoid race conditions.
+      // CachePruning recognizes the prefix, and leaves these files alone
+      // until they expire.
+      SmallString<64> TempModel, TempFilename;
+      sys::path::append(TempModel, CacheDirectoryPath,
+                        "llvmcache-tmp-%%%%%%%%.o");
       int TempFD;
-      SmallString<64> TempFilename;
       std::error_code EC =
-          sys::fs::createTemporaryFile("Thin", "tmp.o", TempFD, TempFilename);
+          sys::fs::createUniqueFile(TempModel, TempFD, TempFilename);
       if (EC) {
         errs() << "Error: " << EC.message() << "\n";
         report_fatal_error("ThinLTO: Can't get a temporary file");
@@ -93,7 +136,17 @@ NativeObjectCache lto::localCache(std::string CacheDirectoryPath,
       // This CacheStream will move the temporary file into the cache when done.
       return llvm::make_unique<CacheStream>(
           llvm::make_unique<raw_fd_ostream>(TempFD, /* ShouldClose */ true),
-          AddFile, TempFilename.str(), EntryPath.str(), Task);
+          AddBuffer, Stats, CacheDirectoryPath, Key, TempFilename.str(),
+          EntryPath.str(), Task);
     };
   };
 }
+
+NativeObjectCache lto::localCache(std::string CacheDirectoryPath,
+                                  AddFileFn AddFile, CacheStats *Stats) {
+  return localCache(std::move(CacheDirectoryPath),
+                    [=](unsigned Task, std::unique_ptr<MemoryBuffer> MB) {
+                      AddFile(Task, MB->getBufferIdentifier());
+                    },
+                    Stats);
+}
@@ -16,11 +16,11 @@
 #include "llvm/Analysis/TargetTransformInfo.h"
 #include "llvm/Bitcode/BitcodeReader.h"
 #include "llvm/Bitcode/BitcodeWriter.h"
-#include "llvm/CodeGen/Analysis.h"
 #include "llvm/IR/AutoUpgrade.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/IR/LegacyPassManager.h"
 #include "llvm/LTO/LTOBackend.h"
+#include "llvm/LTO/ThinBackendScheduler.h"
 #include "llvm/Linker/IRMover.h"
 #include "llvm/Object/ModuleSummaryIndexObjectFile.h"
 #include "llvm/Support/ManagedStatic.h"
@@ -36,6 +36,7 @@
 #include "llvm/Target/TargetOptions.h"
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/IPO/WholeProgramDevirt.h"
 #include "llvm/Transforms/Utils/SplitModule.h"
 
 #include <set>
@@ -80,6 +81,12 @@ static void computeCacheKey(
     Data[3] = I >> 24;
     Hasher.update(ArrayRef<uint8_t>{Data, 4});
   };
+  auto AddUint64 = [&](uint64_t I) {
+    uint8_t Data[8];
+    for (unsigned B = 0; B != 8; ++B)
+      Data[B] = I >> (B * 8);
+    Hasher.update(ArrayRef<uint8_t>{Data, 8});
+  };
   AddString(Conf.CPU);
   // FIXME: Hash more of Options. For now all clients initialize Options from
   // command-line flags (which is unsupported in production), but may set
@@ -121,6 +128,63 @@ static void computeCacheKey(
                                     sizeof(GlobalValue::LinkageTypes)));
   }
 
+  // Include the devirtualization decisions that apply to the module: those for
+  // the slots called by the functions it defines or imports, and the values
+  // stored next to the vtables it defines.
+  std::set<std::pair<GlobalValue::GUID, uint64_t>> VCalls;
+  auto AddVCalls = [&](const GlobalValueSummary *S) {
+    if (auto *FS = dyn_cast_or_null<FunctionSummary>(S))
+      for (const VFuncId &VF : FS->type_test_assume_vcalls())
+        VCalls.insert({VF.TypeId, VF.Offset});
+  };
+  for (auto &GS : DefinedGlobals)
+    AddVCalls(GS.second);
+  for (auto &Entry : ImportList)
+    for (auto &GUIDAndThreshold : Entry.second)
+      AddVCalls(Index.findSummaryInModule(GUIDAndThreshold.first,
+                                          Entry.first()));
+  for (auto &VCall : VCalls) {
+    const WholeProgramDevirtResolution *Res =
+        Index.getDevirtResolution(VCall.first, VCall.second);
+    if (!Res)
+      continue;
+    AddUint64(VCall.first);
+    AddUint64(VCall.second);
+    AddUnsigned(Res->TheKind);
+    AddString(Res->SingleImplName);
+    AddUint64(Res->RetVal);
+    AddUint64(Res->Byte);
+    AddUnsigned(Res->Bit);
+    AddUnsigned(Res->BitWidth);
+  }
+  // Include the read-only variables that the module defines, which are
+  // internalized, and those it imports, which it gets a constant copy of.
+  for (auto &GS : DefinedGlobals)
+    if (auto *GVS = dyn_cast<GlobalVarSummary>(GS.second))
+      if (GVS->isReadOnly())
+        AddUint64(GS.first);
+  for (auto &Entry : ImportList)
+    for (auto &GUIDAndThreshold : Entry.second)
+      if (auto *GVS = dyn_cast_or_null<GlobalVarSummary>(
+              Index.findSummaryInModule(GUIDAndThreshold.first, Entry.first())))
+        if (GVS->isReadOnly())
+          AddUint64(GUIDAndThreshold.first);
+
+  for (auto &GS : DefinedGlobals) {
+    const VirtualConstPropVTable *VT =
+        Index.getVirtualConstPropVTable(GS.first);
+    if (!VT)
+      continue;
+    AddString(VT->Name);
+    for (const VirtualConstPropValue &V : VT->Values) {
+      AddUint64(V.AddressPoint);
+      AddUnsigned(V.IsAfter);
+      AddUint64(V.Pos);
+      AddUnsigned(V.BitWidth);
+      AddUint64(V.Value);
+    }
+  }
+
   // Include the hash for the linkage type to reflect internalization and weak
   // resolution.
   for (auto &GS : DefinedGlobals) {
@@ -220,15 +284,6 @@ void llvm::thinLTOInternalizeAndPromoteInIndex(
     thinLTOInternalizeAndPromoteGUID(I.second, I.first, isExported);
 }
 
-struct InputFile::InputModule {
-  BitcodeModule BM;
-  std::unique_ptr<Module> Mod;
-
-  // The range of ModuleSymbolTable entries for this input module.
-  size_t SymBegin, SymEnd;
-};
-
-// Requires a destructor for std::vector<InputModule>.
 InputFile::~InputFile() = default;
 
 Expected<std::unique_ptr<InputFile>> InputFile::create(MemoryBufferRef Object) {
@@ -239,70 +294,36 @@ Expected<std::unique_ptr<InputFile>> InputFile::create(MemoryBufferRef Object) {
   if (!BCOrErr)
     return errorCodeToError(BCOrErr.getError());
 
-  Expected<std::vector<BitcodeModule>> BMsOrErr =
-      getBitcodeModuleList(*BCOrErr);
-  if (!BMsOrErr)
-    return BMsOrErr.takeError();
-
-  if (BMsOrErr->empty())
-    return make_error<StringError>("Bitcode file does not contain any modules",
-                                   inconvertibleErrorCode());
-
-  // Create an InputModule for each module in the InputFile, and add it to the
-  // ModuleSymbolTable.
-  for (auto BM : *BMsOrErr) {
-    Expected<std::unique_ptr<Module>> MOrErr =
-        BM.getLazyModule(File->Ctx, /*ShouldLazyLoadMetadata*/ true,
-                         /*IsImporting*/ false);
-    if (!MOrErr)
-      return MOrErr.takeError();
-
-    size_t SymBegin = File->SymTab.symbols().size();
-    File->SymTab.addModule(MOrErr->get());
-    size_t SymEnd = File->SymTab.symbols().size();
-
-    for (const auto &C : (*MOrErr)->getComdatSymbolTable()) {
-      auto P = File->ComdatMap.insert(
-          std::make_pair(&C.second, File->Comdats.size()));
-      assert(P.second);
-      (void)P;
-      File->Comdats.push_back(C.first());
-    }
-
-    File->Mods.push_back({BM, std::move(*MOrErr), SymBegin, SymEnd});
+  Expected<irsymtab::FileContents> FCOrErr = irsymtab::readBitcode(*BCOrErr);
+  if (!FCOrErr)
+    return FCOrErr.takeError();
+
+  File->Mods = FCOrErr->Mods;
+  File->Symtab = std::move(FCOrErr->Symtab);
+  File->Strtab = std::move(FCOrErr->Strtab);
+
+  // The reader refers to either the bitcode buffer or the tables we just
+  // moved, whose heap storage is unchanged by the move.
+  const irsymtab::Reader &R = FCOrErr->TheReader;
+  File->TargetTriple = R.getTargetTriple();
+  File->SourceFileName = R.getSourceFileName();
+  File->ComdatTable = R.getComdatTable();
+
+  for (unsigned I = 0; I != File->Mods.size(); ++I) {
+    size_t Begin = File->Symbols.size();
+    for (const irsymtab::Reader::SymbolRef &Sym : R.module_symbols(I))
+      // Skip symbols that are irrelevant to LTO. Note that this condition needs
+      // to match the one in Skip() in LTO::addRegularLTO().
+      if (Sym.isGlobal() && !Sym.isFormatSpecific())
+        File->Symbols.push_back(Sym);
+    File->ModuleSymIndices.push_back({Begin, File->Symbols.size()});
   }
 
   return std::move(File);
 }
 
-Expected<int> InputFile::Symbol::getComdatIndex() const {
-  if (!isGV())
-    return -1;
-  const GlobalObject *GO = getGV()->getBaseObject();
-  if (!GO)
-    return make_error<StringError>("Unable to determine comdat of alias!",
-                                   inconvertibleErrorCode());
-  if (const Comdat *C = GO->getComdat()) {
-    auto I = File->ComdatMap.find(C);
-    assert(I != File->ComdatMap.end());
-    return I->second;
-  }
-  return -1;
-}
-
 StringRef InputFile::getName() const {
-  return Mods[0].BM.getModuleIdentifier();
-}
-
-StringRef InputFile::getSourceFileName() const {
-  return Mods[0].Mod->getSourceFileName();
-}
-
-iterator_range<InputFile::symbol_iterator>
-InputFile::module_symbols(InputModule &IM) {
-  return llvm::make_range(
-      symbol_iterator(SymTab.symbols().data() + IM.SymBegin, SymTab, this),
-      symbol_iterator(SymTab.symbols().data() + IM.SymEnd, SymTab, this));
+  return Mods[0].getModuleIdentifier();
 }
 
 LTO::RegularLTOState::RegularLTOState(unsigned ParallelCodeGenParallelismLevel,
@@ -326,18 +347,20 @@ LTO::LTO(Config Conf, ThinBackend Backend,
 LTO::~LTO() = default;
 
 // Add the given symbol to the GlobalResolutions map, and resolve its partition.
-void LTO::addSymbolToGlobalRes(SmallPtrSet<GlobalValue *, 8> &Used,
-                               const InputFile::Symbol &Sym,
+void LTO::addSymbolToGlobalRes(const InputFile::Symbol &Sym,
                                SymbolResolution Res, unsigned Partition) {
-  GlobalValue *GV = Sym.isGV() ? Sym.getGV() : nullptr;
-
   auto &GlobalRes = GlobalResolutions[Sym.getName()];
-  if (GV) {
-    GlobalRes.UnnamedAddr &= GV->hasGlobalUnnamedAddr();
+  if (!Sym.getIRName().empty()) {
+    GlobalRes.UnnamedAddr &= Sym.isUnnamedAddr();
     if (Res.Prevailing)
-      GlobalRes.IRName = GV->getName();
+      GlobalRes.IRName = Sym.getIRName();
   }
-  if (Res.VisibleToRegularObj || (GV && Used.count(GV)) ||
+  // Symbols without an IR name are referenced from module asm, which has no
+  // summary either.
+  if (Res.VisibleToRegularObj || Sym.isUsed() || Partition == 0 ||
+      Sym.getIRName().empty())
+    GlobalRes.VisibleOutsideThinLTO = true;
+  if (Res.VisibleToRegularObj || Sym.isUsed() ||
       (GlobalRes.Partition != GlobalResolution::Unknown &&
        GlobalRes.Partition != Partition))
     GlobalRes.Partition = GlobalResolution::External;
@@ -368,47 +391,52 @@ static void writeToResolutionFile(raw_ostream &OS, InputFile *Input,
 
 Error LTO::add(std::unique_ptr<InputFile> Input,
                ArrayRef<SymbolResolution> Res) {
+  return addInput(*Input, /*KeepSummaries=*/false, Res);
+}
+
+Error LTO::add(InputFile &Input, ArrayRef<SymbolResolution> Res) {
+  return addInput(Input, /*KeepSummaries=*/true, Res);
+}
+
+Error LTO::addInput(InputFile &Input, bool KeepSummaries,
+                    ArrayRef<SymbolResolution> Res) {
   assert(!CalledGetMaxTasks);
 
   if (Conf.ResolutionFile)
-    writeToResolutionFile(*Conf.ResolutionFile, Input.get(), Res);
+    writeToResolutionFile(*Conf.ResolutionFile, &Input, Res);
+
+  if (KeepSummaries)
+    Input.Summaries.resize(Input.Mods.size());
 
   const SymbolResolution *ResI = Res.begin();
-  for (InputFile::InputModule &IM : Input->Mods)
-    if (Error Err = addModule(*Input, IM, ResI, Res.end()))
+  for (unsigned I = 0; I != Input.Mods.size(); ++I)
+    if (Error Err = addModule(Input, I, KeepSummaries, ResI, Res.end()))
       return Err;
 
   assert(ResI == Res.end());
   return Error::success();
 }
 
-Error LTO::addModule(InputFile &Input, InputFile::InputModule &IM,
+Error LTO::addModule(InputFile &Input, unsigned ModI, bool KeepSummary,
                      const SymbolResolution *&ResI,
                      const SymbolResolution *ResE) {
-  // FIXME: move to backend
-  Module &M = *IM.Mod;
-
-  if (M.getDataLayoutStr().empty())
-    return make_error<StringError>("input module has no datalayout",
-                                    inconvertibleErrorCode());
-
-  if (!Conf.OverrideTriple.empty())
-    M.setTargetTriple(Conf.OverrideTriple);
-  else if (M.getTargetTriple().empty())
-    M.setTargetTriple(Conf.DefaultTriple);
-
-  Expected<bool> HasThinLTOSummary = IM.BM.hasSummary();
+  BitcodeModule BM = Input.Mods[ModI];
+  Expected<bool> HasThinLTOSummary = BM.hasSummary();
   if (!HasThinLTOSummary)
     return HasThinLTOSummary.takeError();
 
+  auto ModSyms = Input.module_symbols(ModI);
   if (*HasThinLTOSummary)
-    return addThinLTO(IM.BM, M, Input.module_symbols(IM), ResI, ResE);
+    return addThinLTO(BM, ModSyms,
+                      KeepSummary ? &Input.Summaries[ModI] : nullptr, ResI,
+                      ResE);
   else
-    return addRegularLTO(IM.BM, ResI, ResE);
+    return addRegularLTO(BM, ModSyms, ResI, ResE);
 }
 
 // Add a regular LTO object to the link.
-Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
+Error LTO::addRegularLTO(BitcodeModule BM, ArrayRef<InputFile::Symbol> Syms,
+                         const SymbolResolution *&ResI,
                          const SymbolResolution *ResE) {
   if (!RegularLTO.CombinedModule) {
     RegularLTO.CombinedModule =
@@ -429,28 +457,40 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
   ModuleSymbolTable SymTab;
   SymTab.addModule(&M);
 
-  SmallPtrSet<GlobalValue *, 8> Used;
-  collectUsedGlobalVariables(M, Used, /*CompilerUsed*/ false);
-
   std::vector<GlobalValue *> Keep;
 
   for (GlobalVariable &GV : M.globals())
     if (GV.hasAppendingLinkage())
       Keep.push_back(&GV);
 
-  for (const InputFile::Symbol &Sym :
-       make_range(InputFile::symbol_iterator(SymTab.symbols().begin(), SymTab,
-                                             nullptr),
-                  InputFile::symbol_iterator(SymTab.symbols().end(), SymTab,
-                                             nullptr))) {
+  // The symbol table of the InputFile only lists the symbols that are relevant
+  // to LTO, in the order of the ModuleSymbolTable. Walk both in lockstep to
+  // find the GlobalValue of each symbol.
+  auto MsymI = SymTab.symbols().begin(), MsymE = SymTab.symbols().end();
+  auto Skip = [&]() {
+    while (MsymI != MsymE) {
+      auto Flags = SymTab.getSymbolFlags(*MsymI);
+      if ((Flags & object::BasicSymbolRef::SF_Global) &&
+          !(Flags & object::BasicSymbolRef::SF_FormatSpecific))
+        return;
+      ++MsymI;
+    }
+  };
+  Skip();
+
+  for (const InputFile::Symbol &Sym : Syms) {
     assert(ResI != ResE);
     SymbolResolution Res = *ResI++;
-    addSymbolToGlobalRes(Used, Sym, Res, 0);
+    addSymbolToGlobalRes(Sym, Res, 0);
+
+    assert(MsymI != MsymE);
+    ModuleSymbolTable::Symbol Msym = *MsymI++;
+    Skip();
 
-    if (Sym.getFlags() & object::BasicSymbolRef::SF_Undefined)
+    if (Sym.isUndefined())
       continue;
-    if (Res.Prevailing && Sym.isGV()) {
-      GlobalValue *GV = Sym.getGV();
+    GlobalValue *GV = Msym.dyn_cast<GlobalValue *>();
+    if (Res.Prevailing && GV) {
       Keep.push_back(GV);
       switch (GV->getLinkage()) {
       default:
@@ -466,10 +506,10 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
     // Common resolution: collect the maximum size/alignment over all commons.
     // We also record if we see an instance of a common as prevailing, so that
     // if none is prevailing we can ignore it later.
-    if (Sym.getFlags() & object::BasicSymbolRef::SF_Common) {
+    if (Sym.isCommon()) {
       // FIXME: We should figure out what to do about commons defined by asm.
       // For now they aren't reported correctly by ModuleSymbolTable.
-      auto &CommonRes = RegularLTO.Commons[Sym.getGV()->getName()];
+      auto &CommonRes = RegularLTO.Commons[Sym.getIRName()];
       CommonRes.Size = std::max(CommonRes.Size, Sym.getCommonSize());
       CommonRes.Align = std::max(CommonRes.Align, Sym.getCommonAlignment());
       CommonRes.Prevailing |= Res.Prevailing;
@@ -477,6 +517,7 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
 
     // FIXME: use proposed local attribute for FinalDefinitionInLinkageUnit.
   }
+  assert(MsymI == MsymE);
 
   return RegularLTO.Mover->move(std::move(*MOrErr), Keep,
                                 [](GlobalValue &, IRMover::ValueAdder) {},
@@ -485,29 +526,36 @@ Error LTO::addRegularLTO(BitcodeModule BM, const SymbolResolution *&ResI,
 }
 
 // Add a ThinLTO object to the link.
-// FIXME: This function should not need to take as many parameters once we have
-// a bitcode symbol table.
-Error LTO::addThinLTO(BitcodeModule BM, Module &M,
-                      iterator_range<InputFile::symbol_iterator> Syms,
+Error LTO::addThinLTO(BitcodeModule BM, ArrayRef<InputFile::Symbol> Syms,
+                      std::unique_ptr<ModuleSummaryIndex> *KeptSummary,
                       const SymbolResolution *&ResI,
                       const SymbolResolution *ResE) {
-  SmallPtrSet<GlobalValue *, 8> Used;
-  collectUsedGlobalVariables(M, Used, /*CompilerUsed*/ false);
-
-  Expected<std::unique_ptr<ModuleSummaryIndex>> SummaryOrErr = BM.getSummary();
-  if (!SummaryOrErr)
-    return SummaryOrErr.takeError();
-  ThinLTO.CombinedIndex.mergeFrom(std::move(*SummaryOrErr),
-                                  ThinLTO.ModuleMap.size());
+  if (!KeptSummary || !*KeptSummary) {
+    Expected<std::unique_ptr<ModuleSummaryIndex>> SummaryOrErr =
+        BM.getSummary();
+    if (!SummaryOrErr)
+      return SummaryOrErr.takeError();
+    if (!KeptSummary)
+      ThinLTO.CombinedIndex.mergeFrom(std::move(*SummaryOrErr),
+                                      ThinLTO.ModuleMap.size());
+    else
+      *KeptSummary = std::move(*SummaryOrErr);
+  }
+  if (KeptSummary)
+    ThinLTO.CombinedIndex.mergeFrom(**KeptSummary, ThinLTO.ModuleMap.size());
 
   for (const InputFile::Symbol &Sym : Syms) {
     assert(ResI != ResE);
     SymbolResolution Res = *ResI++;
-    addSymbolToGlobalRes(Used, Sym, Res, ThinLTO.ModuleMap.size() + 1);
+    addSymbolToGlobalRes(Sym, Res, ThinLTO.ModuleMap.size() + 1);
 
-    if (Res.Prevailing && Sym.isGV())
-      ThinLTO.PrevailingModuleForGUID[Sym.getGV()->getGUID()] =
-          BM.getModuleIdentifier();
+    if (Res.Prevailing) {
+      if (!Sym.getIRName().empty()) {
+        auto GUID = GlobalValue::getGUID(GlobalValue::getGlobalIdentifier(
+            Sym.getIRName(), GlobalValue::ExternalLinkage, ""));
+        ThinLTO.PrevailingModuleForGUID[GUID] = BM.getModuleIdentifier();
+      }
+    }
   }
 
   if (!ThinLTO.ModuleMap.insert({BM.getModuleIdentifier(), BM}).second)
@@ -621,7 +669,9 @@ public:
 
 namespace {
 class InProcessThinBackend : public ThinBackendProc {
-  ThreadPool BackendThreadPool;
+  std::unique_ptr<ThreadPool> OwnedThreadPool;
+  ThreadPool &BackendThreadPool;
+  ThinBackendScheduler Scheduler;
   AddStreamFn AddStream;
   NativeObjectCache Cache;
 
@@ -635,8 +685,17 @@ public:
       const StringMap<GVSummaryMapTy> &ModuleToDefinedGVSummaries,
       AddStreamFn AddStream, NativeObjectCache Cache)
       : ThinBackendProc(Conf, CombinedIndex, ModuleToDefinedGVSummaries),
-        BackendThreadPool(ThinLTOParallelismLevel),
-        AddStream(std::move(AddStream)), Cache(std::move(Cache)) {}
+        OwnedThreadPool(llvm::make_unique<ThreadPool>(ThinLTOParallelismLevel)),
+        BackendThreadPool(*OwnedThreadPool), AddStream(std::move(AddStream)),
+        Cache(std::move(Cache)) {}
+
+  InProcessThinBackend(
+      Config &Conf, ModuleSummaryIndex &CombinedIndex, ThreadPool &Pool,
+      const StringMap<GVSummaryMapTy> &ModuleToDefinedGVSummaries,
+      AddStreamFn AddStream, NativeObjectCache Cache)
+      : ThinBackendProc(Conf, CombinedIndex, ModuleToDefinedGVSummaries),
+        BackendThreadPool(Pool), AddStream(std::move(AddStream)),
+        Cache(std::move(Cache)) {}
 
   Error runThinLTOBackendThread(
       AddStreamFn AddStream, NativeObjectCache Cache, unsigned Task,
@@ -685,33 +744,27 @@ public:
     assert(ModuleToDefinedGVSummaries.count(ModulePath));
     const GVSummaryMapTy &DefinedGlobals =
         ModuleToDefinedGVSummaries.find(ModulePath)->second;
-    BackendThreadPool.async(
-        [=](BitcodeModule BM, ModuleSummaryIndex &CombinedIndex,
-            const FunctionImporter::ImportMapTy &ImportList,
-            const FunctionImporter::ExportSetTy &ExportList,
-            const std::map<GlobalValue::GUID, GlobalValue::LinkageTypes>
-                &ResolvedODR,
-            const GVSummaryMapTy &DefinedGlobals,
-            MapVector<StringRef, BitcodeModule> &ModuleMap) {
-          Error E = runThinLTOBackendThread(
-              AddStream, Cache, Task, BM, CombinedIndex, ImportList,
-              ExportList, ResolvedODR, DefinedGlobals, ModuleMap);
-          if (E) {
-            std::unique_lock<std::mutex> L(ErrMu);
-            if (Err)
-              Err = joinErrors(std::move(*Err), std::move(E));
-            else
-              Err = std::move(E);
-          }
-        },
-        BM, std::ref(CombinedIndex), std::ref(ImportList),
-        std::ref(ExportList), std::ref(ResolvedODR), std::ref(DefinedGlobals),
-        std::ref(ModuleMap));
+    uint64_t Cost =
+        estimateThinBackendCost(CombinedIndex, DefinedGlobals, ImportList);
+    Scheduler.addJob(ModulePath, Cost, [=, &ImportList, &ExportList,
+                                        &ResolvedODR, &DefinedGlobals,
+                                        &ModuleMap]() {
+      Error E = runThinLTOBackendThread(AddStream, Cache, Task, BM,
+                                        CombinedIndex, ImportList, ExportList,
+                                        ResolvedODR, DefinedGlobals, ModuleMap);
+      if (E) {
+        std::unique_lock<std::mutex> L(ErrMu);
+        if (Err)
+          Err = joinErrors(std::move(*Err), std::move(E));
+        else
+          Err = std::move(E);
+      }
+    });
     return Error::success();
   }
 
   Error wait() override {
-    BackendThreadPool.wait();
+    Scheduler.run(BackendThreadPool);
     if (Err)
       return std::move(*Err);
     else
@@ -730,6 +783,16 @@ ThinBackend lto::createInProcessThinBackend(unsigned ParallelismLevel) {
   };
 }
 
+ThinBackend lto::createInProcessThinBackend(ThreadPool &Pool) {
+  return [&Pool](Config &Conf, ModuleSummaryIndex &CombinedIndex,
+                 const StringMap<GVSummaryMapTy> &ModuleToDefinedGVSummaries,
+                 AddStreamFn AddStream, NativeObjectCache Cache) {
+    return llvm::make_unique<InProcessThinBackend>(
+        Conf, CombinedIndex, Pool, ModuleToDefinedGVSummaries, AddStream,
+        Cache);
+  };
+}
+
 // Given the original \p Path to an output file, replace any path
 // prefix matching \p OldPrefix with \p NewPrefix. Also, create the
 // resulting directory if it does not yet exist.
@@ -855,20 +918,39 @@ Error LTO::runThinLTO(AddStreamFn AddStream, NativeObjectCache Cache,
   StringMap<std::map<GlobalValue::GUID, GlobalValue::LinkageTypes>> ResolvedODR;
 
   if (Conf.OptLevel > 0) {
+    auto isPrevailing = [&](GlobalValue::GUID GUID,
+                            const GlobalValueSummary *S) {
+      return ThinLTO.PrevailingModuleForGUID[GUID] == S->modulePath();
+    };
+
+    // The variables that only the ThinLTO modules load from are imported,
+    // then internalized, wherever they are referenced.
+    DenseSet<GlobalValue::GUID> GUIDPreservedSymbols;
+    for (auto &Res : GlobalResolutions)
+      if (Res.second.VisibleOutsideThinLTO && !Res.second.IRName.empty())
+        GUIDPreservedSymbols.insert(GlobalValue::getGUID(Res.second.IRName));
+    computeReadOnlyGlobals(ThinLTO.CombinedIndex, isPrevailing,
+                           GUIDPreservedSymbols);
+
     ComputeCrossModuleImport(ThinLTO.CombinedIndex, ModuleToDefinedGVSummaries,
                              ImportLists, ExportLists);
 
+    // The summaries only describe all the vtables of the program if no module
+    // is linked with regular LTO.
+    if (!HasRegularLTO)
+      runWholeProgramDevirtOnIndex(ThinLTO.CombinedIndex, ExportLists);
+
+    // Read-only variables referenced from other modules are imported there,
+    // so they don't need to be exported.
     std::set<GlobalValue::GUID> ExportedGUIDs;
     for (auto &Res : GlobalResolutions) {
-      if (!Res.second.IRName.empty() &&
-          Res.second.Partition == GlobalResolution::External)
-        ExportedGUIDs.insert(GlobalValue::getGUID(Res.second.IRName));
+      if (Res.second.IRName.empty() ||
+          Res.second.Partition != GlobalResolution::External)
+        continue;
+      auto GUID = GlobalValue::getGUID(Res.second.IRName);
+      if (!ThinLTO.CombinedIndex.getReadOnlyGlobalVarSummary(GUID))
+        ExportedGUIDs.insert(GUID);
     }
-
-    auto isPrevailing = [&](GlobalValue::GUID GUID,
-                            const GlobalValueSummary *S) {
-      return ThinLTO.PrevailingModuleForGUID[GUID] == S->modulePath();
-    };
     auto isExported = [&](StringRef ModuleIdentifier, GlobalValue::GUID GUID) {
       const auto &ExportList = ExportLists.find(ModuleIdentifier);
       return (ExportList != ExportLists.end() &&
@@ -15,6 +15,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/LTO/LTOBackend.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
 #include "llvm/Analysis/CGSCCPassManager.h"
 #include "llvm/Analysis/LoopPassManager.h"
@@ -27,6 +28,7 @@
 #include "llvm/IR/Verifier.h"
 #include "llvm/LTO/LTO.h"
 #include "llvm/LTO/legacy/UpdateCompilerUsed.h"
+#include "llvm/Linker/Linker.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Passes/PassBuilder.h"
 #include "llvm/Support/Error.h"
@@ -36,12 +38,18 @@
 #include "llvm/Target/TargetMachine.h"
 #include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/IPO/WholeProgramDevirt.h"
 #include "llvm/Transforms/Utils/FunctionImportUtils.h"
 #include "llvm/Transforms/Utils/SplitModule.h"
 
 using namespace llvm;
 using namespace lto;
 
+#define DEBUG_TYPE "lto-backend"
+
+STATISTIC(NumOptPartitions,
+          "Number of partitions of the module optimized concurrently");
+
 LLVM_ATTRIBUTE_NORETURN static void reportOpenError(StringRef Path, Twine Msg) {
   errs() << "failed to open " << Path << ": " << Msg << '\n';
   errs().flush();
@@ -167,12 +175,8 @@ static void runNewPMCustomPasses(Module &Mod, TargetMachine *TM,
   MPM.run(Mod, MAM);
 }
 
-static void runOldPMPasses(Config &Conf, Module &Mod, TargetMachine *TM,
-                           bool IsThinLTO) {
-  legacy::PassManager passes;
-  passes.add(createTargetTransformInfoWrapperPass(TM->getTargetIRAnalysis()));
-
-  PassManagerBuilder PMB;
+static void initPassManagerBuilder(PassManagerBuilder &PMB, Config &Conf,
+                                   TargetMachine *TM) {
   PMB.LibraryInfo = new TargetLibraryInfoImpl(Triple(TM->getTargetTriple()));
   PMB.Inliner = createFunctionInliningPass();
   // Unconditionally verify input since it is not verified before this
@@ -183,6 +187,15 @@ static void runOldPMPasses(Config &Conf, Module &Mod, TargetMachine *TM,
   PMB.SLPVectorize = true;
   PMB.OptLevel = Conf.OptLevel;
   PMB.PGOSampleUse = Conf.SampleProfile;
+}
+
+static void runOldPMPasses(Config &Conf, Module &Mod, TargetMachine *TM,
+                           bool IsThinLTO) {
+  legacy::PassManager passes;
+  passes.add(createTargetTransformInfoWrapperPass(TM->getTargetIRAnalysis()));
+
+  PassManagerBuilder PMB;
+  initPassManagerBuilder(PMB, Conf, TM);
   if (IsThinLTO)
     PMB.populateThinLTOPassManager(passes);
   else
@@ -200,6 +213,98 @@ bool opt(Config &Conf, TargetMachine *TM, unsigned Task, Module &Mod,
   return !Conf.PostOptModuleHook || Conf.PostOptModuleHook(Task, Mod);
 }
 
+/// Run the regular LTO pipeline on \p Mod, with the function simplification
+/// passes running concurrently on Conf.OptParallelismLevel partitions of the
+/// module. Each partition is optimized in its own context, and the results are
+/// linked back together into the context of \p Mod.
+static std::unique_ptr<Module> splitOpt(Config &Conf, TargetMachine *TM,
+                                        std::unique_ptr<Module> Mod) {
+  {
+    legacy::PassManager Passes;
+    Passes.add(createTargetTransformInfoWrapperPass(TM->getTargetIRAnalysis()));
+    PassManagerBuilder PMB;
+    initPassManagerBuilder(PMB, Conf, TM);
+    PMB.populateLTOIPOPassManager(Passes);
+    Passes.run(*Mod);
+  }
+
+  LLVMContext &Ctx = Mod->getContext();
+  const Target *T = &TM->getTarget();
+  std::vector<SmallString<0>> Partitions(Conf.OptParallelismLevel);
+  unsigned NumPartitions = 0;
+  {
+    ThreadPool OptThreadPool(Conf.OptParallelismLevel);
+    // Locals are kept in the same partition as all their users, so that the
+    // partitions can be linked back together without renaming anything.
+    SplitModule(
+        std::move(Mod), Conf.OptParallelismLevel,
+        [&](std::unique_ptr<Module> MPart) {
+          // As in splitCodeGen, hand the partition over to the worker as
+          // bitcode written on the main thread.
+          SmallString<0> &BC = Partitions[NumPartitions++];
+          raw_svector_ostream BCOS(BC);
+          WriteBitcodeToFile(MPart.get(), BCOS);
+
+          OptThreadPool.async([&Conf, T, &BC] {
+            LTOLLVMContext PartCtx(Conf);
+            Expected<std::unique_ptr<Module>> MOrErr = parseBitcodeFile(
+                MemoryBufferRef(StringRef(BC.data(), BC.size()), "ld-temp.o"),
+                PartCtx);
+            if (!MOrErr)
+              report_fatal_error("Failed to read bitcode");
+            std::unique_ptr<Module> MPartInCtx = std::move(MOrErr.get());
+
+            std::unique_ptr<TargetMachine> TM =
+                createTargetMachine(Conf, MPartInCtx->getTargetTriple(), T);
+            legacy::PassManager Passes;
+            Passes.add(createTargetTransformInfoWrapperPass(
+                TM->getTargetIRAnalysis()));
+            PassManagerBuilder PMB;
+            initPassManagerBuilder(PMB, Conf, TM.get());
+            PMB.populateLTOFunctionSimplificationPassManager(Passes);
+            Passes.run(*MPartInCtx);
+
+            BC.clear();
+            raw_svector_ostream BCOS(BC);
+            WriteBitcodeToFile(MPartInCtx.get(), BCOS);
+          });
+        },
+        /*PreserveLocals=*/true);
+    OptThreadPool.wait();
+  }
+  NumOptPartitions += NumPartitions;
+
+  std::unique_ptr<Module> Merged;
+  for (unsigned I = 0; I != NumPartitions; ++I) {
+    const SmallString<0> &BC = Partitions[I];
+    Expected<std::unique_ptr<Module>> MOrErr = parseBitcodeFile(
+        MemoryBufferRef(StringRef(BC.data(), BC.size()), "ld-temp.o"), Ctx);
+    if (!MOrErr)
+      report_fatal_error("Failed to read bitcode");
+    if (!Merged)
+      Merged = std::move(MOrErr.get());
+    else if (Linker::linkModules(*Merged, std::move(MOrErr.get())))
+      report_fatal_error("Failed to link optimized partitions");
+  }
+
+  legacy::PassManager Passes;
+  Passes.add(createTargetTransformInfoWrapperPass(TM->getTargetIRAnalysis()));
+  PassManagerBuilder PMB;
+  initPassManagerBuilder(PMB, Conf, TM);
+  PMB.populateLTOLatePassManager(Passes);
+  Passes.run(*Merged);
+  return Merged;
+}
+
+/// Whether to optimize \p Mod with splitOpt. Linking the partitions back
+/// together would duplicate the distinct DICompileUnits of the module, and
+/// below -O2 the function simplification passes are too cheap to be worth the
+/// round trips through bitcode.
+static bool shouldSplitOpt(const Config &Conf, const Module &Mod) {
+  return Conf.OptParallelismLevel > 1 && Conf.OptPipeline.empty() &&
+         Conf.OptLevel >= 2 && !Mod.getNamedMetadata("llvm.dbg.cu");
+}
+
 void codegen(Config &Conf, TargetMachine *TM, AddStreamFn AddStream,
              unsigned Task, Module &Mod) {
   if (Conf.PreCodeGenModuleHook && !Conf.PreCodeGenModuleHook(Task, Mod))
@@ -301,9 +406,15 @@ Error lto::backend(Config &C, AddStreamFn AddStream,
 
   handleAsmUndefinedRefs(*Mod, *TM);
 
-  if (!C.CodeGenOnly)
-    if (!opt(C, TM.get(), 0, *Mod, /*IsThinLTO=*/false))
+  if (!C.CodeGenOnly) {
+    if (shouldSplitOpt(C, *Mod)) {
+      Mod = splitOpt(C, TM.get(), std::move(Mod));
+      if (C.PostOptModuleHook && !C.PostOptModuleHook(0, *Mod))
+        return Error::success();
+    } else if (!opt(C, TM.get(), 0, *Mod, /*IsThinLTO=*/false)) {
       return Error::success();
+    }
+  }
 
   if (ParallelCodeGenParallelismLevel == 1) {
     codegen(C, TM.get(), AddStream, 0, *Mod);
@@ -364,6 +475,10 @@ Error lto::thinBackend(Config &Conf, unsigned Task, AddStreamFn AddStream,
   if (Error Err = Importer.importFunctions(Mod, ImportList).takeError())
     return Err;
 
+  // Devirtualize as decided by the thin link, including in the imported
+  // functions.
+  applyWholeProgramDevirtResolutions(Mod, CombinedIndex);
+
   if (Conf.PostImportModuleHook && !Conf.PostImportModuleHook(Task, Mod))
     return Error::success();
 
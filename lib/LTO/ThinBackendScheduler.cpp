@@ -0,0 +1,144 @@
+//===- ThinBackendScheduler.cpp - ThinLTO backend job scheduling ----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the scheduler used to run the ThinLTO backend jobs of a
+// link in parallel.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/LTO/ThinBackendScheduler.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Process.h"
+#include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <chrono>
+
+using namespace llvm;
+using namespace lto;
+
+static cl::opt<unsigned> ThinBackendMemoryLimit(
+    "thinlto-backend-memory-limit", cl::init(0),
+    cl::desc("Only start a ThinLTO backend job while the estimated memory "
+             "use of the running jobs stays within this many megabytes "
+             "(0 = unlimited)"));
+
+static cl::opt<unsigned> ThinBackendBytesPerInst(
+    "thinlto-backend-bytes-per-inst", cl::init(1024), cl::Hidden,
+    cl::desc("Estimated memory use of a ThinLTO backend job per instruction "
+             "of its module, in bytes"));
+
+static cl::opt<bool> ThinBackendStats(
+    "thinlto-backend-stats", cl::init(false),
+    cl::desc("Print the cost, wall time and peak RSS of the ThinLTO backend "
+             "jobs"));
+
+uint64_t
+lto::estimateThinBackendCost(const ModuleSummaryIndex &Index,
+                             const GVSummaryMapTy &DefinedGlobals,
+                             const FunctionImporter::ImportMapTy &ImportList) {
+  uint64_t Cost = 0;
+  for (auto &GlobalAndSummary : DefinedGlobals)
+    if (auto *FS = dyn_cast<FunctionSummary>(GlobalAndSummary.second))
+      Cost += FS->instCount();
+  for (auto &ModuleAndGUIDs : ImportList)
+    for (auto &GUIDAndThreshold : ModuleAndGUIDs.second)
+      if (auto *FS = dyn_cast_or_null<FunctionSummary>(
+              Index.findSummaryInModule(GUIDAndThreshold.first,
+                                        ModuleAndGUIDs.first())))
+        Cost += FS->instCount();
+  return Cost;
+}
+
+ThinBackendScheduler::ThinBackendScheduler()
+    : MemoryLimit(uint64_t(ThinBackendMemoryLimit) << 20), NextJob(0),
+      NumRunning(0), RunningMemory(0) {}
+
+void ThinBackendScheduler::addJob(StringRef Name, uint64_t Cost, JobFn Fn) {
+  Jobs.push_back({Name, Cost, std::move(Fn), 0, 0});
+}
+
+uint64_t ThinBackendScheduler::getMemoryEstimate(const Job &J) const {
+  return J.Cost * ThinBackendBytesPerInst;
+}
+
+void ThinBackendScheduler::runJobs() {
+  while (true) {
+    Job *J;
+    uint64_t Memory;
+    {
+      std::unique_lock<std::mutex> L(Lock);
+      // Jobs are started in order: a job that doesn't fit in the memory limit
+      // holds back the cheaper ones behind it until enough memory is released.
+      // A job that doesn't fit even on its own runs once nothing else does.
+      JobCompleted.wait(L, [&] {
+        return NextJob == Jobs.size() || !MemoryLimit || !NumRunning ||
+               RunningMemory + getMemoryEstimate(Jobs[NextJob]) <= MemoryLimit;
+      });
+      if (NextJob == Jobs.size())
+        return;
+      J = &Jobs[NextJob++];
+      Memory = getMemoryEstimate(*J);
+      ++NumRunning;
+      RunningMemory += Memory;
+    }
+
+    auto Start = std::chrono::steady_clock::now();
+    J->Fn();
+    J->Seconds = std::chrono::duration<double>(
+                     std::chrono::steady_clock::now() - Start)
+                     .count();
+    J->PeakRSS = sys::Process::GetPeakResidentSetSize();
+    // Release the closure, and whatever it holds on to, right away.
+    J->Fn = nullptr;
+
+    {
+      std::lock_guard<std::mutex> L(Lock);
+      --NumRunning;
+      RunningMemory -= Memory;
+    }
+    JobCompleted.notify_all();
+  }
+}
+
+void ThinBackendScheduler::run(ThreadPool &Pool) {
+  // Most expensive first; modules of the same cost keep the order they were
+  // added in, which keeps the schedule deterministic.
+  std::stable_sort(Jobs.begin(), Jobs.end(), [](const Job &L, const Job &R) {
+    return L.Cost > R.Cost;
+  });
+
+  auto Start = std::chrono::steady_clock::now();
+  // A pool without threads runs its tasks in wait(), one after the other.
+  size_t NumWorkers =
+      std::min<size_t>(std::max(Pool.getThreadCount(), 1u), Jobs.size());
+  for (size_t I = 0; I != NumWorkers; ++I)
+    Pool.async([this] { runJobs(); });
+  Pool.wait();
+
+  if (ThinBackendStats)
+    printStats(errs(), std::chrono::duration<double>(
+                           std::chrono::steady_clock::now() - Start)
+                           .count());
+  Jobs.clear();
+  NextJob = 0;
+}
+
+void ThinBackendScheduler::printStats(raw_ostream &OS, double Seconds) const {
+  OS << "ThinLTO backend jobs, in the order they were started:\n";
+  OS << "        Cost   Wall time    Peak RSS  Module\n";
+  for (const Job &J : Jobs)
+    OS << format("%12" PRIu64 "  %8.3f s  %7.1f MB  ", J.Cost, J.Seconds,
+                 J.PeakRSS / (1024.0 * 1024.0))
+       << J.Name << "\n";
+  OS << Jobs.size() << " jobs in "
+     << format("%.3f s, peak RSS %.1f MB\n", Seconds,
+               sys::Process::GetPeakResidentSetSize() / (1024.0 * 1024.0));
+}
@@ -34,6 +34,7 @@
 #include "llvm/IR/Mangler.h"
 #include "llvm/IRReader/IRReader.h"
 #include "llvm/LTO/LTO.h"
+#include "llvm/LTO/ThinBackendScheduler.h"
 #include "llvm/Linker/Linker.h"
 #include "llvm/MC/SubtargetFeature.h"
 #include "llvm/Object/IRObjectFile.h"
@@ -55,8 +56,6 @@
 #include "llvm/Transforms/ObjCARC.h"
 #include "llvm/Transforms/Utils/FunctionImportUtils.h"
 
-#include <numeric>
-
 using namespace llvm;
 
 #define DEBUG_TYPE "thinlto"
@@ -340,7 +339,10 @@ public:
   ErrorOr<std::unique_ptr<MemoryBuffer>> tryLoadingBuffer() {
     if (EntryPath.empty())
       return std::error_code();
-    return MemoryBuffer::getFile(EntryPath);
+    auto BufferOrErr = MemoryBuffer::getFile(EntryPath);
+    if (BufferOrErr)
+      recordAccess((*BufferOrErr)->getBufferSize());
+    return BufferOrErr;
   }
 
   // Cache the Produced object file
@@ -348,11 +350,15 @@ public:
     if (EntryPath.empty())
       return;
 
-    // Write to a temporary to avoid race condition
-    SmallString<128> TempFilename;
+    // Write to a temporary in the cache directory to avoid race condition.
+    // CachePruning recognizes the prefix, and leaves these files alone until
+    // they expire.
+    SmallString<128> TempModel(sys::path::parent_path(EntryPath)),
+        TempFilename;
+    sys::path::append(TempModel, "llvmcache-tmp-%%%%%%%%.o");
     int TempFD;
     std::error_code EC =
-        sys::fs::createTemporaryFile("Thin", "tmp.o", TempFD, TempFilename);
+        sys::fs::createUniqueFile(TempModel, TempFD, TempFilename);
     if (EC) {
       errs() << "Error: " << EC.message() << "\n";
       report_fatal_error("ThinLTO: Can't get a temporary file");
@@ -361,16 +367,25 @@ public:
       raw_fd_ostream OS(TempFD, /* ShouldClose */ true);
       OS << OutputBuffer.getBuffer();
     }
-    // Rename to final destination (hopefully race condition won't matter here)
+    // Rename to final destination, which is atomic on POSIX systems. If
+    // another process added the same entry concurrently, either one wins;
+    // both are identical.
     EC = sys::fs::rename(TempFilename, EntryPath);
     if (EC) {
       sys::fs::remove(TempFilename);
-      raw_fd_ostream OS(EntryPath, EC, sys::fs::F_None);
-      if (EC)
-        report_fatal_error(Twine("Failed to open ") + EntryPath +
-                           " to save cached entry\n");
-      OS << OutputBuffer.getBuffer();
+      if (!sys::fs::exists(EntryPath))
+        report_fatal_error(Twine("Failed to rename ") + TempFilename + " to " +
+                           EntryPath + " to save cached entry\n");
     }
+    recordAccess(OutputBuffer.getBufferSize());
+  }
+
+private:
+  // Record the use of the entry in the access index of the cache, which
+  // CachePruning prunes the cache from.
+  void recordAccess(uint64_t Size) {
+    CachePruning::recordAccess(sys::path::parent_path(EntryPath),
+                               sys::path::filename(EntryPath), Size);
   }
 };
 
@@ -875,25 +890,20 @@ void ThinLTOCodeGenerator::run() {
     ResolvedODR[DefinedGVSummaries.first()];
   }
 
-  // Compute the ordering we will process the inputs: the rough heuristic here
-  // is to sort them per size so that the largest module get schedule as soon as
-  // possible. This is purely a compile-time optimization.
-  std::vector<int> ModulesOrdering;
-  ModulesOrdering.resize(Modules.size());
-  std::iota(ModulesOrdering.begin(), ModulesOrdering.end(), 0);
-  std::sort(ModulesOrdering.begin(), ModulesOrdering.end(),
-            [&](int LeftIndex, int RightIndex) {
-              auto LSize = Modules[LeftIndex].getBufferSize();
-              auto RSize = Modules[RightIndex].getBufferSize();
-              return LSize > RSize;
-            });
-
-  // Parallel optimizer + codegen
+  // Parallel optimizer + codegen. The scheduler starts the largest modules
+  // first, as estimated from the combined index: this is purely a
+  // compile-time optimization.
   {
-    ThreadPool Pool(ThreadCount);
-    for (auto IndexCount : ModulesOrdering) {
-      auto &ModuleBuffer = Modules[IndexCount];
-      Pool.async([&](int count) {
+    lto::ThinBackendScheduler Scheduler;
+    for (int IndexCount = 0, E = Modules.size(); IndexCount != E;
+         ++IndexCount) {
+      auto ModuleIdentifier = Modules[IndexCount].getBufferIdentifier();
+      uint64_t Cost = lto::estimateThinBackendCost(
+          *Index, ModuleToDefinedGVSummaries[ModuleIdentifier],
+          ImportLists[ModuleIdentifier]);
+      Scheduler.addJob(ModuleIdentifier, Cost, [&, IndexCount]() {
+        int count = IndexCount;
+        auto &ModuleBuffer = Modules[count];
         auto ModuleIdentifier = ModuleBuffer.getBufferIdentifier();
         auto &ExportList = ExportLists[ModuleIdentifier];
 
@@ -975,8 +985,10 @@ void ThinLTOCodeGenerator::run() {
         }
         ProducedBinaryFiles[count] = writeGeneratedObject(
             count, CacheEntryPath, SavedObjectsDirectoryPath, *OutputBuffer);
-      }, IndexCount);
+      });
     }
+    ThreadPool Pool(ThreadCount);
+    Scheduler.run(Pool);
   }
 
   CachePruning(CacheOptions.Path)
@@ -12,6 +12,7 @@
 #include "llvm/ADT/SmallString.h"
 #include "llvm/Support/COFF.h"
 #include "llvm/Support/Endian.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/raw_ostream.h"
 
 #include <vector>
@@ -74,9 +75,15 @@ static int charTailAt(StringPair *P, size_t Pos) {
   return (unsigned char)S[S.size() - Pos - 1];
 }
 
+// Partitions smaller than this are not worth sorting on another thread.
+static const ptrdiff_t MinParallelPartition = 4096;
+
 // Three-way radix quicksort. This is much faster than std::sort with strcmp
 // because it does not compare characters that we already know the same.
-static void multikey_qsort(StringPair **Begin, StringPair **End, int Pos) {
+// The three partitions are independent, so large ones are sorted concurrently
+// in TG, if there is one.
+static void multikey_qsort(StringPair **Begin, StringPair **End, int Pos,
+                           parallel::TaskGroup *TG) {
 tailcall:
   if (End - Begin <= 1)
     return;
@@ -96,8 +103,14 @@ tailcall:
       R++;
   }
 
-  multikey_qsort(Begin, P, Pos);
-  multikey_qsort(Q, End, Pos);
+  if (TG && P - Begin >= MinParallelPartition)
+    TG->spawn([=] { multikey_qsort(Begin, P, Pos, TG); });
+  else
+    multikey_qsort(Begin, P, Pos, TG);
+  if (TG && End - Q >= MinParallelPartition)
+    TG->spawn([=] { multikey_qsort(Q, End, Pos, TG); });
+  else
+    multikey_qsort(Q, End, Pos, TG);
   if (Pivot != -1) {
     // qsort(P, Q, Pos + 1), but with tail call optimization.
     Begin = P;
@@ -124,10 +137,15 @@ void StringTableBuilder::finalizeStringTable(bool Optimize) {
     for (StringPair &P : StringIndexMap)
       Strings.push_back(&P);
 
-    if (!Strings.empty()) {
-      // If we're optimizing, sort by name. If not, sort by previously assigned
-      // offset.
-      multikey_qsort(&Strings[0], &Strings[0] + Strings.size(), 0);
+    // If we're optimizing, sort by name. If not, sort by previously assigned
+    // offset. Small tables are sorted without setting up a task group.
+    StringPair **Begin = Strings.data();
+    StringPair **End = Begin + Strings.size();
+    if (End - Begin >= MinParallelPartition) {
+      parallel::TaskGroup TG;
+      multikey_qsort(Begin, End, 0, &TG);
+    } else {
+      multikey_qsort(Begin, End, 0, nullptr);
     }
 
     initSize();
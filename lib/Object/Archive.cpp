@@ -868,6 +868,18 @@ Archive::Symbol Archive::Symbol::getNext() const {
       t.StringIndex -= CurRanStrx;
       t.StringIndex += NextRanStrx;
     }
+  } else if (Parent->kind() == K_DARWIN64) {
+    // Same as above for the ranlib_64 structs of the __.SYMDEF_64 or
+    // "__.SYMDEF_64 SORTED" member.
+    const char *Buf = Parent->getSymbolTable().begin();
+    uint64_t RanlibCount = read64le(Buf) / 16;
+    if (t.SymbolIndex + 1 < RanlibCount) {
+      const char *Ranlibs = Buf + 8;
+      uint64_t CurRanStrx = read64le(Ranlibs + t.SymbolIndex * 16);
+      uint64_t NextRanStrx = read64le(Ranlibs + (t.SymbolIndex + 1) * 16);
+      t.StringIndex -= CurRanStrx;
+      t.StringIndex += NextRanStrx;
+    }
   } else {
     // Go to one past next null.
     t.StringIndex = Parent->getSymbolTable().find('\0', t.StringIndex) + 1;
@@ -954,20 +966,29 @@ uint32_t Archive::getNumberOfSymbols() const {
   return read32le(buf);
 }
 
+void Archive::buildSymbolMap() const {
+  HasSymbolMap = true;
+  // Every symbol takes at least one byte of the table, which bounds the size
+  // of a malformed count.
+  SymbolMap.reserve(std::min<uint64_t>(getNumberOfSymbols(),
+                                       getSymbolTable().size()));
+  // A name may be defined by several members; like a linear search of the
+  // symbol table, resolve it to the first one, which insert() preserves.
+  for (const Symbol &Sym : symbols())
+    SymbolMap.insert(std::make_pair(Sym.getName(), Sym));
+}
+
 Expected<Optional<Archive::Child>> Archive::findSym(StringRef name) const {
-  Archive::symbol_iterator bs = symbol_begin();
-  Archive::symbol_iterator es = symbol_end();
-
-  for (; bs != es; ++bs) {
-    StringRef SymName = bs->getName();
-    if (SymName == name) {
-      if (auto MemberOrErr = bs->getMember())
-        return Child(*MemberOrErr);
-      else
-        return MemberOrErr.takeError();
-    }
-  }
-  return Optional<Child>();
+  if (!HasSymbolMap)
+    buildSymbolMap();
+
+  auto I = SymbolMap.find(name);
+  if (I == SymbolMap.end())
+    return Optional<Child>();
+  if (auto MemberOrErr = I->second.getMember())
+    return Child(*MemberOrErr);
+  else
+    return MemberOrErr.takeError();
 }
 
 // Returns true if archive file contains no member file.
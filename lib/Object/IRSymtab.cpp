@@ -0,0 +1,335 @@
+//===- IRSymtab.cpp - implementation of IR symbol tables --------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Object/IRSymtab.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/Analysis/ObjectUtils.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/MC/StringTableBuilder.h"
+#include "llvm/Object/ModuleSymbolTable.h"
+#include "llvm/Support/Allocator.h"
+#include "llvm/Support/StringSaver.h"
+
+using namespace llvm;
+using namespace irsymtab;
+
+static const char *getProducer() { return "LLVM" LLVM_VERSION_STRING; }
+
+namespace {
+
+/// Stores the temporary state that is required to build an IR symbol table.
+struct Builder {
+  SmallVector<char, 0> &Symtab;
+  StringTableBuilder StrtabBuilder{StringTableBuilder::RAW};
+
+  BumpPtrAllocator Alloc;
+  StringSaver Saver{Alloc};
+
+  DenseMap<const Comdat *, unsigned> ComdatMap;
+  std::vector<storage::Comdat> Comdats;
+  std::vector<storage::Module> Mods;
+  std::vector<storage::Symbol> Syms;
+  std::vector<storage::Uncommon> Uncommons;
+
+  Builder(SmallVector<char, 0> &Symtab) : Symtab(Symtab) {}
+
+  void setStr(storage::Str &S, StringRef Value) {
+    S.Offset = StrtabBuilder.add(Value);
+    S.Size = Value.size();
+  }
+
+  template <typename T>
+  void writeRange(storage::Range<T> &R, const std::vector<T> &Objs) {
+    R.Offset = Symtab.size();
+    R.Size = Objs.size();
+    Symtab.insert(Symtab.end(), reinterpret_cast<const char *>(Objs.data()),
+                  reinterpret_cast<const char *>(Objs.data() + Objs.size()));
+  }
+
+  Error addModule(Module *M);
+  Error addSymbol(const ModuleSymbolTable &Msymtab,
+                  const SmallPtrSet<GlobalValue *, 8> &Used,
+                  ModuleSymbolTable::Symbol Sym);
+
+  Error build(ArrayRef<Module *> Mods, SmallVector<char, 0> &Strtab);
+};
+
+Error Builder::addModule(Module *M) {
+  if (M->getDataLayoutStr().empty())
+    return make_error<StringError>("input module has no datalayout",
+                                   inconvertibleErrorCode());
+
+  SmallPtrSet<GlobalValue *, 8> Used;
+  collectUsedGlobalVariables(*M, Used, /*CompilerUsed*/ false);
+
+  ModuleSymbolTable Msymtab;
+  Msymtab.addModule(M);
+
+  storage::Module Mod;
+  Mod.Begin = Syms.size();
+  Mod.End = Syms.size() + Msymtab.symbols().size();
+  Mod.UncBegin = Uncommons.size();
+  Mods.push_back(Mod);
+
+  for (ModuleSymbolTable::Symbol Msym : Msymtab.symbols())
+    if (Error Err = addSymbol(Msymtab, Used, Msym))
+      return Err;
+
+  return Error::success();
+}
+
+Error Builder::addSymbol(const ModuleSymbolTable &Msymtab,
+                         const SmallPtrSet<GlobalValue *, 8> &Used,
+                         ModuleSymbolTable::Symbol Msym) {
+  Syms.emplace_back();
+  storage::Symbol &Sym = Syms.back();
+  Sym = {};
+
+  SmallString<64> Name;
+  {
+    raw_svector_ostream OS(Name);
+    Msymtab.printSymbolName(OS, Msym);
+  }
+  setStr(Sym.Name, Saver.save(StringRef(Name)));
+
+  uint32_t Flags = Msymtab.getSymbolFlags(Msym);
+  if (Flags & object::BasicSymbolRef::SF_Undefined)
+    Sym.Flags |= 1 << storage::Symbol::FB_undefined;
+  if (Flags & object::BasicSymbolRef::SF_Weak)
+    Sym.Flags |= 1 << storage::Symbol::FB_weak;
+  if (Flags & object::BasicSymbolRef::SF_Common)
+    Sym.Flags |= 1 << storage::Symbol::FB_common;
+  if (Flags & object::BasicSymbolRef::SF_Indirect)
+    Sym.Flags |= 1 << storage::Symbol::FB_indirect;
+  if (Flags & object::BasicSymbolRef::SF_Global)
+    Sym.Flags |= 1 << storage::Symbol::FB_global;
+  if (Flags & object::BasicSymbolRef::SF_FormatSpecific)
+    Sym.Flags |= 1 << storage::Symbol::FB_format_specific;
+  if (Flags & object::BasicSymbolRef::SF_Executable)
+    Sym.Flags |= 1 << storage::Symbol::FB_executable;
+  if (Flags & object::BasicSymbolRef::SF_Hidden)
+    Sym.Flags |= 1 << storage::Symbol::FB_hidden;
+  if (Flags & object::BasicSymbolRef::SF_Const)
+    Sym.Flags |= 1 << storage::Symbol::FB_const;
+
+  Sym.ComdatIndex = -1;
+  auto *GV = Msym.dyn_cast<GlobalValue *>();
+  if (!GV) {
+    setStr(Sym.IRName, "");
+    return Error::success();
+  }
+
+  setStr(Sym.IRName, GV->getName());
+
+  if (Used.count(GV))
+    Sym.Flags |= 1 << storage::Symbol::FB_used;
+  if (GV->isThreadLocal())
+    Sym.Flags |= 1 << storage::Symbol::FB_tls;
+  if (GV->hasGlobalUnnamedAddr())
+    Sym.Flags |= 1 << storage::Symbol::FB_unnamed_addr;
+  if (canBeOmittedFromSymbolTable(GV))
+    Sym.Flags |= 1 << storage::Symbol::FB_may_omit;
+  Sym.Flags |= unsigned(GV->getVisibility()) << storage::Symbol::FB_visibility;
+
+  if (Flags & object::BasicSymbolRef::SF_Common) {
+    Sym.Flags |= 1 << storage::Symbol::FB_has_uncommon;
+    storage::Uncommon Unc;
+    Unc.CommonSize = GV->getParent()->getDataLayout().getTypeAllocSize(
+        GV->getType()->getElementType());
+    Unc.CommonAlign = GV->getAlignment();
+    Uncommons.push_back(Unc);
+  }
+
+  // Comdats only matter to linkers for the symbols they see.
+  if (!(Flags & object::BasicSymbolRef::SF_Global) ||
+      (Flags & object::BasicSymbolRef::SF_FormatSpecific))
+    return Error::success();
+
+  // An alias may point to an arbitrary ConstantExpr, from which we cannot
+  // always find an aliasee and its comdat.
+  const GlobalObject *Base = GV->getBaseObject();
+  if (!Base)
+    return make_error<StringError>("Unable to determine comdat of alias!",
+                                   inconvertibleErrorCode());
+  if (const Comdat *C = Base->getComdat()) {
+    auto P = ComdatMap.insert(std::make_pair(C, Comdats.size()));
+    Sym.ComdatIndex = P.first->second;
+    if (P.second) {
+      storage::Comdat Comdat;
+      setStr(Comdat.Name, C->getName());
+      Comdats.push_back(Comdat);
+    }
+  }
+
+  return Error::success();
+}
+
+Error Builder::build(ArrayRef<Module *> IRMods, SmallVector<char, 0> &Strtab) {
+  storage::Header Hdr;
+
+  assert(!IRMods.empty());
+  Hdr.Version = storage::Header::kCurrentVersion;
+  setStr(Hdr.Producer, getProducer());
+  setStr(Hdr.TargetTriple, IRMods[0]->getTargetTriple());
+  setStr(Hdr.SourceFileName, IRMods[0]->getSourceFileName());
+
+  for (Module *M : IRMods)
+    if (Error Err = addModule(M))
+      return Err;
+
+  // We are about to fill in the header's range fields, so reserve space for it
+  // and copy it in afterwards.
+  Symtab.resize(sizeof(storage::Header));
+  writeRange(Hdr.Modules, Mods);
+  writeRange(Hdr.Comdats, Comdats);
+  writeRange(Hdr.Symbols, Syms);
+  writeRange(Hdr.Uncommons, Uncommons);
+
+  *reinterpret_cast<storage::Header *>(Symtab.data()) = Hdr;
+
+  StrtabBuilder.finalizeInOrder();
+  Strtab.resize(StrtabBuilder.getSize());
+  StrtabBuilder.write(reinterpret_cast<uint8_t *>(Strtab.data()));
+  return Error::success();
+}
+
+} // end anonymous namespace
+
+Error irsymtab::build(ArrayRef<Module *> Mods, SmallVector<char, 0> &Symtab,
+                      SmallVector<char, 0> &Strtab) {
+  return Builder(Symtab).build(Mods, Strtab);
+}
+
+uint32_t irsymtab::Symbol::getFlags() const {
+  uint32_t Res = object::BasicSymbolRef::SF_None;
+  if (isUndefined())
+    Res |= object::BasicSymbolRef::SF_Undefined;
+  if (isWeak())
+    Res |= object::BasicSymbolRef::SF_Weak;
+  if (isCommon())
+    Res |= object::BasicSymbolRef::SF_Common;
+  if (isIndirect())
+    Res |= object::BasicSymbolRef::SF_Indirect;
+  if (isGlobal())
+    Res |= object::BasicSymbolRef::SF_Global;
+  if (isFormatSpecific())
+    Res |= object::BasicSymbolRef::SF_FormatSpecific;
+  if (isExecutable())
+    Res |= object::BasicSymbolRef::SF_Executable;
+  if ((Flags >> storage::Symbol::FB_hidden) & 1)
+    Res |= object::BasicSymbolRef::SF_Hidden;
+  if ((Flags >> storage::Symbol::FB_const) & 1)
+    Res |= object::BasicSymbolRef::SF_Const;
+  return Res;
+}
+
+template <typename T>
+static bool isValidRange(storage::Range<T> R, StringRef Symtab) {
+  return R.Offset <= Symtab.size() &&
+         R.Size <= (Symtab.size() - R.Offset) / sizeof(T);
+}
+
+static bool isValidStr(storage::Str S, StringRef Strtab) {
+  return S.Offset <= Strtab.size() && S.Size <= Strtab.size() - S.Offset;
+}
+
+bool Reader::isValid(StringRef Symtab, StringRef Strtab) {
+  if (Symtab.size() < sizeof(storage::Header))
+    return false;
+  auto &Hdr = *reinterpret_cast<const storage::Header *>(Symtab.data());
+  if (Hdr.Version != storage::Header::kCurrentVersion ||
+      !isValidStr(Hdr.Producer, Strtab) ||
+      Hdr.Producer.get(Strtab) != getProducer())
+    return false;
+
+  if (!isValidRange(Hdr.Modules, Symtab) ||
+      !isValidRange(Hdr.Comdats, Symtab) ||
+      !isValidRange(Hdr.Symbols, Symtab) ||
+      !isValidRange(Hdr.Uncommons, Symtab) ||
+      !isValidStr(Hdr.TargetTriple, Strtab) ||
+      !isValidStr(Hdr.SourceFileName, Strtab))
+    return false;
+
+  for (const storage::Comdat &C : Hdr.Comdats.get(Symtab))
+    if (!isValidStr(C.Name, Strtab))
+      return false;
+
+  size_t NumUncommons = 0;
+  ArrayRef<storage::Symbol> Syms = Hdr.Symbols.get(Symtab);
+  for (const storage::Symbol &S : Syms) {
+    if (!isValidStr(S.Name, Strtab) || !isValidStr(S.IRName, Strtab))
+      return false;
+    if (S.ComdatIndex != -1u && S.ComdatIndex >= Hdr.Comdats.Size)
+      return false;
+    if (S.Flags & (1 << storage::Symbol::FB_has_uncommon))
+      ++NumUncommons;
+  }
+  if (NumUncommons != Hdr.Uncommons.Size)
+    return false;
+
+  for (const storage::Module &M : Hdr.Modules.get(Symtab))
+    if (M.Begin > M.End || M.End > Syms.size() ||
+        M.UncBegin > Hdr.Uncommons.Size)
+      return false;
+  return true;
+}
+
+static Expected<FileContents> upgrade(ArrayRef<BitcodeModule> BMs) {
+  FileContents FC;
+  LLVMContext Ctx;
+  std::vector<Module *> Mods;
+  std::vector<std::unique_ptr<Module>> OwnedMods;
+  for (BitcodeModule BM : BMs) {
+    Expected<std::unique_ptr<Module>> MOrErr =
+        BM.getLazyModule(Ctx, /*ShouldLazyLoadMetadata*/ true,
+                         /*IsImporting*/ false);
+    if (!MOrErr)
+      return MOrErr.takeError();
+
+    Mods.push_back(MOrErr->get());
+    OwnedMods.push_back(std::move(*MOrErr));
+  }
+
+  if (Error E = build(Mods, FC.Symtab, FC.Strtab))
+    return std::move(E);
+
+  FC.TheReader = {{FC.Symtab.data(), FC.Symtab.size()},
+                  {FC.Strtab.data(), FC.Strtab.size()}};
+  FC.Mods = BMs.vec();
+  return std::move(FC);
+}
+
+Expected<FileContents> irsymtab::readBitcode(MemoryBufferRef MBRef) {
+  Expected<BitcodeFileContents> BFCOrErr = getBitcodeFileContents(MBRef);
+  if (!BFCOrErr)
+    return BFCOrErr.takeError();
+  BitcodeFileContents &BFC = *BFCOrErr;
+
+  if (BFC.Mods.empty())
+    return make_error<StringError>("Bitcode file does not contain any modules",
+                                   inconvertibleErrorCode());
+
+  // Use the symbol table of the file unless it is missing, was written by
+  // another version of LLVM, or does not describe the modules of the file
+  // (e.g. because they were concatenated by a tool that does not know about
+  // symbol tables).
+  if (!Reader::isValid(BFC.Symtab, BFC.StrtabForSymtab))
+    return upgrade(BFC.Mods);
+
+  FileContents FC;
+  FC.TheReader = {BFC.Symtab, BFC.StrtabForSymtab};
+  if (FC.TheReader.getNumModules() != BFC.Mods.size())
+    return upgrade(BFC.Mods);
+
+  FC.Mods = std::move(BFC.Mods);
+  return std::move(FC);
+}
@@ -16,20 +16,35 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/Optional.h"
 #include "llvm/ADT/SmallBitVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/ProfileData/Coverage/CoverageMappingReader.h"
 #include "llvm/ProfileData/InstrProfReader.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/ErrorHandling.h"
 #include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <mutex>
 
 using namespace llvm;
 using namespace coverage;
 
 #define DEBUG_TYPE "coverage-mapping"
 
+STATISTIC(NumDecodedRecords, "Number of function records decoded");
+STATISTIC(MaxDecodedRecords,
+          "Largest number of function records decoded at once");
+
+static cl::opt<unsigned> LoadChunkSize(
+    "coverage-load-chunk-size", cl::init(4096), cl::Hidden,
+    cl::desc("Number of function records that are decoded and evaluated at a "
+             "time when loading coverage mapping"));
+
 Counter CounterExpressionBuilder::get(const CounterExpression &E) {
   auto It = ExpressionIndices.find(E);
   if (It != ExpressionIndices.end())
@@ -183,32 +198,79 @@ void FunctionRecordIterator::skipOtherFiles() {
     *this = FunctionRecordIterator();
 }
 
-Error CoverageMapping::loadFunctionRecord(
-    const CoverageMappingRecord &Record,
-    IndexedInstrProfReader &ProfileReader) {
-  StringRef OrigFuncName = Record.FunctionName;
-  if (Record.Filenames.empty())
-    OrigFuncName = getFuncNameWithoutPrefix(OrigFuncName);
-  else
-    OrigFuncName = getFuncNameWithoutPrefix(OrigFuncName, Record.Filenames[0]);
+bool coverage::TimeLoadIsEnabled = false;
 
-  // Don't load records for functions we've already seen.
-  if (!FunctionNames.insert(OrigFuncName).second)
-    return Error::success();
+static const char *const TimerGroupName = "coverage-load";
+static const char *const TimerGroupDescription = "Coverage Mapping Loading";
 
-  CounterMappingContext Ctx(Record.Expressions);
+namespace {
+/// \brief A function record decoded into storage of its own, so that it stays
+/// valid after the reader moves on to other records.
+struct DecodedRecord {
+  StringRef FunctionName;
+  uint64_t FunctionHash;
+  StringRef OrigFuncName;
+  /// Whether the function has a record in an earlier chunk, in which case
+  /// the storage is released as soon as the record is decoded.
+  bool IsDuplicate = false;
+  CoverageMappingRecordStorage Storage;
+
+  CoverageMappingRecord getRecord() const {
+    CoverageMappingRecord Record;
+    Record.FunctionName = FunctionName;
+    Record.FunctionHash = FunctionHash;
+    Record.Filenames = Storage.Filenames;
+    Record.Expressions = Storage.Expressions;
+    Record.MappingRegions = Storage.MappingRegions;
+    return Record;
+  }
+};
+
+/// \brief The result of evaluating the counters of a function record.
+struct EvaluatedRecord {
+  enum StatusKind { Loaded, Mismatched, Skipped };
+
+  StatusKind Status;
+  /// An error reading the profile, other than a hash mismatch or a missing
+  /// function.
+  instrprof_error ProfileError;
+  Optional<FunctionRecord> Function;
+
+  EvaluatedRecord()
+      : Status(Skipped), ProfileError(instrprof_error::success) {}
+};
+} // end anonymous namespace
+
+static StringRef getOrigFuncName(const CoverageMappingRecord &Record) {
+  if (Record.Filenames.empty())
+    return getFuncNameWithoutPrefix(Record.FunctionName);
+  return getFuncNameWithoutPrefix(Record.FunctionName, Record.Filenames[0]);
+}
 
+/// \brief Evaluate the counters of every region of \p Record with the counts
+/// in the profile. This only reads \p ProfileReader, so several records may
+/// be evaluated at once.
+static void evaluateRecord(const CoverageMappingRecord &Record,
+                           StringRef OrigFuncName,
+                           IndexedInstrProfReader &ProfileReader,
+                           EvaluatedRecord &Result) {
   std::vector<uint64_t> Counts;
-  if (Error E = ProfileReader.getFunctionCounts(Record.FunctionName,
-                                                Record.FunctionHash, Counts)) {
+  ArrayRef<support::ulittle64_t> CounterView;
+  if (Error E = ProfileReader.getFunctionCounterView(
+          Record.FunctionName, Record.FunctionHash, CounterView)) {
     instrprof_error IPE = InstrProfError::take(std::move(E));
     if (IPE == instrprof_error::hash_mismatch) {
-      MismatchedFunctionCount++;
-      return Error::success();
-    } else if (IPE != instrprof_error::unknown_function)
-      return make_error<InstrProfError>(IPE);
+      Result.Status = EvaluatedRecord::Mismatched;
+      return;
+    } else if (IPE != instrprof_error::unknown_function) {
+      Result.ProfileError = IPE;
+      return;
+    }
     Counts.assign(Record.MappingRegions.size(), 0);
-  }
+  } else
+    Counts.assign(CounterView.begin(), CounterView.end());
+
+  CounterMappingContext Ctx(Record.Expressions);
   Ctx.setCounts(Counts);
 
   assert(!Record.MappingRegions.empty() && "Function has no regions");
@@ -218,27 +280,166 @@ Error CoverageMapping::loadFunctionRecord(
     Expected<int64_t> ExecutionCount = Ctx.evaluate(Region.Count);
     if (auto E = ExecutionCount.takeError()) {
       llvm::consumeError(std::move(E));
-      return Error::success();
+      return;
     }
     Function.pushRegion(Region, *ExecutionCount);
   }
   if (Function.CountedRegions.size() != Record.MappingRegions.size()) {
-    MismatchedFunctionCount++;
-    return Error::success();
+    Result.Status = EvaluatedRecord::Mismatched;
+    return;
   }
 
-  Functions.push_back(std::move(Function));
+  Result.Status = EvaluatedRecord::Loaded;
+  Result.Function = std::move(Function);
+}
+
+/// \brief Pick the records of \p Records that are the first of their function,
+/// in order, and release the storage of the others.
+static void dedupeRecords(MutableArrayRef<DecodedRecord> Records,
+                          StringSet<> &FunctionNames,
+                          std::vector<const DecodedRecord *> &ToLoad) {
+  for (DecodedRecord &R : Records) {
+    if (R.IsDuplicate)
+      continue;
+    if (FunctionNames.insert(R.OrigFuncName).second)
+      ToLoad.push_back(&R);
+    else
+      R.Storage = CoverageMappingRecordStorage();
+  }
+}
+
+/// \brief Evaluate the counters of the records \p ToLoad, and add those that
+/// the profile has counts for to \p Functions.
+static Error loadRecords(ArrayRef<const DecodedRecord *> ToLoad,
+                         IndexedInstrProfReader &ProfileReader,
+                         std::vector<FunctionRecord> &Functions,
+                         unsigned &MismatchedFunctionCount) {
+  std::vector<EvaluatedRecord> Results(ToLoad.size());
+  {
+    NamedRegionTimer T("evaluate", "Evaluate region counters", TimerGroupName,
+                       TimerGroupDescription, TimeLoadIsEnabled);
+    parallel_for_each_n(size_t(0), ToLoad.size(), [&](size_t I) {
+      evaluateRecord(ToLoad[I]->getRecord(), ToLoad[I]->OrigFuncName,
+                     ProfileReader, Results[I]);
+    });
+  }
+
+  NamedRegionTimer T("merge", "Merge function records", TimerGroupName,
+                     TimerGroupDescription, TimeLoadIsEnabled);
+  for (EvaluatedRecord &Result : Results) {
+    if (Result.ProfileError != instrprof_error::success)
+      return make_error<InstrProfError>(Result.ProfileError);
+    if (Result.Status == EvaluatedRecord::Mismatched)
+      MismatchedFunctionCount++;
+    else if (Result.Status == EvaluatedRecord::Loaded)
+      Functions.push_back(std::move(*Result.Function));
+  }
   return Error::success();
 }
 
+Error CoverageMapping::loadFunctionRecords(
+    CoverageMappingReader &CoverageReader,
+    IndexedInstrProfReader &ProfileReader) {
+  // The records are decoded, evaluated and merged a chunk at a time, so that
+  // only the storage of one chunk is held at once however many records the
+  // reader has.
+  size_t ChunkSize = std::max(1u, unsigned(LoadChunkSize));
+  std::vector<DecodedRecord> Records;
+  std::vector<const DecodedRecord *> ToLoad;
+
+  if (size_t NumRecords = CoverageReader.getNumRecords()) {
+    for (size_t Begin = 0; Begin < NumRecords; Begin += ChunkSize) {
+      size_t End = std::min(NumRecords, Begin + ChunkSize);
+      Records.clear();
+      Records.resize(End - Begin);
+      ToLoad.clear();
+      {
+        NamedRegionTimer T("decode", "Decode function records", TimerGroupName,
+                           TimerGroupDescription, TimeLoadIsEnabled);
+        std::mutex ErrLock;
+        size_t ErrIndex = Records.size();
+        Error Err = Error::success();
+        parallel_for_each_n(size_t(0), Records.size(), [&](size_t I) {
+          DecodedRecord &R = Records[I];
+          CoverageMappingRecord Record;
+          if (Error E =
+                  CoverageReader.readRecord(Begin + I, Record, R.Storage)) {
+            // Report the error of the first bad record, as reading the
+            // records in sequence would.
+            std::lock_guard<std::mutex> Lock(ErrLock);
+            if (I < ErrIndex) {
+              consumeError(std::move(Err));
+              Err = std::move(E);
+              ErrIndex = I;
+            } else
+              consumeError(std::move(E));
+            return;
+          }
+          R.FunctionName = Record.FunctionName;
+          R.FunctionHash = Record.FunctionHash;
+          R.OrigFuncName = getOrigFuncName(Record);
+          // FunctionNames only changes between chunks, so the duplicates of
+          // the functions of earlier chunks can be dropped right away.
+          if (FunctionNames.count(R.OrigFuncName)) {
+            R.IsDuplicate = true;
+            R.Storage = CoverageMappingRecordStorage();
+          }
+        });
+        if (Err)
+          return Err;
+        NumDecodedRecords += Records.size();
+        if (Records.size() > MaxDecodedRecords)
+          MaxDecodedRecords = Records.size();
+        // Pick the records in the order of the reader, so that the result
+        // doesn't depend on the scheduling.
+        dedupeRecords(Records, FunctionNames, ToLoad);
+      }
+      if (Error E = loadRecords(ToLoad, ProfileReader, Functions,
+                                MismatchedFunctionCount))
+        return E;
+    }
+    return Error::success();
+  }
+
+  // Only the records that are the first of their function are copied out of
+  // the reader.
+  auto LoadChunk = [&]() -> Error {
+    if (Records.size() > MaxDecodedRecords)
+      MaxDecodedRecords = Records.size();
+    ToLoad.clear();
+    dedupeRecords(Records, FunctionNames, ToLoad);
+    Error E = loadRecords(ToLoad, ProfileReader, Functions,
+                          MismatchedFunctionCount);
+    Records.clear();
+    return E;
+  };
+  for (const auto &Record : CoverageReader) {
+    ++NumDecodedRecords;
+    if (Records.size() == ChunkSize)
+      if (Error E = LoadChunk())
+        return E;
+    StringRef OrigFuncName = getOrigFuncName(Record);
+    if (FunctionNames.count(OrigFuncName))
+      continue;
+    Records.emplace_back();
+    DecodedRecord &R = Records.back();
+    R.FunctionName = Record.FunctionName;
+    R.FunctionHash = Record.FunctionHash;
+    R.OrigFuncName = OrigFuncName;
+    R.Storage.Filenames = Record.Filenames;
+    R.Storage.Expressions = Record.Expressions;
+    R.Storage.MappingRegions = Record.MappingRegions;
+  }
+  return LoadChunk();
+}
+
 Expected<std::unique_ptr<CoverageMapping>>
 CoverageMapping::load(CoverageMappingReader &CoverageReader,
                       IndexedInstrProfReader &ProfileReader) {
   auto Coverage = std::unique_ptr<CoverageMapping>(new CoverageMapping());
 
-  for (const auto &Record : CoverageReader)
-    if (Error E = Coverage->loadFunctionRecord(Record, ProfileReader))
-      return std::move(E);
+  if (Error E = Coverage->loadFunctionRecords(CoverageReader, ProfileReader))
+    return std::move(E);
 
   return std::move(Coverage);
 }
@@ -249,9 +450,8 @@ Expected<std::unique_ptr<CoverageMapping>> CoverageMapping::load(
   auto Coverage = std::unique_ptr<CoverageMapping>(new CoverageMapping());
 
   for (const auto &CoverageReader : CoverageReaders)
-    for (const auto &Record : *CoverageReader)
-      if (Error E = Coverage->loadFunctionRecord(Record, ProfileReader))
-        return std::move(E);
+    if (Error E = Coverage->loadFunctionRecords(*CoverageReader, ProfileReader))
+      return std::move(E);
 
   return std::move(Coverage);
 }
@@ -41,6 +41,11 @@ void CoverageMappingIterator::increment() {
   }
 }
 
+Error CoverageMappingReader::readRecord(size_t, CoverageMappingRecord &,
+                                        CoverageMappingRecordStorage &) const {
+  llvm_unreachable("Reader can only read its records in sequence");
+}
+
 Error RawCoverageReader::readULEB128(uint64_t &Result) {
   if (Data.size() < 1)
     return make_error<CoverageMapError>(coveragemap_error::truncated);
@@ -687,23 +692,31 @@ Error BinaryCoverageReader::readNextRecord(CoverageMappingRecord &Record) {
   if (CurrentRecord >= MappingRecords.size())
     return make_error<CoverageMapError>(coveragemap_error::eof);
 
-  FunctionsFilenames.clear();
-  Expressions.clear();
-  MappingRegions.clear();
-  auto &R = MappingRecords[CurrentRecord];
+  if (auto Err = readRecord(CurrentRecord, Record, CurrentStorage))
+    return Err;
+
+  ++CurrentRecord;
+  return Error::success();
+}
+
+Error BinaryCoverageReader::readRecord(
+    size_t Index, CoverageMappingRecord &Record,
+    CoverageMappingRecordStorage &Storage) const {
+  Storage.Filenames.clear();
+  Storage.Expressions.clear();
+  Storage.MappingRegions.clear();
+  auto &R = MappingRecords[Index];
   RawCoverageMappingReader Reader(
       R.CoverageMapping,
       makeArrayRef(Filenames).slice(R.FilenamesBegin, R.FilenamesSize),
-      FunctionsFilenames, Expressions, MappingRegions);
+      Storage.Filenames, Storage.Expressions, Storage.MappingRegions);
   if (auto Err = Reader.read())
     return Err;
 
   Record.FunctionName = R.FunctionName;
   Record.FunctionHash = R.FunctionHash;
-  Record.Filenames = FunctionsFilenames;
-  Record.Expressions = Expressions;
-  Record.MappingRegions = MappingRegions;
-
-  ++CurrentRecord;
+  Record.Filenames = Storage.Filenames;
+  Record.Expressions = Storage.Expressions;
+  Record.MappingRegions = Storage.MappingRegions;
   return Error::success();
 }
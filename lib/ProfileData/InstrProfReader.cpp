@@ -19,9 +19,9 @@
 using namespace llvm;
 
 static Expected<std::unique_ptr<MemoryBuffer>>
-setupMemoryBuffer(const Twine &Path) {
+setupMemoryBuffer(const Twine &Path, bool RequiresNullTerminator = true) {
   ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
-      MemoryBuffer::getFileOrSTDIN(Path);
+      MemoryBuffer::getFileOrSTDIN(Path, -1, RequiresNullTerminator);
   if (std::error_code EC = BufferOrErr.getError())
     return errorCodeToError(EC);
   return std::move(BufferOrErr.get());
@@ -71,8 +71,10 @@ InstrProfReader::create(std::unique_ptr<MemoryBuffer> Buffer) {
 
 Expected<std::unique_ptr<IndexedInstrProfReader>>
 IndexedInstrProfReader::create(const Twine &Path) {
-  // Set up the buffer to read.
-  auto BufferOrError = setupMemoryBuffer(Path);
+  // Set up the buffer to read. The indexed format does not need a null
+  // terminator, which lets the file be mapped whatever its size, rather than
+  // read into memory when its size is a multiple of the page size.
+  auto BufferOrError = setupMemoryBuffer(Path, /*RequiresNullTerminator=*/false);
   if (Error E = BufferOrError.takeError())
     return std::move(E);
   return IndexedInstrProfReader::create(std::move(BufferOrError.get()));
@@ -467,16 +469,56 @@ typedef InstrProfLookupTrait::data_type data_type;
 typedef InstrProfLookupTrait::offset_type offset_type;
 
 bool InstrProfLookupTrait::readValueProfilingData(
-    const unsigned char *&D, const unsigned char *const End) {
+    ArrayRef<unsigned char> ValueData, InstrProfRecord &Record) {
   Expected<std::unique_ptr<ValueProfData>> VDataPtrOrErr =
-      ValueProfData::getValueProfData(D, End, ValueProfDataEndianness);
+      ValueProfData::getValueProfData(ValueData.begin(), ValueData.end(),
+                                      ValueProfDataEndianness);
 
   if (VDataPtrOrErr.takeError())
     return false;
 
-  VDataPtrOrErr.get()->deserializeTo(DataBuffer.back(), nullptr);
-  D += VDataPtrOrErr.get()->TotalSize;
+  VDataPtrOrErr.get()->deserializeTo(Record, nullptr);
+  return true;
+}
 
+bool InstrProfLookupTrait::readRecordView(const unsigned char *&D,
+                                          const unsigned char *const End,
+                                          offset_type N,
+                                          InstrProfRecordView &View) {
+  using namespace support;
+  // Read hash.
+  if (D + sizeof(uint64_t) >= End)
+    return false;
+  View.Hash = endian::readNext<uint64_t, little, unaligned>(D);
+
+  // Initialize number of counters for GET_VERSION(FormatVersion) == 1.
+  uint64_t CountsSize = N / sizeof(uint64_t) - 1;
+  // If format version is different then read the number of counters.
+  if (GET_VERSION(FormatVersion) != IndexedInstrProf::ProfVersion::Version1) {
+    if (D + sizeof(uint64_t) > End)
+      return false;
+    CountsSize = endian::readNext<uint64_t, little, unaligned>(D);
+  }
+  // Point at the counter values.
+  if (CountsSize > (uint64_t)(End - D) / sizeof(uint64_t))
+    return false;
+  View.Counts = makeArrayRef(reinterpret_cast<const ulittle64_t *>(D),
+                             CountsSize);
+  D += CountsSize * sizeof(uint64_t);
+
+  // Point at the value profiling data, whose first field is its total size.
+  View.ValueData = ArrayRef<unsigned char>();
+  if (GET_VERSION(FormatVersion) > IndexedInstrProf::ProfVersion::Version2) {
+    if (D + sizeof(uint32_t) > End)
+      return false;
+    uint32_t TotalSize = ValueProfDataEndianness == little
+                             ? endian::read<uint32_t, little, unaligned>(D)
+                             : endian::read<uint32_t, big, unaligned>(D);
+    if (TotalSize > (uint64_t)(End - D))
+      return false;
+    View.ValueData = makeArrayRef(D, TotalSize);
+    D += TotalSize;
+  }
   return true;
 }
 
@@ -487,38 +529,20 @@ data_type InstrProfLookupTrait::ReadData(StringRef K, const unsigned char *D,
     return data_type();
 
   DataBuffer.clear();
-  std::vector<uint64_t> CounterBuffer;
 
-  using namespace support;
   const unsigned char *End = D + N;
   while (D < End) {
-    // Read hash.
-    if (D + sizeof(uint64_t) >= End)
-      return data_type();
-    uint64_t Hash = endian::readNext<uint64_t, little, unaligned>(D);
-
-    // Initialize number of counters for GET_VERSION(FormatVersion) == 1.
-    uint64_t CountsSize = N / sizeof(uint64_t) - 1;
-    // If format version is different then read the number of counters.
-    if (GET_VERSION(FormatVersion) != IndexedInstrProf::ProfVersion::Version1) {
-      if (D + sizeof(uint64_t) > End)
-        return data_type();
-      CountsSize = endian::readNext<uint64_t, little, unaligned>(D);
-    }
-    // Read counter values.
-    if (D + CountsSize * sizeof(uint64_t) > End)
+    InstrProfRecordView View;
+    if (!readRecordView(D, End, N, View))
       return data_type();
 
-    CounterBuffer.clear();
-    CounterBuffer.reserve(CountsSize);
-    for (uint64_t J = 0; J < CountsSize; ++J)
-      CounterBuffer.push_back(endian::readNext<uint64_t, little, unaligned>(D));
-
-    DataBuffer.emplace_back(K, Hash, std::move(CounterBuffer));
+    DataBuffer.emplace_back(
+        K, View.Hash,
+        std::vector<uint64_t>(View.Counts.begin(), View.Counts.end()));
 
     // Read value profiling data.
     if (GET_VERSION(FormatVersion) > IndexedInstrProf::ProfVersion::Version2 &&
-        !readValueProfilingData(D, End)) {
+        !readValueProfilingData(View.ValueData, DataBuffer.back())) {
       DataBuffer.clear();
       return data_type();
     }
@@ -554,6 +578,45 @@ Error InstrProfReaderIndex<HashTableImpl>::getRecords(
   return Error::success();
 }
 
+template <typename HashTableImpl>
+Error InstrProfReaderIndex<HashTableImpl>::getRecordView(
+    StringRef FuncName, uint64_t FuncHash, InstrProfRecordView &View) {
+  auto Iter = HashTable->find(FuncName);
+  if (Iter == HashTable->end())
+    return make_error<InstrProfError>(instrprof_error::unknown_function);
+
+  // Walk the records of the key in place and stop at the one with the right
+  // hash, rather than decoding all of them as dereferencing Iter would.
+  const unsigned char *D = Iter.getDataPtr();
+  offset_type N = Iter.getDataLen();
+  if (N == 0 || N % sizeof(uint64_t))
+    return make_error<InstrProfError>(instrprof_error::malformed);
+
+  const unsigned char *End = D + N;
+  while (D < End) {
+    if (!HashTable->getInfoObj().readRecordView(D, End, N, View))
+      return make_error<InstrProfError>(instrprof_error::malformed);
+    if (View.Hash == FuncHash)
+      return Error::success();
+  }
+  return make_error<InstrProfError>(instrprof_error::hash_mismatch);
+}
+
+template <typename HashTableImpl>
+Error InstrProfReaderIndex<HashTableImpl>::readRecord(
+    StringRef FuncName, const InstrProfRecordView &View,
+    InstrProfRecord &Record) {
+  Record = InstrProfRecord(
+      FuncName, View.Hash,
+      std::vector<uint64_t>(View.Counts.begin(), View.Counts.end()));
+
+  if (GET_VERSION(FormatVersion) > IndexedInstrProf::ProfVersion::Version2 &&
+      !HashTable->getInfoObj().readValueProfilingData(View.ValueData, Record))
+    return make_error<InstrProfError>(instrprof_error::malformed);
+
+  return Error::success();
+}
+
 template <typename HashTableImpl>
 InstrProfReaderIndex<HashTableImpl>::InstrProfReaderIndex(
     const unsigned char *Buckets, const unsigned char *const Payload,
@@ -680,34 +743,49 @@ InstrProfSymtab &IndexedInstrProfReader::getSymtab() {
 Expected<InstrProfRecord>
 IndexedInstrProfReader::getInstrProfRecord(StringRef FuncName,
                                            uint64_t FuncHash) {
-  ArrayRef<InstrProfRecord> Data;
-  Error Err = Index->getRecords(FuncName, Data);
-  if (Err)
-    return std::move(Err);
-  // Found it. Look for counters with the right hash.
-  for (unsigned I = 0, E = Data.size(); I < E; ++I) {
-    // Check for a match and fill the vector if there is one.
-    if (Data[I].Hash == FuncHash) {
-      return std::move(Data[I]);
-    }
+  // Only decode the record with the right hash, not every record of the
+  // function.
+  InstrProfRecordView View;
+  if (Error E = Index->getRecordView(FuncName, FuncHash, View)) {
+    // Only a hash mismatch is recorded in the reader: callers probe for many
+    // functions that the profile doesn't have.
+    instrprof_error Err = InstrProfError::take(std::move(E));
+    if (Err == instrprof_error::hash_mismatch)
+      return error(Err);
+    return make_error<InstrProfError>(Err);
   }
-  return error(instrprof_error::hash_mismatch);
+
+  InstrProfRecord Record;
+  if (Error E = Index->readRecord(FuncName, View, Record))
+    return error(std::move(E));
+  return std::move(Record);
 }
 
 Error IndexedInstrProfReader::getFunctionCounts(StringRef FuncName,
                                                 uint64_t FuncHash,
                                                 std::vector<uint64_t> &Counts) {
-  Expected<InstrProfRecord> Record = getInstrProfRecord(FuncName, FuncHash);
-  if (Error E = Record.takeError())
+  ArrayRef<support::ulittle64_t> CounterView;
+  if (Error E = getFunctionCounterView(FuncName, FuncHash, CounterView))
     return error(std::move(E));
 
-  Counts = Record.get().Counts;
+  Counts.assign(CounterView.begin(), CounterView.end());
   return success();
 }
 
-Error IndexedInstrProfReader::readNextRecord(InstrProfRecord &Record) {
-  static unsigned RecordIndex = 0;
+Error IndexedInstrProfReader::getFunctionCounterView(
+    StringRef FuncName, uint64_t FuncHash,
+    ArrayRef<support::ulittle64_t> &Counts) {
+  // Don't record the error in the reader, so that concurrent lookups don't
+  // write to it.
+  InstrProfRecordView View;
+  if (Error E = Index->getRecordView(FuncName, FuncHash, View))
+    return E;
 
+  Counts = View.Counts;
+  return Error::success();
+}
+
+Error IndexedInstrProfReader::readNextRecord(InstrProfRecord &Record) {
   ArrayRef<InstrProfRecord> Data;
 
   Error E = Index->getRecords(Data);
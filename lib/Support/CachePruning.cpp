@@ -13,19 +13,54 @@
 
 #include "llvm/Support/CachePruning.h"
 
+#include "llvm/ADT/ArrayRef.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/Chrono.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/Errc.h"
 #include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
 #include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/raw_ostream.h"
 
 #define DEBUG_TYPE "cache-pruning"
 
-#include <set>
+#include <algorithm>
 #include <system_error>
+#include <vector>
 
 using namespace llvm;
 
+/// The name of the access index of a cache directory. Each line of the index
+/// records an access to an entry as "<time> <size> <name>", the time being in
+/// seconds since the epoch. Later records of an entry supersede earlier ones.
+static const char IndexName[] = "llvmcache.index";
+
+/// The first line of a rewritten index is "# llvmcache index <size>", the size
+/// being that of the records that follow it. An index without it was started
+/// by recordAccess().
+static const char IndexHeader[] = "# llvmcache index";
+
+/// recordAccess() compacts an index that has grown past this size and to more
+/// than twice the size it had when it was last rewritten.
+static const uint64_t MinIndexSizeToCompact = 1 << 20;
+
+/// The prefix of temporary files in a cache directory: entries being written,
+/// and the index being rewritten. They are not entries themselves, and are
+/// only removed once they expire, after the process writing them crashed.
+static const char TempPrefix[] = "llvmcache-tmp-";
+
+namespace {
+/// What the pruner knows about an entry of the cache.
+struct CacheEntry {
+  uint64_t Size = 0;
+  /// The time of the last access, in seconds since the epoch.
+  uint64_t Time = 0;
+};
+} // end anonymous namespace
+
 /// Write a new timestamp file with the given path. This is used for the pruning
 /// interval option.
 static void writeTimestampFile(StringRef TimestampFile) {
@@ -33,6 +68,221 @@ static void writeTimestampFile(StringRef TimestampFile) {
   raw_fd_ostream Out(TimestampFile.str(), EC, sys::fs::F_None);
 }
 
+/// Call \p AddRecord for each record of the index \p Contents. A last record
+/// that is cut short, by a process that crashed while writing it, is ignored.
+static void
+parseIndex(StringRef Contents,
+           function_ref<void(StringRef, uint64_t, uint64_t)> AddRecord) {
+  while (true) {
+    size_t End = Contents.find('\n');
+    if (End == StringRef::npos)
+      return;
+    StringRef Line = Contents.take_front(End);
+    Contents = Contents.drop_front(End + 1);
+
+    StringRef Time, Size, Name;
+    std::tie(Time, Line) = Line.split(' ');
+    std::tie(Size, Name) = Line.split(' ');
+    uint64_t TimeValue, SizeValue;
+    if (Time.getAsInteger(10, TimeValue) || Size.getAsInteger(10, SizeValue) ||
+        Name.empty() || Name.find_first_of(" /\\") != StringRef::npos)
+      continue;
+    AddRecord(Name, SizeValue, TimeValue);
+  }
+}
+
+/// Return the size of the records of the index \p IndexPath when it was last
+/// rewritten, or 0 if it never was.
+static uint64_t getRewrittenIndexSize(StringRef IndexPath) {
+  int FD;
+  if (sys::fs::openFileForRead(IndexPath, FD))
+    return 0;
+  auto HeaderOrErr = MemoryBuffer::getOpenFileSlice(FD, IndexPath, 64, 0);
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (!HeaderOrErr)
+    return 0;
+  StringRef Header = (*HeaderOrErr)->getBuffer();
+  if (!Header.consume_front(IndexHeader) || !Header.consume_front(" "))
+    return 0;
+  uint64_t Size;
+  if (Header.take_until([](char C) { return C == '\n'; })
+          .getAsInteger(10, Size))
+    return 0;
+  return Size;
+}
+
+void CachePruning::recordAccess(StringRef Path, StringRef EntryName,
+                                uint64_t Size) {
+  SmallString<128> IndexPath(Path);
+  sys::path::append(IndexPath, IndexName);
+  std::string Record =
+      (Twine(sys::toTimeT(std::chrono::system_clock::now())) + " " +
+       Twine(Size) + " " + EntryName + "\n")
+          .str();
+
+  // A record is appended with a single write, which other processes appending
+  // to the index can't interleave with. The pruner replaces the index with a
+  // rewritten one, and then copies over what was appended to the old one in
+  // the meantime; a record appended to the old index after that is appended
+  // again to the new one.
+  for (int Attempt = 0; Attempt != 2; ++Attempt) {
+    sys::fs::file_status Written, Current;
+    {
+      int FD;
+      if (sys::fs::openFileForWrite(IndexPath, FD, sys::fs::F_Append))
+        return;
+      raw_fd_ostream OS(FD, /*shouldClose=*/true, /*unbuffered=*/true);
+      OS << Record;
+      if (OS.has_error()) {
+        OS.clear_error();
+        return;
+      }
+      if (sys::fs::status(FD, Written))
+        return;
+    }
+    if (sys::fs::status(IndexPath, Current))
+      return;
+    if (!sys::fs::equivalent(Written, Current))
+      continue;
+
+    // Caches that are never pruned would otherwise grow their index forever.
+    if (Written.getSize() >= MinIndexSizeToCompact &&
+        Written.getSize() > 2 * getRewrittenIndexSize(IndexPath))
+      compactIndex(Path);
+    return;
+  }
+}
+
+/// Replace the index \p IndexPath, open as \p IndexFD and of which the first
+/// \p IndexSize bytes were read, with one listing \p Entries.
+static void
+rewriteIndex(StringRef Path, StringRef IndexPath, int IndexFD,
+             uint64_t IndexSize,
+             ArrayRef<const StringMapEntry<CacheEntry> *> Entries) {
+  std::string Records;
+  raw_string_ostream RecordsOS(Records);
+  for (const StringMapEntry<CacheEntry> *E : Entries)
+    RecordsOS << E->second.Time << ' ' << E->second.Size << ' ' << E->first()
+              << '\n';
+  RecordsOS.flush();
+
+  SmallString<128> TempModel(Path), TempPath;
+  sys::path::append(TempModel, Twine(TempPrefix) + "index-%%%%%%%%");
+  int TempFD;
+  if (sys::fs::createUniqueFile(TempModel, TempFD, TempPath))
+    return;
+  {
+    raw_fd_ostream OS(TempFD, /*shouldClose=*/true);
+    OS << IndexHeader << ' ' << Records.size() << '\n' << Records;
+    OS.close();
+    if (OS.has_error()) {
+      OS.clear_error();
+      sys::fs::remove(TempPath);
+      return;
+    }
+  }
+  if (sys::fs::rename(TempPath, IndexPath)) {
+    sys::fs::remove(TempPath);
+    return;
+  }
+
+  // Carry over the complete records appended to the old index since it was
+  // read.
+  sys::fs::file_status Status;
+  if (sys::fs::status(IndexFD, Status) || Status.getSize() <= IndexSize)
+    return;
+  auto TailOrErr = MemoryBuffer::getOpenFileSlice(
+      IndexFD, IndexPath, Status.getSize() - IndexSize, IndexSize);
+  if (!TailOrErr)
+    return;
+  StringRef Tail = (*TailOrErr)->getBuffer();
+  Tail = Tail.take_front(Tail.rfind('\n') + 1);
+  if (Tail.empty())
+    return;
+  int FD;
+  if (sys::fs::openFileForWrite(IndexPath, FD, sys::fs::F_Append))
+    return;
+  raw_fd_ostream OS(FD, /*shouldClose=*/true, /*unbuffered=*/true);
+  OS << Tail;
+  if (OS.has_error())
+    OS.clear_error();
+}
+
+/// Collect the entries of the cache directory \p Path into \p Entries. Their
+/// size and last access time come from the access index \p Index if it lists
+/// them, and from the file system otherwise; records of entries that are no
+/// longer in the directory are dropped. Temporary files for which
+/// \p IsExpired returns true are removed.
+static void collectEntries(StringRef Path, StringRef Index,
+                           StringMap<CacheEntry> &Entries,
+                           function_ref<bool(uint64_t)> IsExpired) {
+  StringMap<CacheEntry> Indexed;
+  parseIndex(Index, [&](StringRef Name, uint64_t Size, uint64_t Time) {
+    CacheEntry &Entry = Indexed[Name];
+    Entry.Size = Size;
+    Entry.Time = std::max(Entry.Time, Time);
+  });
+
+  std::error_code EC;
+  SmallString<128> CachePathNative;
+  sys::path::native(Path, CachePathNative);
+  for (sys::fs::directory_iterator File(CachePathNative, EC), FileEnd;
+       File != FileEnd && !EC; File.increment(EC)) {
+    // Do not touch the timestamp or the index.
+    StringRef Name = sys::path::filename(File->path());
+    if (Name == "llvmcache.timestamp" || Name == IndexName)
+      continue;
+
+    // The index has the most recent access time of entries that it lists.
+    if (!Name.startswith(TempPrefix)) {
+      auto I = Indexed.find(Name);
+      if (I != Indexed.end()) {
+        Entries[Name] = I->second;
+        continue;
+      }
+    }
+
+    // Look at this file. If we can't stat it, there's nothing interesting
+    // there.
+    sys::fs::file_status FileStatus;
+    if (sys::fs::status(File->path(), FileStatus)) {
+      DEBUG(dbgs() << "Ignore " << File->path() << " (can't stat)\n");
+      continue;
+    }
+
+    uint64_t Time = sys::toTimeT(FileStatus.getLastAccessedTime());
+    if (Name.startswith(TempPrefix)) {
+      if (IsExpired(Time))
+        sys::fs::remove(File->path());
+      continue;
+    }
+    CacheEntry &Entry = Entries[Name];
+    Entry.Size = FileStatus.getSize();
+    Entry.Time = Time;
+  }
+}
+
+void CachePruning::compactIndex(StringRef Path) {
+  SmallString<128> IndexPath(Path);
+  sys::path::append(IndexPath, IndexName);
+  int IndexFD;
+  if (sys::fs::openFileForRead(IndexPath, IndexFD))
+    return;
+  auto IndexOrErr = MemoryBuffer::getOpenFile(
+      IndexFD, IndexPath, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+  if (IndexOrErr) {
+    StringMap<CacheEntry> Entries;
+    collectEntries(Path, (*IndexOrErr)->getBuffer(), Entries,
+                   [](uint64_t) { return false; });
+    std::vector<const StringMapEntry<CacheEntry> *> List;
+    for (const StringMapEntry<CacheEntry> &Entry : Entries)
+      List.push_back(&Entry);
+    rewriteIndex(Path, IndexPath, IndexFD, (*IndexOrErr)->getBufferSize(),
+                 List);
+  }
+  sys::Process::SafelyCloseFileDescriptor(IndexFD);
+}
+
 /// Prune the cache of files that haven't been accessed in a long time.
 bool CachePruning::prune() {
   using namespace std::chrono;
@@ -47,7 +297,8 @@ bool CachePruning::prune() {
   if (!isPathDir)
     return false;
 
-  if (Expiration == seconds(0) && PercentageOfAvailableSpace == 0) {
+  if (Expiration == seconds(0) && PercentageOfAvailableSpace == 0 &&
+      MaxSizeBytes == 0) {
     DEBUG(dbgs() << "No pruning settings set, exit early\n");
     // Nothing will be pruned, early exit
     return false;
@@ -67,7 +318,7 @@ bool CachePruning::prune() {
       return false;
     }
   } else {
-    if (Interval == seconds(0)) {
+    if (Interval != seconds(0)) {
       // Check whether the time stamp is older than our pruning interval.
       // If not, do nothing.
       const auto TimeStampModTime = FileStatus.getLastModificationTime();
@@ -85,77 +336,95 @@ bool CachePruning::prune() {
     writeTimestampFile(TimestampFile);
   }
 
-  bool ShouldComputeSize = (PercentageOfAvailableSpace > 0);
-
-  // Keep track of space
-  std::set<std::pair<uint64_t, std::string>> FileSizes;
-  uint64_t TotalSize = 0;
-  // Helper to add a path to the set of files to consider for size-based
-  // pruning, sorted by size.
-  auto AddToFileListForSizePruning =
-      [&](StringRef Path) {
-        if (!ShouldComputeSize)
-          return;
-        TotalSize += FileStatus.getSize();
-        FileSizes.insert(
-            std::make_pair(FileStatus.getSize(), std::string(Path)));
-      };
-
-  // Walk the entire directory cache, looking for unused files.
-  std::error_code EC;
-  SmallString<128> CachePathNative;
-  sys::path::native(Path, CachePathNative);
-  // Walk all of the files within this directory.
-  for (sys::fs::directory_iterator File(CachePathNative, EC), FileEnd;
-       File != FileEnd && !EC; File.increment(EC)) {
-    // Do not touch the timestamp.
-    if (File->path() == TimestampFile)
-      continue;
+  const uint64_t Now = sys::toTimeT(CurrentTime);
+  auto IsExpired = [&](uint64_t Time) {
+    return Expiration != seconds(0) && Now > Time &&
+           Now - Time > uint64_t(Expiration.count());
+  };
+  auto Remove = [&](StringRef Name) {
+    SmallString<128> EntryPath(Path);
+    sys::path::append(EntryPath, Name);
+    sys::fs::remove(EntryPath);
+  };
 
-    // Look at this file. If we can't stat it, there's nothing interesting
-    // there.
-    if (sys::fs::status(File->path(), FileStatus)) {
-      DEBUG(dbgs() << "Ignore " << File->path() << " (can't stat)\n");
-      continue;
-    }
+  // Read the access index, if the cache keeps one. It is kept open, so that
+  // records appended while pruning can be carried over to the new index.
+  SmallString<128> IndexPath(Path);
+  sys::path::append(IndexPath, IndexName);
+  int IndexFD;
+  bool HasIndex = !sys::fs::openFileForRead(IndexPath, IndexFD);
+  std::unique_ptr<MemoryBuffer> Index;
+  if (HasIndex) {
+    auto IndexOrErr = MemoryBuffer::getOpenFile(
+        IndexFD, IndexPath, /*FileSize=*/-1, /*RequiresNullTerminator=*/false);
+    if (IndexOrErr)
+      Index = std::move(*IndexOrErr);
+  }
+
+  // Reconcile the index with the directory: entries that were added without
+  // being recorded, or before the cache kept an index, are still pruned.
+  StringMap<CacheEntry> Entries;
+  collectEntries(Path, Index ? Index->getBuffer() : "", Entries, IsExpired);
 
-    // If the file hasn't been used recently enough, delete it
-    const auto FileAccessTime = FileStatus.getLastAccessedTime();
-    auto FileAge = CurrentTime - FileAccessTime;
-    if (FileAge > Expiration) {
-      DEBUG(dbgs() << "Remove " << File->path() << " ("
-                   << duration_cast<seconds>(FileAge).count() << "s old)\n");
-      sys::fs::remove(File->path());
+  // If the file hasn't been used recently enough, delete it.
+  std::vector<const StringMapEntry<CacheEntry> *> Survivors;
+  for (const StringMapEntry<CacheEntry> &Entry : Entries) {
+    if (IsExpired(Entry.second.Time)) {
+      DEBUG(dbgs() << "Remove " << Entry.first() << " ("
+                   << Now - Entry.second.Time << "s old)\n");
+      Remove(Entry.first());
       continue;
     }
-
-    // Leave it here for now, but add it to the list of size-based pruning.
-    AddToFileListForSizePruning(File->path());
+    Survivors.push_back(&Entry);
   }
 
   // Prune for size now if needed
-  if (ShouldComputeSize) {
-    auto ErrOrSpaceInfo = sys::fs::disk_space(Path);
-    if (!ErrOrSpaceInfo) {
-      report_fatal_error("Can't get available size");
+  if (PercentageOfAvailableSpace > 0 || MaxSizeBytes > 0) {
+    uint64_t TotalSize = 0;
+    for (const StringMapEntry<CacheEntry> *Entry : Survivors)
+      TotalSize += Entry->second.Size;
+    uint64_t AvailableSpace = 0;
+    if (PercentageOfAvailableSpace > 0) {
+      auto ErrOrSpaceInfo = sys::fs::disk_space(Path);
+      if (!ErrOrSpaceInfo) {
+        report_fatal_error("Can't get available size");
+      }
+      sys::fs::space_info SpaceInfo = ErrOrSpaceInfo.get();
+      AvailableSpace = TotalSize + SpaceInfo.free;
+      DEBUG(dbgs() << "Occupancy: " << ((100 * TotalSize) / AvailableSpace)
+                   << "% target is: " << PercentageOfAvailableSpace << "\n");
     }
-    sys::fs::space_info SpaceInfo = ErrOrSpaceInfo.get();
-    auto AvailableSpace = TotalSize + SpaceInfo.free;
-    auto FileAndSize = FileSizes.rbegin();
-    DEBUG(dbgs() << "Occupancy: " << ((100 * TotalSize) / AvailableSpace)
-                 << "% target is: " << PercentageOfAvailableSpace << "\n");
-    // Remove the oldest accessed files first, till we get below the threshold
-    while (((100 * TotalSize) / AvailableSpace) > PercentageOfAvailableSpace &&
-           FileAndSize != FileSizes.rend()) {
-      // Remove the file.
-      sys::fs::remove(FileAndSize->second);
+    auto IsOverLimit = [&]() {
+      if (PercentageOfAvailableSpace > 0 &&
+          ((100 * TotalSize) / AvailableSpace) > PercentageOfAvailableSpace)
+        return true;
+      return MaxSizeBytes > 0 && TotalSize > MaxSizeBytes;
+    };
+    // Remove the least recently used files first, till we get below the
+    // threshold. Ties are broken by name to keep this deterministic.
+    std::sort(Survivors.begin(), Survivors.end(),
+              [](const StringMapEntry<CacheEntry> *L,
+                 const StringMapEntry<CacheEntry> *R) {
+                return std::make_pair(L->second.Time, L->first()) <
+                       std::make_pair(R->second.Time, R->first());
+              });
+    auto Entry = Survivors.begin();
+    while (IsOverLimit() && Entry != Survivors.end()) {
+      Remove((*Entry)->first());
       // Update size
-      TotalSize -= FileAndSize->first;
-      DEBUG(dbgs() << " - Remove " << FileAndSize->second << " (size "
-                   << FileAndSize->first << "), new occupancy is " << TotalSize
-                   << "%\n");
-      ++FileAndSize;
+      TotalSize -= (*Entry)->second.Size;
+      DEBUG(dbgs() << " - Remove " << (*Entry)->first() << " (size "
+                   << (*Entry)->second.Size << "), new cache size is "
+                   << TotalSize << " bytes\n");
+      ++Entry;
     }
+    Survivors.erase(Survivors.begin(), Entry);
+  }
+
+  if (HasIndex) {
+    rewriteIndex(Path, IndexPath, IndexFD,
+                 Index ? Index->getBufferSize() : 0, Survivors);
+    sys::Process::SafelyCloseFileDescriptor(IndexFD);
   }
   return true;
 }
@@ -0,0 +1,25 @@
+//===- GenericDomTree.cpp - Generic dominator tree options ----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file defines the options shared by all the instantiations of the
+// generic dominator tree construction.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/GenericDomTree.h"
+#include "llvm/Support/CommandLine.h"
+
+using namespace llvm;
+
+static cl::opt<bool> UseSemiNCA(
+    "dom-tree-semi-nca", cl::init(false), cl::Hidden,
+    cl::desc("Build dominator trees with the Semi-NCA algorithm instead of "
+             "Lengauer-Tarjan"));
+
+bool llvm::DomTreeBuilder::useSemiNCA() { return UseSemiNCA; }
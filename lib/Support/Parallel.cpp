@@ -0,0 +1,32 @@
+//===- llvm/Support/Parallel.cpp - Parallel algorithms --------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/Parallel.h"
+#include "llvm/Support/ManagedStatic.h"
+
+using namespace llvm;
+
+static ManagedStatic<ThreadPool> DefaultPool;
+
+ThreadPool &parallel::getDefaultPool() { return *DefaultPool; }
+
+bool parallel::isEnabled() {
+#if LLVM_ENABLE_THREADS
+  return getDefaultPool().getThreadCount() > 1;
+#else
+  return false;
+#endif
+}
+
+parallel::TaskGroup::TaskGroup() {
+  if (isEnabled())
+    Group.reset(new ThreadPoolTaskGroup(getDefaultPool()));
+}
+
+parallel::TaskGroup::~TaskGroup() { sync(); }
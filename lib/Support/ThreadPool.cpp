@@ -7,95 +7,185 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This file implements a crude C++11 based thread pool.
+// This file implements a C++11 based work-stealing thread pool.
 //
 //===----------------------------------------------------------------------===//
 
 #include "llvm/Support/ThreadPool.h"
 
 #include "llvm/Config/llvm-config.h"
+#include "llvm/Support/Compiler.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
 
+void ThreadPool::runTask(QueuedTask &Task) {
+#ifndef _MSC_VER
+  Task.Task();
+#else
+  Task.Task(/* unused */ false);
+#endif
+  taskCompleted(Task.Group);
+}
+
+void ThreadPool::taskCompleted(ThreadPoolTaskGroup *Group) {
+  if (Group) {
+    // The group may be destroyed as soon as a waiter observes the counter
+    // reaching zero, so decrement and notify while holding its lock: waiters
+    // acquire it before returning.
+    std::unique_lock<std::mutex> LockGuard(Group->Lock);
+    if (--Group->Outstanding == 0)
+      Group->Condition.notify_all();
+  }
+  if (--OutstandingTasks == 0) {
+    // Synchronize with ThreadPool::wait() before notifying, so that the
+    // notification can't slip in between its check and its sleep.
+    { std::unique_lock<std::mutex> LockGuard(CompletionLock); }
+    CompletionCondition.notify_all();
+  }
+}
+
 #if LLVM_ENABLE_THREADS
 
+// The pool and worker index of the current thread, if it is a worker.
+static LLVM_THREAD_LOCAL ThreadPool *CurrentPool = nullptr;
+static LLVM_THREAD_LOCAL unsigned CurrentWorker = 0;
+
 // Default to std::thread::hardware_concurrency
 ThreadPool::ThreadPool() : ThreadPool(std::thread::hardware_concurrency()) {}
 
 ThreadPool::ThreadPool(unsigned ThreadCount)
-    : ActiveThreads(0), EnableFlag(true) {
+    : PendingTasks(0), IdleWorkers(0), NextQueue(0), EnableFlag(true),
+      OutstandingTasks(0) {
+  // Create the deques before starting any thread, as workers steal from each
+  // other as soon as they run.
+  Queues.reserve(ThreadCount);
+  for (unsigned ThreadID = 0; ThreadID < ThreadCount; ++ThreadID)
+    Queues.emplace_back(new WorkerQueue());
   // Create ThreadCount threads that will loop forever, wait on QueueCondition
   // for tasks to be queued or the Pool to be destroyed.
   Threads.reserve(ThreadCount);
-  for (unsigned ThreadID = 0; ThreadID < ThreadCount; ++ThreadID) {
-    Threads.emplace_back([&] {
-      while (true) {
-        PackagedTaskTy Task;
-        {
-          std::unique_lock<std::mutex> LockGuard(QueueLock);
-          // Wait for tasks to be pushed in the queue
-          QueueCondition.wait(LockGuard,
-                              [&] { return !EnableFlag || !Tasks.empty(); });
-          // Exit condition
-          if (!EnableFlag && Tasks.empty())
-            return;
-          // Yeah, we have a task, grab it and release the lock on the queue
-
-          // We first need to signal that we are active before popping the queue
-          // in order for wait() to properly detect that even if the queue is
-          // empty, there is still a task in flight.
-          {
-            ++ActiveThreads;
-            std::unique_lock<std::mutex> LockGuard(CompletionLock);
-          }
-          Task = std::move(Tasks.front());
-          Tasks.pop();
-        }
-        // Run the task we just grabbed
-#ifndef _MSC_VER
-        Task();
-#else
-        Task(/* unused */ false);
-#endif
+  for (unsigned ThreadID = 0; ThreadID < ThreadCount; ++ThreadID)
+    Threads.emplace_back([this, ThreadID] { runWorker(ThreadID); });
+}
 
-        {
-          // Adjust `ActiveThreads`, in case someone waits on ThreadPool::wait()
-          std::unique_lock<std::mutex> LockGuard(CompletionLock);
-          --ActiveThreads;
-        }
+void ThreadPool::runWorker(unsigned Index) {
+  CurrentPool = this;
+  CurrentWorker = Index;
+  while (true) {
+    QueuedTask Task;
+    if (popTask(Index, Task)) {
+      runTask(Task);
+      continue;
+    }
+
+    std::unique_lock<std::mutex> LockGuard(QueueLock);
+    // Announce that we are going to sleep before checking for tasks, so that
+    // a concurrent asyncImpl() either sees us idle and notifies, or we see
+    // its task.
+    ++IdleWorkers;
+    QueueCondition.wait(LockGuard,
+                        [&] { return !EnableFlag || PendingTasks > 0; });
+    --IdleWorkers;
+    // Exit condition
+    if (!EnableFlag && PendingTasks <= 0)
+      return;
+  }
+}
+
+bool ThreadPool::popTask(unsigned Index, QueuedTask &Task) {
+  if (PendingTasks <= 0)
+    return false;
+
+  // Our own deque first, newest task first for locality.
+  {
+    WorkerQueue &Queue = *Queues[Index];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    if (!Queue.Tasks.empty()) {
+      Task = std::move(Queue.Tasks.back());
+      Queue.Tasks.pop_back();
+      --PendingTasks;
+      return true;
+    }
+  }
 
-        // Notify task completion, in case someone waits on ThreadPool::wait()
-        CompletionCondition.notify_all();
-      }
-    });
+  // Then steal the oldest task of another worker.
+  unsigned NumQueues = Queues.size();
+  for (unsigned I = 1; I < NumQueues; ++I) {
+    WorkerQueue &Queue = *Queues[(Index + I) % NumQueues];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    if (Queue.Tasks.empty())
+      continue;
+    Task = std::move(Queue.Tasks.front());
+    Queue.Tasks.pop_front();
+    --PendingTasks;
+    return true;
   }
+  return false;
 }
 
 void ThreadPool::wait() {
-  // Wait for all threads to complete and the queue to be empty
+  assert(!isWorkerThread() &&
+         "ThreadPool::wait() called from a task, use a ThreadPoolTaskGroup");
+  // Wait for all tasks to complete and the queues to be empty
   std::unique_lock<std::mutex> LockGuard(CompletionLock);
-  // The order of the checks for ActiveThreads and Tasks.empty() matters because
-  // any active threads might be modifying the Tasks queue, and this would be a
-  // race.
-  CompletionCondition.wait(LockGuard,
-                           [&] { return !ActiveThreads && Tasks.empty(); });
+  CompletionCondition.wait(LockGuard, [&] { return !OutstandingTasks; });
 }
 
-std::shared_future<ThreadPool::VoidTy> ThreadPool::asyncImpl(TaskTy Task) {
+void ThreadPool::wait(ThreadPoolTaskGroup &Group) {
+  assert(&Group.Pool == this && "Waiting on a group of another pool");
+  if (isWorkerThread()) {
+    // Help with the pending tasks rather than blocking a worker, otherwise
+    // tasks waiting on their subtasks could occupy every thread of the pool.
+    QueuedTask Task;
+    while (Group.Outstanding && popTask(CurrentWorker, Task))
+      runTask(Task);
+  }
+  // The remaining tasks of the group, if any, are running on other threads.
+  std::unique_lock<std::mutex> LockGuard(Group.Lock);
+  Group.Condition.wait(LockGuard, [&] { return !Group.Outstanding; });
+}
+
+unsigned ThreadPool::getThreadCount() const { return Threads.size(); }
+
+bool ThreadPool::isWorkerThread() const { return CurrentPool == this; }
+
+std::shared_future<ThreadPool::VoidTy>
+ThreadPool::asyncImpl(TaskTy Task, ThreadPoolTaskGroup *Group) {
+  // Don't allow enqueueing after disabling the pool
+  assert(EnableFlag && "Queuing a thread during ThreadPool destruction");
+
   /// Wrap the Task in a packaged_task to return a future object.
-  PackagedTaskTy PackagedTask(std::move(Task));
-  auto Future = PackagedTask.get_future();
-  {
-    // Lock the queue and push the new task
-    std::unique_lock<std::mutex> LockGuard(QueueLock);
+  QueuedTask Queued;
+  Queued.Task = PackagedTaskTy(std::move(Task));
+  Queued.Group = Group;
+  auto Future = Queued.Task.get_future();
+
+  ++OutstandingTasks;
+  if (Group)
+    ++Group->Outstanding;
+
+  if (Queues.empty()) {
+    // A pool without worker threads runs its tasks synchronously.
+    runTask(Queued);
+    return Future.share();
+  }
 
-    // Don't allow enqueueing after disabling the pool
-    assert(EnableFlag && "Queuing a thread during ThreadPool destruction");
+  // Tasks forked by a worker stay on its deque, others are spread evenly.
+  unsigned Index = isWorkerThread() ? CurrentWorker
+                                    : NextQueue++ % Queues.size();
+  {
+    WorkerQueue &Queue = *Queues[Index];
+    std::unique_lock<std::mutex> LockGuard(Queue.Lock);
+    Queue.Tasks.push_back(std::move(Queued));
+  }
+  ++PendingTasks;
 
-    Tasks.push(std::move(PackagedTask));
+  // Only go through the shared lock if some worker may be sleeping.
+  if (IdleWorkers) {
+    { std::unique_lock<std::mutex> LockGuard(QueueLock); }
+    QueueCondition.notify_one();
   }
-  QueueCondition.notify_one();
   return Future.share();
 }
 
@@ -116,7 +206,7 @@ ThreadPool::ThreadPool() : ThreadPool(0) {}
 
 // No threads are launched, issue a warning if ThreadCount is not 0
 ThreadPool::ThreadPool(unsigned ThreadCount)
-    : ActiveThreads(0) {
+    : OutstandingTasks(0) {
   if (ThreadCount) {
     errs() << "Warning: request a ThreadPool with " << ThreadCount
            << " threads, but LLVM_ENABLE_THREADS has been turned off\n";
@@ -127,16 +217,28 @@ void ThreadPool::wait() {
   // Sequential implementation running the tasks
   while (!Tasks.empty()) {
     auto Task = std::move(Tasks.front());
-    Tasks.pop();
-#ifndef _MSC_VER
-        Task();
-#else
-        Task(/* unused */ false);
-#endif
+    Tasks.pop_front();
+    runTask(Task);
   }
 }
 
-std::shared_future<ThreadPool::VoidTy> ThreadPool::asyncImpl(TaskTy Task) {
+void ThreadPool::wait(ThreadPoolTaskGroup &Group) {
+  // Tasks are run in submission order, which runs every task of the group
+  // once the last one has been reached.
+  while (Group.Outstanding) {
+    assert(!Tasks.empty() && "Group has tasks that were never queued");
+    auto Task = std::move(Tasks.front());
+    Tasks.pop_front();
+    runTask(Task);
+  }
+}
+
+unsigned ThreadPool::getThreadCount() const { return 0; }
+
+bool ThreadPool::isWorkerThread() const { return false; }
+
+std::shared_future<ThreadPool::VoidTy>
+ThreadPool::asyncImpl(TaskTy Task, ThreadPoolTaskGroup *Group) {
 #ifndef _MSC_VER
   // Get a Future with launch::deferred execution using std::async
   auto Future = std::async(std::launch::deferred, std::move(Task)).share();
@@ -147,7 +249,13 @@ std::shared_future<ThreadPool::VoidTy> ThreadPool::asyncImpl(TaskTy Task) {
   auto Future = std::async(std::launch::deferred, std::move(Task), false).share();
   PackagedTaskTy PackagedTask([Future](bool) -> bool { Future.get(); return false; });
 #endif
-  Tasks.push(std::move(PackagedTask));
+  QueuedTask Queued;
+  Queued.Task = std::move(PackagedTask);
+  Queued.Group = Group;
+  ++OutstandingTasks;
+  if (Group)
+    ++Group->Outstanding;
+  Tasks.push_back(std::move(Queued));
   return Future;
 }
 
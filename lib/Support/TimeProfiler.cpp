@@ -0,0 +1,267 @@
+//===-- TimeProfiler.cpp - Hierarchical Time Profiler ---------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// This file implements the hierarchical time profiler.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/ADT/StringMap.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <vector>
+
+using namespace llvm;
+using namespace std::chrono;
+
+static cl::opt<bool> TimeTrace(
+    "time-trace",
+    cl::desc("Record a hierarchical time trace in Chrome trace_event format"));
+
+static cl::opt<unsigned> TimeTraceGranularity(
+    "time-trace-granularity",
+    cl::desc(
+        "Minimum time granularity (in microseconds) traced by time profiler"),
+    cl::init(500));
+
+static cl::opt<std::string>
+    TimeTraceFile("time-trace-file",
+                  cl::desc("Specify time trace file destination"),
+                  cl::value_desc("filename"));
+
+namespace llvm {
+
+LLVM_THREAD_LOCAL TimeTraceProfiler *TimeTraceProfilerInstance = nullptr;
+
+typedef duration<steady_clock::rep, steady_clock::period> DurationType;
+typedef std::pair<size_t, DurationType> CountAndDurationType;
+
+/// A region of time being profiled, or already profiled.
+struct TimeTraceEntry {
+  steady_clock::time_point Start;
+  DurationType Duration;
+  std::string Name;
+  std::string Detail;
+
+  TimeTraceEntry(steady_clock::time_point Start, std::string Name,
+                 std::string Detail)
+      : Start(Start), Duration(0), Name(std::move(Name)),
+        Detail(std::move(Detail)) {}
+};
+
+struct TimeTraceProfiler {
+  TimeTraceProfiler(unsigned TimeTraceGranularity, StringRef ProcName)
+      : StartTime(steady_clock::now()), ProcName(ProcName),
+        TimeTraceGranularity(TimeTraceGranularity) {}
+
+  void begin(std::string Name, function_ref<std::string()> Detail) {
+    Stack.emplace_back(steady_clock::now(), std::move(Name), Detail());
+  }
+
+  void end() {
+    assert(!Stack.empty() && "Must call begin() first");
+    TimeTraceEntry &E = Stack.back();
+    E.Duration = steady_clock::now() - E.Start;
+
+    // Only include sections at least as long as the granularity.
+    if (duration_cast<microseconds>(E.Duration).count() >=
+        TimeTraceGranularity)
+      Entries.push_back(E);
+
+    // Track total time taken by each name, but only the outermost instance of
+    // it: recursive sections would otherwise be counted several times.
+    if (std::find_if(++Stack.rbegin(), Stack.rend(),
+                     [&](const TimeTraceEntry &Val) {
+                       return Val.Name == E.Name;
+                     }) == Stack.rend()) {
+      CountAndDurationType &Total = CountAndTotalPerName[E.Name];
+      Total.first++;
+      Total.second += E.Duration;
+    }
+
+    Stack.pop_back();
+  }
+
+  void write(raw_ostream &OS);
+
+  std::vector<TimeTraceEntry> Stack;
+  std::vector<TimeTraceEntry> Entries;
+  StringMap<CountAndDurationType> CountAndTotalPerName;
+  const steady_clock::time_point StartTime;
+  const std::string ProcName;
+
+  /// Minimum duration, in microseconds, of the recorded events.
+  const unsigned TimeTraceGranularity;
+};
+
+} // end namespace llvm
+
+/// Write \p Str as a JSON string literal.
+static void writeJSONString(raw_ostream &OS, StringRef Str) {
+  OS << '"';
+  for (unsigned char C : Str) {
+    switch (C) {
+    case '"':
+      OS << "\\\"";
+      break;
+    case '\\':
+      OS << "\\\\";
+      break;
+    case '\n':
+      OS << "\\n";
+      break;
+    case '\t':
+      OS << "\\t";
+      break;
+    default:
+      if (C < 0x20)
+        OS << format("\\u%04x", C);
+      else
+        OS << C;
+      break;
+    }
+  }
+  OS << '"';
+}
+
+/// Write a complete ("X") event starting at \p StartUs and lasting \p DurUs
+/// microseconds.
+static void writeCompleteEvent(raw_ostream &OS, int Tid, int64_t StartUs,
+                               int64_t DurUs, StringRef Name,
+                               StringRef Detail) {
+  OS << "{\"pid\":1,\"tid\":" << Tid << ",\"ph\":\"X\",\"ts\":" << StartUs
+     << ",\"dur\":" << DurUs << ",\"name\":";
+  writeJSONString(OS, Name);
+  if (!Detail.empty()) {
+    OS << ",\"args\":{\"detail\":";
+    writeJSONString(OS, Detail);
+    OS << '}';
+  }
+  OS << "},\n";
+}
+
+void TimeTraceProfiler::write(raw_ostream &OS) {
+  assert(Stack.empty() &&
+         "All profiler sections should be ended when calling write");
+
+  OS << "{\"traceEvents\":[\n";
+
+  // Emit all events for the main flame graph.
+  for (const TimeTraceEntry &E : Entries) {
+    int64_t StartUs = duration_cast<microseconds>(E.Start - StartTime).count();
+    int64_t DurUs = duration_cast<microseconds>(E.Duration).count();
+    writeCompleteEvent(OS, 0, StartUs, DurUs, E.Name, E.Detail);
+  }
+
+  // Emit totals by section name as additional "thread" events, sorted from
+  // longest one.
+  typedef std::pair<std::string, CountAndDurationType>
+      NameAndCountAndDurationType;
+  std::vector<NameAndCountAndDurationType> SortedTotals;
+  SortedTotals.reserve(CountAndTotalPerName.size());
+  for (const auto &Total : CountAndTotalPerName)
+    SortedTotals.emplace_back(Total.getKey(), Total.getValue());
+
+  std::sort(SortedTotals.begin(), SortedTotals.end(),
+            [](const NameAndCountAndDurationType &A,
+               const NameAndCountAndDurationType &B) {
+              if (A.second.second != B.second.second)
+                return A.second.second > B.second.second;
+              return A.first < B.first;
+            });
+  int Tid = 1;
+  for (const NameAndCountAndDurationType &Total : SortedTotals) {
+    int64_t DurUs = duration_cast<microseconds>(Total.second.second).count();
+    std::string Detail;
+    raw_string_ostream(Detail) << Total.second.first << " calls, "
+                               << DurUs / 1000 << " ms";
+    writeCompleteEvent(OS, Tid++, 0, DurUs, "Total " + Total.first, Detail);
+  }
+
+  // Emit metadata event with process name.
+  OS << "{\"cat\":\"\",\"pid\":1,\"tid\":0,\"ts\":0,\"ph\":\"M\","
+        "\"name\":\"process_name\",\"args\":{\"name\":";
+  writeJSONString(OS, sys::path::filename(ProcName));
+  OS << "}}\n]}\n";
+}
+
+void llvm::timeTraceProfilerInitialize(unsigned TimeTraceGranularity,
+                                       StringRef ProcName) {
+  assert(TimeTraceProfilerInstance == nullptr &&
+         "Profiler should not be initialized");
+  TimeTraceProfilerInstance =
+      new TimeTraceProfiler(TimeTraceGranularity, ProcName);
+}
+
+void llvm::timeTraceProfilerCleanup() {
+  delete TimeTraceProfilerInstance;
+  TimeTraceProfilerInstance = nullptr;
+}
+
+void llvm::timeTraceProfilerWrite(raw_ostream &OS) {
+  assert(TimeTraceProfilerInstance != nullptr &&
+         "Profiler object can't be null");
+  TimeTraceProfilerInstance->write(OS);
+}
+
+Error llvm::timeTraceProfilerWrite(StringRef FileName) {
+  std::error_code EC;
+  raw_fd_ostream OS(FileName, EC, sys::fs::F_Text);
+  if (EC)
+    return errorCodeToError(EC);
+  timeTraceProfilerWrite(OS);
+  return Error::success();
+}
+
+void llvm::timeTraceProfilerBegin(StringRef Name, StringRef Detail) {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->begin(Name, [&]() { return Detail; });
+}
+
+void llvm::timeTraceProfilerBegin(StringRef Name,
+                                  function_ref<std::string()> Detail) {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->begin(Name, Detail);
+}
+
+void llvm::timeTraceProfilerEnd() {
+  if (TimeTraceProfilerInstance != nullptr)
+    TimeTraceProfilerInstance->end();
+}
+
+TimeTraceProfilerRAII::TimeTraceProfilerRAII(StringRef ProgramName,
+                                             const std::string &OutputFilename,
+                                             const std::string &InputFilename)
+    : OutputFilename(OutputFilename), InputFilename(InputFilename) {
+  if (TimeTrace)
+    timeTraceProfilerInitialize(TimeTraceGranularity, ProgramName);
+}
+
+TimeTraceProfilerRAII::~TimeTraceProfilerRAII() {
+  if (!TimeTrace)
+    return;
+  std::string FileName = TimeTraceFile;
+  if (FileName.empty()) {
+    StringRef Base = OutputFilename;
+    if (Base.empty() || Base == "-")
+      Base = InputFilename == "-" ? StringRef("stdin")
+                                  : StringRef(InputFilename);
+    FileName = (Base + ".time-trace.json").str();
+  }
+  if (Error E = timeTraceProfilerWrite(FileName))
+    errs() << "error writing time trace to '" << FileName
+           << "': " << toString(std::move(E)) << '\n';
+  timeTraceProfilerCleanup();
+}
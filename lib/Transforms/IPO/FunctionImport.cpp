@@ -37,6 +37,8 @@
 using namespace llvm;
 
 STATISTIC(NumImported, "Number of functions imported");
+STATISTIC(NumImportedReadOnlyGlobals,
+          "Number of read-only global variables imported and internalized");
 
 /// Limit on instruction count of imported functions.
 static cl::opt<unsigned> ImportInstrLimit(
@@ -66,6 +68,11 @@ static cl::opt<float> ImportColdMultiplier(
     "import-cold-multiplier", cl::init(0), cl::Hidden, cl::value_desc("N"),
     cl::desc("Multiply the `import-instr-limit` threshold for cold callsites"));
 
+static cl::opt<unsigned> ImportReadOnlyGlobalSizeLimit(
+    "import-readonly-global-size-limit", cl::init(1024), cl::Hidden,
+    cl::value_desc("N"),
+    cl::desc("Only import read-only global variables of at most N bytes"));
+
 static cl::opt<bool> PrintImports("print-imports", cl::init(false), cl::Hidden,
                                   cl::desc("Print imported functions"));
 
@@ -177,6 +184,33 @@ static bool eligibleForImport(const ModuleSummaryIndex &Index,
   return true;
 }
 
+/// Import the read-only global variables referenced by \p Summary, a function
+/// defined in or imported into the module, unless the module defines them.
+/// Unlike the values their initializers reference, they don't need to be
+/// exported from their source module.
+static void computeImportForReferencedGlobals(
+    const FunctionSummary &Summary, const ModuleSummaryIndex &Index,
+    const GVSummaryMapTy &DefinedGVSummaries,
+    FunctionImporter::ImportMapTy &ImportList,
+    StringMap<FunctionImporter::ExportSetTy> *ExportLists) {
+  for (auto &Ref : Summary.refs()) {
+    auto GUID = Ref.getGUID();
+    if (DefinedGVSummaries.count(GUID))
+      continue;
+    auto *GVS = Index.getReadOnlyGlobalVarSummary(GUID);
+    if (!GVS)
+      continue;
+    if (!ImportList[GVS->modulePath()].insert({GUID, 0}).second)
+      continue;
+    DEBUG(dbgs() << " ref -> " << GUID << " imported read-only\n");
+    if (ExportLists) {
+      auto &ExportList = (*ExportLists)[GVS->modulePath()];
+      for (auto &VarRef : GVS->refs())
+        ExportList.insert(VarRef.getGUID());
+    }
+  }
+}
+
 /// Given a list of possible callee implementation for a call site, select one
 /// that fits the \p Threshold.
 ///
@@ -248,6 +282,9 @@ static void computeImportForFunction(
     SmallVectorImpl<EdgeInfo> &Worklist,
     FunctionImporter::ImportMapTy &ImportList,
     StringMap<FunctionImporter::ExportSetTy> *ExportLists = nullptr) {
+  computeImportForReferencedGlobals(Summary, Index, DefinedGVSummaries,
+                                    ImportList, ExportLists);
+
   for (auto &Edge : Summary.calls()) {
     auto GUID = Edge.first.getGUID();
     DEBUG(dbgs() << " edge -> " << GUID << " Threshold:" << Threshold << "\n");
@@ -330,7 +367,9 @@ static void computeImportForFunction(
         }
         for (auto &Ref : ResolvedCalleeSummary->refs()) {
           auto GUID = Ref.getGUID();
-          ExportList.insert(GUID);
+          // Read-only variables are imported along with the function.
+          if (!Index.getReadOnlyGlobalVarSummary(GUID))
+            ExportList.insert(GUID);
         }
       }
     }
@@ -437,6 +476,59 @@ void llvm::ComputeCrossModuleImport(
 #endif
 }
 
+void llvm::computeReadOnlyGlobals(
+    ModuleSummaryIndex &Index,
+    function_ref<bool(GlobalValue::GUID, const GlobalValueSummary *)>
+        isPrevailing,
+    const DenseSet<GlobalValue::GUID> &GUIDPreservedSymbols) {
+  // Start from the variables that their own module only loads from, and that
+  // neither the linker nor code outside of the index may replace or write to.
+  DenseSet<GlobalValue::GUID> ReadOnly;
+  for (auto &I : Index) {
+    for (auto &S : I.second)
+      if (auto *GVS = dyn_cast<GlobalVarSummary>(S.get()))
+        GVS->setReadOnly(false);
+    if (I.second.size() != 1)
+      continue;
+    auto *GVS = dyn_cast<GlobalVarSummary>(I.second.front().get());
+    if (!GVS || !GVS->maybeReadOnly())
+      continue;
+    auto Linkage = GVS->linkage();
+    if (GlobalValue::isInterposableLinkage(Linkage) ||
+        GlobalValue::isAppendingLinkage(Linkage) ||
+        (!GlobalValue::isLocalLinkage(Linkage) && !isPrevailing(I.first, GVS)))
+      continue;
+    if (GUIDPreservedSymbols.count(I.first) ||
+        GVS->getSize() > ImportReadOnlyGlobalSizeLimit ||
+        !eligibleForImport(Index, *GVS))
+      continue;
+    ReadOnly.insert(I.first);
+  }
+
+  // Drop those that another module writes to or lets the address of escape,
+  // which variable initializers do as well.
+  DenseSet<GlobalValue::GUID> ReadOnlyRefs;
+  for (auto &I : Index)
+    for (auto &S : I.second) {
+      ReadOnlyRefs.clear();
+      if (auto *FS = dyn_cast<FunctionSummary>(S.get()))
+        for (auto &VI : FS->readonly_refs())
+          ReadOnlyRefs.insert(VI.getGUID());
+      for (auto &Ref : S->refs()) {
+        auto GUID = Ref.getGUID();
+        if (ReadOnly.count(GUID) && !ReadOnlyRefs.count(GUID))
+          ReadOnly.erase(GUID);
+      }
+    }
+
+  for (auto GUID : ReadOnly) {
+    DEBUG(dbgs() << "Global variable " << GUID << " is read-only\n");
+    cast<GlobalVarSummary>(
+        Index.findGlobalValueSummaryList(GUID)->second.front().get())
+        ->setReadOnly(true);
+  }
+}
+
 /// Compute all the imports for the given module in the Index.
 void llvm::ComputeCrossModuleImportForModule(
     StringRef ModulePath, const ModuleSummaryIndex &Index,
@@ -630,6 +722,7 @@ Expected<bool> FunctionImporter::importFunctions(
     auto &ImportGUIDs = FunctionsToImportPerModule->second;
     // Find the globals to import
     DenseSet<const GlobalValue *> GlobalsToImport;
+    SmallVector<GlobalVariable *, 4> ReadOnlyGlobals;
     for (Function &F : *SrcModule) {
       if (!F.hasName())
         continue;
@@ -665,6 +758,10 @@ Expected<bool> FunctionImporter::importFunctions(
         if (Error Err = GV.materialize())
           return std::move(Err);
         GlobalsToImport.insert(&GV);
+        auto *GVS = dyn_cast_or_null<GlobalVarSummary>(
+            Index.findSummaryInModule(GUID, Name));
+        if (GVS && GVS->isReadOnly())
+          ReadOnlyGlobals.push_back(&GV);
       }
     }
     for (GlobalAlias &GA : SrcModule->aliases()) {
@@ -708,6 +805,12 @@ Expected<bool> FunctionImporter::importFunctions(
                << " from " << SrcModule->getSourceFileName() << "\n";
     }
 
+    // The names of the read-only variables after promotion, which they keep
+    // in the destination module.
+    std::vector<std::string> ReadOnlyGlobalNames;
+    for (const auto *GV : ReadOnlyGlobals)
+      ReadOnlyGlobalNames.push_back(GV->getName());
+
     // Instruct the linker that the client will take care of linkonce resolution
     unsigned Flags = Linker::Flags::None;
     if (!ForceImportReferencedDiscardableSymbols)
@@ -716,6 +819,19 @@ Expected<bool> FunctionImporter::importFunctions(
     if (TheLinker.linkInModule(std::move(SrcModule), Flags, &GlobalsToImport))
       report_fatal_error("Function Import: link error");
 
+    // Nothing writes to the read-only variables or looks at their address, so
+    // each module can have its own constant copy, which loads fold through.
+    // Those that end up unused are then dropped.
+    for (auto &Name : ReadOnlyGlobalNames) {
+      GlobalVariable *GV = DestModule.getNamedGlobal(Name);
+      if (!GV || GV->isDeclaration())
+        continue;
+      GV->setLinkage(GlobalValue::InternalLinkage);
+      GV->setVisibility(GlobalValue::DefaultVisibility);
+      GV->setConstant(true);
+      ++NumImportedReadOnlyGlobals;
+    }
+
     ImportedCount += GlobalsToImport.size();
   }
 
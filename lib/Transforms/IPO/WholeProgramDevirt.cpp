@@ -35,6 +35,7 @@
 #include "llvm/ADT/iterator_range.h"
 #include "llvm/ADT/MapVector.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/TypeMetadataUtils.h"
 #include "llvm/IR/CallSite.h"
 #include "llvm/IR/Constants.h"
@@ -54,6 +55,7 @@
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Metadata.h"
 #include "llvm/IR/Module.h"
+#include "llvm/IR/ModuleSummaryIndex.h"
 #include "llvm/Pass.h"
 #include "llvm/PassRegistry.h"
 #include "llvm/PassSupport.h"
@@ -72,6 +74,19 @@ using namespace wholeprogramdevirt;
 
 #define DEBUG_TYPE "wholeprogramdevirt"
 
+STATISTIC(NumSingleImplSlots, "Number of virtual function slots devirtualized "
+                              "to their single implementation");
+STATISTIC(NumUniformRetValSlots, "Number of virtual function slots whose "
+                                 "calls were replaced by a uniform return "
+                                 "value");
+STATISTIC(NumVirtualConstPropSlots, "Number of virtual function slots whose "
+                                    "calls load their return value from the "
+                                    "vtable");
+STATISTIC(NumDevirtCalls, "Number of virtual calls devirtualized in ThinLTO "
+                          "backends");
+STATISTIC(NumRebuiltVTables, "Number of vtables rebuilt with return values "
+                             "in ThinLTO backends");
+
 // Find the minimum offset that we may store a value of size Size bits at. If
 // IsAfter is set, look for an offset before the object, otherwise look for an
 // offset after the object.
@@ -183,6 +198,46 @@ void wholeprogramdevirt::setAfterReturnValues(
   }
 }
 
+// Find an allocation offset in bits in all vtables of Targets for a value of
+// BitWidth bits, either before (IsAfter false) or after the vtables, and store
+// the return values of Targets there. Pos is set to the allocation offset, and
+// OffsetByte/OffsetBit to the offset of the value from the address point.
+// Returns false, without storing anything, if that would take too much
+// padding.
+static bool layOutReturnValues(MutableArrayRef<VirtualCallTarget> Targets,
+                               unsigned BitWidth, bool &IsAfter, uint64_t &Pos,
+                               int64_t &OffsetByte, uint64_t &OffsetBit) {
+  uint64_t AllocBefore =
+      findLowestOffset(Targets, /*IsAfter=*/false, BitWidth);
+  uint64_t AllocAfter = findLowestOffset(Targets, /*IsAfter=*/true, BitWidth);
+
+  // Calculate the total amount of padding needed to store a value at both
+  // ends of the object.
+  uint64_t TotalPaddingBefore = 0, TotalPaddingAfter = 0;
+  for (auto &&Target : Targets) {
+    TotalPaddingBefore += std::max<int64_t>(
+        (AllocBefore + 7) / 8 - Target.allocatedBeforeBytes() - 1, 0);
+    TotalPaddingAfter += std::max<int64_t>(
+        (AllocAfter + 7) / 8 - Target.allocatedAfterBytes() - 1, 0);
+  }
+
+  // If the amount of padding is too large, give up.
+  // FIXME: do something smarter here.
+  if (std::min(TotalPaddingBefore, TotalPaddingAfter) > 128)
+    return false;
+
+  // Calculate the offset to the value as a (possibly negative) byte offset
+  // and (if applicable) a bit offset, and store the values in the targets.
+  IsAfter = TotalPaddingBefore > TotalPaddingAfter;
+  Pos = IsAfter ? AllocAfter : AllocBefore;
+  if (IsAfter)
+    setAfterReturnValues(Targets, AllocAfter, BitWidth, OffsetByte, OffsetBit);
+  else
+    setBeforeReturnValues(Targets, AllocBefore, BitWidth, OffsetByte,
+                          OffsetBit);
+  return true;
+}
+
 VirtualCallTarget::VirtualCallTarget(Function *Fn, const TypeMemberInfo *TM)
     : Fn(Fn), TM(TM),
       IsBigEndian(Fn->getParent()->getDataLayout().isBigEndian()), WasDevirt(false) {}
@@ -311,10 +366,21 @@ struct DevirtModule {
                           MutableArrayRef<VirtualCallSite> CallSites);
   bool tryVirtualConstProp(MutableArrayRef<VirtualCallTarget> TargetsForSlot,
                            ArrayRef<VirtualCallSite> CallSites);
+  void applyVirtualConstProp(ArrayRef<VirtualCallSite> CallSites,
+                             IntegerType *RetType, int64_t OffsetByte,
+                             uint64_t OffsetBit, StringRef TargetName);
 
   void rebuildGlobal(VTableBits &B);
 
   bool run();
+
+  // Apply the devirtualization decided by runWholeProgramDevirtOnIndex.
+  void rebuildVirtualConstPropVTable(GlobalVariable *GV,
+                                     ArrayRef<VirtualConstPropValue> Values);
+  unsigned applyResolution(const WholeProgramDevirtResolution &Res,
+                           MutableArrayRef<VirtualCallSite> CallSites,
+                           StringRef TypeIdName);
+  bool applySummaryResolutions(const ModuleSummaryIndex &Index);
 };
 
 struct WholeProgramDevirt : public ModulePass {
@@ -622,67 +688,48 @@ bool DevirtModule::tryVirtualConstProp(
     if (tryUniqueRetValOpt(BitWidth, TargetsForSlot, CSByConstantArg.second))
       continue;
 
-    // Find an allocation offset in bits in all vtables associated with the
-    // type.
-    uint64_t AllocBefore =
-        findLowestOffset(TargetsForSlot, /*IsAfter=*/false, BitWidth);
-    uint64_t AllocAfter =
-        findLowestOffset(TargetsForSlot, /*IsAfter=*/true, BitWidth);
-
-    // Calculate the total amount of padding needed to store a value at both
-    // ends of the object.
-    uint64_t TotalPaddingBefore = 0, TotalPaddingAfter = 0;
-    for (auto &&Target : TargetsForSlot) {
-      TotalPaddingBefore += std::max<int64_t>(
-          (AllocBefore + 7) / 8 - Target.allocatedBeforeBytes() - 1, 0);
-      TotalPaddingAfter += std::max<int64_t>(
-          (AllocAfter + 7) / 8 - Target.allocatedAfterBytes() - 1, 0);
-    }
-
-    // If the amount of padding is too large, give up.
-    // FIXME: do something smarter here.
-    if (std::min(TotalPaddingBefore, TotalPaddingAfter) > 128)
-      continue;
-
-    // Calculate the offset to the value as a (possibly negative) byte offset
-    // and (if applicable) a bit offset, and store the values in the targets.
+    bool IsAfter;
+    uint64_t Pos;
     int64_t OffsetByte;
     uint64_t OffsetBit;
-    if (TotalPaddingBefore <= TotalPaddingAfter)
-      setBeforeReturnValues(TargetsForSlot, AllocBefore, BitWidth, OffsetByte,
-                            OffsetBit);
-    else
-      setAfterReturnValues(TargetsForSlot, AllocAfter, BitWidth, OffsetByte,
-                           OffsetBit);
+    if (!layOutReturnValues(TargetsForSlot, BitWidth, IsAfter, Pos, OffsetByte,
+                            OffsetBit))
+      continue;
 
     if (RemarksEnabled)
       for (auto &&Target : TargetsForSlot)
         Target.WasDevirt = true;
 
-    // Rewrite each call to a load from OffsetByte/OffsetBit.
-    for (auto Call : CSByConstantArg.second) {
-      IRBuilder<> B(Call.CS.getInstruction());
-      Value *Addr = B.CreateConstGEP1_64(Call.VTable, OffsetByte);
-      if (BitWidth == 1) {
-        Value *Bits = B.CreateLoad(Addr);
-        Value *Bit = ConstantInt::get(Int8Ty, 1ULL << OffsetBit);
-        Value *BitsAndBit = B.CreateAnd(Bits, Bit);
-        auto IsBitSet = B.CreateICmpNE(BitsAndBit, ConstantInt::get(Int8Ty, 0));
-        Call.replaceAndErase("virtual-const-prop-1-bit",
-                             TargetsForSlot[0].Fn->getName(),
-                             RemarksEnabled, IsBitSet);
-      } else {
-        Value *ValAddr = B.CreateBitCast(Addr, RetType->getPointerTo());
-        Value *Val = B.CreateLoad(RetType, ValAddr);
-        Call.replaceAndErase("virtual-const-prop",
-                             TargetsForSlot[0].Fn->getName(),
-                             RemarksEnabled, Val);
-      }
-    }
+    applyVirtualConstProp(CSByConstantArg.second, RetType, OffsetByte,
+                          OffsetBit, TargetsForSlot[0].Fn->getName());
   }
   return true;
 }
 
+void DevirtModule::applyVirtualConstProp(ArrayRef<VirtualCallSite> CallSites,
+                                         IntegerType *RetType,
+                                         int64_t OffsetByte, uint64_t OffsetBit,
+                                         StringRef TargetName) {
+  // Rewrite each call to a load from OffsetByte/OffsetBit.
+  for (auto Call : CallSites) {
+    IRBuilder<> B(Call.CS.getInstruction());
+    Value *Addr = B.CreateConstGEP1_64(Call.VTable, OffsetByte);
+    if (RetType->getBitWidth() == 1) {
+      Value *Bits = B.CreateLoad(Addr);
+      Value *Bit = ConstantInt::get(Int8Ty, 1ULL << OffsetBit);
+      Value *BitsAndBit = B.CreateAnd(Bits, Bit);
+      auto IsBitSet = B.CreateICmpNE(BitsAndBit, ConstantInt::get(Int8Ty, 0));
+      Call.replaceAndErase("virtual-const-prop-1-bit", TargetName,
+                           RemarksEnabled, IsBitSet);
+    } else {
+      Value *ValAddr = B.CreateBitCast(Addr, RetType->getPointerTo());
+      Value *Val = B.CreateLoad(RetType, ValAddr);
+      Call.replaceAndErase("virtual-const-prop", TargetName, RemarksEnabled,
+                           Val);
+    }
+  }
+}
+
 void DevirtModule::rebuildGlobal(VTableBits &B) {
   if (B.Before.Bytes.empty() && B.After.Bytes.empty())
     return;
@@ -940,3 +987,321 @@ bool DevirtModule::run() {
 
   return true;
 }
+
+void DevirtModule::rebuildVirtualConstPropVTable(
+    GlobalVariable *GV, ArrayRef<VirtualConstPropValue> Values) {
+  const DataLayout &DL = M.getDataLayout();
+  VTableBits B;
+  B.GV = GV;
+  B.ObjectSize = DL.getTypeAllocSize(GV->getInitializer()->getType());
+
+  // Store the values where the thin link laid them out, in the byte order of
+  // the target.
+  for (const VirtualConstPropValue &V : Values) {
+    TypeMemberInfo TM{&B, V.AddressPoint};
+    VirtualCallTarget Target(&TM, DL.isBigEndian());
+    Target.RetVal = V.Value;
+    if (V.BitWidth == 1) {
+      if (V.IsAfter)
+        Target.setAfterBit(V.Pos);
+      else
+        Target.setBeforeBit(V.Pos);
+    } else {
+      if (V.IsAfter)
+        Target.setAfterBytes(V.Pos, (V.BitWidth + 7) / 8);
+      else
+        Target.setBeforeBytes(V.Pos, (V.BitWidth + 7) / 8);
+    }
+  }
+  rebuildGlobal(B);
+}
+
+unsigned
+DevirtModule::applyResolution(const WholeProgramDevirtResolution &Res,
+                              MutableArrayRef<VirtualCallSite> CallSites,
+                              StringRef TypeIdName) {
+  switch (Res.TheKind) {
+  case WholeProgramDevirtResolution::SingleImpl: {
+    // The implementation may be defined in another module. A local function
+    // of the same name is unrelated: exported locals were promoted.
+    GlobalValue *Existing = M.getNamedValue(Res.SingleImplName);
+    if (Existing && (!isa<Function>(Existing) || Existing->hasLocalLinkage()))
+      return 0;
+    auto *TheFn = cast_or_null<Function>(Existing);
+    if (!TheFn) {
+      Type *CalleeTy = CallSites[0].CS.getCalledValue()->getType();
+      TheFn = Function::Create(
+          cast<FunctionType>(CalleeTy->getPointerElementType()),
+          GlobalValue::ExternalLinkage, Res.SingleImplName, &M);
+    }
+    for (auto &&VCallSite : CallSites) {
+      if (RemarksEnabled)
+        VCallSite.emitRemark("single-impl", TheFn->getName());
+      VCallSite.CS.setCalledFunction(ConstantExpr::getBitCast(
+          TheFn, VCallSite.CS.getCalledValue()->getType()));
+    }
+    return CallSites.size();
+  }
+  case WholeProgramDevirtResolution::UniformRetVal:
+  case WholeProgramDevirtResolution::VirtualConstProp: {
+    // The thin link only looked at implementations returning RetType.
+    auto *RetType = IntegerType::get(M.getContext(), Res.BitWidth);
+    std::vector<VirtualCallSite> Calls;
+    for (auto &&VCallSite : CallSites)
+      if (VCallSite.CS.getType() == RetType)
+        Calls.push_back(VCallSite);
+    if (Res.TheKind == WholeProgramDevirtResolution::VirtualConstProp) {
+      applyVirtualConstProp(Calls, RetType, Res.Byte, Res.Bit, TypeIdName);
+      return Calls.size();
+    }
+    for (auto &&Call : Calls)
+      Call.replaceAndErase("uniform-ret-val", TypeIdName, RemarksEnabled,
+                           ConstantInt::get(RetType, Res.RetVal));
+    return Calls.size();
+  }
+  }
+  llvm_unreachable("Unknown devirtualization kind");
+}
+
+bool DevirtModule::applySummaryResolutions(const ModuleSummaryIndex &Index) {
+  bool Changed = false;
+
+  // Store the return values of virtual constant propagation next to the
+  // vtables this module defines. Only definitions get the values, so copies
+  // that the linker won't keep become declarations.
+  for (auto &P : Index.virtualConstPropVTables()) {
+    GlobalVariable *GV = M.getNamedGlobal(P.second.Name);
+    if (!GV || GV->isDeclaration())
+      continue;
+    Changed = true;
+    if (GV->hasAvailableExternallyLinkage()) {
+      GV->setInitializer(nullptr);
+      GV->setLinkage(GlobalValue::ExternalLinkage);
+      GV->clearMetadata();
+      continue;
+    }
+    rebuildVirtualConstPropVTable(GV, P.second.Values);
+    ++NumRebuiltVTables;
+  }
+
+  Function *TypeTestFunc =
+      M.getFunction(Intrinsic::getName(Intrinsic::type_test));
+  Function *AssumeFunc = M.getFunction(Intrinsic::getName(Intrinsic::assume));
+  if (!Index.hasDevirtResolutions() || !TypeTestFunc ||
+      TypeTestFunc->use_empty() || !AssumeFunc || AssumeFunc->use_empty())
+    return Changed;
+
+  scanTypeTestUsers(TypeTestFunc, AssumeFunc);
+  for (auto &S : CallSlots) {
+    auto *TypeId = dyn_cast<MDString>(S.first.TypeID);
+    if (!TypeId)
+      continue;
+    if (const WholeProgramDevirtResolution *Res = Index.getDevirtResolution(
+            GlobalValue::getGUID(TypeId->getString()), S.first.ByteOffset))
+      NumDevirtCalls += applyResolution(*Res, S.second, TypeId->getString());
+  }
+  return true;
+}
+
+bool llvm::applyWholeProgramDevirtResolutions(Module &M,
+                                              const ModuleSummaryIndex &Index) {
+  return DevirtModule(M).applySummaryResolutions(Index);
+}
+
+namespace {
+
+// A vtable of a ThinLTO link, as described by its summary.
+struct SummaryVTable {
+  GlobalValue::GUID GUID;
+  const GlobalVarSummary *Summary = nullptr;
+  VTableBits Bits;
+};
+
+} // end anonymous namespace
+
+// Return the name by which the backends refer to the value GUID, whose first
+// summary is S (if any), once exported, or an empty string if it can't be
+// referred to from other modules.
+static std::string getExportedName(const ModuleSummaryIndex &Index,
+                                   GlobalValue::GUID GUID,
+                                   const GlobalValueSummary *S) {
+  StringRef Name = Index.getDevirtValueName(GUID);
+  if (Name.empty() || !S || !GlobalValue::isLocalLinkage(S->linkage()))
+    return Name;
+  if (S->noRename())
+    return "";
+  return ModuleSummaryIndex::getGlobalNameForLocal(
+      Name, Index.getModuleHash(S->modulePath()));
+}
+
+// Return the summary of GUID if it is a function that always returns the same
+// constant integer, and that can't be replaced at link time.
+static const FunctionSummary *
+getConstantReturnSummary(const ModuleSummaryIndex &Index,
+                         GlobalValue::GUID GUID) {
+  auto Summaries = Index.findGlobalValueSummaryList(GUID);
+  if (Summaries == Index.end() || Summaries->second.empty())
+    return nullptr;
+  auto *FS = dyn_cast<FunctionSummary>(Summaries->second.front().get());
+  if (!FS || !FS->hasConstantReturn() ||
+      GlobalValue::isInterposableLinkage(FS->linkage()))
+    return nullptr;
+  return FS;
+}
+
+void llvm::runWholeProgramDevirtOnIndex(
+    ModuleSummaryIndex &Index,
+    StringMap<FunctionImporter::ExportSetTy> &ExportLists) {
+  // Collect the vtables by type identifier, and the slots that are called.
+  std::map<GlobalValue::GUID, SummaryVTable> VTables;
+  DenseMap<const VTableBits *, const SummaryVTable *> VTableForBits;
+  std::map<GlobalValue::GUID, std::vector<TypeMemberInfo>> TypeIdMap;
+  std::set<std::pair<GlobalValue::GUID, uint64_t>> CallSlots;
+  for (auto &GlobalList : Index) {
+    for (auto &Summary : GlobalList.second) {
+      if (auto *FS = dyn_cast<FunctionSummary>(Summary.get()))
+        for (const VFuncId &VF : FS->type_test_assume_vcalls())
+          CallSlots.insert({VF.TypeId, VF.Offset});
+      auto *VS = dyn_cast<GlobalVarSummary>(Summary.get());
+      if (!VS || !VS->isVTable())
+        continue;
+      // All the copies of a vtable are the same; look at the first one.
+      SummaryVTable &VT = VTables[GlobalList.first];
+      if (VT.Summary)
+        continue;
+      VT.GUID = GlobalList.first;
+      VT.Summary = VS;
+      VT.Bits.GV = nullptr;
+      VT.Bits.ObjectSize = VS->getVTableSize();
+      VTableForBits[&VT.Bits] = &VT;
+      for (const VTableTypeId &TI : VS->vtable_type_ids())
+        TypeIdMap[TI.TypeId].push_back({&VT.Bits, TI.AddressPoint});
+    }
+  }
+
+  auto Export = [&](GlobalValue::GUID GUID) {
+    auto Summaries = Index.findGlobalValueSummaryList(GUID);
+    if (Summaries == Index.end())
+      return;
+    for (auto &Summary : Summaries->second)
+      ExportLists[Summary->modulePath()].insert(GUID);
+  };
+
+  for (auto &Slot : CallSlots) {
+    auto TypeMembers = TypeIdMap.find(Slot.first);
+    if (TypeMembers == TypeIdMap.end())
+      continue;
+
+    // Search each of the members of the type identifier for the virtual
+    // function implementation at offset Slot.second.
+    std::vector<VirtualCallTarget> TargetsForSlot;
+    std::vector<GlobalValue::GUID> TargetFns;
+    bool FoundAll = true;
+    for (const TypeMemberInfo &TM : TypeMembers->second) {
+      // As in tryFindVirtualCallTargets, a vtable that isn't constant could
+      // hold any function by the time of the call.
+      const GlobalVarSummary *VS = VTableForBits[TM.Bits]->Summary;
+      if (!VS->isConstantVTable()) {
+        FoundAll = false;
+        break;
+      }
+      auto VF = llvm::find_if(VS->vtable_funcs(), [&](const VTableFunc &VF) {
+        return VF.Offset == TM.Offset + Slot.second;
+      });
+      if (VF == VS->vtable_funcs().end()) {
+        FoundAll = false;
+        break;
+      }
+      // We can disregard __cxa_pure_virtual as a possible call target, as
+      // calls to pure virtuals are UB.
+      GlobalValue::GUID Fn = VF->Func.getGUID();
+      if (Index.getDevirtValueName(Fn) == "__cxa_pure_virtual")
+        continue;
+      TargetsForSlot.push_back(VirtualCallTarget(&TM, /*IsBigEndian=*/false));
+      TargetFns.push_back(Fn);
+    }
+    if (!FoundAll || TargetsForSlot.empty())
+      continue;
+
+    WholeProgramDevirtResolution Res;
+    if (llvm::all_of(TargetFns, [&](GlobalValue::GUID Fn) {
+          return Fn == TargetFns[0];
+        })) {
+      auto Summaries = Index.findGlobalValueSummaryList(TargetFns[0]);
+      const GlobalValueSummary *S =
+          Summaries == Index.end() || Summaries->second.empty()
+              ? nullptr
+              : Summaries->second.front().get();
+      std::string Name = getExportedName(Index, TargetFns[0], S);
+      if (Name.empty())
+        continue;
+      Export(TargetFns[0]);
+      Res.TheKind = WholeProgramDevirtResolution::SingleImpl;
+      Res.SingleImplName = std::move(Name);
+      Index.setDevirtResolution(Slot.first, Slot.second, std::move(Res));
+      ++NumSingleImplSlots;
+      continue;
+    }
+
+    // The other optimizations need the return value of each implementation.
+    unsigned BitWidth = 0;
+    bool AllConstant = true;
+    for (size_t I = 0, E = TargetsForSlot.size(); I != E; ++I) {
+      const FunctionSummary *FS = getConstantReturnSummary(Index, TargetFns[I]);
+      if (!FS || (BitWidth && FS->getConstantReturnBitWidth() != BitWidth)) {
+        AllConstant = false;
+        break;
+      }
+      BitWidth = FS->getConstantReturnBitWidth();
+      TargetsForSlot[I].RetVal = FS->getConstantReturnValue();
+    }
+    if (!AllConstant)
+      continue;
+    Res.BitWidth = BitWidth;
+
+    if (llvm::all_of(TargetsForSlot, [&](const VirtualCallTarget &Target) {
+          return Target.RetVal == TargetsForSlot[0].RetVal;
+        })) {
+      Res.TheKind = WholeProgramDevirtResolution::UniformRetVal;
+      Res.RetVal = TargetsForSlot[0].RetVal;
+      Index.setDevirtResolution(Slot.first, Slot.second, std::move(Res));
+      ++NumUniformRetValSlots;
+      continue;
+    }
+
+    // The backends of the modules defining the vtables need to find them.
+    std::vector<std::string> VTableNames;
+    for (const VirtualCallTarget &Target : TargetsForSlot) {
+      const SummaryVTable &VT = *VTableForBits[Target.TM->Bits];
+      VTableNames.push_back(getExportedName(Index, VT.GUID, VT.Summary));
+      if (VTableNames.back().empty())
+        break;
+    }
+    if (VTableNames.size() != TargetsForSlot.size() ||
+        VTableNames.back().empty())
+      continue;
+
+    bool IsAfter;
+    uint64_t Pos;
+    int64_t OffsetByte;
+    uint64_t OffsetBit;
+    if (!layOutReturnValues(TargetsForSlot, BitWidth, IsAfter, Pos, OffsetByte,
+                            OffsetBit))
+      continue;
+    for (size_t I = 0, E = TargetsForSlot.size(); I != E; ++I) {
+      const VirtualCallTarget &Target = TargetsForSlot[I];
+      GlobalValue::GUID VTableGUID = VTableForBits[Target.TM->Bits]->GUID;
+      VirtualConstPropVTable &VT =
+          Index.getOrCreateVirtualConstPropVTable(VTableGUID);
+      VT.Name = VTableNames[I];
+      VT.Values.push_back(
+          {Target.TM->Offset, IsAfter, Pos, BitWidth, Target.RetVal});
+      Export(VTableGUID);
+    }
+    Res.TheKind = WholeProgramDevirtResolution::VirtualConstProp;
+    Res.Byte = OffsetByte;
+    Res.Bit = OffsetBit;
+    Index.setDevirtResolution(Slot.first, Slot.second, std::move(Res));
+    ++NumVirtualConstPropSlots;
+  }
+}
@@ -0,0 +1,189 @@
+; RUN: lli -force-interpreter -interpreter-predecode %s | FileCheck %s
+; RUN: lli -force-interpreter %s | FileCheck %s
+
+; CHECK: fib 6765
+; CHECK: swap 55 89
+; CHECK: sum 4950
+; CHECK: switch 10 20 30
+; CHECK: ctpop 3
+; CHECK: popsum 5
+; CHECK: fp 2.500000
+; CHECK: field 42
+
+@fmt = internal constant [7 x i8] c"%s %d\0A\00"
+@fmt2 = internal constant [10 x i8] c"%s %d %d\0A\00"
+@fmt3 = internal constant [13 x i8] c"%s %d %d %d\0A\00"
+@fmtf = internal constant [7 x i8] c"%s %f\0A\00"
+@s.fib = internal constant [4 x i8] c"fib\00"
+@s.swap = internal constant [5 x i8] c"swap\00"
+@s.sum = internal constant [4 x i8] c"sum\00"
+@s.switch = internal constant [7 x i8] c"switch\00"
+@s.ctpop = internal constant [6 x i8] c"ctpop\00"
+@s.popsum = internal constant [7 x i8] c"popsum\00"
+@s.fp = internal constant [3 x i8] c"fp\00"
+@s.field = internal constant [6 x i8] c"field\00"
+
+@array = internal global [100 x i32] zeroinitializer
+
+%pair = type { i8, i64 }
+
+declare i32 @printf(i8*, ...)
+declare i32 @llvm.ctpop.i32(i32)
+declare void @llvm.trap()
+
+; Recursion and calls.
+define i32 @fib(i32 %n) {
+entry:
+  %small = icmp slt i32 %n, 2
+  br i1 %small, label %done, label %recurse
+
+recurse:
+  %n1 = sub i32 %n, 1
+  %n2 = sub i32 %n, 2
+  %f1 = call i32 @fib(i32 %n1)
+  %f2 = call i32 @fib(i32 %n2)
+  %sum = add i32 %f1, %f2
+  ret i32 %sum
+
+done:
+  ret i32 %n
+}
+
+; PHI nodes that read each other on the back edge must be updated at once.
+define void @swap(i32* %pa, i32* %pb) {
+entry:
+  br label %loop
+
+loop:
+  %b = phi i32 [ 1, %entry ], [ %c, %loop ]
+  %a = phi i32 [ 0, %entry ], [ %b, %loop ]
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %c = add i32 %a, %b
+  %i.next = add i32 %i, 1
+  %cont = icmp ult i32 %i.next, 11
+  br i1 %cont, label %loop, label %exit
+
+exit:
+  store i32 %a, i32* %pa
+  store i32 %b, i32* %pb
+  ret void
+}
+
+; GEPs with variable indices, loads and stores.
+define i32 @sum() {
+entry:
+  br label %fill
+
+fill:
+  %i = phi i64 [ 0, %entry ], [ %i.next, %fill ]
+  %p = getelementptr [100 x i32], [100 x i32]* @array, i64 0, i64 %i
+  %v = trunc i64 %i to i32
+  store i32 %v, i32* %p
+  %i.next = add i64 %i, 1
+  %fill.cont = icmp ne i64 %i.next, 100
+  br i1 %fill.cont, label %fill, label %add
+
+add:
+  %j = phi i32 [ 0, %fill ], [ %j.next, %add ]
+  %acc = phi i32 [ 0, %fill ], [ %acc.next, %add ]
+  %j.ext = sext i32 %j to i64
+  %q = getelementptr [100 x i32], [100 x i32]* @array, i64 0, i64 %j.ext
+  %w = load i32, i32* %q
+  %acc.next = add i32 %acc, %w
+  %j.next = add i32 %j, 1
+  %add.cont = icmp slt i32 %j.next, 100
+  br i1 %add.cont, label %add, label %exit
+
+exit:
+  ret i32 %acc.next
+}
+
+; Switch and select are executed by the visitor and the decoded code alike.
+define i32 @classify(i32 %x) {
+entry:
+  switch i32 %x, label %other [ i32 1, label %one
+                               i32 2, label %two ]
+
+one:
+  br label %exit
+
+two:
+  br label %exit
+
+other:
+  %big = icmp ugt i32 %x, 2
+  %r = select i1 %big, i32 30, i32 0
+  br label %exit
+
+exit:
+  %res = phi i32 [ 10, %one ], [ 20, %two ], [ %r, %other ]
+  ret i32 %res
+}
+
+; Intrinsic calls are lowered when they are first executed. The frames already
+; running the function, which all resume at the ctpop call, continue in the
+; code decoded after lowering it. The trap is never reached, so it must not be
+; lowered, which IntrinsicLowering does not support.
+define i32 @popsum(i32 %n) {
+entry:
+  %zero = icmp eq i32 %n, 0
+  br i1 %zero, label %done, label %recurse
+
+recurse:
+  %n1 = sub i32 %n, 1
+  %r = call i32 @popsum(i32 %n1)
+  %p = call i32 @llvm.ctpop.i32(i32 %n)
+  %sum = add i32 %r, %p
+  %bad = icmp ugt i32 %sum, 100
+  br i1 %bad, label %trap, label %done
+
+trap:
+  call void @llvm.trap()
+  unreachable
+
+done:
+  %res = phi i32 [ 0, %entry ], [ %sum, %recurse ]
+  ret i32 %res
+}
+
+define i32 @main() {
+entry:
+  %pa = alloca i32
+  %pb = alloca i32
+  %pair = alloca %pair
+
+  %fib = call i32 @fib(i32 20)
+  call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @fmt, i64 0, i64 0), i8* getelementptr ([4 x i8], [4 x i8]* @s.fib, i64 0, i64 0), i32 %fib)
+
+  call void @swap(i32* %pa, i32* %pb)
+  %a = load i32, i32* %pa
+  %b = load i32, i32* %pb
+  call i32 (i8*, ...) @printf(i8* getelementptr ([10 x i8], [10 x i8]* @fmt2, i64 0, i64 0), i8* getelementptr ([5 x i8], [5 x i8]* @s.swap, i64 0, i64 0), i32 %a, i32 %b)
+
+  %sum = call i32 @sum()
+  call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @fmt, i64 0, i64 0), i8* getelementptr ([4 x i8], [4 x i8]* @s.sum, i64 0, i64 0), i32 %sum)
+
+  %c1 = call i32 @classify(i32 1)
+  %c2 = call i32 @classify(i32 2)
+  %c3 = call i32 @classify(i32 3)
+  call i32 (i8*, ...) @printf(i8* getelementptr ([13 x i8], [13 x i8]* @fmt3, i64 0, i64 0), i8* getelementptr ([7 x i8], [7 x i8]* @s.switch, i64 0, i64 0), i32 %c1, i32 %c2, i32 %c3)
+
+  %pop = call i32 @llvm.ctpop.i32(i32 11)
+  call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @fmt, i64 0, i64 0), i8* getelementptr ([6 x i8], [6 x i8]* @s.ctpop, i64 0, i64 0), i32 %pop)
+
+  %popsum = call i32 @popsum(i32 4)
+  call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @fmt, i64 0, i64 0), i8* getelementptr ([7 x i8], [7 x i8]* @s.popsum, i64 0, i64 0), i32 %popsum)
+
+  %x = sitofp i32 5 to double
+  %half = fmul double %x, 5.000000e-01
+  call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @fmtf, i64 0, i64 0), i8* getelementptr ([3 x i8], [3 x i8]* @s.fp, i64 0, i64 0), double %half)
+
+  ; Struct GEPs fold the field offset.
+  %field = getelementptr %pair, %pair* %pair, i32 0, i32 1
+  store i64 42, i64* %field
+  %val = load i64, i64* %field
+  %val.trunc = trunc i64 %val to i32
+  call i32 (i8*, ...) @printf(i8* getelementptr ([7 x i8], [7 x i8]* @fmt, i64 0, i64 0), i8* getelementptr ([6 x i8], [6 x i8]* @s.field, i64 0, i64 0), i32 %val.trunc)
+
+  ret i32 0
+}
@@ -0,0 +1,21 @@
+; The first run compiles all three modules and fills the cache.
+; RUN: rm -rf %t.cache
+; RUN: %lli -extra-module=%p/Inputs/multi-module-b.ll -extra-module=%p/Inputs/multi-module-c.ll -persistent-cache-dir=%t.cache -persistent-cache-stats %s 2>&1 | FileCheck --check-prefix=COLD %s
+; RUN: ls %t.cache | grep -c '^llvmcache-[0-9A-F]*\.o$' | FileCheck --check-prefix=ENTRIES %s
+
+; The second run loads all of them from the cache.
+; RUN: %lli -extra-module=%p/Inputs/multi-module-b.ll -extra-module=%p/Inputs/multi-module-c.ll -persistent-cache-dir=%t.cache -persistent-cache-stats %s 2>&1 | FileCheck --check-prefix=WARM %s
+
+; Objects compiled with other code generation options are not reused.
+; RUN: %lli -O0 -extra-module=%p/Inputs/multi-module-b.ll -extra-module=%p/Inputs/multi-module-c.ll -persistent-cache-dir=%t.cache -persistent-cache-stats %s 2>&1 | FileCheck --check-prefix=COLD %s
+
+; COLD: Persistent cache hits: 0, misses: 3
+; ENTRIES: 3
+; WARM: Persistent cache hits: 3, misses: 0
+
+declare i32 @FB()
+
+define i32 @main() {
+  %r = call i32 @FB( )   ; <i32> [#uses=1]
+  ret i32 %r
+}
@@ -0,0 +1,16 @@
+; RUN: %lli -rtdyld-relocation-stats %s 2>&1 > /dev/null | FileCheck %s
+
+; CHECK: rtdyld: {{.*}}: processed {{[0-9]+}} relocations (2 new external symbols) in {{[0-9.]+}} ms
+; CHECK: rtdyld: resolved {{[0-9]+}} relocations (2 external symbols, 1 resolver lookups) in {{[0-9.]+}} ms
+
+@.LC0 = internal global [12 x i8] c"Hello World\00"
+
+declare i32 @puts(i8*)
+
+declare i32 @putchar(i32)
+
+define i32 @main() {
+  %reg210 = call i32 @puts( i8* getelementptr ([12 x i8], [12 x i8]* @.LC0, i64 0, i64 0) )
+  %reg211 = call i32 @putchar(i32 10)
+  ret i32 0
+}
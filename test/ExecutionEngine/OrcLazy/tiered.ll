@@ -0,0 +1,50 @@
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-tiered -orc-lazy-tier-up-threshold=50 \
+; RUN:   -orc-lazy-compile-stats %s 2>&1 | FileCheck %s
+; RUN: lli -jit-kind=orc-lazy -orc-lazy-tiered -orc-lazy-tier-up-threshold=50 \
+; RUN:   -jit-memory-slab-size=1024 -orc-lazy-compile-stats %s 2>&1 \
+; RUN:   | FileCheck %s
+;
+; @sum gets hot in its first call and is recompiled with optimization, while
+; @main stays below the threshold. The result does not depend on which tier
+; runs each call.
+;
+; CHECK-DAG: total 99000
+; CHECK-DAG: Tier-up recompiles: 1
+
+@fmt = private unnamed_addr constant [10 x i8] c"total %d\0A\00"
+
+declare i32 @printf(i8*, ...)
+
+define i32 @sum(i32 %n) {
+entry:
+  br label %loop
+
+loop:
+  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]
+  %acc = phi i32 [ 0, %entry ], [ %acc.next, %loop ]
+  %acc.next = add i32 %acc, %i
+  %i.next = add i32 %i, 1
+  %cont = icmp ult i32 %i.next, %n
+  br i1 %cont, label %loop, label %exit
+
+exit:
+  ret i32 %acc.next
+}
+
+define i32 @main(i32 %argc, i8** %argv) {
+entry:
+  br label %loop
+
+loop:
+  %j = phi i32 [ 0, %entry ], [ %j.next, %loop ]
+  %total = phi i32 [ 0, %entry ], [ %total.next, %loop ]
+  %s = call i32 @sum(i32 100)
+  %total.next = add i32 %total, %s
+  %j.next = add i32 %j, 1
+  %cont = icmp ult i32 %j.next, 20
+  br i1 %cont, label %loop, label %exit
+
+exit:
+  %r = call i32 (i8*, ...) @printf(i8* getelementptr ([10 x i8], [10 x i8]* @fmt, i64 0, i64 0), i32 %total.next)
+  ret i32 0
+}
@@ -0,0 +1,28 @@
+; RUN: %lli -jit-kind=orc-mcjit -remote-mcjit -remote-shared-memory -O0 -mcjit-remote-process=lli-child-target%exeext %s
+; RUN: %lli -jit-kind=orc-mcjit -remote-mcjit -remote-shared-memory -remote-benchmark -mcjit-remote-process=lli-child-target%exeext %s | FileCheck %s
+; RUN: %lli -jit-kind=orc-mcjit -remote-mcjit -remote-benchmark -mcjit-remote-process=lli-child-target%exeext %s | FileCheck %s
+; XFAIL: mingw32,win32
+; UNSUPPORTED: powerpc64-unknown-linux-gnu
+
+; Check that code and data placed in the shared memory region work, and that
+; the benchmark runs over both kinds of channel.
+
+; CHECK: call latency:
+; CHECK: batched calls:
+; CHECK: upload throughput:
+
+@var = global i32 0, align 32
+@count = global i32 5
+
+define i32 @main() nounwind {
+  %addr = ptrtoint i32* @var to i64
+  %mask = and i64 %addr, 31
+  %tst = icmp eq i64 %mask, 0
+  br i1 %tst, label %good, label %bad
+good:
+  %c = load i32, i32* @count
+  %r = sub i32 %c, 5
+  ret i32 %r
+bad:
+  ret i32 1
+}
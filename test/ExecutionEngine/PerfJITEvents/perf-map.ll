@@ -0,0 +1,33 @@
+; RUN: rm -rf %t.mcjit && mkdir -p %t.mcjit
+; RUN: %lli -perf-jit-events -perf-jit-dir=%t.mcjit %s
+; RUN: cat %t.mcjit/perf-*.map | FileCheck %s
+; RUN: ls %t.mcjit | FileCheck --check-prefix=DUMP %s
+
+; RUN: rm -rf %t.orc-mcjit && mkdir -p %t.orc-mcjit
+; RUN: %lli -jit-kind=orc-mcjit -perf-jit-events -perf-jit-dir=%t.orc-mcjit %s
+; RUN: cat %t.orc-mcjit/perf-*.map | FileCheck %s
+; RUN: ls %t.orc-mcjit | FileCheck --check-prefix=DUMP %s
+
+; RUN: rm -rf %t.orc-lazy && mkdir -p %t.orc-lazy
+; RUN: %lli -jit-kind=orc-lazy -perf-jit-events -perf-jit-dir=%t.orc-lazy %s
+; RUN: cat %t.orc-lazy/perf-*.map | FileCheck %s
+; RUN: ls %t.orc-lazy | FileCheck --check-prefix=DUMP %s
+
+; Each function is described by its address, size and name.
+; CHECK-DAG: {{^[0-9a-f]+ [0-9a-f]+ }}main{{$}}
+; CHECK-DAG: {{^[0-9a-f]+ [0-9a-f]+ }}square{{$}}
+
+; DUMP: jit-{{[0-9]+}}.dump
+
+define i32 @square(i32 %x) {
+entry:
+  %r = mul i32 %x, %x
+  ret i32 %r
+}
+
+define i32 @main() {
+entry:
+  %s = call i32 @square(i32 3)
+  %r = sub i32 %s, 9
+  ret i32 %r
+}
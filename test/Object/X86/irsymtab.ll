@@ -0,0 +1,27 @@
+; RUN: llvm-as -o %t %s
+; RUN: llvm-bcanalyzer -dump %t | FileCheck --check-prefix=BCA %s
+
+; Check that a symbol table is written after the module, and that the tools
+; which link concatenated modules write a single one covering all of them.
+; RUN: llvm-cat -o %t2 %s %s
+; RUN: llvm-bcanalyzer -dump %t2 | FileCheck --check-prefix=CAT %s
+
+; BCA: </MODULE_BLOCK>
+; BCA-NEXT: <SYMTAB_BLOCK
+; BCA-NEXT: <BLOB {{.*}}unprintable
+; BCA-NEXT: <STRTAB_BLOB {{.*}}x86_64-unknown-linux-gnu{{.*}}foobar'
+; BCA-NEXT: </SYMTAB_BLOCK>
+
+; CAT: </MODULE_BLOCK>
+; CAT: </MODULE_BLOCK>
+; CAT-NEXT: <SYMTAB_BLOCK
+; CAT-NOT: <MODULE_BLOCK
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@bar = global i32 1
+
+define void @foo() {
+  ret void
+}
@@ -0,0 +1,30 @@
+; RUN: opt < %s -instcombine -pass-memory-report=%t.csv -disable-output
+; RUN: FileCheck --input-file=%t.csv %s
+; RUN: opt < %s -instcombine -pass-memory-report=%t.json \
+; RUN:     -pass-memory-report-format=json -disable-output
+; RUN: FileCheck --input-file=%t.json --check-prefix=JSON %s
+; RUN: opt < %s -passes=instcombine -pass-memory-report=%t.newpm.csv \
+; RUN:     -disable-output
+; RUN: FileCheck --input-file=%t.newpm.csv --check-prefix=NEWPM %s
+; RUN: opt < %s -disable-verify -pass-memory-report=%t.empty.csv \
+; RUN:     -disable-output
+; RUN: FileCheck --input-file=%t.empty.csv --check-prefix=EMPTY %s
+
+; CHECK: pass,unit,name,malloc_delta,context_delta,instructions_before,instructions_after,blocks_before,blocks_after
+; CHECK: "Combine redundant instructions",function,"foo",{{-?[0-9]+}},{{-?[0-9]+}},2,1,1,1
+
+; JSON: {"pass":"Combine redundant instructions","unit":"function","name":"foo",
+; JSON-SAME: "instructions_before":2,"instructions_after":1,"blocks_before":1,"blocks_after":1}
+
+; NEWPM: "InstCombinePass",function,"foo",{{-?[0-9]+}},{{-?[0-9]+}},2,1,1,1
+; NEWPM: "ModuleToFunctionPassAdaptor<{{.*}}>",module,"<stdin>",{{-?[0-9]+}},{{-?[0-9]+}},2,1,1,1
+
+; The report is written even if no pass ran.
+; EMPTY: pass,unit,name,malloc_delta,context_delta,instructions_before,instructions_after,blocks_before,blocks_after
+; EMPTY-NOT: function
+; EMPTY-NOT: module
+
+define i32 @foo(i32 %x) {
+  %a = add i32 %x, 0
+  ret i32 %a
+}
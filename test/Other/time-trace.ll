@@ -0,0 +1,21 @@
+; RUN: opt < %s -instcombine -time-trace -time-trace-granularity=0 \
+; RUN:     -time-trace-file=%t.json -disable-output
+; RUN: FileCheck --input-file=%t.json %s
+; RUN: opt < %s -passes=instcombine -time-trace -time-trace-granularity=0 \
+; RUN:     -time-trace-file=%t.newpm.json -disable-output
+; RUN: FileCheck --input-file=%t.newpm.json --check-prefix=NEWPM %s
+
+; CHECK: "traceEvents":[
+; CHECK-DAG: "name":"Combine redundant instructions","args":{"detail":"foo"}
+; CHECK-DAG: "name":"RunFunctionPasses","args":{"detail":"foo"}
+; CHECK-DAG: "name":"Total Combine redundant instructions"
+; CHECK: "ph":"M","name":"process_name"
+
+; NEWPM: "traceEvents":[
+; NEWPM-DAG: "name":"InstCombinePass","args":{"detail":"foo"}
+; NEWPM: "ph":"M","name":"process_name"
+
+define i32 @foo(i32 %x) {
+  %a = add i32 %x, 0
+  ret i32 %a
+}
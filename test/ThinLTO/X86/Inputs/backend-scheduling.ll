@@ -0,0 +1,12 @@
+target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.11.0"
+
+define i32 @big(i32 %a, i32 %b) {
+entry:
+  %0 = add i32 %a, %b
+  %1 = mul i32 %0, %a
+  %2 = sub i32 %1, %b
+  %3 = xor i32 %2, %0
+  %4 = and i32 %3, %1
+  ret i32 %4
+}
@@ -0,0 +1,65 @@
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@vt_single = constant [1 x i8*] [
+i8* bitcast (i32 (i8*, i32)* @single_impl to i8*)
+], !type !0
+
+@vt_b = constant [3 x i8*] [
+i8* bitcast (i32 (i8*)* @b_uniform to i8*),
+i8* bitcast (i32 (i8*)* @b_vcp to i8*),
+i8* bitcast (i32 (i8*, i32)* @b_nonconst to i8*)
+], !type !1
+
+@vt_c = constant [3 x i8*] [
+i8* bitcast (i32 (i8*)* @c_uniform to i8*),
+i8* bitcast (i32 (i8*)* @c_vcp to i8*),
+i8* bitcast (i32 (i8*, i32)* @c_nonconst to i8*)
+], !type !1
+
+; A slot of a type that has a vtable that isn't constant can't be
+; devirtualized, even though all the vtables hold the same function.
+@vt_w_const = constant [1 x i8*] [
+i8* bitcast (i32 (i8*)* @w_impl to i8*)
+], !type !2
+
+@vt_w = global [1 x i8*] [
+i8* bitcast (i32 (i8*)* @w_impl to i8*)
+], !type !2
+
+define internal i32 @single_impl(i8* %this, i32 %a) {
+  ret i32 %a
+}
+
+define i32 @b_uniform(i8* %this) {
+  ret i32 7
+}
+
+define i32 @c_uniform(i8* %this) {
+  ret i32 7
+}
+
+define i32 @b_vcp(i8* %this) {
+  ret i32 1
+}
+
+define i32 @c_vcp(i8* %this) {
+  ret i32 2
+}
+
+define i32 @b_nonconst(i8* %this, i32 %a) {
+  ret i32 %a
+}
+
+define i32 @w_impl(i8* %this) {
+  ret i32 3
+}
+
+define i32 @c_nonconst(i8* %this, i32 %a) {
+  %r = add i32 %a, 1
+  ret i32 %r
+}
+
+!0 = !{i64 0, !"single"}
+!1 = !{i64 0, !"multi"}
+!2 = !{i64 0, !"writable"}
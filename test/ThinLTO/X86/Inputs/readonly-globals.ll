@@ -0,0 +1,28 @@
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@config = global i32 42
+@table = global [4 x i32] [i32 1, i32 2, i32 3, i32 4]
+@counter = global i32 0
+@escaped = global i32 5
+@visible = global i32 6
+@local = internal global i32 7
+@stored = global i32 10
+@passed = global i32 11
+@referenced = global i32 12
+@sectioned = global i32 8, section "foo"
+
+declare void @use(i32*)
+
+define void @bump() {
+  %v = load i32, i32* @counter
+  %inc = add i32 %v, 1
+  store i32 %inc, i32* @counter
+  call void @use(i32* @escaped)
+  ret void
+}
+
+define i32 @get_local() {
+  %v = load i32, i32* @local
+  ret i32 %v
+}
@@ -0,0 +1,15 @@
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@stored = external global i32
+@passed = external global i32
+@referenced = external global i32
+@ptr = global i32* @referenced
+
+declare void @use(i32*)
+
+define void @writer() {
+  store i32 1, i32* @stored
+  call void @use(i32* @passed)
+  ret void
+}
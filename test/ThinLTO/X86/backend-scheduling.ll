@@ -0,0 +1,39 @@
+; Check that the ThinLTO backend jobs are started most expensive first, as
+; estimated from the instruction counts in the combined index.
+; RUN: opt -module-summary %s -o %t1.bc
+; RUN: opt -module-summary %p/Inputs/backend-scheduling.ll -o %t2.bc
+
+; RUN: llvm-lto2 %t1.bc %t2.bc -o %t.o -thinlto-backend-stats \
+; RUN:     -r=%t1.bc,_small,plx \
+; RUN:     -r=%t2.bc,_big,plx 2>&1 | FileCheck %s
+
+; A memory limit that no job fits in runs them one at a time, in the same
+; order. Outputs keep the task numbers of their modules.
+; RUN: llvm-lto2 %t1.bc %t2.bc -o %t.o -thinlto-backend-stats \
+; RUN:     -thinlto-backend-memory-limit=1 \
+; RUN:     -thinlto-backend-bytes-per-inst=1000000 \
+; RUN:     -r=%t1.bc,_small,plx \
+; RUN:     -r=%t2.bc,_big,plx 2>&1 | FileCheck %s
+; RUN: llvm-nm %t.o.0 | FileCheck %s --check-prefix=NM0
+; RUN: llvm-nm %t.o.1 | FileCheck %s --check-prefix=NM1
+; NM0: T _small
+; NM1: T _big
+
+; The legacy ThinLTO code generator uses the same schedule.
+; RUN: llvm-lto -thinlto-action=run -thinlto-backend-stats \
+; RUN:     -exported-symbol=_small -exported-symbol=_big \
+; RUN:     %t1.bc %t2.bc 2>&1 | FileCheck %s
+
+; CHECK: ThinLTO backend jobs, in the order they were started:
+; CHECK-NEXT: Cost Wall time Peak RSS Module
+; CHECK-NEXT: 6 {{[0-9.]+}} s {{[0-9.]+}} MB {{.*}}2.bc
+; CHECK-NEXT: 1 {{[0-9.]+}} s {{[0-9.]+}} MB {{.*}}1.bc
+; CHECK-NEXT: 2 jobs in {{[0-9.]+}} s, peak RSS {{[0-9.]+}} MB
+
+target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-apple-macosx10.11.0"
+
+define void @small() {
+entry:
+  ret void
+}
@@ -27,15 +27,35 @@
 ; RUN: rm -Rf %t.cache && mkdir %t.cache
 ; RUN: llvm-lto -thinlto-action=run -exported-symbol=globalfunc %t2.bc  %t.bc -thinlto-cache-dir %t.cache
 ; RUN: ls %t.cache/llvmcache.timestamp
-; RUN: ls %t.cache | count 3
+; RUN: ls %t.cache/llvmcache.index
+; RUN: ls %t.cache | count 4
 
-; Verify that enabling caching is working with llvm-lto2
+; Verify that enabling caching is working with llvm-lto2: the entries are
+; committed from temporary files in the cache directory, and recorded in the
+; access index.
 ; RUN: rm -Rf %t.cache && mkdir %t.cache
-; RUN: llvm-lto2 -o %t.o %t2.bc  %t.bc -cache-dir %t.cache \
+; RUN: llvm-lto2 -o %t.o %t2.bc  %t.bc -cache-dir %t.cache -cache-stats \
 ; RUN:  -r=%t2.bc,_main,plx \
 ; RUN:  -r=%t2.bc,_globalfunc,lx \
-; RUN:  -r=%t.bc,_globalfunc,plx
-; RUN: ls %t.cache | count 2
+; RUN:  -r=%t.bc,_globalfunc,plx 2>&1 | FileCheck %s --check-prefix=MISS
+; RUN: ls %t.cache | count 3
+; RUN: FileCheck %s --check-prefix=INDEX < %t.cache/llvmcache.index
+; RUN: cp %t.o.0 %t.cold.o.0
+; RUN: cp %t.o.1 %t.cold.o.1
+
+; The second link hits both entries, and produces the same objects.
+; RUN: llvm-lto2 -o %t.o %t2.bc  %t.bc -cache-dir %t.cache -cache-stats \
+; RUN:  -r=%t2.bc,_main,plx \
+; RUN:  -r=%t2.bc,_globalfunc,lx \
+; RUN:  -r=%t.bc,_globalfunc,plx 2>&1 | FileCheck %s --check-prefix=HIT
+; RUN: cmp %t.o.0 %t.cold.o.0
+; RUN: cmp %t.o.1 %t.cold.o.1
+; RUN: ls %t.cache | count 3
+
+; MISS: ThinLTO cache hits: 0 (0 bytes), misses: 2 ({{[1-9][0-9]*}} bytes written)
+; HIT: ThinLTO cache hits: 2 ({{[1-9][0-9]*}} bytes), misses: 0 (0 bytes written)
+; INDEX: {{^[0-9]+ [0-9]+ [0-9A-F]{40}$}}
+; INDEX-NEXT: {{^[0-9]+ [0-9]+ [0-9A-F]{40}$}}
 
 target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
 target triple = "x86_64-apple-macosx10.11.0"
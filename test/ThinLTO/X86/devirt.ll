@@ -0,0 +1,132 @@
+; REQUIRES: asserts
+; RUN: opt -module-summary %s -o %t1.bc
+; RUN: opt -module-summary %p/Inputs/devirt.ll -o %t2.bc
+
+; The summaries record the virtual calls, the vtables and the functions that
+; return a constant.
+; RUN: llvm-bcanalyzer -dump %t1.bc | FileCheck %s --check-prefix=CALLS
+; CALLS: <TYPE_TEST_ASSUME_VCALLS
+; RUN: llvm-bcanalyzer -dump %t2.bc | FileCheck %s --check-prefix=VTABLES
+; VTABLES-DAG: <CONSTANT_RETURN op0=32 op1=7/>
+; VTABLES-DAG: <VTABLE_TYPE_IDS op0=24 op1=1
+; VTABLES-DAG: <VTABLE_TYPE_IDS op0=8 op1=0
+; VTABLES-DAG: <VTABLE_FUNCS
+
+; RUN: llvm-lto2 %t1.bc %t2.bc -o %t.o -save-temps -stats \
+; RUN:   -r=%t1.bc,call_single,px \
+; RUN:   -r=%t1.bc,call_uniform,px \
+; RUN:   -r=%t1.bc,call_vcp,px \
+; RUN:   -r=%t1.bc,call_nonconst,px \
+; RUN:   -r=%t1.bc,call_writable,px \
+; RUN:   -r=%t2.bc,vt_single,px \
+; RUN:   -r=%t2.bc,vt_b,px \
+; RUN:   -r=%t2.bc,vt_c,px \
+; RUN:   -r=%t2.bc,b_uniform,px \
+; RUN:   -r=%t2.bc,c_uniform,px \
+; RUN:   -r=%t2.bc,b_vcp,px \
+; RUN:   -r=%t2.bc,c_vcp,px \
+; RUN:   -r=%t2.bc,vt_w_const,px \
+; RUN:   -r=%t2.bc,vt_w,px \
+; RUN:   -r=%t2.bc,w_impl,px \
+; RUN:   -r=%t2.bc,b_nonconst,px \
+; RUN:   -r=%t2.bc,c_nonconst,px 2>&1 | FileCheck %s --check-prefix=STATS
+; RUN: llvm-dis %t.o.0.3.import.bc -o - | FileCheck %s --check-prefix=CALLER
+; RUN: llvm-dis %t.o.1.3.import.bc -o - | FileCheck %s --check-prefix=VTABLE
+
+; STATS-DAG: 3 wholeprogramdevirt - Number of virtual calls devirtualized in ThinLTO backends
+; STATS-DAG: 1 wholeprogramdevirt - Number of virtual function slots devirtualized to their single implementation
+; STATS-DAG: 1 wholeprogramdevirt - Number of virtual function slots whose calls load their return value from the vtable
+; STATS-DAG: 1 wholeprogramdevirt - Number of virtual function slots whose calls were replaced by a uniform return value
+; STATS-DAG: 2 wholeprogramdevirt - Number of vtables rebuilt with return values in ThinLTO backends
+
+; The local implementation is called by its promoted name.
+; CALLER-LABEL: define i32 @call_single(
+; CALLER: call i32 @single_impl.llvm.{{.*}}(i8* %obj, i32 1)
+; CALLER-LABEL: define i32 @call_uniform(
+; CALLER-NOT: call
+; CALLER: ret i32 7
+; CALLER-LABEL: define i32 @call_vcp(
+; CALLER: [[ADDR:%.*]] = getelementptr i8, i8* %vtablei8, i64 -4
+; CALLER: [[PTR:%.*]] = bitcast i8* [[ADDR]] to i32*
+; CALLER: [[VAL:%.*]] = load i32, i32* [[PTR]]
+; CALLER: ret i32 [[VAL]]
+; CALLER-LABEL: define i32 @call_nonconst(
+; CALLER: call i32 %fptr_casted(
+; CALLER-LABEL: define i32 @call_writable(
+; CALLER: call i32 %fptr_casted(
+
+; VTABLE-DAG: @vt_b = alias [3 x i8*], getelementptr inbounds ({ [8 x i8], [3 x i8*], [0 x i8] }, { [8 x i8], [3 x i8*], [0 x i8] }* [[VTB:@.*]], i32 0, i32 1)
+; VTABLE-DAG: [[VTB]] = private constant { [8 x i8], [3 x i8*], [0 x i8] } { [8 x i8] c"\00\00\00\00\01\00\00\00",
+; VTABLE-DAG: [[VTC:@.*]] = private constant { [8 x i8], [3 x i8*], [0 x i8] } { [8 x i8] c"\00\00\00\00\02\00\00\00",
+; VTABLE-DAG: define hidden i32 @single_impl.llvm.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @call_single(i8* %obj) {
+  %vtableptr = bitcast i8* %obj to [1 x i8*]**
+  %vtable = load [1 x i8*]*, [1 x i8*]** %vtableptr
+  %vtablei8 = bitcast [1 x i8*]* %vtable to i8*
+  %p = call i1 @llvm.type.test(i8* %vtablei8, metadata !"single")
+  call void @llvm.assume(i1 %p)
+  %fptrptr = getelementptr [1 x i8*], [1 x i8*]* %vtable, i32 0, i32 0
+  %fptr = load i8*, i8** %fptrptr
+  %fptr_casted = bitcast i8* %fptr to i32 (i8*, i32)*
+  %result = call i32 %fptr_casted(i8* %obj, i32 1)
+  ret i32 %result
+}
+
+define i32 @call_uniform(i8* %obj) {
+  %vtableptr = bitcast i8* %obj to [3 x i8*]**
+  %vtable = load [3 x i8*]*, [3 x i8*]** %vtableptr
+  %vtablei8 = bitcast [3 x i8*]* %vtable to i8*
+  %p = call i1 @llvm.type.test(i8* %vtablei8, metadata !"multi")
+  call void @llvm.assume(i1 %p)
+  %fptrptr = getelementptr [3 x i8*], [3 x i8*]* %vtable, i32 0, i32 0
+  %fptr = load i8*, i8** %fptrptr
+  %fptr_casted = bitcast i8* %fptr to i32 (i8*)*
+  %result = call i32 %fptr_casted(i8* %obj)
+  ret i32 %result
+}
+
+define i32 @call_vcp(i8* %obj) {
+  %vtableptr = bitcast i8* %obj to [3 x i8*]**
+  %vtable = load [3 x i8*]*, [3 x i8*]** %vtableptr
+  %vtablei8 = bitcast [3 x i8*]* %vtable to i8*
+  %p = call i1 @llvm.type.test(i8* %vtablei8, metadata !"multi")
+  call void @llvm.assume(i1 %p)
+  %fptrptr = getelementptr [3 x i8*], [3 x i8*]* %vtable, i32 0, i32 1
+  %fptr = load i8*, i8** %fptrptr
+  %fptr_casted = bitcast i8* %fptr to i32 (i8*)*
+  %result = call i32 %fptr_casted(i8* %obj)
+  ret i32 %result
+}
+
+define i32 @call_nonconst(i8* %obj) {
+  %vtableptr = bitcast i8* %obj to [3 x i8*]**
+  %vtable = load [3 x i8*]*, [3 x i8*]** %vtableptr
+  %vtablei8 = bitcast [3 x i8*]* %vtable to i8*
+  %p = call i1 @llvm.type.test(i8* %vtablei8, metadata !"multi")
+  call void @llvm.assume(i1 %p)
+  %fptrptr = getelementptr [3 x i8*], [3 x i8*]* %vtable, i32 0, i32 2
+  %fptr = load i8*, i8** %fptrptr
+  %fptr_casted = bitcast i8* %fptr to i32 (i8*, i32)*
+  %result = call i32 %fptr_casted(i8* %obj, i32 1)
+  ret i32 %result
+}
+
+define i32 @call_writable(i8* %obj) {
+  %vtableptr = bitcast i8* %obj to [1 x i8*]**
+  %vtable = load [1 x i8*]*, [1 x i8*]** %vtableptr
+  %vtablei8 = bitcast [1 x i8*]* %vtable to i8*
+  %p = call i1 @llvm.type.test(i8* %vtablei8, metadata !"writable")
+  call void @llvm.assume(i1 %p)
+  %fptrptr = getelementptr [1 x i8*], [1 x i8*]* %vtable, i32 0, i32 0
+  %fptr = load i8*, i8** %fptrptr
+  %fptr_casted = bitcast i8* %fptr to i32 (i8*)*
+  %result = call i32 %fptr_casted(i8* %obj)
+  ret i32 %result
+}
+
+declare i1 @llvm.type.test(i8*, metadata)
+declare void @llvm.assume(i1)
@@ -5,13 +5,14 @@
 ; RUN: rm -Rf %t.cache && mkdir %t.cache
 ; RUN: llvm-lto -thinlto-action=run %t2.bc  %t.bc -exported-symbol=main -thinlto-cache-dir %t.cache
 ; RUN: ls %t.cache/llvmcache.timestamp
-; RUN: ls %t.cache | count 3
+; RUN: ls %t.cache/llvmcache.index
+; RUN: ls %t.cache | count 4
 
 ; Verify that enabling caching is working with llvm-lto2
 ; RUN: rm -Rf %t.cache && mkdir %t.cache
 ; RUN: llvm-lto2 -o %t.o %t2.bc  %t.bc -cache-dir %t.cache \
 ; RUN:  -r=%t2.bc,_main,plx
-; RUN: ls %t.cache | count 2
+; RUN: ls %t.cache | count 3
 
 ; Same, but without hash, the index will be empty and caching should not happen
 
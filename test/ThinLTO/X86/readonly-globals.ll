@@ -0,0 +1,120 @@
+; RUN: opt -module-summary %s -o %t1.bc
+; RUN: opt -module-summary %p/Inputs/readonly-globals.ll -o %t2.bc
+; RUN: opt -module-summary %p/Inputs/readonly-globals2.ll -o %t3.bc
+
+; The summaries record the references to variables that a module only loads
+; from, and the variables that their module only loads from.
+; RUN: llvm-bcanalyzer -dump %t1.bc | FileCheck %s --check-prefix=REFS
+; REFS: <READONLY_REFS
+; RUN: llvm-bcanalyzer -dump %t2.bc | FileCheck %s --check-prefix=VARS
+; VARS-DAG: <READONLY_GLOBALVAR op0=4/>
+; VARS-DAG: <READONLY_GLOBALVAR op0=16/>
+
+; RUN: llvm-lto2 %t1.bc %t2.bc %t3.bc -o %t.o -save-temps \
+; RUN:   -r=%t1.bc,main,px \
+; RUN:   -r=%t1.bc,others,px \
+; RUN:   -r=%t1.bc,get_local, \
+; RUN:   -r=%t1.bc,config, \
+; RUN:   -r=%t1.bc,table, \
+; RUN:   -r=%t1.bc,counter, \
+; RUN:   -r=%t1.bc,escaped, \
+; RUN:   -r=%t1.bc,visible, \
+; RUN:   -r=%t1.bc,stored, \
+; RUN:   -r=%t1.bc,passed, \
+; RUN:   -r=%t1.bc,referenced, \
+; RUN:   -r=%t1.bc,sectioned, \
+; RUN:   -r=%t2.bc,config,p \
+; RUN:   -r=%t2.bc,table,p \
+; RUN:   -r=%t2.bc,counter,p \
+; RUN:   -r=%t2.bc,escaped,p \
+; RUN:   -r=%t2.bc,visible,px \
+; RUN:   -r=%t2.bc,use, \
+; RUN:   -r=%t2.bc,bump,px \
+; RUN:   -r=%t2.bc,get_local,p \
+; RUN:   -r=%t2.bc,stored,p \
+; RUN:   -r=%t2.bc,passed,p \
+; RUN:   -r=%t2.bc,referenced,p \
+; RUN:   -r=%t2.bc,sectioned,p \
+; RUN:   -r=%t3.bc,stored, \
+; RUN:   -r=%t3.bc,passed, \
+; RUN:   -r=%t3.bc,referenced, \
+; RUN:   -r=%t3.bc,ptr,px \
+; RUN:   -r=%t3.bc,writer,px \
+; RUN:   -r=%t3.bc,use,
+; RUN: llvm-dis %t.o.0.3.import.bc -o - | FileCheck %s --check-prefix=IMPORT
+; RUN: llvm-dis %t.o.0.4.opt.bc -o - | FileCheck %s --check-prefix=OPT
+; RUN: llvm-dis %t.o.1.2.internalize.bc -o - | FileCheck %s --check-prefix=DEF
+
+; Only the variables that no module writes to, takes the address of or lets
+; the linker see are imported, as internal constants. Another module storing
+; to a variable, passing its address to a call or referencing it from an
+; initializer keeps it from being imported, as does an explicit section.
+; IMPORT-DAG: @config = internal constant i32 42
+; IMPORT-DAG: @table = internal constant [4 x i32] [i32 1, i32 2, i32 3, i32 4]
+; IMPORT-DAG: @counter = external global i32
+; IMPORT-DAG: @escaped = external global i32
+; IMPORT-DAG: @visible = external global i32
+; IMPORT-DAG: @local.llvm.{{.*}} = internal constant i32 7
+; IMPORT-DAG: @stored = external global i32
+; IMPORT-DAG: @passed = external global i32
+; IMPORT-DAG: @referenced = external global i32
+; IMPORT-DAG: @sectioned = external global i32
+
+; Loads from the imported copies fold: 49 is @config plus @local.
+; OPT-LABEL: define i32 @main(
+; OPT-NOT: load i32, i32* @config
+; OPT: add i32 %t, 49
+
+; The defining module no longer needs to export the read-only variables.
+; DEF-DAG: @config = internal global i32 42
+; DEF-DAG: @table = internal global [4 x i32]
+; DEF-DAG: @counter = global i32 0
+; DEF-DAG: @escaped = global i32 5
+; DEF-DAG: @visible = global i32 6
+; DEF-DAG: @local = internal global i32 7
+; DEF-DAG: @stored = global i32 10
+; DEF-DAG: @passed = global i32 11
+; DEF-DAG: @referenced = global i32 12
+; DEF-DAG: @sectioned = global i32 8, section "foo"
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@config = external global i32
+@table = external global [4 x i32]
+@counter = external global i32
+@escaped = external global i32
+@visible = external global i32
+@stored = external global i32
+@passed = external global i32
+@referenced = external global i32
+@sectioned = external global i32
+
+declare i32 @get_local()
+
+define i32 @main(i32 %i) {
+  %config = load i32, i32* @config
+  %p = getelementptr [4 x i32], [4 x i32]* @table, i32 0, i32 %i
+  %t = load i32, i32* %p
+  %counter = load i32, i32* @counter
+  %escaped = load i32, i32* @escaped
+  %visible = load i32, i32* @visible
+  %local = call i32 @get_local()
+  %a = add i32 %config, %t
+  %b = add i32 %a, %counter
+  %c = add i32 %b, %escaped
+  %d = add i32 %c, %visible
+  %e = add i32 %d, %local
+  ret i32 %e
+}
+
+define i32 @others() {
+  %stored = load i32, i32* @stored
+  %passed = load i32, i32* @passed
+  %referenced = load i32, i32* @referenced
+  %sectioned = load i32, i32* @sectioned
+  %a = add i32 %stored, %passed
+  %b = add i32 %a, %referenced
+  %c = add i32 %b, %sectioned
+  ret i32 %c
+}
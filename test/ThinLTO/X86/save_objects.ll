@@ -11,14 +11,14 @@
 ; RUN: rm -Rf %t.cache && mkdir %t.cache
 ; RUN: llvm-lto -thinlto-save-objects=%t.thin.out -thinlto-action=run %t2.bc  %t.bc -exported-symbol=main -thinlto-cache-dir %t.cache 
 ; RUN: ls %t.thin.out | count 2
-; RUN: ls %t.cache | count 3
+; RUN: ls %t.cache | count 4
 
 ; Same with hot cache
 ; RUN: rm -Rf %t.thin.out
 ; RUN: rm -Rf %t.cache && mkdir %t.cache
 ; RUN: llvm-lto -thinlto-save-objects=%t.thin.out -thinlto-action=run %t2.bc  %t.bc -exported-symbol=main -thinlto-cache-dir %t.cache 
 ; RUN: ls %t.thin.out | count 2
-; RUN: ls %t.cache | count 3
+; RUN: ls %t.cache | count 4
 
 
 target datalayout = "e-m:o-i64:64-f80:128-n8:16:32:64-S128"
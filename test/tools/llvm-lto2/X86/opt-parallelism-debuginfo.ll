@@ -0,0 +1,38 @@
+; RUN: llvm-as %s -o %t.bc
+; RUN: llvm-lto2 -o %t.o %t.bc -r %t.bc,foo,px -r %t.bc,bar,px \
+; RUN:   -opt-parallelism=2 -save-temps
+; RUN: llvm-dis < %t.o.0.4.opt.bc | FileCheck %s
+
+; Modules with debug info are not split: linking the partitions back together
+; would leave one copy of the compile unit per partition.
+
+; CHECK: !llvm.dbg.cu = !{![[CU:[0-9]+]]}
+; CHECK: ![[CU]] = distinct !DICompileUnit(
+; CHECK-NOT: !DICompileUnit(
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @foo(i32 %x) !dbg !6 {
+  %y = add i32 %x, 0, !dbg !9
+  ret i32 %y, !dbg !9
+}
+
+define i32 @bar(i32 %x) !dbg !10 {
+  %y = mul i32 %x, 1, !dbg !11
+  ret i32 %y, !dbg !11
+}
+
+!llvm.dbg.cu = !{!0}
+!llvm.module.flags = !{!3, !4}
+
+!0 = distinct !DICompileUnit(language: DW_LANG_C99, file: !1, producer: "clang", isOptimized: true, runtimeVersion: 0, emissionKind: FullDebug, enums: !2)
+!1 = !DIFile(filename: "t.c", directory: "/tmp")
+!2 = !{}
+!3 = !{i32 2, !"Dwarf Version", i32 4}
+!4 = !{i32 2, !"Debug Info Version", i32 3}
+!5 = !DISubroutineType(types: !2)
+!6 = distinct !DISubprogram(name: "foo", scope: !1, file: !1, line: 1, type: !5, isLocal: false, isDefinition: true, scopeLine: 1, isOptimized: true, unit: !0, variables: !2)
+!9 = !DILocation(line: 1, column: 1, scope: !6)
+!10 = distinct !DISubprogram(name: "bar", scope: !1, file: !1, line: 2, type: !5, isLocal: false, isDefinition: true, scopeLine: 2, isOptimized: true, unit: !0, variables: !2)
+!11 = !DILocation(line: 2, column: 1, scope: !10)
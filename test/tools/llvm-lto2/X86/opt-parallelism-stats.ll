@@ -0,0 +1,27 @@
+; REQUIRES: asserts
+; RUN: llvm-as %s -o %t.bc
+; RUN: llvm-lto2 -o %t.o %t.bc -r %t.bc,foo,px -r %t.bc,bar,px \
+; RUN:   -opt-parallelism=2 -stats 2>&1 | FileCheck %s --check-prefix=SPLIT
+; RUN: llvm-lto2 -o %t.o %t.bc -r %t.bc,foo,px -r %t.bc,bar,px \
+; RUN:   -opt-parallelism=2 -O1 -stats 2>&1 | FileCheck %s --check-prefix=NOSPLIT
+; RUN: llvm-lto2 -o %t.o %t.bc -r %t.bc,foo,px -r %t.bc,bar,px \
+; RUN:   -stats 2>&1 | FileCheck %s --check-prefix=NOSPLIT
+
+; The module is split into -opt-parallelism partitions, which are optimized
+; concurrently, unless the function simplification passes run below -O2 or
+; on a single thread.
+; SPLIT: 2 lto-backend - Number of partitions of the module optimized concurrently
+; NOSPLIT-NOT: lto-backend
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+define i32 @foo(i32 %x) {
+  %y = add i32 %x, 0
+  ret i32 %y
+}
+
+define i32 @bar(i32 %x) {
+  %y = mul i32 %x, 1
+  ret i32 %y
+}
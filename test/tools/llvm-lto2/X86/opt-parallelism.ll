@@ -0,0 +1,41 @@
+; RUN: llvm-as %s -o %t.bc
+; RUN: llvm-lto2 -o %t.o %t.bc -r %t.bc,foo,px -r %t.bc,bar,px -r %t.bc,baz,px \
+; RUN:   -opt-parallelism=2 -save-temps
+; RUN: llvm-dis < %t.o.0.4.opt.bc -o %t.opt.ll
+; RUN: FileCheck --check-prefix=FOO %s < %t.opt.ll
+; RUN: FileCheck --check-prefix=BAR %s < %t.opt.ll
+; RUN: FileCheck --check-prefix=BAZ %s < %t.opt.ll
+
+; The function simplification passes run on separate partitions of the module,
+; which are linked back together afterwards, in no particular order.
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+@g = internal global i32 0
+
+; FOO: define i32 @foo(i32 {{[^%]*}}[[X:%[0-9a-z]+]])
+; FOO-NEXT: ret i32 [[X]]
+define i32 @foo(i32 %x) {
+  %p = alloca i32
+  store i32 %x, i32* %p
+  %v = load i32, i32* %p
+  ret i32 %v
+}
+
+; BAR: define void @bar(i32 {{[^%]*}}[[X:%[0-9a-z]+]])
+; BAR-NEXT: store i32 [[X]], i32* @g
+define void @bar(i32 %x) {
+  %y = add i32 %x, 0
+  store i32 %y, i32* @g
+  ret void
+}
+
+; BAZ: define i32 @baz()
+; BAZ-NEXT: [[V:%[0-9a-z]+]] = load i32, i32* @g
+; BAZ-NEXT: ret i32 [[V]]
+define i32 @baz() {
+  %v = load i32, i32* @g
+  %w = mul i32 %v, 1
+  ret i32 %w
+}
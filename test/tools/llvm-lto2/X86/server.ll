@@ -0,0 +1,73 @@
+; REQUIRES: shell
+; UNSUPPORTED: system-windows
+
+; The socket is created in the current directory, as the path of the test
+; directory may be too long for a socket address.
+; RUN: rm -rf %t.dir && mkdir -p %t.dir && cd %t.dir
+; RUN: opt -module-summary %s -o main.bc
+; RUN: opt -module-summary %p/Inputs/server.ll -o foo.bc
+
+; The server stops on its own if the test fails before stopping it.
+; RUN: (llvm-lto2 -serve=lto.sock -serve-stats -serve-idle-timeout=60 \
+; RUN:   > server.log 2>&1 &)
+
+; RUN: llvm-lto2 -connect=lto.sock -o out main.bc foo.bc \
+; RUN:   -r main.bc,main,plx -r main.bc,foo, -r foo.bc,foo,pl \
+; RUN:   -r foo.bc,baz,plx 2>&1 | \
+; RUN:   FileCheck %s --check-prefix=COLD
+; COLD: the server had 0 of 2 inputs parsed already
+
+; The server links like llvm-lto2 itself, given the absolute paths of the
+; inputs, which become the module identifiers.
+; RUN: llvm-lto2 -o ref %t.dir/main.bc %t.dir/foo.bc \
+; RUN:   -r %t.dir/main.bc,main,plx -r %t.dir/main.bc,foo, \
+; RUN:   -r %t.dir/foo.bc,foo,pl -r %t.dir/foo.bc,baz,plx
+; RUN: cmp out.0 ref.0
+; RUN: cmp out.1 ref.1
+
+; RUN: llvm-lto2 -connect=lto.sock -o out main.bc foo.bc \
+; RUN:   -r main.bc,main,plx -r main.bc,foo, -r foo.bc,foo,pl \
+; RUN:   -r foo.bc,baz,plx 2>&1 | \
+; RUN:   FileCheck %s --check-prefix=WARM
+; WARM: the server had 2 of 2 inputs parsed already
+; RUN: cmp out.0 ref.0
+; RUN: cmp out.1 ref.1
+
+; A failed link doesn't take the server down.
+; RUN: not llvm-lto2 -connect=lto.sock -o out main.bc foo.bc \
+; RUN:   -r main.bc,main,plx -r main.bc,foo, 2>&1 | \
+; RUN:   FileCheck %s --check-prefix=ERR
+; ERR: missing symbol resolution for foo.bc,foo
+
+; Inputs that changed are loaded again.
+; RUN: opt -module-summary %p/Inputs/server2.ll -o foo.bc
+; RUN: llvm-lto2 -connect=lto.sock -o out main.bc foo.bc \
+; RUN:   -r main.bc,main,plx -r main.bc,foo, -r foo.bc,foo,pl \
+; RUN:   -r foo.bc,bar,plx 2>&1 | FileCheck %s --check-prefix=CHANGED
+; CHANGED: the server had 1 of 2 inputs parsed already
+; RUN: llvm-nm out.1 | FileCheck %s --check-prefix=NM
+; NM: T bar
+; NM: T foo
+
+; Paths are resolved against the working directory of the client, and inputs
+; are known by their absolute path, whatever the client calls them.
+; RUN: mkdir -p sub && (cd sub && llvm-lto2 -connect=../lto.sock -o out \
+; RUN:   ../main.bc ../foo.bc -r ../main.bc,main,plx -r ../main.bc,foo, \
+; RUN:   -r ../foo.bc,foo,pl -r ../foo.bc,bar,plx 2>&1) | \
+; RUN:   FileCheck %s --check-prefix=SUBDIR
+; SUBDIR: the server had 2 of 2 inputs parsed already
+; RUN: llvm-nm sub/out.1 | FileCheck %s --check-prefix=NM
+
+; The socket is removed by the time the server answers.
+; RUN: llvm-lto2 -connect=lto.sock -stop-server
+; RUN: test ! -e lto.sock
+
+target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"
+target triple = "x86_64-unknown-linux-gnu"
+
+declare i32 @foo()
+
+define i32 @main() {
+  %1 = call i32 @foo()
+  ret i32 %1
+}
@@ -167,6 +167,8 @@ namespace options {
   static std::string thinlto_prefix_replace;
   // Optional path to a directory for caching ThinLTO objects.
   static std::string cache_dir;
+  // Print the hits, misses and bytes of the cache.
+  static bool cache_stats = false;
   // Additional options to pass into the code generator.
   // Note: This array will contain all plugin options which are not claimed
   // as plugin exclusive to pass to the code generator.
@@ -209,6 +211,8 @@ namespace options {
         message(LDPL_FATAL, "thinlto-prefix-replace expects 'old;new' format");
     } else if (opt.startswith("cache-dir=")) {
       cache_dir = opt.substr(strlen("cache-dir="));
+    } else if (opt == "cache-stats") {
+      cache_stats = true;
     } else if (opt.size() == 2 && opt[0] == 'O') {
       if (opt[1] < '0' || opt[1] > '3')
         message(LDPL_FATAL, "Optimization level must be between 0 and 3");
@@ -831,14 +835,27 @@ static ld_plugin_status allSymbolsReadHook() {
         llvm::make_unique<llvm::raw_fd_ostream>(FD, true));
   };
 
-  auto AddFile = [&](size_t Task, StringRef Path) { Filenames[Task] = Path; };
+  // Cached objects are copied from the mapped entries to the output files of
+  // their tasks, so that the linker still finds them if a concurrent link
+  // prunes the cache in the meantime.
+  auto AddBuffer = [&](size_t Task, std::unique_ptr<MemoryBuffer> MB) {
+    *AddStream(Task)->OS << MB->getBuffer();
+  };
 
   NativeObjectCache Cache;
+  CacheStats Stats;
   if (!options::cache_dir.empty())
-    Cache = localCache(options::cache_dir, AddFile);
+    Cache = localCache(options::cache_dir, AddBuffer, &Stats);
 
   check(Lto->run(AddStream, Cache));
 
+  if (!options::cache_dir.empty() && options::cache_stats) {
+    std::string Message;
+    raw_string_ostream OS(Message);
+    Stats.print(OS);
+    message(LDPL_INFO, "%s", OS.str().c_str());
+  }
+
   if (options::TheOutputType == options::OT_DISABLE ||
       options::TheOutputType == options::OT_BC_ONLY)
     return LDPS_OK;
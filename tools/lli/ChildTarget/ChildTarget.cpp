@@ -1,5 +1,6 @@
 #include "llvm/ExecutionEngine/Orc/OrcABISupport.h"
 #include "llvm/ExecutionEngine/Orc/OrcRemoteTargetServer.h"
+#include "llvm/ExecutionEngine/Orc/SharedMemoryRawChannel.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/DynamicLibrary.h"
 #include "llvm/Support/Process.h"
@@ -21,8 +22,9 @@ ExitOnError ExitOnErr;
 
 int main(int argc, char *argv[]) {
 
-  if (argc != 3) {
-    errs() << "Usage: " << argv[0] << " <input fd> <output fd>\n";
+  if (argc != 3 && argc != 4) {
+    errs() << "Usage: " << argv[0]
+           << " <input fd> <output fd> [<shared memory fd>]\n";
     return 1;
   }
 
@@ -53,12 +55,40 @@ int main(int argc, char *argv[]) {
     RTDyldMemoryManager::deregisterEHFramesInProcess(Addr, Size);
   };
 
-  FDRawChannel Channel(InFD, OutFD);
-  typedef remote::OrcRemoteTargetServer<FDRawChannel, HostOrcArch> JITServer;
-  JITServer Server(Channel, SymbolLookup, RegisterEHFrames, DeregisterEHFrames);
+  // With a shared memory region, the pipes only carry wake-ups.
+  std::unique_ptr<rpc::RawByteChannel> Channel;
+  rpc::SharedMemoryRawChannel *SharedChannel = nullptr;
+  if (argc == 4) {
+    int SharedMemoryFD;
+    std::istringstream SharedMemoryFDStream(argv[3]);
+    SharedMemoryFDStream >> SharedMemoryFD;
+    auto C = ExitOnErr(
+        rpc::SharedMemoryRawChannel::attach(SharedMemoryFD, InFD, OutFD));
+    SharedChannel = C.get();
+    Channel = std::move(C);
+  } else
+    Channel = llvm::make_unique<FDRawChannel>(InFD, OutFD);
+
+  typedef remote::OrcRemoteTargetServer<rpc::RawByteChannel, HostOrcArch>
+      JITServer;
+  JITServer Server(*Channel, SymbolLookup, RegisterEHFrames,
+                   DeregisterEHFrames);
+
+  // Place JIT'd code and data in the shared heap, where the JIT can write it
+  // directly.
+  if (SharedChannel)
+    Server.setMemoryAllocator(
+        [=](uint64_t Size) {
+          return SharedChannel->allocateSharedMemory(Size);
+        },
+        [=](sys::MemoryBlock &Block) {
+          return SharedChannel->releaseSharedMemory(Block);
+        });
 
   while (!Server.receivedTerminate())
     ExitOnErr(Server.handleOne());
+  // Deliver the response to the terminate call.
+  ExitOnErr(Channel->send());
 
   close(InFD);
   close(OutFD);
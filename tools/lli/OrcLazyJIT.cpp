@@ -8,9 +8,19 @@
 //===----------------------------------------------------------------------===//
 
 #include "OrcLazyJIT.h"
+#include "llvm/Analysis/TargetLibraryInfo.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/Bitcode/BitcodeReader.h"
+#include "llvm/Bitcode/BitcodeWriter.h"
 #include "llvm/ExecutionEngine/Orc/OrcABISupport.h"
+#include "llvm/IR/Dominators.h"
+#include "llvm/IR/LegacyPassManager.h"
 #include "llvm/Support/Debug.h"
 #include "llvm/Support/DynamicLibrary.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Transforms/IPO.h"
+#include "llvm/Transforms/IPO/PassManagerBuilder.h"
+#include "llvm/Transforms/Utils/BasicBlockUtils.h"
 #include <cstdio>
 #include <system_error>
 
@@ -43,6 +53,36 @@ namespace {
   cl::opt<bool> OrcInlineStubs("orc-lazy-inline-stubs",
                                cl::desc("Try to inline stubs"),
                                cl::init(true), cl::Hidden);
+
+  cl::opt<bool> OrcBackgroundCompile(
+      "orc-lazy-background-compile",
+      cl::desc("Speculatively compile the callees of compiled functions on a "
+               "background thread"),
+      cl::init(false), cl::Hidden);
+
+  cl::opt<bool> OrcTiered(
+      "orc-lazy-tiered",
+      cl::desc("Compile functions without optimization first, and recompile "
+               "them with optimization once they get hot"),
+      cl::init(false), cl::Hidden);
+
+  cl::opt<unsigned> OrcTierUpThreshold(
+      "orc-lazy-tier-up-threshold",
+      cl::desc("Number of calls and loop iterations after which a function "
+               "is recompiled with optimization in the tiered mode"),
+      cl::init(1000), cl::Hidden);
+
+  cl::opt<unsigned> OrcTierUpOptLevel(
+      "orc-lazy-tier-up-opt-level",
+      cl::desc("IR optimization level of recompiled functions in the tiered "
+               "mode"),
+      cl::init(2), cl::Hidden);
+
+  cl::opt<bool> OrcCompileStats(
+      "orc-lazy-compile-stats",
+      cl::desc("Print the time spent waiting for functions to be compiled on "
+               "their first call"),
+      cl::init(false), cl::Hidden);
 }
 
 OrcLazyJIT::TransformFtor OrcLazyJIT::createDebugDumper() {
@@ -95,6 +135,178 @@ OrcLazyJIT::TransformFtor OrcLazyJIT::createDebugDumper() {
   llvm_unreachable("Unknown DumpKind");
 }
 
+OrcLazyJIT::TransformFtor OrcLazyJIT::createTier0Transform(bool Tiered) {
+  TransformFtor Dump = createDebugDumper();
+  if (!Tiered)
+    return Dump;
+  return [this, Dump](std::unique_ptr<Module> M) {
+    return Dump(addTierUpCounters(std::move(M)));
+  };
+}
+
+OrcLazyJIT::TransformFtor OrcLazyJIT::createOptimizer(TargetMachine &TM,
+                                                      unsigned OptLevel) {
+  return [&TM, OptLevel](std::unique_ptr<Module> M) {
+    // Stubs cloned into the partition load the address of their function
+    // from the stub pointer, which the optimized code cannot link against.
+    // Call the stubs instead.
+    for (auto &F : *M)
+      if (F.hasAvailableExternallyLinkage())
+        F.deleteBody();
+
+    legacy::FunctionPassManager FPM(M.get());
+    legacy::PassManager MPM;
+    TargetLibraryInfoImpl TLII(TM.getTargetTriple());
+    MPM.add(new TargetLibraryInfoWrapperPass(TLII));
+    MPM.add(createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+    FPM.add(createTargetTransformInfoWrapperPass(TM.getTargetIRAnalysis()));
+
+    PassManagerBuilder Builder;
+    Builder.OptLevel = OptLevel;
+    Builder.Inliner = createFunctionInliningPass(OptLevel, 0);
+    Builder.LibraryInfo = new TargetLibraryInfoImpl(TLII);
+    Builder.populateFunctionPassManager(FPM);
+    Builder.populateModulePassManager(MPM);
+
+    FPM.doInitialization();
+    for (auto &F : *M)
+      FPM.run(F);
+    FPM.doFinalization();
+    MPM.run(*M);
+    return M;
+  };
+}
+
+std::unique_ptr<Module>
+OrcLazyJIT::addTierUpCounters(std::unique_ptr<Module> M) {
+  std::vector<Function *> Fns;
+  for (auto &F : *M)
+    if (!F.isDeclaration() && !F.hasAvailableExternallyLinkage())
+      Fns.push_back(&F);
+  // The globals module has nothing to recompile.
+  if (Fns.empty())
+    return M;
+
+  // Keep the uninstrumented partition for the recompilation.
+  auto U = llvm::make_unique<TierUpUnit>();
+  {
+    raw_svector_ostream OS(U->Bitcode);
+    WriteBitcodeToFile(M.get(), OS);
+  }
+  for (auto *F : Fns)
+    U->FnNames.push_back(mangle(F->getName()));
+  uint64_t UnitId;
+  {
+    std::lock_guard<std::mutex> Lock(TierUpMutex);
+    UnitId = TierUpUnits.size();
+    TierUpUnits.push_back(std::move(U));
+  }
+
+  // Every function counts its calls and the iterations of its loops, and
+  // calls tierUpCallback(this, UnitId) when the count reaches the threshold.
+  LLVMContext &Ctx = M->getContext();
+  Type *Int32Ty = Type::getInt32Ty(Ctx);
+  Type *IntPtrTy = M->getDataLayout().getIntPtrType(Ctx);
+  Type *ArgTys[] = {Type::getInt8PtrTy(Ctx), Type::getInt64Ty(Ctx)};
+  FunctionType *CallbackTy =
+      FunctionType::get(Type::getVoidTy(Ctx), ArgTys, false);
+  Constant *Callback = ConstantExpr::getIntToPtr(
+      ConstantInt::get(IntPtrTy, reinterpret_cast<uintptr_t>(&tierUpCallback)),
+      CallbackTy->getPointerTo());
+  Value *Args[] = {
+      ConstantExpr::getIntToPtr(
+          ConstantInt::get(IntPtrTy, reinterpret_cast<uintptr_t>(this)),
+          ArgTys[0]),
+      ConstantInt::get(ArgTys[1], UnitId)};
+
+  for (auto *F : Fns) {
+    auto *Counter = new GlobalVariable(
+        *M, Int32Ty, false, GlobalValue::PrivateLinkage,
+        ConstantInt::get(Int32Ty, 0), F->getName() + "$tier_up_count");
+
+    // Count on entry and on every back edge.
+    std::vector<Instruction *> CountPoints;
+    BasicBlock::iterator EntryPt = F->getEntryBlock().getFirstInsertionPt();
+    while (isa<AllocaInst>(EntryPt))
+      ++EntryPt;
+    CountPoints.push_back(&*EntryPt);
+    DominatorTree DT(*F);
+    for (auto &BB : *F)
+      for (auto *Succ : successors(&BB))
+        if (DT.dominates(Succ, &BB)) {
+          CountPoints.push_back(BB.getTerminator());
+          break;
+        }
+
+    for (auto *I : CountPoints) {
+      IRBuilder<> B(I);
+      Value *Count = B.CreateAdd(B.CreateLoad(Counter), B.getInt32(1));
+      B.CreateStore(Count, Counter);
+      Value *Hot = B.CreateICmpEQ(Count, B.getInt32(TierUpThreshold));
+      B.SetInsertPoint(SplitBlockAndInsertIfThen(Hot, I, false));
+      B.CreateCall(Callback, Args);
+    }
+  }
+  return M;
+}
+
+void OrcLazyJIT::tierUpCallback(OrcLazyJIT *J, uint64_t UnitId) {
+  TierUpUnit *U;
+  {
+    std::lock_guard<std::mutex> Lock(J->TierUpMutex);
+    U = J->TierUpUnits[UnitId].get();
+    // Several functions of the unit, or racing threads, may get hot.
+    if (U->Queued)
+      return;
+    U->Queued = true;
+  }
+  if (J->TierUpPool)
+    J->TierUpPool->async([J, U]() { J->tierUp(*U); });
+  else
+    J->tierUp(*U);
+}
+
+void OrcLazyJIT::tierUp(TierUpUnit &U) {
+  if (ShuttingDown)
+    return;
+
+  // Recompile in a context of our own, so as not to race with tier 0.
+  LLVMContext Ctx;
+  auto MOrErr = parseBitcodeFile(
+      MemoryBufferRef(StringRef(U.Bitcode.data(), U.Bitcode.size()),
+                      "tier-up"),
+      Ctx);
+  if (!MOrErr) {
+    // Keep running the tier 0 code.
+    consumeError(MOrErr.takeError());
+    return;
+  }
+
+  auto Resolver = orc::createLambdaResolver(
+      [this](const std::string &Name) -> JITSymbol {
+        if (auto Sym = CODLayer.findSymbol(Name, false))
+          return Sym;
+        return CXXRuntimeOverrides.searchOverrides(Name);
+      },
+      [](const std::string &Name) {
+        if (auto Addr = RTDyldMemoryManager::getSymbolAddressInProcess(Name))
+          return JITSymbol(Addr, JITSymbolFlags::Exported);
+        return JITSymbol(nullptr);
+      });
+
+  std::vector<std::unique_ptr<Module>> Ms;
+  Ms.push_back(std::move(*MOrErr));
+  auto H = OptimizeLayer->addModuleSet(
+      std::move(Ms), llvm::make_unique<SectionMemoryManager>(MemPool),
+      std::move(Resolver));
+
+  // Swap the optimized bodies in.
+  for (auto &Name : U.FnNames)
+    if (auto Sym = OptimizeLayer->findSymbolIn(H, Name, false))
+      CODLayer.updatePointer(Name, Sym.getAddress());
+  ++NumTierUps;
+}
+
 // Defined in lli.cpp.
 CodeGenOpt::Level getOptLevel();
 
@@ -105,7 +317,9 @@ static PtrTy fromTargetAddress(JITTargetAddress Addr) {
 }
 
 int llvm::runOrcLazyJIT(std::vector<std::unique_ptr<Module>> Ms,
-                        const std::vector<std::string> &Args) {
+                        const std::vector<std::string> &Args,
+                        SectionMemoryPool *MemPool,
+                        JITEventListener *Listener) {
   // Add the program's symbols into the JIT's search space.
   if (sys::DynamicLibrary::LoadLibraryPermanently(nullptr)) {
     errs() << "Error loading program symbols.\n";
@@ -117,6 +331,17 @@ int llvm::runOrcLazyJIT(std::vector<std::unique_ptr<Module>> Ms,
   EngineBuilder EB;
   EB.setOptLevel(getOptLevel());
   auto TM = std::unique_ptr<TargetMachine>(EB.selectTarget());
+
+  // In the tiered mode, the lazy JIT compiles without optimization, using
+  // FastISel, and TM recompiles hot functions.
+  OrcLazyJIT::TierUpOptions TierUp;
+  if (OrcTiered) {
+    TierUp.OptTM = std::move(TM);
+    TierUp.Threshold = OrcTierUpThreshold;
+    TierUp.OptLevel = OrcTierUpOptLevel;
+    EB.setOptLevel(CodeGenOpt::None);
+    TM.reset(EB.selectTarget());
+  }
   Triple T(TM->getTargetTriple());
   auto CompileCallbackMgr = orc::createLocalCompileCallbackManager(T, 0);
 
@@ -140,9 +365,12 @@ int llvm::runOrcLazyJIT(std::vector<std::unique_ptr<Module>> Ms,
   // Everything looks good. Build the JIT.
   OrcLazyJIT J(std::move(TM), std::move(CompileCallbackMgr),
                std::move(IndirectStubsMgrBuilder),
-               OrcInlineStubs);
+               OrcInlineStubs, OrcBackgroundCompile, std::move(TierUp));
 
   // Add the module, look up main and run it.
+  J.setMemoryPool(MemPool);
+  if (Listener)
+    J.registerJITEventListener(*Listener);
   J.addModuleSet(std::move(Ms));
   auto MainSym = J.findSymbol("main");
 
@@ -156,6 +384,21 @@ int llvm::runOrcLazyJIT(std::vector<std::unique_ptr<Module>> Ms,
   for (auto &Arg : Args)
     ArgV.push_back(Arg.c_str());
   auto Main = fromTargetAddress<MainFnPtr>(MainSym.getAddress());
-  return Main(ArgV.size(), (const char**)ArgV.data());
+  int Result = Main(ArgV.size(), (const char**)ArgV.data());
+
+  if (OrcCompileStats) {
+    J.waitForTierUps();
+    auto Stats = J.getCompileStats();
+    auto ToMs = [](std::chrono::nanoseconds T) { return T.count() / 1e6; };
+    errs() << "First-call stalls: " << Stats.NumStalls << " ("
+           << Stats.NumBackgroundHits << " compiled in the background)\n"
+           << "Background compiles: " << Stats.NumBackgroundCompiles << "\n"
+           << "Tier-up recompiles: " << J.getNumTierUps() << "\n"
+           << format("Total stall time: %.3f ms\n",
+                     ToMs(Stats.TotalStallTime))
+           << format("Longest stall: %.3f ms\n", ToMs(Stats.MaxStallTime));
+  }
+
+  return Result;
 }
 
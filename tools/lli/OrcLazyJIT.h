@@ -23,6 +23,9 @@
 #include "llvm/ExecutionEngine/Orc/IRTransformLayer.h"
 #include "llvm/ExecutionEngine/Orc/ObjectLinkingLayer.h"
 #include "llvm/ExecutionEngine/RTDyldMemoryManager.h"
+#include "llvm/Support/ThreadPool.h"
+#include <atomic>
+#include <mutex>
 
 namespace llvm {
 
@@ -30,7 +33,7 @@ class OrcLazyJIT {
 public:
 
   typedef orc::JITCompileCallbackManager CompileCallbackMgr;
-  typedef orc::ObjectLinkingLayer<> ObjLayerT;
+  typedef orc::ObjectLinkingLayer<orc::NotifyJITEventListeners> ObjLayerT;
   typedef orc::IRCompileLayer<ObjLayerT> CompileLayerT;
   typedef std::function<std::unique_ptr<Module>(std::unique_ptr<Module>)>
     TransformFtor;
@@ -40,21 +43,52 @@ public:
     IndirectStubsManagerBuilder;
   typedef CODLayerT::ModuleSetHandleT ModuleSetHandleT;
 
+  /// Settings of the tiered mode. Functions are first compiled by TM, and
+  /// instrumented to count their calls and loop iterations. Once a function's
+  /// count reaches Threshold, it is recompiled by OptTM after running the
+  /// optimization pipeline at OptLevel, and its stub is pointed at the new
+  /// body. A lower threshold trades startup time for peak performance sooner.
+  struct TierUpOptions {
+    TierUpOptions() : Threshold(0), OptLevel(2) {}
+
+    std::unique_ptr<TargetMachine> OptTM;
+    unsigned Threshold;
+    unsigned OptLevel;
+  };
+
   OrcLazyJIT(std::unique_ptr<TargetMachine> TM,
              std::unique_ptr<CompileCallbackMgr> CCMgr,
              IndirectStubsManagerBuilder IndirectStubsMgrBuilder,
-             bool InlineStubs)
+             bool InlineStubs, bool CompileInBackground,
+             TierUpOptions TierUp = TierUpOptions())
       : TM(std::move(TM)), DL(this->TM->createDataLayout()),
 	CCMgr(std::move(CCMgr)),
-	ObjectLayer(),
+	ObjectLayer(EventListeners),
         CompileLayer(ObjectLayer, orc::SimpleCompiler(*this->TM)),
-        IRDumpLayer(CompileLayer, createDebugDumper()),
+        IRDumpLayer(CompileLayer, createTier0Transform(!!TierUp.OptTM)),
         CODLayer(IRDumpLayer, extractSingleFunction, *this->CCMgr,
-                 std::move(IndirectStubsMgrBuilder), InlineStubs),
+                 std::move(IndirectStubsMgrBuilder), InlineStubs,
+                 CompileInBackground),
         CXXRuntimeOverrides(
-            [this](const std::string &S) { return mangle(S); }) {}
+            [this](const std::string &S) { return mangle(S); }),
+        OptTM(std::move(TierUp.OptTM)), TierUpThreshold(TierUp.Threshold),
+        TierUpOptLevel(TierUp.OptLevel), OptObjectLayer(EventListeners) {
+    if (OptTM) {
+      OptCompileLayer = llvm::make_unique<CompileLayerT>(
+          OptObjectLayer, orc::SimpleCompiler(*OptTM));
+      OptimizeLayer = llvm::make_unique<IRDumpLayerT>(
+          *OptCompileLayer, createOptimizer(*OptTM, TierUpOptLevel));
+#if LLVM_ENABLE_THREADS
+      TierUpPool = llvm::make_unique<ThreadPool>(1);
+#endif
+    }
+  }
 
   ~OrcLazyJIT() {
+    // Stop recompiling functions; recompiles already under way complete.
+    ShuttingDown = true;
+    waitForTierUps();
+
     // Run any destructors registered with __cxa_atexit.
     CXXRuntimeOverrides.runDestructors();
     // Run any IR destructors.
@@ -62,6 +96,16 @@ public:
       DtorRunner.runViaLayer(CODLayer);
   }
 
+  /// Take the memory of the modules added from now on from \p Pool, which
+  /// must outlive the JIT.
+  void setMemoryPool(SectionMemoryPool *Pool) { MemPool = Pool; }
+
+  /// Tell \p L about the objects linked from now on, at either tier. \p L
+  /// must outlive the JIT.
+  void registerJITEventListener(JITEventListener &L) {
+    EventListeners.push_back(&L);
+  }
+
   ModuleSetHandleT addModuleSet(std::vector<std::unique_ptr<Module>> Ms) {
     // Attach a data-layouts if they aren't already present.
     for (auto &M : Ms)
@@ -113,7 +157,7 @@ public:
 
     // Add the module to the JIT.
     auto H = CODLayer.addModuleSet(std::move(Ms),
-				   llvm::make_unique<SectionMemoryManager>(),
+				   llvm::make_unique<SectionMemoryManager>(MemPool),
 				   std::move(Resolver));
 
     // Run the static constructors, and save the static destructor runner for
@@ -134,6 +178,19 @@ public:
     return CODLayer.findSymbolIn(H, mangle(Name), true);
   }
 
+  CODLayerT::CompileStats getCompileStats() const {
+    return CODLayer.getCompileStats();
+  }
+
+  /// Returns the number of partitions recompiled by the tiered mode.
+  unsigned getNumTierUps() const { return NumTierUps; }
+
+  /// Waits for the recompiles already requested by the tiered mode.
+  void waitForTierUps() {
+    if (TierUpPool)
+      TierUpPool->wait();
+  }
+
 private:
 
   std::string mangle(const std::string &Name) {
@@ -152,12 +209,28 @@ private:
   }
 
   static TransformFtor createDebugDumper();
+  TransformFtor createTier0Transform(bool Tiered);
+  static TransformFtor createOptimizer(TargetMachine &TM, unsigned OptLevel);
+
+  // A partition compiled at tier 0, kept as bitcode so that it can be
+  // recompiled in a fresh context on the tier-up thread.
+  struct TierUpUnit {
+    SmallVector<char, 0> Bitcode;
+    std::vector<std::string> FnNames;
+    bool Queued = false;
+  };
+
+  std::unique_ptr<Module> addTierUpCounters(std::unique_ptr<Module> M);
+  static void tierUpCallback(OrcLazyJIT *J, uint64_t UnitId);
+  void tierUp(TierUpUnit &U);
 
   std::unique_ptr<TargetMachine> TM;
   DataLayout DL;
   SectionMemoryManager CCMgrMemMgr;
+  SectionMemoryPool *MemPool = nullptr;
 
   std::unique_ptr<CompileCallbackMgr> CCMgr;
+  orc::NotifyJITEventListeners::ListenerListT EventListeners;
   ObjLayerT ObjectLayer;
   CompileLayerT CompileLayer;
   IRDumpLayerT IRDumpLayer;
@@ -165,10 +238,27 @@ private:
 
   orc::LocalCXXRuntimeOverrides CXXRuntimeOverrides;
   std::vector<orc::CtorDtorRunner<CODLayerT>> IRStaticDestructorRunners;
+
+  // Tier 1, if the tiered mode is enabled. Optimized code is linked by a
+  // separate object layer only used by the tier-up thread.
+  std::unique_ptr<TargetMachine> OptTM;
+  unsigned TierUpThreshold;
+  unsigned TierUpOptLevel;
+  ObjLayerT OptObjectLayer;
+  std::unique_ptr<CompileLayerT> OptCompileLayer;
+  std::unique_ptr<IRDumpLayerT> OptimizeLayer;
+
+  std::mutex TierUpMutex;
+  std::vector<std::unique_ptr<TierUpUnit>> TierUpUnits;
+  std::atomic<unsigned> NumTierUps{0};
+  std::atomic<bool> ShuttingDown{false};
+  std::unique_ptr<ThreadPool> TierUpPool;
 };
 
 int runOrcLazyJIT(std::vector<std::unique_ptr<Module>> Ms,
-                  const std::vector<std::string> &Args);
+                  const std::vector<std::string> &Args,
+                  SectionMemoryPool *MemPool = nullptr,
+                  JITEventListener *Listener = nullptr);
 
 } // end namespace llvm
 
@@ -72,7 +72,7 @@ private:
 };
 
 // launch the remote process (see lli.cpp) and return a channel to it.
-std::unique_ptr<FDRawChannel> launchRemote();
+std::unique_ptr<llvm::orc::rpc::RawByteChannel> launchRemote();
 
 namespace llvm {
 
@@ -144,6 +144,10 @@ public:
     return Resolver->findSymbolInLogicalDylib(Name);
   }
 
+  Expected<LookupResult> lookup(const LookupSet &Symbols) override {
+    return Resolver->lookup(Symbols);
+  }
+
 private:
   std::unique_ptr<RuntimeDyld::MemoryManager> MemMgr;
   std::unique_ptr<JITSymbolResolver> Resolver;
@@ -24,10 +24,12 @@
 #include "llvm/ExecutionEngine/Interpreter.h"
 #include "llvm/ExecutionEngine/JITEventListener.h"
 #include "llvm/ExecutionEngine/MCJIT.h"
+#include "llvm/ExecutionEngine/FileObjectCache.h"
 #include "llvm/ExecutionEngine/ObjectCache.h"
 #include "llvm/ExecutionEngine/OrcMCJITReplacement.h"
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "llvm/ExecutionEngine/Orc/OrcRemoteTargetClient.h"
+#include "llvm/ExecutionEngine/Orc/SharedMemoryRawChannel.h"
 #include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/Type.h"
@@ -111,6 +113,30 @@ namespace {
                          "\n\tremote execution will be simulated in-process."),
                 cl::value_desc("filename"), cl::init(""));
 
+  cl::opt<bool> RemoteSharedMemory(
+      "remote-shared-memory",
+      cl::desc("Talk to the remote process through a shared memory region "
+               "rather than through pipes, and place the JIT'd code in it"),
+      cl::init(false));
+
+  cl::opt<bool> RemoteBenchmark(
+      "remote-benchmark", cl::Hidden,
+      cl::desc("Instead of running the program, measure the latency of calls "
+               "to the remote process and the throughput of uploads to it"),
+      cl::init(false));
+
+  cl::opt<bool> PerfJITEvents(
+      "perf-jit-events",
+      cl::desc("Describe the JIT'd functions in a jitdump file and a perf map, "
+               "for profiling with Linux perf"),
+      cl::init(false));
+
+  cl::opt<std::string> PerfJITDir(
+      "perf-jit-dir", cl::Hidden,
+      cl::desc("Write the jitdump file and the perf map to this directory "
+               "rather than to the ones perf looks in"),
+      cl::value_desc("directory"), cl::init(""));
+
   // Determine optimization level.
   cl::opt<char>
   OptLevel("O",
@@ -172,6 +198,48 @@ namespace {
                            "(must be user writable)"),
                   cl::init(""));
 
+  cl::opt<std::string>
+  PersistentCacheDir("persistent-cache-dir",
+        cl::desc("Cache compiled objects in this directory, keyed on a hash "
+                 "of the module and the code generation options"),
+        cl::value_desc("directory"), cl::init(""));
+
+  cl::opt<unsigned>
+  PersistentCacheMaxSize("persistent-cache-max-size",
+        cl::desc("Maximum size of the persistent object cache in kilobytes "
+                 "(0 means unlimited)"),
+        cl::init(0));
+
+  cl::opt<unsigned>
+  PersistentCacheExpiration("persistent-cache-expiration",
+        cl::desc("Remove persistent object cache entries that were not used "
+                 "for this many seconds (0 means never)"),
+        cl::init(0));
+
+  cl::opt<unsigned>
+  PersistentCachePruneInterval("persistent-cache-prune-interval",
+        cl::desc("Minimum number of seconds between two prunings of the "
+                 "persistent object cache"),
+        cl::init(1200));
+
+  cl::opt<bool>
+  PersistentCacheStats("persistent-cache-stats",
+        cl::desc("Print the number of persistent object cache hits and "
+                 "misses"),
+        cl::init(false));
+
+  cl::opt<unsigned>
+  JITMemorySlabSize("jit-memory-slab-size",
+        cl::desc("Reserve JIT memory in slabs of this many kilobytes, shared "
+                 "by all objects (0 maps memory for each object)"),
+        cl::init(0));
+
+  cl::opt<bool>
+  JITMemoryHugePages("jit-memory-huge-pages",
+        cl::desc("Back the slabs holding JITed code with huge pages where "
+                 "available (requires -jit-memory-slab-size)"),
+        cl::init(false));
+
   cl::opt<std::string>
   FakeArgv0("fake-argv0",
             cl::desc("Override the 'argv[0]' value passed into the executing"
@@ -357,6 +425,77 @@ CodeGenOpt::Level getOptLevel() {
   llvm_unreachable("Unrecognized opt level.");
 }
 
+/// Print the latency of calls to the remote, alone and in batches, and the
+/// throughput of copies to its memory.
+static int runRemoteBenchmark(orc::rpc::RawByteChannel &C,
+                              orc::rpc::SharedMemoryRawChannel *SharedC) {
+  typedef orc::remote::OrcRemoteTargetRPCAPI RemoteAPI;
+  typedef std::chrono::duration<double> Seconds;
+  const unsigned NumCalls = 10000;
+  const unsigned NumUploads = 16;
+  const uint64_t UploadSize = 16 << 20;
+  const uint64_t AllocatorId = 0;
+  RemoteAPI Remote(C);
+
+  JITTargetAddress GetPid =
+      ExitOnErr(Remote.callB<RemoteAPI::GetSymbolAddress>(
+          std::string("getpid")));
+  auto Start = std::chrono::steady_clock::now();
+  for (unsigned I = 0; I != NumCalls; ++I)
+    ExitOnErr(Remote.callB<RemoteAPI::CallIntVoid>(GetPid));
+  Seconds CallTime = std::chrono::steady_clock::now() - Start;
+
+  ExitOnErr(Remote.callB<RemoteAPI::CreateRemoteAllocator>(AllocatorId));
+  JITTargetAddress Buffer = ExitOnErr(Remote.callB<RemoteAPI::ReserveMem>(
+      AllocatorId, UploadSize, uint32_t(sys::Process::getPageSize())));
+
+  // Batched calls are only waited for once all of them have been sent.
+  unsigned NumPending = 0;
+  Start = std::chrono::steady_clock::now();
+  for (unsigned I = 0; I != NumCalls; ++I) {
+    ++NumPending;
+    ExitOnErr(Remote.appendCallAsync<RemoteAPI::WritePtr>(
+        [&](Error Err) {
+          --NumPending;
+          return Err;
+        },
+        Buffer, JITTargetAddress(I)));
+  }
+  ExitOnErr(Remote.sendAppendedCalls());
+  while (NumPending != 0)
+    ExitOnErr(Remote.handleOne());
+  Seconds BatchTime = std::chrono::steady_clock::now() - Start;
+
+  std::vector<char> Data(UploadSize, 'x');
+  Start = std::chrono::steady_clock::now();
+  for (unsigned I = 0; I != NumUploads; ++I) {
+    // Writes to the shared heap only need a round trip to be seen, which the
+    // permission change that follows every upload provides.
+    if (char *Dst = SharedC ? SharedC->getLocalAddress(Buffer, UploadSize)
+                            : nullptr)
+      memcpy(Dst, Data.data(), UploadSize);
+    else
+      ExitOnErr(Remote.callB<RemoteAPI::WriteMem>(
+          orc::remote::DirectBufferWriter(Data.data(), Buffer, UploadSize)));
+    ExitOnErr(Remote.callB<RemoteAPI::SetProtections>(
+        AllocatorId, Buffer,
+        uint32_t(sys::Memory::MF_READ | sys::Memory::MF_WRITE)));
+  }
+  Seconds UploadTime = std::chrono::steady_clock::now() - Start;
+
+  ExitOnErr(Remote.callB<RemoteAPI::DestroyRemoteAllocator>(AllocatorId));
+  ExitOnErr(Remote.callB<RemoteAPI::TerminateSession>());
+
+  outs() << format("call latency:      %10.2f us\n",
+                   CallTime.count() * 1e6 / NumCalls)
+         << format("batched calls:     %10.2f us per call\n",
+                   BatchTime.count() * 1e6 / NumCalls)
+         << format("upload throughput: %10.2f MB/s\n",
+                   double(UploadSize) * NumUploads / (1 << 20) /
+                       UploadTime.count());
+  return 0;
+}
+
 LLVM_ATTRIBUTE_NORETURN
 static void reportError(SMDiagnostic Err, const char *ProgName) {
   Err.print(ProgName, errs());
@@ -397,6 +536,26 @@ int main(int argc, char **argv, char * const *envp) {
   if (!Mod)
     reportError(Err, argv[0]);
 
+  // The memory pool must outlive the execution engine.
+  std::unique_ptr<SectionMemoryPool> MemPool;
+  if (JITMemorySlabSize)
+    MemPool = make_unique<SectionMemoryPool>(size_t(JITMemorySlabSize) * 1024,
+                                             JITMemoryHugePages);
+
+  // The perf listener reads the JIT'd code, so it is only used when the code
+  // runs in this process. It must outlive the execution engine too.
+  std::unique_ptr<JITEventListener> PerfListener;
+  if (PerfJITEvents && !RemoteMCJIT) {
+    if (PerfJITDir.empty())
+      PerfListener.reset(JITEventListener::createPerfJITEventListener());
+    else
+      PerfListener.reset(
+          JITEventListener::createPerfJITEventListener(PerfJITDir, PerfJITDir));
+    if (!PerfListener)
+      errs() << argv[0] << ": warning: perf support was not enabled in the "
+             << "build, ignoring -perf-jit-events\n";
+  }
+
   if (UseJITKind == JITKind::OrcLazy) {
     std::vector<std::unique_ptr<Module>> Ms;
     Ms.push_back(std::move(Owner));
@@ -409,7 +568,8 @@ int main(int argc, char **argv, char * const *envp) {
     Args.push_back(InputFile);
     for (auto &Arg : InputArgv)
       Args.push_back(Arg);
-    return runOrcLazyJIT(std::move(Ms), Args);
+    return runOrcLazyJIT(std::move(Ms), Args, MemPool.get(),
+                         PerfListener.get());
   }
 
   if (EnableCacheManager) {
@@ -450,7 +610,7 @@ int main(int argc, char **argv, char * const *envp) {
     if (RemoteMCJIT)
       RTDyldMM = new ForwardingMemoryManager();
     else
-      RTDyldMM = new SectionMemoryManager();
+      RTDyldMM = new SectionMemoryManager(MemPool.get());
 
     // Deliberately construct a temp std::unique_ptr to pass in. Do not null out
     // RTDyldMM: We still use it below, even though we don't own it.
@@ -479,8 +639,23 @@ int main(int argc, char **argv, char * const *envp) {
     exit(1);
   }
 
-  std::unique_ptr<LLIObjectCache> CacheManager;
-  if (EnableCacheManager) {
+  std::unique_ptr<ObjectCache> CacheManager;
+  FileObjectCache *PersistentCache = nullptr;
+  if (!PersistentCacheDir.empty() && !ForceInterpreter) {
+    if (EnableCacheManager) {
+      errs() << argv[0] << ": -persistent-cache-dir and -enable-cache-manager "
+                           "are mutually exclusive\n";
+      exit(1);
+    }
+    PersistentCache =
+        new FileObjectCache(PersistentCacheDir, *EE->getTargetMachine());
+    PersistentCache->setMaxSizeBytes(uint64_t(PersistentCacheMaxSize) * 1024)
+        .setEntryExpiration(std::chrono::seconds(PersistentCacheExpiration))
+        .setPruningInterval(
+            std::chrono::seconds(PersistentCachePruneInterval));
+    CacheManager.reset(PersistentCache);
+    EE->setObjectCache(CacheManager.get());
+  } else if (EnableCacheManager) {
     CacheManager.reset(new LLIObjectCache(ObjectCacheDir));
     EE->setObjectCache(CacheManager.get());
   }
@@ -546,6 +721,8 @@ int main(int argc, char **argv, char * const *envp) {
                 JITEventListener::createOProfileJITEventListener());
   EE->RegisterJITEventListener(
                 JITEventListener::createIntelJITEventListener());
+  if (PerfListener)
+    EE->RegisterJITEventListener(PerfListener.get());
 
   if (!NoLazyCompilation && RemoteMCJIT) {
     errs() << "warning: remote mcjit does not support lazy compilation\n";
@@ -619,6 +796,9 @@ int main(int argc, char **argv, char * const *envp) {
     // Trigger compilation separately so code regions that need to be
     // invalidated will be known.
     (void)EE->getPointerToFunction(EntryFn);
+    if (PersistentCache && PersistentCacheStats)
+      errs() << "Persistent cache hits: " << PersistentCache->getNumHits()
+             << ", misses: " << PersistentCache->getNumMisses() << "\n";
     // Clear instruction cache before code will be executed.
     if (RTDyldMM)
       static_cast<SectionMemoryManager*>(RTDyldMM)->invalidateInstructionCache();
@@ -651,17 +831,31 @@ int main(int argc, char **argv, char * const *envp) {
     // MCJIT itself. FIXME.
 
     // Lanch the remote process and get a channel to it.
-    std::unique_ptr<FDRawChannel> C = launchRemote();
+    std::unique_ptr<orc::rpc::RawByteChannel> C = launchRemote();
     if (!C) {
       errs() << "Failed to launch remote JIT.\n";
       exit(1);
     }
+    auto *SharedC =
+        RemoteSharedMemory
+            ? static_cast<orc::rpc::SharedMemoryRawChannel *>(C.get())
+            : nullptr;
+
+    if (RemoteBenchmark)
+      return runRemoteBenchmark(*C, SharedC);
 
     // Create a remote target client running over the channel.
     typedef orc::remote::OrcRemoteTargetClient<orc::rpc::RawByteChannel>
       MyRemote;
     auto R = ExitOnErr(MyRemote::Create(*C));
 
+    // Write sections placed in the shared heap directly.
+    if (SharedC)
+      R->setLocalAddressMapping(
+          [SharedC](JITTargetAddress Addr, uint64_t Size) {
+            return SharedC->getLocalAddress(Addr, Size);
+          });
+
     // Create a remote memory manager.
     std::unique_ptr<MyRemote::RCMemoryManager> RemoteMM;
     ExitOnErr(R->createRemoteMemoryManager(RemoteMM));
@@ -705,7 +899,7 @@ int main(int argc, char **argv, char * const *envp) {
   return Result;
 }
 
-std::unique_ptr<FDRawChannel> launchRemote() {
+std::unique_ptr<orc::rpc::RawByteChannel> launchRemote() {
 #ifndef LLVM_ON_UNIX
   llvm_unreachable("launchRemote not supported on non-Unix platforms");
 #else
@@ -716,6 +910,20 @@ std::unique_ptr<FDRawChannel> launchRemote() {
   if (pipe(PipeFD[0]) != 0 || pipe(PipeFD[1]) != 0)
     perror("Error creating pipe: ");
 
+  // Create the shared memory region before the fork, so that the child
+  // inherits it. The pipes then only carry wake-ups.
+  std::unique_ptr<orc::rpc::SharedMemoryRawChannel> SharedC;
+  if (RemoteSharedMemory) {
+    auto SharedCOrErr =
+        orc::rpc::SharedMemoryRawChannel::create(PipeFD[1][0], PipeFD[0][1]);
+    if (!SharedCOrErr) {
+      logAllUnhandledErrors(SharedCOrErr.takeError(), errs(),
+                            "Error creating shared memory channel: ");
+      return nullptr;
+    }
+    SharedC = std::move(*SharedCOrErr);
+  }
+
   ChildPID = fork();
 
   if (ChildPID == 0) {
@@ -727,7 +935,7 @@ std::unique_ptr<FDRawChannel> launchRemote() {
 
 
     // Execute the child process.
-    std::unique_ptr<char[]> ChildPath, ChildIn, ChildOut;
+    std::unique_ptr<char[]> ChildPath, ChildIn, ChildOut, ChildShared;
     {
       ChildPath.reset(new char[ChildExecPath.size() + 1]);
       std::copy(ChildExecPath.begin(), ChildExecPath.end(), &ChildPath[0]);
@@ -740,9 +948,17 @@ std::unique_ptr<FDRawChannel> launchRemote() {
       ChildOut.reset(new char[ChildOutStr.size() + 1]);
       std::copy(ChildOutStr.begin(), ChildOutStr.end(), &ChildOut[0]);
       ChildOut[ChildOutStr.size()] = '\0';
+      if (SharedC) {
+        std::string ChildSharedStr = utostr(SharedC->getSharedMemoryFD());
+        ChildShared.reset(new char[ChildSharedStr.size() + 1]);
+        std::copy(ChildSharedStr.begin(), ChildSharedStr.end(),
+                  &ChildShared[0]);
+        ChildShared[ChildSharedStr.size()] = '\0';
+      }
     }
 
-    char * const args[] = { &ChildPath[0], &ChildIn[0], &ChildOut[0], nullptr };
+    char * const args[] = { &ChildPath[0], &ChildIn[0], &ChildOut[0],
+                            ChildShared.get(), nullptr };
     int rc = execv(ChildExecPath.c_str(), args);
     if (rc != 0)
       perror("Error executing child process: ");
@@ -754,6 +970,9 @@ std::unique_ptr<FDRawChannel> launchRemote() {
   close(PipeFD[0][0]);
   close(PipeFD[1][1]);
 
+  if (SharedC)
+    return std::move(SharedC);
+
   // Return an RPC channel connected to our end of the pipes.
   return llvm::make_unique<FDRawChannel>(PipeFD[1][0], PipeFD[0][1]);
 #endif
@@ -122,6 +122,7 @@ static const char *GetBlockName(unsigned BlockID,
   case bitc::GLOBALVAL_SUMMARY_BLOCK_ID:
                                            return "GLOBALVAL_SUMMARY_BLOCK";
   case bitc::MODULE_STRTAB_BLOCK_ID:       return "MODULE_STRTAB_BLOCK";
+  case bitc::SYMTAB_BLOCK_ID:              return "SYMTAB_BLOCK";
   }
 }
 
@@ -312,6 +313,13 @@ static const char *GetCodeName(unsigned CodeID, unsigned BlockID,
       STRINGIFY_CODE(FS, COMBINED_ORIGINAL_NAME)
       STRINGIFY_CODE(FS, VERSION)
       STRINGIFY_CODE(FS, TYPE_TESTS)
+      STRINGIFY_CODE(FS, TYPE_TEST_ASSUME_VCALLS)
+      STRINGIFY_CODE(FS, CONSTANT_RETURN)
+      STRINGIFY_CODE(FS, VTABLE_TYPE_IDS)
+      STRINGIFY_CODE(FS, VTABLE_FUNCS)
+      STRINGIFY_CODE(FS, DEVIRT_VALUE_NAME)
+      STRINGIFY_CODE(FS, READONLY_REFS)
+      STRINGIFY_CODE(FS, READONLY_GLOBALVAR)
     }
   case bitc::METADATA_ATTACHMENT_ID:
     switch(CodeID) {
@@ -372,6 +380,12 @@ static const char *GetCodeName(unsigned CodeID, unsigned BlockID,
     default: return nullptr;
     case bitc::OPERAND_BUNDLE_TAG: return "OPERAND_BUNDLE_TAG";
     }
+  case bitc::SYMTAB_BLOCK_ID:
+    switch(CodeID) {
+    default: return nullptr;
+    case bitc::SYMTAB_BLOB: return "BLOB";
+    case bitc::SYMTAB_STRTAB_BLOB: return "STRTAB_BLOB";
+    }
   }
 #undef STRINGIFY_CODE
 }
@@ -49,6 +49,9 @@ int main(int argc, char **argv) {
                       BitcodeMod.getBuffer().end());
     }
   } else {
+    // The symbol table refers to every module, so keep them alive until it has
+    // been written.
+    std::vector<std::unique_ptr<Module>> OwnedMods;
     for (std::string InputFilename : InputFilenames) {
       SMDiagnostic Err;
       std::unique_ptr<Module> M = parseIRFile(InputFilename, Err, Context);
@@ -57,7 +60,9 @@ int main(int argc, char **argv) {
         return 1;
       }
       Writer.writeModule(M.get());
+      OwnedMods.push_back(std::move(M));
     }
+    Writer.writeSymtab();
   }
 
   std::error_code EC;
@@ -32,6 +32,7 @@
 #include "llvm/Support/Program.h"
 #include "llvm/Support/ScopedPrinter.h"
 #include "llvm/Support/ThreadPool.h"
+#include "llvm/Support/Timer.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include <functional>
 #include <system_error>
@@ -39,6 +40,9 @@
 using namespace llvm;
 using namespace coverage;
 
+static const char *const TimerGroupName = "llvm-cov";
+static const char *const TimerGroupDescription = "llvm-cov Phases";
+
 void exportCoverageDataToJson(const coverage::CoverageMapping &CoverageMapping,
                               raw_ostream &OS);
 
@@ -129,6 +133,9 @@ private:
   /// Whether or not we're in -filename-equivalence mode.
   bool CompareFilenamesOnly;
 
+  /// Whether or not to time the phases of the command (-time-phases).
+  bool TimePhases;
+
   /// In -filename-equivalence mode, this maps absolute paths from the
   /// coverage mapping data to input source files.
   StringMap<std::string> RemappedFilenames;
@@ -329,6 +336,8 @@ std::unique_ptr<CoverageMapping> CodeCoverageTool::load() {
     if (modifiedTimeGT(ObjectFilename, PGOFilename))
       warning("profile data may be out of date - object is newer",
               ObjectFilename);
+  NamedRegionTimer T("load", "Load coverage data", TimerGroupName,
+                     TimerGroupDescription, TimePhases);
   auto CoverageOrErr =
       CoverageMapping::load(ObjectFilenames, PGOFilename, CoverageArch);
   if (Error E = CoverageOrErr.takeError()) {
@@ -568,10 +577,17 @@ int CodeCoverageTool::run(Command Cmd, int argc, const char **argv) {
   cl::list<std::string> DemanglerOpts(
       "Xdemangler", cl::desc("<demangler-path>|<demangler-option>"));
 
+  cl::opt<bool> TimePhasesOpt(
+      "time-phases", cl::Optional,
+      cl::desc("Report the time taken by each phase of loading the coverage "
+               "data and producing the output"));
+
   auto commandLineParser = [&, this](int argc, const char **argv) -> int {
     cl::ParseCommandLineOptions(argc, argv, "LLVM code coverage tool\n");
     ViewOpts.Debug = DebugDump;
     CompareFilenamesOnly = FilenameEquivalence;
+    TimePhases = TimePhasesOpt;
+    TimeLoadIsEnabled = TimePhases;
 
     if (!CovFilename.empty())
       ObjectFilenames.emplace_back(CovFilename);
@@ -751,6 +767,8 @@ int CodeCoverageTool::show(int argc, const char **argv,
   if (!Coverage)
     return 1;
 
+  NamedRegionTimer T("render", "Render views", TimerGroupName,
+                     TimerGroupDescription, TimePhases);
   auto Printer = CoveragePrinter::create(ViewOpts);
 
   if (!Filters.empty()) {
@@ -828,6 +846,8 @@ int CodeCoverageTool::report(int argc, const char **argv,
   if (!Coverage)
     return 1;
 
+  NamedRegionTimer T("report", "Summarize and render the report",
+                     TimerGroupName, TimerGroupDescription, TimePhases);
   CoverageReport Report(ViewOpts, *Coverage.get());
   if (SourceFiles.empty())
     Report.renderFileReports(llvm::outs());
@@ -849,6 +869,8 @@ int CodeCoverageTool::export_(int argc, const char **argv,
     return 1;
   }
 
+  NamedRegionTimer T("export", "Export coverage data", TimerGroupName,
+                     TimerGroupDescription, TimePhases);
   exportCoverageDataToJson(*Coverage.get(), outs());
 
   return 0;
@@ -16,6 +16,7 @@
 #include "llvm/ADT/DenseMap.h"
 #include "llvm/Support/FileSystem.h"
 #include "llvm/Support/Format.h"
+#include "llvm/Support/Parallel.h"
 #include "llvm/Support/Path.h"
 #include <numeric>
 
@@ -276,18 +277,25 @@ std::vector<FileCoverageSummary>
 CoverageReport::prepareFileReports(const coverage::CoverageMapping &Coverage,
                                    FileCoverageSummary &Totals,
                                    ArrayRef<std::string> Files) {
-  std::vector<FileCoverageSummary> FileReports;
   unsigned LCP = 0;
   if (Files.size() > 1)
     LCP = getLongestCommonPrefixLen(Files);
 
-  for (StringRef Filename : Files) {
-    FileCoverageSummary Summary(Filename.drop_front(LCP));
+  std::vector<FileCoverageSummary> FileReports;
+  FileReports.reserve(Files.size());
+  for (StringRef Filename : Files)
+    FileReports.emplace_back(Filename.drop_front(LCP));
+
+  // Files are summarized independently of each other. Each summary only
+  // contributes to the totals through its own counts, so the totals are
+  // accumulated in file order once all the summaries are computed.
+  parallel_for_each_n(size_t(0), Files.size(), [&](size_t I) {
+    FileCoverageSummary &Summary = FileReports[I];
 
     // Map source locations to aggregate function coverage summaries.
     DenseMap<std::pair<unsigned, unsigned>, FunctionCoverageSummary> Summaries;
 
-    for (const auto &F : Coverage.getCoveredFunctions(Filename)) {
+    for (const auto &F : Coverage.getCoveredFunctions(Files[I])) {
       FunctionCoverageSummary Function = FunctionCoverageSummary::get(F);
       auto StartLoc = F.CountedRegions[0].startLoc();
 
@@ -296,17 +304,14 @@ CoverageReport::prepareFileReports(const coverage::CoverageMapping &Coverage,
         UniquedSummary.first->second.update(Function);
 
       Summary.addInstantiation(Function);
-      Totals.addInstantiation(Function);
     }
 
-    for (const auto &UniquedSummary : Summaries) {
-      const FunctionCoverageSummary &FCS = UniquedSummary.second;
-      Summary.addFunction(FCS);
-      Totals.addFunction(FCS);
-    }
+    for (const auto &UniquedSummary : Summaries)
+      Summary.addFunction(UniquedSummary.second);
+  });
 
-    FileReports.push_back(Summary);
-  }
+  for (const FileCoverageSummary &Summary : FileReports)
+    Totals += Summary;
 
   return FileReports;
 }
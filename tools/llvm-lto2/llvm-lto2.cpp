@@ -14,15 +14,41 @@
 // This program is intended to eventually replace llvm-lto which uses the legacy
 // LTO interface.
 //
+// With -serve, it instead runs as a server listening on a Unix socket, which
+// links the inputs that invocations with -connect send it. The server keeps the
+// inputs of its links parsed, that is their buffers, symbol tables and
+// summaries, and only parses again the inputs that changed since. Nothing else
+// is kept: every link builds its combined index, computes the imports, exports
+// and internalization, and runs all the backends from scratch.
+//
 //===----------------------------------------------------------------------===//
 
 #include "llvm/LTO/Caching.h"
 #include "llvm/CodeGen/CommandFlags.h"
+#include "llvm/Config/llvm-config.h"
 #include "llvm/IR/DiagnosticPrinter.h"
 #include "llvm/LTO/LTO.h"
+#include "llvm/Support/Chrono.h"
 #include "llvm/Support/CommandLine.h"
+#include "llvm/Support/EndianStream.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/Process.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/Threading.h"
+#include <mutex>
+
+#ifdef LLVM_ON_UNIX
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+#endif
 
 using namespace llvm;
 using namespace lto;
@@ -38,16 +64,19 @@ static cl::opt<char> CGOptLevel(
     cl::desc("Codegen optimization level (0, 1, 2 or 3, default = '2')"),
     cl::init('2'));
 
-static cl::list<std::string> InputFilenames(cl::Positional, cl::OneOrMore,
+static cl::list<std::string> InputFilenames(cl::Positional, cl::ZeroOrMore,
                                             cl::desc("<input bitcode files>"));
 
-static cl::opt<std::string> OutputFilename("o", cl::Required,
-                                           cl::desc("Output filename"),
+static cl::opt<std::string> OutputFilename("o", cl::desc("Output filename"),
                                            cl::value_desc("filename"));
 
 static cl::opt<std::string> CacheDir("cache-dir", cl::desc("Cache Directory"),
                                      cl::value_desc("directory"));
 
+static cl::opt<bool>
+    PrintCacheStats("cache-stats",
+                    cl::desc("Print the hits, misses and bytes of the cache"));
+
 static cl::opt<std::string> OptPipeline("opt-pipeline",
                                         cl::desc("Optimizer Pipeline"),
                                         cl::value_desc("pipeline"));
@@ -67,6 +96,11 @@ static cl::opt<bool>
 static cl::opt<int> Threads("thinlto-threads",
                             cl::init(llvm::heavyweight_hardware_concurrency()));
 
+static cl::opt<unsigned> OptParallelism(
+    "opt-parallelism", cl::init(1),
+    cl::desc("Number of module partitions to run the regular LTO function "
+             "simplification passes on concurrently"));
+
 static cl::list<std::string> SymbolResolutions(
     "r",
     cl::desc("Specify a symbol resolution: filename,symbolname,resolution\n"
@@ -90,53 +124,176 @@ static cl::opt<std::string> DefaultTriple(
     cl::desc(
         "Replace unspecified target triples in input files with this triple"));
 
-static void check(Error E, std::string Msg) {
+static cl::opt<std::string> ServeSocket(
+    "serve",
+    cl::desc("Run as a server listening on this Unix socket, and link the "
+             "inputs sent by -connect, keeping them parsed from one link to "
+             "the next. The other options are those of the server, and apply "
+             "to every link"),
+    cl::value_desc("socket"));
+
+static cl::opt<unsigned> ServeIdleTimeout(
+    "serve-idle-timeout", cl::init(0),
+    cl::desc("Stop the server after this many seconds without a request "
+             "(0 = never)"));
+
+static cl::opt<bool> ServeStats(
+    "serve-stats",
+    cl::desc("Report to the clients how many of their inputs the server "
+             "had already parsed"));
+
+static cl::opt<std::string> ConnectSocket(
+    "connect",
+    cl::desc("Have the server listening on this Unix socket link the inputs "
+             "with the symbol resolutions and output filename given here"),
+    cl::value_desc("socket"));
+
+static cl::opt<bool> StopServer("stop-server",
+                                cl::desc("With -connect, stop the server "
+                                         "instead of linking"));
+
+static const char *ProgName;
+
+static bool reportError(raw_ostream &OS, Error E, const Twine &Msg) {
   if (!E)
-    return;
+    return false;
   handleAllErrors(std::move(E), [&](ErrorInfoBase &EIB) {
-    errs() << "llvm-lto: " << Msg << ": " << EIB.message().c_str() << '\n';
+    OS << "llvm-lto: " << Msg << ": " << EIB.message().c_str() << '\n';
   });
-  exit(1);
+  return true;
 }
 
-template <typename T> static T check(Expected<T> E, std::string Msg) {
-  if (E)
-    return std::move(*E);
-  check(E.takeError(), Msg);
-  return T();
+static bool reportError(raw_ostream &OS, std::error_code EC, const Twine &Msg) {
+  return reportError(OS, errorCodeToError(EC), Msg);
 }
 
-static void check(std::error_code EC, std::string Msg) {
-  check(errorCodeToError(EC), Msg);
-}
+namespace {
+/// The inputs, symbol resolutions and output of a link.
+struct LinkRequest {
+  std::vector<std::string> InputFilenames;
+  std::vector<std::string> SymbolResolutions;
+  std::string OutputFilename;
+  /// The working directory of the client that sent the request, against
+  /// which relative paths are resolved. Empty for the current directory.
+  std::string WorkingDir;
+
+  /// Return \p Path resolved against WorkingDir.
+  std::string resolvePath(StringRef Path) const {
+    if (WorkingDir.empty() || sys::path::is_absolute(Path))
+      return Path;
+    SmallString<128> Resolved(WorkingDir);
+    sys::path::append(Resolved, Path);
+    sys::path::remove_dots(Resolved);
+    return Resolved.str();
+  }
+};
+
+/// An input file loaded by the server, which the next links reuse for as long
+/// as the file doesn't change, whichever path they name it by. The InputFile
+/// keeps the summaries of the modules of the file once they have been read,
+/// and the path it was loaded from as its module identifier.
+struct WarmInput {
+  std::unique_ptr<MemoryBuffer> Buffer;
+  std::unique_ptr<InputFile> Input;
+  /// The status of the file when it was read, and the time it was read at,
+  /// rounded down to the second.
+  sys::fs::file_status Status;
+  sys::TimePoint<> ReadTime;
+  /// The number of the last link that used the file.
+  unsigned LastUse = 0;
+};
+
+/// The state that the server keeps from one link to the next.
+struct ServerState {
+  ServerState() : Pool(Threads) {}
+
+  ThreadPool Pool;
+  std::map<sys::fs::UniqueID, WarmInput> Inputs;
+  unsigned NumLinks = 0;
+};
+} // end anonymous namespace
+
+/// The number of links after which the server unloads the inputs they didn't
+/// use.
+static const unsigned WarmInputLifetime = 8;
+
+/// Return the input file at the absolute path \p Path from \p Server, loading
+/// it if no earlier link used it, or if it changed since. \p Reused is set to
+/// whether it was loaded already.
+static Expected<InputFile *> getWarmInput(ServerState &Server, StringRef Path,
+                                          bool &Reused) {
+  int FD;
+  if (std::error_code EC = sys::fs::openFileForRead(Path, FD))
+    return errorCodeToError(EC);
+  sys::fs::file_status Status;
+  if (std::error_code EC = sys::fs::status(FD, Status)) {
+    sys::Process::SafelyCloseFileDescriptor(FD);
+    return errorCodeToError(EC);
+  }
 
-template <typename T> static T check(ErrorOr<T> E, std::string Msg) {
-  if (E)
-    return std::move(*E);
-  check(E.getError(), Msg);
-  return T();
-}
+  // A file that has the same size and modification time as when it was read
+  // is reused without reading it again. Modification times are only accurate
+  // to the second, so this doesn't apply to a file modified in the second it
+  // was read in.
+  sys::fs::UniqueID ID = Status.getUniqueID();
+  WarmInput &Warm = Server.Inputs[ID];
+  Warm.LastUse = Server.NumLinks;
+  if (Warm.Input && Warm.Status.getSize() == Status.getSize() &&
+      Warm.Status.getLastModificationTime() ==
+          Status.getLastModificationTime() &&
+      Status.getLastModificationTime() < Warm.ReadTime) {
+    sys::Process::SafelyCloseFileDescriptor(FD);
+    Reused = true;
+    return Warm.Input.get();
+  }
 
-int main(int argc, char **argv) {
-  InitializeAllTargets();
-  InitializeAllTargetMCs();
-  InitializeAllAsmPrinters();
-  InitializeAllAsmParsers();
+  // The file may be overwritten while the server holds on to it, so don't map
+  // it.
+  sys::TimePoint<> ReadTime =
+      sys::toTimePoint(sys::toTimeT(std::chrono::system_clock::now()));
+  ErrorOr<std::unique_ptr<MemoryBuffer>> MBOrErr = MemoryBuffer::getOpenFile(
+      FD, Path, /*FileSize=*/-1, /*RequiresNullTerminator=*/true,
+      /*IsVolatileSize=*/true);
+  sys::Process::SafelyCloseFileDescriptor(FD);
+  if (!MBOrErr) {
+    Server.Inputs.erase(ID);
+    return errorCodeToError(MBOrErr.getError());
+  }
 
-  cl::ParseCommandLineOptions(argc, argv, "Resolution-based LTO test harness");
+  Warm.Status = Status;
+  Warm.ReadTime = ReadTime;
+  Reused = Warm.Input && Warm.Buffer->getBuffer() == (*MBOrErr)->getBuffer();
+  if (Reused)
+    return Warm.Input.get();
+
+  Expected<std::unique_ptr<InputFile>> InputOrErr =
+      InputFile::create((*MBOrErr)->getMemBufferRef());
+  if (!InputOrErr) {
+    Server.Inputs.erase(ID);
+    return InputOrErr.takeError();
+  }
+  Warm.Input = std::move(*InputOrErr);
+  Warm.Buffer = std::move(*MBOrErr);
+  return Warm.Input.get();
+}
 
+/// Link the inputs of \p Req, reporting errors to \p ErrOS, and return the exit
+/// status of the link. \p Server is the state of the server when running as
+/// one, and null otherwise.
+static int link(const LinkRequest &Req, raw_ostream &ErrOS,
+                ServerState *Server) {
   // FIXME: Workaround PR30396 which means that a symbol can appear
   // more than once if it is defined in module-level assembly and
   // has a GV declaration. We allow (file, symbol) pairs to have multiple
   // resolutions and apply them in the order observed.
   std::map<std::pair<std::string, std::string>, std::list<SymbolResolution>>
       CommandLineResolutions;
-  for (std::string R : SymbolResolutions) {
+  for (const std::string &R : Req.SymbolResolutions) {
     StringRef Rest = R;
     StringRef FileName, SymbolName;
     std::tie(FileName, Rest) = Rest.split(',');
     if (Rest.empty()) {
-      llvm::errs() << "invalid resolution: " << R << '\n';
+      ErrOS << "invalid resolution: " << R << '\n';
       return 1;
     }
     std::tie(SymbolName, Rest) = Rest.split(',');
@@ -149,20 +306,27 @@ int main(int argc, char **argv) {
       else if (C == 'x')
         Res.VisibleToRegularObj = true;
       else
-        llvm::errs() << "invalid character " << C << " in resolution: " << R
-                     << '\n';
+        ErrOS << "invalid character " << C << " in resolution: " << R << '\n';
     }
     CommandLineResolutions[{FileName, SymbolName}].push_back(Res);
   }
 
   std::vector<std::unique_ptr<MemoryBuffer>> MBs;
 
+  // Diagnostics and output errors may be reported from the backend threads.
+  std::mutex ErrMu;
+  bool HasErrors = false;
+
   Config Conf;
-  Conf.DiagHandler = [](const DiagnosticInfo &DI) {
-    DiagnosticPrinterRawOStream DP(errs());
+  Conf.DiagHandler = [&](const DiagnosticInfo &DI) {
+    std::lock_guard<std::mutex> Lock(ErrMu);
+    DiagnosticPrinterRawOStream DP(ErrOS);
     DI.print(DP);
-    errs() << '\n';
-    exit(1);
+    ErrOS << '\n';
+    // The server carries on with the link, so that it doesn't go down with it.
+    if (!Server)
+      exit(1);
+    HasErrors = true;
   };
 
   Conf.CPU = MCPU;
@@ -172,15 +336,17 @@ int main(int argc, char **argv) {
     Conf.RelocModel = *RM;
   Conf.CodeModel = CMModel;
 
-  if (SaveTemps)
-    check(Conf.addSaveTemps(OutputFilename + "."),
-          "Config::addSaveTemps failed");
+  if (SaveTemps &&
+      reportError(ErrOS, Conf.addSaveTemps(Req.OutputFilename + "."),
+                  "Config::addSaveTemps failed"))
+    return 1;
 
   // Run a custom pipeline, if asked for.
   Conf.OptPipeline = OptPipeline;
   Conf.AAPipeline = AAPipeline;
 
   Conf.OptLevel = OptLevel - '0';
+  Conf.OptParallelismLevel = OptParallelism;
   switch (CGOptLevel) {
   case '0':
     Conf.CGOptLevel = CodeGenOpt::None;
@@ -195,7 +361,7 @@ int main(int argc, char **argv) {
     Conf.CGOptLevel = CodeGenOpt::Aggressive;
     break;
   default:
-    llvm::errs() << "invalid cg optimization level: " << CGOptLevel << '\n';
+    ErrOS << "invalid cg optimization level: " << CGOptLevel << '\n';
     return 1;
   }
 
@@ -205,22 +371,52 @@ int main(int argc, char **argv) {
   ThinBackend Backend;
   if (ThinLTODistributedIndexes)
     Backend = createWriteIndexesThinBackend("", "", true, "");
+  else if (Server)
+    Backend = createInProcessThinBackend(Server->Pool);
   else
     Backend = createInProcessThinBackend(Threads);
   LTO Lto(std::move(Conf), std::move(Backend));
 
-  bool HasErrors = false;
-  for (std::string F : InputFilenames) {
-    std::unique_ptr<MemoryBuffer> MB = check(MemoryBuffer::getFile(F), F);
-    std::unique_ptr<InputFile> Input =
-        check(InputFile::create(MB->getMemBufferRef()), F);
+  if (Server)
+    ++Server->NumLinks;
+  unsigned NumReused = 0;
+  for (const std::string &F : Req.InputFilenames) {
+    std::unique_ptr<InputFile> OwnedInput;
+    InputFile *Input;
+    if (Server) {
+      bool Reused;
+      Expected<InputFile *> InputOrErr =
+          getWarmInput(*Server, Req.resolvePath(F), Reused);
+      if (!InputOrErr) {
+        reportError(ErrOS, InputOrErr.takeError(), F);
+        return 1;
+      }
+      Input = *InputOrErr;
+      NumReused += Reused;
+    } else {
+      ErrorOr<std::unique_ptr<MemoryBuffer>> MBOrErr =
+          MemoryBuffer::getFile(F);
+      if (!MBOrErr) {
+        reportError(ErrOS, MBOrErr.getError(), F);
+        return 1;
+      }
+      Expected<std::unique_ptr<InputFile>> InputOrErr =
+          InputFile::create((*MBOrErr)->getMemBufferRef());
+      if (!InputOrErr) {
+        reportError(ErrOS, InputOrErr.takeError(), F);
+        return 1;
+      }
+      MBs.push_back(std::move(*MBOrErr));
+      OwnedInput = std::move(*InputOrErr);
+      Input = OwnedInput.get();
+    }
 
     std::vector<SymbolResolution> Res;
     for (const InputFile::Symbol &Sym : Input->symbols()) {
       auto I = CommandLineResolutions.find({F, Sym.getName()});
       if (I == CommandLineResolutions.end()) {
-        llvm::errs() << argv[0] << ": missing symbol resolution for " << F
-                     << ',' << Sym.getName() << '\n';
+        ErrOS << ProgName << ": missing symbol resolution for " << F << ','
+              << Sym.getName() << '\n';
         HasErrors = true;
       } else {
         Res.push_back(I->second.front());
@@ -233,42 +429,334 @@ int main(int argc, char **argv) {
     if (HasErrors)
       continue;
 
-    MBs.push_back(std::move(MB));
-    check(Lto.add(std::move(Input), Res), F);
+    if (reportError(ErrOS,
+                    OwnedInput ? Lto.add(std::move(OwnedInput), Res)
+                               : Lto.add(*Input, Res),
+                    F))
+      return 1;
   }
 
   if (!CommandLineResolutions.empty()) {
     HasErrors = true;
     for (auto UnusedRes : CommandLineResolutions)
-      llvm::errs() << argv[0] << ": unused symbol resolution for "
-                   << UnusedRes.first.first << ',' << UnusedRes.first.second
-                   << '\n';
+      ErrOS << ProgName << ": unused symbol resolution for "
+            << UnusedRes.first.first << ',' << UnusedRes.first.second << '\n';
   }
   if (HasErrors)
     return 1;
 
+  if (Server && ServeStats)
+    ErrOS << ProgName << ": the server had " << NumReused << " of "
+          << Req.InputFilenames.size() << " inputs parsed already\n";
+
+  // The objects of the tasks whose output file couldn't be opened go here, so
+  // that the link carries on.
+  std::vector<SmallString<0>> Discarded(Lto.getMaxTasks());
   auto AddStream =
       [&](size_t Task) -> std::unique_ptr<lto::NativeObjectStream> {
-    std::string Path = OutputFilename + "." + utostr(Task);
+    std::string Path = Req.OutputFilename + "." + utostr(Task);
 
     std::error_code EC;
     auto S = llvm::make_unique<raw_fd_ostream>(Path, EC, sys::fs::F_None);
-    check(EC, Path);
+    if (EC) {
+      std::lock_guard<std::mutex> Lock(ErrMu);
+      reportError(ErrOS, EC, Path);
+      HasErrors = true;
+      return llvm::make_unique<lto::NativeObjectStream>(
+          llvm::make_unique<raw_svector_ostream>(Discarded[Task]));
+    }
     return llvm::make_unique<lto::NativeObjectStream>(std::move(S));
   };
 
-  auto AddFile = [&](size_t Task, StringRef Path) {
-    auto ReloadedBufferOrErr = MemoryBuffer::getFile(Path);
-    if (auto EC = ReloadedBufferOrErr.getError())
-      report_fatal_error(Twine("Can't reload cached file '") + Path + "': " +
-                         EC.message() + "\n");
-
-    *AddStream(Task)->OS << (*ReloadedBufferOrErr)->getBuffer();
+  auto AddBuffer = [&](size_t Task, std::unique_ptr<MemoryBuffer> MB) {
+    *AddStream(Task)->OS << MB->getBuffer();
   };
 
   NativeObjectCache Cache;
+  CacheStats Stats;
   if (!CacheDir.empty())
-    Cache = localCache(CacheDir, AddFile);
+    Cache = localCache(CacheDir, AddBuffer, &Stats);
+
+  if (reportError(ErrOS, Lto.run(AddStream, Cache), "LTO::run failed"))
+    return 1;
+
+  if (!CacheDir.empty() && PrintCacheStats)
+    Stats.print(ErrOS);
+  return HasErrors;
+}
+
+#ifdef LLVM_ON_UNIX
+// The server and its clients exchange messages made of a list of strings: the
+// number of strings, then the size and contents of each of them. A link request
+// is "link", the working directory of the client, the output filename, the
+// number of inputs, the inputs and the symbol resolutions. A stop request is
+// "stop". The server answers with the exit status of the request, followed by
+// the errors and diagnostics to report.
+
+static bool writeMessage(int FD, ArrayRef<std::string> Strings) {
+  std::string Buffer;
+  raw_string_ostream OS(Buffer);
+  support::endian::Writer<support::little> W(OS);
+  W.write<uint32_t>(Strings.size());
+  for (const std::string &S : Strings) {
+    W.write<uint32_t>(S.size());
+    OS << S;
+  }
+  OS.flush();
+
+  for (size_t Pos = 0; Pos != Buffer.size();) {
+    ssize_t Written = ::write(FD, Buffer.data() + Pos, Buffer.size() - Pos);
+    if (Written < 0 && errno == EINTR)
+      continue;
+    if (Written <= 0)
+      return false;
+    Pos += Written;
+  }
+  return true;
+}
+
+static bool readBytes(int FD, char *Buf, size_t Size) {
+  for (size_t Pos = 0; Pos != Size;) {
+    ssize_t Read = ::read(FD, Buf + Pos, Size - Pos);
+    if (Read < 0 && errno == EINTR)
+      continue;
+    if (Read <= 0)
+      return false;
+    Pos += Read;
+  }
+  return true;
+}
+
+static bool readUInt32(int FD, uint32_t &Value) {
+  char Buf[4];
+  if (!readBytes(FD, Buf, sizeof(Buf)))
+    return false;
+  Value = support::endian::read32le(Buf);
+  return true;
+}
+
+static bool readMessage(int FD, std::vector<std::string> &Strings) {
+  uint32_t NumStrings;
+  if (!readUInt32(FD, NumStrings))
+    return false;
+  Strings.clear();
+  for (uint32_t I = 0; I != NumStrings; ++I) {
+    uint32_t Size;
+    if (!readUInt32(FD, Size))
+      return false;
+    std::string S(Size, '\0');
+    if (!readBytes(FD, &S[0], Size))
+      return false;
+    Strings.push_back(std::move(S));
+  }
+  return true;
+}
+
+static bool getSocketAddress(StringRef Path, sockaddr_un &Addr) {
+  memset(&Addr, 0, sizeof(Addr));
+  Addr.sun_family = AF_UNIX;
+  if (Path.size() >= sizeof(Addr.sun_path)) {
+    errs() << ProgName << ": socket path too long: " << Path << '\n';
+    return false;
+  }
+  memcpy(Addr.sun_path, Path.data(), Path.size());
+  return true;
+}
+
+/// Answer the link request \p Request on behalf of a client.
+static std::vector<std::string> serveLink(ServerState &Server,
+                                          ArrayRef<std::string> Request) {
+  unsigned NumInputs;
+  if (Request.size() < 4 || StringRef(Request[3]).getAsInteger(10, NumInputs) ||
+      Request.size() < 4 + NumInputs)
+    return {"1", "malformed link request\n"};
+
+  // Paths are relative to the working directory of the client. The inputs are
+  // resolved when they are loaded; they keep their names for the resolutions.
+  LinkRequest Req;
+  Req.WorkingDir = Request[1];
+  if (!sys::path::is_absolute(Req.WorkingDir))
+    return {"1", "working directory is not absolute: " + Req.WorkingDir + '\n'};
+  Req.OutputFilename = Req.resolvePath(Request[2]);
+  Req.InputFilenames.assign(Request.begin() + 4,
+                            Request.begin() + 4 + NumInputs);
+  Req.SymbolResolutions.assign(Request.begin() + 4 + NumInputs, Request.end());
+
+  std::string Errors;
+  raw_string_ostream ErrOS(Errors);
+  int Status = link(Req, ErrOS, &Server);
+
+  // Unload the inputs that the latest links didn't use.
+  for (auto I = Server.Inputs.begin(), E = Server.Inputs.end(); I != E;) {
+    auto Cur = I;
+    ++I;
+    if (Cur->second.LastUse + WarmInputLifetime <= Server.NumLinks)
+      Server.Inputs.erase(Cur);
+  }
+  return {utostr(Status), ErrOS.str()};
+}
+
+static int runServer(StringRef SocketPath) {
+  sockaddr_un Addr;
+  if (!getSocketAddress(SocketPath, Addr))
+    return 1;
+
+  int ListenFD = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (ListenFD < 0)
+    return reportError(errs(), std::error_code(errno, std::generic_category()),
+                       SocketPath);
+  // Replace the socket of a server that didn't stop cleanly.
+  ::unlink(Addr.sun_path);
+  if (::bind(ListenFD, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr)) ||
+      ::listen(ListenFD, SOMAXCONN)) {
+    reportError(errs(), std::error_code(errno, std::generic_category()),
+                SocketPath);
+    ::close(ListenFD);
+    return 1;
+  }
+  // Don't go down with a client that goes away before reading its answer.
+  ::signal(SIGPIPE, SIG_IGN);
+
+  ServerState Server;
+  while (true) {
+    if (ServeIdleTimeout) {
+      pollfd PollFD = {ListenFD, POLLIN, 0};
+      int Ready = ::poll(&PollFD, 1, ServeIdleTimeout * 1000);
+      if (Ready < 0 && errno == EINTR)
+        continue;
+      if (Ready == 0)
+        break;
+    }
+    int FD = ::accept(ListenFD, nullptr, nullptr);
+    if (FD < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      reportError(errs(), std::error_code(errno, std::generic_category()),
+                  SocketPath);
+      break;
+    }
+
+    std::vector<std::string> Request;
+    bool Stop = false;
+    if (readMessage(FD, Request) && !Request.empty()) {
+      if (Request[0] == "link") {
+        writeMessage(FD, serveLink(Server, Request));
+      } else if (Request[0] == "stop") {
+        // Remove the socket before answering, so that it is gone once the
+        // client returns.
+        Stop = true;
+        ::close(ListenFD);
+        ::unlink(Addr.sun_path);
+        writeMessage(FD, {"0", ""});
+      } else {
+        writeMessage(FD, {"1", "unknown request " + Request[0] + '\n'});
+      }
+    }
+    ::close(FD);
+    if (Stop)
+      return 0;
+  }
+
+  ::close(ListenFD);
+  ::unlink(Addr.sun_path);
+  return 0;
+}
+
+/// Send \p Request to the server listening on \p SocketPath, and return the
+/// exit status of the request.
+static int runClient(StringRef SocketPath, ArrayRef<std::string> Request) {
+  sockaddr_un Addr;
+  if (!getSocketAddress(SocketPath, Addr))
+    return 1;
+
+  int FD = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (FD < 0)
+    return reportError(errs(), std::error_code(errno, std::generic_category()),
+                       SocketPath);
+  // Give a server that was just started some time to start listening.
+  int Err = 0;
+  for (unsigned Attempt = 0; Attempt != 100; ++Attempt) {
+    if (!::connect(FD, reinterpret_cast<sockaddr *>(&Addr), sizeof(Addr))) {
+      Err = 0;
+      break;
+    }
+    Err = errno;
+    if (Err != ENOENT && Err != ECONNREFUSED && Err != EINTR)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  }
+  if (Err) {
+    ::close(FD);
+    return reportError(errs(), std::error_code(Err, std::generic_category()),
+                       SocketPath);
+  }
+
+  std::vector<std::string> Answer;
+  bool Answered = writeMessage(FD, Request) && readMessage(FD, Answer) &&
+                  Answer.size() == 2;
+  ::close(FD);
+  if (!Answered) {
+    errs() << ProgName << ": no answer from the server on " << SocketPath
+           << '\n';
+    return 1;
+  }
+  errs() << Answer[1];
+  return Answer[0] != "0";
+}
+#endif
+
+int main(int argc, char **argv) {
+  llvm_shutdown_obj Y; // Call llvm_shutdown() on exit, which prints -stats.
+  InitializeAllTargets();
+  InitializeAllTargetMCs();
+  InitializeAllAsmPrinters();
+  InitializeAllAsmParsers();
+
+  cl::ParseCommandLineOptions(argc, argv, "Resolution-based LTO test harness");
+  ProgName = argv[0];
+
+  if (!ServeSocket.empty() || !ConnectSocket.empty()) {
+#ifdef LLVM_ON_UNIX
+    if (!ServeSocket.empty())
+      return runServer(ServeSocket);
+    if (StopServer)
+      return runClient(ConnectSocket, {"stop"});
+#else
+    errs() << ProgName << ": -serve and -connect need Unix sockets\n";
+    return 1;
+#endif
+  }
+
+  if (InputFilenames.empty()) {
+    errs() << ProgName << ": no input files\n";
+    return 1;
+  }
+  if (OutputFilename.empty()) {
+    errs() << ProgName << ": no output filename given with -o\n";
+    return 1;
+  }
+
+  LinkRequest Req;
+  Req.InputFilenames.assign(InputFilenames.begin(), InputFilenames.end());
+  Req.SymbolResolutions.assign(SymbolResolutions.begin(),
+                               SymbolResolutions.end());
+  Req.OutputFilename = OutputFilename;
+
+#ifdef LLVM_ON_UNIX
+  if (!ConnectSocket.empty()) {
+    SmallString<128> WorkingDir;
+    if (std::error_code EC = sys::fs::current_path(WorkingDir))
+      return reportError(errs(), EC, "current directory");
+    std::vector<std::string> Request = {"link", WorkingDir.str(),
+                                        Req.OutputFilename,
+                                        utostr(Req.InputFilenames.size())};
+    Request.insert(Request.end(), Req.InputFilenames.begin(),
+                   Req.InputFilenames.end());
+    Request.insert(Request.end(), Req.SymbolResolutions.begin(),
+                   Req.SymbolResolutions.end());
+    return runClient(ConnectSocket, Request);
+  }
+#endif
 
-  check(Lto.run(AddStream, Cache), "LTO::run failed");
+  return link(Req, errs(), nullptr);
 }
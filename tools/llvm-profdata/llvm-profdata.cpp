@@ -13,6 +13,7 @@
 
 #include "llvm/ADT/SmallSet.h"
 #include "llvm/ADT/SmallVector.h"
+#include "llvm/ADT/StringSet.h"
 #include "llvm/ADT/StringRef.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/ProfileData/InstrProfReader.h"
@@ -32,13 +33,34 @@
 #include "llvm/Support/ThreadPool.h"
 #include "llvm/Support/raw_ostream.h"
 #include <algorithm>
+#include <chrono>
+#include <queue>
 
 using namespace llvm;
 
 enum ProfileFormat { PF_None = 0, PF_Text, PF_Binary, PF_GCC };
 
+/// The intermediate profiles written by the streaming merge that have not
+/// been merged yet. They are removed when exiting with an error.
+static std::mutex TemporaryFilesLock;
+static StringSet<> TemporaryFiles;
+
+/// Remove the intermediate profiles \p Filenames.
+static void removeTemporaryFiles(ArrayRef<std::string> Filenames) {
+  std::lock_guard<std::mutex> Guard(TemporaryFilesLock);
+  for (const std::string &Filename : Filenames) {
+    sys::fs::remove(Filename);
+    TemporaryFiles.erase(Filename);
+  }
+}
+
 static void exitWithError(const Twine &Message, StringRef Whence = "",
                           StringRef Hint = "") {
+  {
+    std::lock_guard<std::mutex> Guard(TemporaryFilesLock);
+    for (const auto &Filename : TemporaryFiles)
+      sys::fs::remove(Filename.getKey());
+  }
   errs() << "error: ";
   if (!Whence.empty())
     errs() << Whence << ": ";
@@ -122,13 +144,33 @@ struct WriterContext {
   StringRef ErrWhence;
   std::mutex &ErrLock;
   SmallSet<instrprof_error, 4> &WriterErrorCodes;
+  /// An upper bound on the memory used by the records in Writer.
+  uint64_t RecordBytes;
 
   WriterContext(bool IsSparse, std::mutex &ErrLock,
                 SmallSet<instrprof_error, 4> &WriterErrorCodes)
       : Lock(), Writer(IsSparse), Err(Error::success()), ErrWhence(""),
-        ErrLock(ErrLock), WriterErrorCodes(WriterErrorCodes) {}
+        ErrLock(ErrLock), WriterErrorCodes(WriterErrorCodes), RecordBytes(0) {}
 };
 
+/// Estimate the memory an InstrProfWriter needs to hold \p Record, assuming
+/// none of it is merged with an existing record.
+static uint64_t estimateRecordSize(const InstrProfRecord &Record) {
+  // Charge every record for a whole function entry, as if each had a name of
+  // its own.
+  uint64_t Size = sizeof(InstrProfWriter::ProfilingData) + Record.Name.size() +
+                  Record.Counts.size() * sizeof(uint64_t);
+  for (uint32_t Kind = IPVK_First; Kind <= IPVK_Last; ++Kind) {
+    uint32_t NumSites = Record.getNumValueSites(Kind);
+    Size += NumSites * sizeof(InstrProfValueSiteRecord);
+    // The values of each site are held in a std::list.
+    for (uint32_t Site = 0; Site < NumSites; ++Site)
+      Size += Record.getNumValueDataForSite(Kind, Site) *
+              (sizeof(InstrProfValueData) + 2 * sizeof(void *));
+  }
+  return Size;
+}
+
 /// Load an input into a writer context.
 static void loadInput(const WeightedFile &Input, WriterContext *WC) {
   std::unique_lock<std::mutex> CtxGuard{WC->Lock};
@@ -159,6 +201,7 @@ static void loadInput(const WeightedFile &Input, WriterContext *WC) {
 
   for (auto &I : *Reader) {
     const StringRef FuncName = I.Name;
+    WC->RecordBytes += estimateRecordSize(I);
     if (Error E = WC->Writer.addRecord(std::move(I), Input.Weight)) {
       // Only show hint the first time an error occurs.
       instrprof_error IPE = InstrProfError::take(std::move(E));
@@ -178,10 +221,195 @@ static void mergeWriterContexts(WriterContext *Dst, WriterContext *Src) {
     Dst->Err = std::move(E);
 }
 
+/// Create a temporary file for an intermediate profile, which is removed if
+/// the merge fails. Stores its descriptor in \p FD and its name in
+/// \p Filename.
+static Error createTemporaryFile(std::string *Filename, int &FD) {
+  SmallString<128> Path;
+  if (std::error_code EC =
+          sys::fs::createTemporaryFile("profdata-merge", "profdata", FD, Path))
+    return errorCodeToError(EC);
+  sys::RemoveFileOnSignal(Path);
+  *Filename = Path.str();
+  std::lock_guard<std::mutex> Guard(TemporaryFilesLock);
+  TemporaryFiles.insert(*Filename);
+  return Error::success();
+}
+
+/// Write the profile held by \p WC to the new temporary file \p Filename.
+static void spillWriterContext(WriterContext *WC, std::string *Filename) {
+  int FD;
+  if (Error E = createTemporaryFile(Filename, FD)) {
+    WC->Err = std::move(E);
+    WC->ErrWhence = "cannot create a temporary file";
+    return;
+  }
+  raw_fd_ostream Output(FD, /*shouldClose=*/true);
+  WC->Writer.write(Output);
+}
+
+/// An intermediate profile written to disk by the streaming merge, read back
+/// as a stream of records sorted by function name and hash.
+struct MergeRun {
+  std::string Filename;
+  std::unique_ptr<IndexedInstrProfReader> Reader;
+  std::vector<std::pair<StringRef, uint64_t>> Keys;
+  size_t Pos;
+
+  MergeRun(std::string Filename) : Filename(std::move(Filename)), Pos(0) {}
+  const std::pair<StringRef, uint64_t> &key() const { return Keys[Pos]; }
+};
+
+/// Merge the intermediate profiles \p RunFiles into one, visiting the
+/// functions in sorted order so that each is complete before the next one is
+/// started. Text output is streamed straight to \p Output; binary output has
+/// to go through an InstrProfWriter, which builds the whole on-disk hash
+/// table in memory.
+///
+/// Warnings are reported while holding \p ErrLock. A hard error is returned
+/// instead, with the file it comes from in \p ErrWhence, so that merges
+/// running on a thread pool can leave reporting it to the main thread.
+static Error mergeRuns(ArrayRef<std::string> RunFiles, raw_fd_ostream &Output,
+                       ProfileFormat OutputFormat, bool OutputSparse,
+                       std::mutex &ErrLock, std::string &ErrWhence) {
+  std::vector<std::unique_ptr<MergeRun>> Runs;
+  InstrProfWriter Writer(OutputSparse);
+  InstrProfSymtab Symtab;
+  for (const std::string &Filename : RunFiles) {
+    Runs.emplace_back(llvm::make_unique<MergeRun>(Filename));
+    MergeRun &Run = *Runs.back();
+    ErrWhence = Filename;
+    auto ReaderOrErr = IndexedInstrProfReader::create(Filename);
+    if (Error E = ReaderOrErr.takeError())
+      return E;
+    Run.Reader = std::move(ReaderOrErr.get());
+    if (Error E = Writer.setIsIRLevelProfile(Run.Reader->isIRLevelProfile())) {
+      consumeError(std::move(E));
+      ErrWhence.clear();
+      return make_error<StringError>(
+          "Merge IR generated profile with Clang generated profile.",
+          std::error_code());
+    }
+
+    // The names point into the mapped profile, so only the keys are copied.
+    for (const auto &I : *Run.Reader)
+      Run.Keys.emplace_back(I.Name, I.Hash);
+    if (Run.Reader->hasError())
+      return Run.Reader->getError();
+    std::sort(Run.Keys.begin(), Run.Keys.end());
+    if (OutputFormat == PF_Text)
+      for (const auto &Key : Run.Keys)
+        Symtab.addFuncName(Key.first);
+  }
+
+  if (OutputFormat == PF_Text) {
+    if (Runs.front()->Reader->isIRLevelProfile())
+      Output << "# IR level Instrumentation Flag\n:ir\n";
+    Symtab.finalizeSymtab();
+  }
+
+  auto Later = [&](unsigned A, unsigned B) {
+    return Runs[B]->key() < Runs[A]->key();
+  };
+  std::priority_queue<unsigned, std::vector<unsigned>, decltype(Later)> Heap(
+      Later);
+  for (unsigned I = 0, E = Runs.size(); I != E; ++I)
+    if (!Runs[I]->Keys.empty())
+      Heap.push(I);
+
+  while (!Heap.empty()) {
+    // Merge the records of the next function from every run that has it.
+    StringRef FuncName = Runs[Heap.top()]->key().first;
+    InstrProfWriter::ProfilingData Merged;
+    while (!Heap.empty() && Runs[Heap.top()]->key().first == FuncName) {
+      unsigned RunIndex = Heap.top();
+      MergeRun &Run = *Runs[RunIndex];
+      Heap.pop();
+      uint64_t Hash = Run.key().second;
+      Expected<InstrProfRecord> RecordOrErr =
+          Run.Reader->getInstrProfRecord(FuncName, Hash);
+      if (Error E = RecordOrErr.takeError()) {
+        ErrWhence = Run.Filename;
+        return E;
+      }
+
+      auto Where = Merged.insert(std::make_pair(Hash, InstrProfRecord()));
+      InstrProfRecord &Dest = Where.first->second;
+      if (Where.second) {
+        Dest = std::move(*RecordOrErr);
+      } else {
+        Dest.merge(*RecordOrErr);
+        Dest.sortValueData();
+        if (Error E = Dest.takeError()) {
+          std::lock_guard<std::mutex> ErrGuard(ErrLock);
+          handleMergeWriterError(std::move(E), "", FuncName);
+        }
+      }
+
+      if (++Run.Pos != Run.Keys.size())
+        Heap.push(RunIndex);
+    }
+
+    if (OutputFormat == PF_Text) {
+      if (OutputSparse &&
+          none_of(Merged, [](const std::pair<uint64_t, InstrProfRecord> &R) {
+            return any_of(R.second.Counts, [](uint64_t C) { return C > 0; });
+          }))
+        continue;
+      std::vector<const InstrProfRecord *> Records;
+      for (const auto &R : Merged)
+        Records.push_back(&R.second);
+      std::sort(Records.begin(), Records.end(),
+                [](const InstrProfRecord *A, const InstrProfRecord *B) {
+                  return A->Hash < B->Hash;
+                });
+      for (const InstrProfRecord *R : Records)
+        InstrProfWriter::writeRecordInText(*R, Symtab, Output);
+    } else {
+      for (auto &R : Merged)
+        if (Error E = Writer.addRecord(std::move(R.second))) {
+          std::lock_guard<std::mutex> ErrGuard(ErrLock);
+          handleMergeWriterError(std::move(E), "", FuncName);
+        }
+    }
+  }
+
+  if (OutputFormat != PF_Text)
+    Writer.write(Output);
+  return Error::success();
+}
+
+/// An intermediate merge of the streaming merge, run on a thread pool.
+struct MergeRunsTask {
+  /// The temporary file receiving the merged profile.
+  std::string Filename;
+  /// The message of the error that stopped the merge, if any.
+  std::string Err;
+  std::string ErrWhence;
+};
+
+/// Merge the intermediate profiles \p RunFiles into the new temporary file
+/// of \p Task.
+static void mergeRunsToFile(ArrayRef<std::string> RunFiles,
+                            MergeRunsTask *Task, std::mutex *ErrLock) {
+  int FD;
+  if (Error E = createTemporaryFile(&Task->Filename, FD)) {
+    Task->Err = toString(std::move(E));
+    Task->ErrWhence = "cannot create a temporary file";
+    return;
+  }
+  raw_fd_ostream Output(FD, /*shouldClose=*/true);
+  // The final merge drops the functions without counts if asked to.
+  if (Error E = mergeRuns(RunFiles, Output, PF_Binary, /*OutputSparse=*/false,
+                          *ErrLock, Task->ErrWhence))
+    Task->Err = toString(std::move(E));
+}
+
 static void mergeInstrProfile(const WeightedFileVector &Inputs,
                               StringRef OutputFilename,
                               ProfileFormat OutputFormat, bool OutputSparse,
-                              unsigned NumThreads) {
+                              unsigned NumThreads, uint64_t MaxMemory,
+                              unsigned MaxFanIn, bool ShowThroughput) {
   if (OutputFilename.compare("-") == 0)
     exitWithError("Cannot write indexed profdata format to stdout.");
 
@@ -201,13 +429,58 @@ static void mergeInstrProfile(const WeightedFileVector &Inputs,
     NumThreads = std::max(1U, std::min(std::thread::hardware_concurrency(),
                                        unsigned(Inputs.size() / 2)));
 
-  // Initialize the writer contexts.
+  // Initialize the writer contexts. The profiles that the streaming merge
+  // writes to disk keep the functions without counts, as their counts may
+  // come from another profile; only the final merge can drop them.
+  bool ContextSparse = OutputSparse && !MaxMemory;
   SmallVector<std::unique_ptr<WriterContext>, 4> Contexts;
   for (unsigned I = 0; I < NumThreads; ++I)
     Contexts.emplace_back(llvm::make_unique<WriterContext>(
-        OutputSparse, ErrorLock, WriterErrorCodes));
+        ContextSparse, ErrorLock, WriterErrorCodes));
 
-  if (NumThreads == 1) {
+  auto StartTime = std::chrono::steady_clock::now();
+  std::vector<std::string> RunFiles;
+
+  if (MaxMemory) {
+    // Stream the inputs through the contexts, one input per context at a
+    // time. Whenever the contexts hold more than MaxMemory bytes of records,
+    // write each of them to disk as an intermediate profile and start over
+    // with empty ones; the intermediate profiles are merged at the end.
+    ThreadPool Pool(NumThreads);
+    for (size_t Begin = 0, E = Inputs.size(); Begin < E; Begin += NumThreads) {
+      size_t End = std::min<size_t>(E, Begin + NumThreads);
+      for (size_t I = Begin; I != End; ++I)
+        Pool.async(loadInput, Inputs[I], Contexts[I - Begin].get());
+      Pool.wait();
+
+      uint64_t RecordBytes = 0;
+      for (std::unique_ptr<WriterContext> &WC : Contexts)
+        RecordBytes += WC->RecordBytes;
+      // Once anything has been spilled, spill the rest too so that every
+      // record goes through the final merge.
+      if (RecordBytes < MaxMemory && (End != E || RunFiles.empty()))
+        continue;
+
+      std::vector<std::string> Spilled(Contexts.size());
+      for (unsigned I = 0; I < NumThreads; ++I) {
+        WriterContext *WC = Contexts[I].get();
+        if (WC->Err)
+          exitWithError(std::move(WC->Err), WC->ErrWhence);
+        if (WC->RecordBytes)
+          Pool.async(spillWriterContext, WC, &Spilled[I]);
+      }
+      Pool.wait();
+      for (unsigned I = 0; I < NumThreads; ++I) {
+        WriterContext *WC = Contexts[I].get();
+        if (WC->Err)
+          exitWithError(std::move(WC->Err), WC->ErrWhence);
+        if (!Spilled[I].empty())
+          RunFiles.push_back(std::move(Spilled[I]));
+        Contexts[I] = llvm::make_unique<WriterContext>(
+            ContextSparse, ErrorLock, WriterErrorCodes);
+      }
+    }
+  } else if (NumThreads == 1) {
     for (const auto &Input : Inputs)
       loadInput(Input, Contexts[0].get());
   } else {
@@ -220,6 +493,11 @@ static void mergeInstrProfile(const WeightedFileVector &Inputs,
       Ctx = (Ctx + 1) % NumThreads;
     }
     Pool.wait();
+  }
+
+  size_t NumRunFiles = RunFiles.size();
+  if (RunFiles.empty() && NumThreads > 1) {
+    ThreadPool Pool(NumThreads);
 
     // Merge the writer contexts together (~ lg(NumThreads) serial steps).
     unsigned Mid = Contexts.size() / 2;
@@ -245,11 +523,63 @@ static void mergeInstrProfile(const WeightedFileVector &Inputs,
     if (WC->Err)
       exitWithError(std::move(WC->Err), WC->ErrWhence);
 
-  InstrProfWriter &Writer = Contexts[0]->Writer;
-  if (OutputFormat == PF_Text)
-    Writer.writeText(Output);
-  else
-    Writer.write(Output);
+  if (!RunFiles.empty()) {
+    // Every intermediate profile being merged is open and mapped at the same
+    // time, so merge them in groups of at most MaxFanIn until few enough are
+    // left for the final merge.
+    ThreadPool Pool(NumThreads);
+    while (RunFiles.size() > MaxFanIn) {
+      std::vector<MergeRunsTask> Tasks((RunFiles.size() + MaxFanIn - 1) /
+                                       MaxFanIn);
+      ArrayRef<std::string> Pending = RunFiles;
+      for (MergeRunsTask &Task : Tasks) {
+        size_t GroupSize = std::min<size_t>(MaxFanIn, Pending.size());
+        Pool.async(mergeRunsToFile, Pending.take_front(GroupSize), &Task,
+                   &ErrorLock);
+        Pending = Pending.drop_front(GroupSize);
+      }
+      Pool.wait();
+      // Report the errors once no merge is running anymore.
+      for (MergeRunsTask &Task : Tasks)
+        if (!Task.Err.empty())
+          exitWithError(Task.Err, Task.ErrWhence);
+      removeTemporaryFiles(RunFiles);
+      RunFiles.clear();
+      for (MergeRunsTask &Task : Tasks)
+        RunFiles.push_back(std::move(Task.Filename));
+    }
+    std::string ErrWhence;
+    if (Error E = mergeRuns(RunFiles, Output, OutputFormat, OutputSparse,
+                            ErrorLock, ErrWhence))
+      exitWithError(std::move(E), ErrWhence);
+    removeTemporaryFiles(RunFiles);
+  } else {
+    InstrProfWriter &Writer = Contexts[0]->Writer;
+    if (OutputFormat == PF_Text)
+      Writer.writeText(Output);
+    else
+      Writer.write(Output);
+  }
+
+  if (ShowThroughput) {
+    double Seconds = std::chrono::duration<double>(
+                         std::chrono::steady_clock::now() - StartTime)
+                         .count();
+    uint64_t InputBytes = 0;
+    for (const auto &Input : Inputs) {
+      uint64_t Size;
+      if (!sys::fs::file_size(Input.Filename, Size))
+        InputBytes += Size;
+    }
+    double InputMB = InputBytes / (1024.0 * 1024.0);
+    errs() << "merged " << Inputs.size() << " inputs ("
+           << format("%.1f", InputMB) << " MB) in " << format("%.2f", Seconds)
+           << " s: " << format("%.1f", InputMB / Seconds) << " MB/s, "
+           << format("%.1f", Inputs.size() / Seconds) << " inputs/s";
+    if (NumRunFiles)
+      errs() << ", " << NumRunFiles << " intermediate profiles";
+    errs() << "\n";
+  }
 }
 
 static sampleprof::SampleProfileFormat FormatMap[] = {
@@ -413,6 +743,21 @@ static int merge_main(int argc, const char *argv[]) {
       cl::desc("Number of merge threads to use (default: autodetect)"));
   cl::alias NumThreadsA("j", cl::desc("Alias for --num-threads"),
                         cl::aliasopt(NumThreads));
+  cl::opt<unsigned> MaxMemory(
+      "max-memory", cl::init(0), cl::value_desc("megabytes"),
+      cl::desc("Merge the inputs in batches whose profile data fits in about "
+               "this much memory, spilling each batch to disk (default: no "
+               "limit; only meaningful for -instr)"));
+  cl::opt<unsigned long long> MaxMemoryBytes(
+      "max-memory-bytes", cl::init(0), cl::Hidden,
+      cl::desc("Like -max-memory, in bytes (for testing)"));
+  cl::opt<unsigned> MaxFanIn(
+      "max-merge-fan-in", cl::init(64), cl::Hidden,
+      cl::desc("The number of intermediate profiles -max-memory merges at "
+               "once (default: 64)"));
+  cl::opt<bool> ShowThroughput(
+      "show-throughput", cl::init(false),
+      cl::desc("Report the time taken by the merge and its throughput"));
 
   cl::ParseCommandLineOptions(argc, argv, "LLVM profile data merger\n");
 
@@ -431,6 +776,9 @@ static int merge_main(int argc, const char *argv[]) {
     exitWithError("No input files specified. See " +
                   sys::path::filename(argv[0]) + " -help");
 
+  if (MaxFanIn < 2)
+    exitWithError("-max-merge-fan-in must be at least 2.");
+
   if (DumpInputFileList) {
     for (auto &WF : WeightedInputs)
       outs() << WF.Weight << "," << WF.Filename << "\n";
@@ -439,7 +787,10 @@ static int merge_main(int argc, const char *argv[]) {
 
   if (ProfileKind == instr)
     mergeInstrProfile(WeightedInputs, OutputFilename, OutputFormat,
-                      OutputSparse, NumThreads);
+                      OutputSparse, NumThreads,
+                      MaxMemoryBytes ? MaxMemoryBytes
+                                     : uint64_t(MaxMemory) << 20,
+                      MaxFanIn, ShowThroughput);
   else
     mergeSampleProfile(WeightedInputs, OutputFilename, OutputFormat);
 
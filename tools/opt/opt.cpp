@@ -48,6 +48,7 @@
 #include "llvm/Support/SystemUtils.h"
 #include "llvm/Support/TargetRegistry.h"
 #include "llvm/Support/TargetSelect.h"
+#include "llvm/Support/TimeProfiler.h"
 #include "llvm/Support/ToolOutputFile.h"
 #include "llvm/Support/YAMLTraits.h"
 #include "llvm/Target/TargetMachine.h"
@@ -410,6 +411,8 @@ int main(int argc, char **argv) {
     return 1;
   }
 
+  TimeTraceProfilerRAII TimeTracer(argv[0], OutputFilename, InputFilename);
+
   SMDiagnostic Err;
 
   Context.setDiscardValueNames(DiscardValueNames);
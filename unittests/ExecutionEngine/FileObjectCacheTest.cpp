@@ -0,0 +1,159 @@
+//===- FileObjectCacheTest.cpp - Unit tests for FileObjectCache -----------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/FileObjectCache.h"
+#include "llvm/ADT/STLExtras.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/IR/Constants.h"
+#include "llvm/IR/GlobalVariable.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/Path.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+class FileObjectCacheTest : public testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_FALSE(sys::fs::createUniqueDirectory("FileObjectCacheTest", Dir));
+  }
+
+  void TearDown() override {
+    for (const std::string &File : listEntries(/*IncludeAll=*/true))
+      sys::fs::remove(File);
+    sys::fs::remove(Dir);
+  }
+
+  /// A module defining a global with the given initializer.
+  std::unique_ptr<Module> createModule(StringRef Name, int Value) {
+    auto M = make_unique<Module>(Name, Context);
+    Type *Int32Ty = Type::getInt32Ty(Context);
+    new GlobalVariable(*M, Int32Ty, false, GlobalValue::ExternalLinkage,
+                       ConstantInt::get(Int32Ty, Value), "value");
+    return M;
+  }
+
+  /// The ELF header of a relocatable object, followed by Tag.
+  static std::string createObject(StringRef Tag) {
+    std::string Obj(64, '\0');
+    Obj[0] = 0x7f;
+    Obj[1] = 'E';
+    Obj[2] = 'L';
+    Obj[3] = 'F';
+    Obj[4] = 2; // ELFCLASS64
+    Obj[5] = 1; // ELFDATA2LSB
+    Obj[16] = 1; // ET_REL
+    return Obj + Tag.str();
+  }
+
+  /// The cache entries in Dir, or all its files if IncludeAll is set.
+  std::vector<std::string> listEntries(bool IncludeAll = false) {
+    std::vector<std::string> Entries;
+    std::error_code EC;
+    for (sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC;
+         I.increment(EC)) {
+      StringRef Name = sys::path::filename(I->path());
+      if (IncludeAll ||
+          (Name.startswith("llvmcache-") && Name.endswith(".o") &&
+           !Name.startswith("llvmcache-tmp-")))
+        Entries.push_back(I->path());
+    }
+    return Entries;
+  }
+
+  LLVMContext Context;
+  SmallString<128> Dir;
+};
+
+TEST_F(FileObjectCacheTest, StoreAndLoad) {
+  auto M = createModule("a", 1);
+  {
+    FileObjectCache Cache(Dir, "config");
+    EXPECT_EQ(nullptr, Cache.getObject(M.get()));
+    std::string Obj = createObject("a");
+    Cache.notifyObjectCompiled(M.get(), MemoryBufferRef(Obj, "a.o"));
+    EXPECT_EQ(0u, Cache.getNumHits());
+    EXPECT_EQ(1u, Cache.getNumMisses());
+  }
+  EXPECT_EQ(1u, listEntries().size());
+
+  // A new cache over the same directory, as in a new process, finds the
+  // object of an identical module.
+  FileObjectCache Cache(Dir, "config");
+  auto Copy = createModule("a", 1);
+  std::unique_ptr<MemoryBuffer> Buf = Cache.getObject(Copy.get());
+  ASSERT_NE(nullptr, Buf);
+  EXPECT_EQ(createObject("a"), Buf->getBuffer());
+  EXPECT_EQ(1u, Cache.getNumHits());
+}
+
+TEST_F(FileObjectCacheTest, KeyIncludesModuleAndConfig) {
+  auto M = createModule("m", 1);
+  FileObjectCache Cache(Dir, "config");
+  Cache.getObject(M.get());
+  std::string Obj = createObject("m");
+  Cache.notifyObjectCompiled(M.get(), MemoryBufferRef(Obj, "m.o"));
+
+  auto Different = createModule("m", 2);
+  EXPECT_EQ(nullptr, Cache.getObject(Different.get()));
+
+  FileObjectCache OtherConfig(Dir, "other config");
+  EXPECT_EQ(nullptr, OtherConfig.getObject(M.get()));
+  EXPECT_NE(Cache.getKey(*M), OtherConfig.getKey(*M));
+}
+
+TEST_F(FileObjectCacheTest, KeyIsComputedBeforeCodeGen) {
+  // Code generation may change the module: the object must be stored under
+  // the key of the module as it was when the JIT looked it up.
+  auto M = createModule("m", 1);
+  FileObjectCache Cache(Dir, "config");
+  std::string Key = Cache.getKey(*M);
+  EXPECT_EQ(nullptr, Cache.getObject(M.get()));
+  M->getGlobalVariable("value")->setInitializer(
+      ConstantInt::get(Type::getInt32Ty(Context), 5));
+  std::string Obj = createObject("m");
+  Cache.notifyObjectCompiled(M.get(), MemoryBufferRef(Obj, "m.o"));
+  EXPECT_TRUE(sys::fs::exists(Cache.getEntryPath(Key)));
+
+  auto Fresh = createModule("m", 1);
+  EXPECT_NE(nullptr, Cache.getObject(Fresh.get()));
+}
+
+TEST_F(FileObjectCacheTest, InvalidEntryIsDropped) {
+  auto M = createModule("m", 1);
+  FileObjectCache Cache(Dir, "config");
+  std::string EntryPath = Cache.getEntryPath(Cache.getKey(*M));
+  {
+    std::error_code EC;
+    raw_fd_ostream OS(EntryPath, EC, sys::fs::F_None);
+    ASSERT_FALSE(EC);
+    OS << "not an object";
+  }
+  EXPECT_EQ(nullptr, Cache.getObject(M.get()));
+  EXPECT_FALSE(sys::fs::exists(EntryPath));
+}
+
+TEST_F(FileObjectCacheTest, PruneToMaxSize) {
+  FileObjectCache Cache(Dir, "config");
+  std::string Obj = createObject(std::string(100, 'x'));
+  Cache.setMaxSizeBytes(3 * Obj.size());
+  for (int I = 0; I != 6; ++I) {
+    auto M = createModule("m", I);
+    Cache.getObject(M.get());
+    Cache.notifyObjectCompiled(M.get(), MemoryBufferRef(Obj, "m.o"));
+    EXPECT_GE(3u, listEntries().size());
+  }
+  EXPECT_EQ(3u, listEntries().size());
+}
+
+} // end anonymous namespace
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ExecutionEngine/SectionMemoryManager.h"
+#include "llvm/ADT/STLExtras.h"
 #include "gtest/gtest.h"
 
 using namespace llvm;
@@ -166,5 +167,92 @@ TEST(MCJITMemoryManagerTest, ManyVariedAllocations) {
   }
 }
 
-} // Namespace
+TEST(MCJITMemoryManagerTest, PoolAllocations) {
+  const size_t SlabSize = 1 << 20;
+  SectionMemoryPool Pool(SlabSize);
+  std::string Error;
+
+  // Sections of several memory managers are packed into the same slabs.
+  auto MemMgr1 = make_unique<SectionMemoryManager>(&Pool);
+  auto MemMgr2 = make_unique<SectionMemoryManager>(&Pool);
+  uint8_t *code1 = MemMgr1->allocateCodeSection(256, 0, 1, "");
+  uint8_t *data1 = MemMgr1->allocateDataSection(256, 0, 2, "", true);
+  uint8_t *code2 = MemMgr2->allocateCodeSection(256, 0, 1, "");
+  uint8_t *data2 = MemMgr2->allocateDataSection(256, 0, 2, "", false);
+  ASSERT_NE((uint8_t*)nullptr, code1);
+  ASSERT_NE((uint8_t*)nullptr, data1);
+  ASSERT_NE((uint8_t*)nullptr, code2);
+  ASSERT_NE((uint8_t*)nullptr, data2);
+  EXPECT_EQ(2u, Pool.getNumSlabs());
 
+  for (unsigned i = 0; i < 256; ++i) {
+    code1[i] = 1;
+    data1[i] = 2;
+    code2[i] = 3;
+    data2[i] = 4;
+  }
+  EXPECT_FALSE(MemMgr1->finalizeMemory(&Error));
+  EXPECT_FALSE(MemMgr2->finalizeMemory(&Error));
+  for (unsigned i = 0; i < 256; ++i) {
+    EXPECT_EQ(1, code1[i]);
+    EXPECT_EQ(2, data1[i]);
+    EXPECT_EQ(3, code2[i]);
+    EXPECT_EQ(4, data2[i]);
+  }
+
+  // The memory of a destroyed memory manager is reused by the next one.
+  size_t FreeSize = Pool.getFreeSize();
+  MemMgr1.reset();
+  EXPECT_LT(FreeSize, Pool.getFreeSize());
+  auto MemMgr3 = make_unique<SectionMemoryManager>(&Pool);
+  EXPECT_EQ(code1, MemMgr3->allocateCodeSection(256, 0, 1, ""));
+  EXPECT_EQ(2u, Pool.getNumSlabs());
+
+  // Allocations larger than a slab get a slab of their own, which is given
+  // back to the system once it is unused.
+  uint8_t *big = MemMgr3->allocateDataSection(4 * SlabSize, 0, 2, "", false);
+  ASSERT_NE((uint8_t*)nullptr, big);
+  big[4 * SlabSize - 1] = 5;
+  EXPECT_EQ(3u, Pool.getNumSlabs());
+  EXPECT_FALSE(MemMgr3->finalizeMemory(&Error));
+  MemMgr3.reset();
+  EXPECT_EQ(2u, Pool.getNumSlabs());
+
+  MemMgr2.reset();
+  EXPECT_EQ(Pool.getReservedSize(), Pool.getFreeSize());
+}
+
+TEST(MCJITMemoryManagerTest, HugePagePool) {
+  // Huge pages are only a hint, so this merely checks that code allocated
+  // with the hint is usable.
+  SectionMemoryPool Pool(1 << 20, /*HugePagesForCode=*/true);
+  auto MemMgr = make_unique<SectionMemoryManager>(&Pool);
+  uint8_t *code = MemMgr->allocateCodeSection(0x10000, 0, 1, "");
+  ASSERT_NE((uint8_t*)nullptr, code);
+  for (unsigned i = 0; i < 0x10000; ++i)
+    code[i] = i % 251;
+  std::string Error;
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+  for (unsigned i = 0; i < 0x10000; ++i)
+    EXPECT_EQ(i % 251, code[i]);
+
+  // Finalizing made the rest of the block executable too, so later code goes
+  // to a new, writable block.
+  uint8_t *code2 = MemMgr->allocateCodeSection(256, 0, 2, "");
+  ASSERT_NE((uint8_t*)nullptr, code2);
+  EXPECT_TRUE(code2 >= code + 0x10000);
+  for (unsigned i = 0; i < 256; ++i)
+    code2[i] = i;
+  EXPECT_FALSE(MemMgr->finalizeMemory(&Error));
+
+  // Blocks given back are reused, and made writable again.
+  MemMgr.reset();
+  EXPECT_EQ(Pool.getReservedSize(), Pool.getFreeSize());
+  auto MemMgr2 = make_unique<SectionMemoryManager>(&Pool);
+  uint8_t *code3 = MemMgr2->allocateCodeSection(256, 0, 1, "");
+  ASSERT_EQ(code, code3);
+  for (unsigned i = 0; i < 256; ++i)
+    code3[i] = 0;
+}
+
+} // Namespace
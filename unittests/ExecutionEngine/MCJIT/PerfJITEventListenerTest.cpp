@@ -0,0 +1,125 @@
+//===- PerfJITEventListenerTest.cpp - Unit tests for the perf listener ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "MCJITTestBase.h"
+#include "llvm/ExecutionEngine/JITEventListener.h"
+#include "llvm/Support/ELF.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <unistd.h>
+
+using namespace llvm;
+
+namespace {
+
+class PerfJITEventListenerTest : public testing::Test, public MCJITTestBase {
+protected:
+  void SetUp() override {
+    ASSERT_FALSE(
+        sys::fs::createUniqueDirectory("PerfJITEventListenerTest", Dir));
+  }
+
+  void TearDown() override {
+    sys::fs::remove(getPath("perf-", ".map"));
+    sys::fs::remove(getPath("jit-", ".dump"));
+    sys::fs::remove(Dir);
+  }
+
+  std::string getPath(StringRef Prefix, StringRef Suffix) {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, Prefix + Twine(::getpid()) + Suffix);
+    return Path.str();
+  }
+
+  SmallString<128> Dir;
+};
+
+template <typename T> T read(StringRef Buffer, size_t Offset) {
+  return support::endian::read<T, support::native, support::unaligned>(
+      Buffer.data() + Offset);
+}
+
+TEST_F(PerfJITEventListenerTest, CodeLoadRecords) {
+  SKIP_UNSUPPORTED_PLATFORM;
+
+  M.reset(createEmptyModule("<main>"));
+  insertAddFunction(M.get());
+  createJIT(std::move(M));
+  std::unique_ptr<JITEventListener> Listener(
+      JITEventListener::createPerfJITEventListener(Dir, Dir));
+  ASSERT_TRUE(Listener != nullptr);
+  TheJIT->RegisterJITEventListener(Listener.get());
+  TheJIT->finalizeObject();
+  uint64_t AddAddr = TheJIT->getFunctionAddress("add");
+  ASSERT_NE(0u, AddAddr);
+  TheJIT->UnregisterJITEventListener(Listener.get());
+
+  // The perf map has one "<address> <size> <name>" line per function, with
+  // the numbers in hexadecimal.
+  auto MapOrErr = MemoryBuffer::getFile(getPath("perf-", ".map"));
+  ASSERT_TRUE(bool(MapOrErr));
+  SmallVector<StringRef, 2> Lines;
+  (*MapOrErr)->getBuffer().split(Lines, '\n', -1, /*KeepEmpty=*/false);
+  ASSERT_EQ(1u, Lines.size());
+  SmallVector<StringRef, 3> Fields;
+  Lines[0].split(Fields, ' ');
+  ASSERT_EQ(3u, Fields.size());
+  uint64_t MapAddr, Size;
+  ASSERT_FALSE(Fields[0].getAsInteger(16, MapAddr));
+  ASSERT_FALSE(Fields[1].getAsInteger(16, Size));
+  EXPECT_EQ(AddAddr, MapAddr);
+  EXPECT_NE(0u, Size);
+  EXPECT_EQ("add", Fields[2]);
+
+  // Destroying the listener closes the jitdump file.
+  Listener.reset();
+  auto DumpOrErr = MemoryBuffer::getFile(getPath("jit-", ".dump"));
+  ASSERT_TRUE(bool(DumpOrErr));
+  StringRef Dump = (*DumpOrErr)->getBuffer();
+
+  // The file header.
+  const size_t HeaderSize = 40;
+  ASSERT_LE(HeaderSize, Dump.size());
+  EXPECT_EQ(0x4A695444u, read<uint32_t>(Dump, 0)); // "JiTD"
+  EXPECT_EQ(1u, read<uint32_t>(Dump, 4));
+  EXPECT_EQ(HeaderSize, read<uint32_t>(Dump, 8));
+  EXPECT_NE(uint32_t(ELF::EM_NONE), read<uint32_t>(Dump, 12));
+  EXPECT_EQ(uint32_t(::getpid()), read<uint32_t>(Dump, 20));
+  Dump = Dump.drop_front(HeaderSize);
+
+  // The code load record of add: the record prefix, the pid and tid, the
+  // address (twice), size and index of the code, then its name and a copy of
+  // the code. The module has no debug info, so there is no debug info record.
+  const size_t CodeLoadSize = 56;
+  ASSERT_LE(CodeLoadSize, Dump.size());
+  EXPECT_EQ(0u, read<uint32_t>(Dump, 0));
+  uint32_t TotalSize = read<uint32_t>(Dump, 4);
+  EXPECT_EQ(CodeLoadSize + sizeof("add") + Size, TotalSize);
+  EXPECT_EQ(uint32_t(::getpid()), read<uint32_t>(Dump, 16));
+  EXPECT_EQ(AddAddr, read<uint64_t>(Dump, 24));
+  EXPECT_EQ(AddAddr, read<uint64_t>(Dump, 32));
+  EXPECT_EQ(Size, read<uint64_t>(Dump, 40));
+  EXPECT_EQ(0u, read<uint64_t>(Dump, 48));
+  ASSERT_LE(TotalSize, Dump.size());
+  EXPECT_EQ(StringRef("add\0", 4), Dump.substr(CodeLoadSize, 4));
+  EXPECT_EQ(0, std::memcmp(Dump.data() + CodeLoadSize + 4,
+                           reinterpret_cast<const void *>(AddAddr), Size));
+  Dump = Dump.drop_front(TotalSize);
+
+  // The close record ends the file.
+  ASSERT_EQ(16u, Dump.size());
+  EXPECT_EQ(3u, read<uint32_t>(Dump, 0));
+  EXPECT_EQ(16u, read<uint32_t>(Dump, 4));
+}
+
+} // end anonymous namespace
@@ -9,7 +9,9 @@
 
 #include "OrcTestCommon.h"
 #include "llvm/ExecutionEngine/Orc/CompileOnDemandLayer.h"
+#include "llvm/ExecutionEngine/SectionMemoryManager.h"
 #include "gtest/gtest.h"
+#include <thread>
 
 using namespace llvm;
 using namespace llvm::orc;
@@ -70,4 +72,151 @@ TEST(CompileOnDemandLayerTest, FindSymbol) {
   EXPECT_TRUE(!!Sym) << "CompileOnDemand::findSymbol should call findSymbol in "
                         "the base layer.";
 }
+
+#if LLVM_ENABLE_THREADS
+
+// Hands out fake trampoline addresses.
+class FakeCallbackManager : public orc::JITCompileCallbackManager {
+public:
+  FakeCallbackManager() : JITCompileCallbackManager(0) {}
+
+private:
+  void grow() override {
+    for (unsigned I = 0; I != 16; ++I)
+      AvailableTrampolines.push_back(0x1000 + 0x10 * NextTrampoline++);
+  }
+
+  unsigned NextTrampoline = 0;
+};
+
+// Records the pointer of every stub, and hands out fake stub addresses.
+class FakeStubsManager : public orc::IndirectStubsManager {
+public:
+  Error createStub(StringRef StubName, JITTargetAddress InitAddr,
+                   JITSymbolFlags Flags) override {
+    Stubs[StubName] = std::make_pair(0x2000 + 0x10 * Stubs.size(), InitAddr);
+    return Error::success();
+  }
+
+  Error createStubs(const StubInitsMap &StubInits) override {
+    for (auto &Entry : StubInits)
+      if (auto Err = createStub(Entry.first(), Entry.second.first,
+                                Entry.second.second))
+        return Err;
+    return Error::success();
+  }
+
+  JITSymbol findStub(StringRef Name, bool ExportedStubsOnly) override {
+    auto I = Stubs.find(Name);
+    if (I == Stubs.end())
+      return nullptr;
+    return JITSymbol(I->second.first, JITSymbolFlags::Exported);
+  }
+
+  JITSymbol findPointer(StringRef Name) override {
+    llvm_unreachable("Not implemented");
+  }
+
+  Error updatePointer(StringRef Name, JITTargetAddress NewAddr) override {
+    Stubs[Name].second = NewAddr;
+    return Error::success();
+  }
+
+  // Stub name -> (stub address, pointer).
+  StringMap<std::pair<JITTargetAddress, JITTargetAddress>> Stubs;
+};
+
+TEST(CompileOnDemandLayerTest, BackgroundCompile) {
+  // f calls g, which calls h.
+  LLVMContext Context;
+  auto M = llvm::make_unique<Module>("test", Context);
+  FunctionType *FTy = FunctionType::get(Type::getVoidTy(Context), false);
+  Function *Prev = nullptr;
+  for (const char *Name : {"h", "g", "f"}) {
+    Function *F =
+        Function::Create(FTy, GlobalValue::ExternalLinkage, Name, M.get());
+    IRBuilder<> B(BasicBlock::Create(Context, "entry", F));
+    if (Prev)
+      B.CreateCall(Prev);
+    B.CreateRetVoid();
+    Prev = F;
+  }
+
+  // The base layer "compiles" every function to a fake address.
+  std::vector<std::unique_ptr<Module>> Compiled;
+  StringMap<JITTargetAddress> Bodies;
+  auto MockBaseLayer = createMockBaseLayer<int>(
+      [&](std::vector<std::unique_ptr<Module>> Ms, RuntimeDyld::MemoryManager *,
+          std::unique_ptr<JITSymbolResolver>) {
+        for (auto &PM : Ms) {
+          for (auto &F : *PM)
+            if (!F.isDeclaration())
+              Bodies[F.getName()] = 0x3000 + 0x10 * Bodies.size();
+          Compiled.push_back(std::move(PM));
+        }
+        return static_cast<int>(Compiled.size());
+      },
+      DoNothingAndReturn<void>(),
+      DoNothingAndReturn<JITSymbol>(nullptr),
+      [&](int, const std::string &Name, bool) {
+        auto I = Bodies.find(Name);
+        if (I == Bodies.end())
+          return JITSymbol(nullptr);
+        return JITSymbol(I->second, JITSymbolFlags::Exported);
+      });
+
+  typedef decltype(MockBaseLayer) MockBaseLayerT;
+  FakeCallbackManager CallbackMgr;
+  FakeStubsManager *StubsMgr = nullptr;
+
+  llvm::orc::CompileOnDemandLayer<MockBaseLayerT> COD(
+      MockBaseLayer, [](Function &F) { return std::set<Function *>{&F}; },
+      CallbackMgr,
+      [&] {
+        auto SM = llvm::make_unique<FakeStubsManager>();
+        StubsMgr = SM.get();
+        return SM;
+      },
+      false, true);
+
+  std::vector<std::unique_ptr<Module>> Ms;
+  Ms.push_back(std::move(M));
+  COD.addModuleSet(std::move(Ms), llvm::make_unique<SectionMemoryManager>(),
+                   createLambdaResolver(
+                       [](const std::string &) { return JITSymbol(nullptr); },
+                       [](const std::string &) { return JITSymbol(nullptr); }));
+  ASSERT_TRUE(StubsMgr);
+  JITTargetAddress TrampolineG = StubsMgr->Stubs["g"].second;
+
+  // Calling f compiles it synchronously, and queues g for the compile thread,
+  // which then queues h in turn.
+  JITTargetAddress FAddr =
+      CallbackMgr.executeCompileCallback(StubsMgr->Stubs["f"].second);
+
+  for (unsigned I = 0; I != 10000; ++I) {
+    if (COD.getCompileStats().NumBackgroundCompiles == 2)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  auto Stats = COD.getCompileStats();
+  ASSERT_EQ(2U, Stats.NumBackgroundCompiles);
+  EXPECT_EQ(1U, Stats.NumStalls);
+  EXPECT_EQ(0U, Stats.NumBackgroundHits);
+
+  // The compile thread retargeted the stubs.
+  EXPECT_EQ(Bodies["f"], FAddr);
+  EXPECT_EQ(Bodies["f"], StubsMgr->Stubs["f"].second);
+  EXPECT_EQ(Bodies["g"], StubsMgr->Stubs["g"].second);
+  EXPECT_EQ(Bodies["h"], StubsMgr->Stubs["h"].second);
+
+  // A call that raced with the compile thread goes through the stub.
+  EXPECT_EQ(StubsMgr->Stubs["g"].first,
+            CallbackMgr.executeCompileCallback(TrampolineG));
+  Stats = COD.getCompileStats();
+  EXPECT_EQ(2U, Stats.NumStalls);
+  EXPECT_EQ(1U, Stats.NumBackgroundHits);
+  EXPECT_GE(Stats.TotalStallTime, Stats.MaxStallTime);
+}
+
+#endif // LLVM_ENABLE_THREADS
 }
@@ -244,4 +244,134 @@ TEST_F(ObjectLinkingLayerExecutionTest, NoPrematureAllocation) {
          "(multiple unrelated objects loaded prior to finalization)";
 }
 
+TEST_F(ObjectLinkingLayerExecutionTest, NotifyJITEventListeners) {
+  if (!TM)
+    return;
+
+  class CountingListener : public JITEventListener {
+  public:
+    void NotifyObjectEmitted(const object::ObjectFile &Obj,
+                             const RuntimeDyld::LoadedObjectInfo &L) override {
+      ++NumObjects;
+      for (auto &Sym : Obj.symbols())
+        if (auto Name = Sym.getName())
+          FooSeen |= *Name == "foo";
+        else
+          consumeError(Name.takeError());
+    }
+
+    int NumObjects = 0;
+    bool FooSeen = false;
+  };
+
+  // Listeners registered after the layer is constructed are notified.
+  NotifyJITEventListeners::ListenerListT Listeners;
+  ObjectLinkingLayer<NotifyJITEventListeners> ObjLayer(Listeners);
+  CountingListener L1, L2;
+  Listeners.push_back(&L1);
+  Listeners.push_back(&L2);
+
+  ModuleBuilder MB(Context, "", "dummy");
+  {
+    MB.getModule()->setDataLayout(TM->createDataLayout());
+    Function *FooImpl = MB.createFunctionDecl<int32_t(void)>("foo");
+    BasicBlock *FooEntry = BasicBlock::Create(Context, "entry", FooImpl);
+    IRBuilder<> Builder(FooEntry);
+    IntegerType *Int32Ty = IntegerType::get(Context, 32);
+    Builder.CreateRet(ConstantInt::getSigned(Int32Ty, 42));
+  }
+  auto Obj = SimpleCompiler(*TM)(*MB.getModule());
+  std::vector<object::ObjectFile*> ObjSet;
+  ObjSet.push_back(Obj.getBinary());
+
+  SectionMemoryManagerWrapper SMMW;
+  NullResolver NR;
+  auto H = ObjLayer.addObjectSet(std::move(ObjSet), &SMMW, &NR);
+  EXPECT_EQ(0, L1.NumObjects) << "Listener notified before the object loaded";
+  ObjLayer.emitAndFinalize(H);
+
+  EXPECT_EQ(1, L1.NumObjects);
+  EXPECT_EQ(1, L2.NumObjects);
+  EXPECT_TRUE(L1.FooSeen) << "Listener was not given the loaded object";
+}
+
+static int32_t bulkLookupBar() { return 7; }
+static int32_t bulkLookupBaz() { return 35; }
+
+TEST_F(ObjectLinkingLayerExecutionTest, BulkSymbolLookup) {
+  if (!TM)
+    return;
+
+  class CountingResolver : public JITSymbolResolver {
+  public:
+    JITSymbol findSymbolInLogicalDylib(const std::string &Name) override {
+      return nullptr;
+    }
+
+    JITSymbol findSymbol(const std::string &Name) override {
+      ++NumFindSymbolCalls;
+      StringRef N(Name);
+      N.consume_front("_");
+      if (N == "bar")
+        return JITSymbol(
+            static_cast<JITTargetAddress>(
+                reinterpret_cast<uintptr_t>(&bulkLookupBar)),
+            JITSymbolFlags::Exported);
+      if (N == "baz")
+        return JITSymbol(
+            static_cast<JITTargetAddress>(
+                reinterpret_cast<uintptr_t>(&bulkLookupBaz)),
+            JITSymbolFlags::Exported);
+      return nullptr;
+    }
+
+    Expected<LookupResult> lookup(const LookupSet &Symbols) override {
+      ++NumLookupCalls;
+      NumSymbolsLookedUp += Symbols.size();
+      return JITSymbolResolver::lookup(Symbols);
+    }
+
+    int NumFindSymbolCalls = 0;
+    int NumLookupCalls = 0;
+    int NumSymbolsLookedUp = 0;
+  };
+
+  ObjectLinkingLayer<> ObjLayer;
+
+  // Create a module with two external references, each used twice:
+  //   int bar();
+  //   int baz();
+  //   int foo() { return bar() + baz() + bar() + baz(); }
+  //
+  // Verify that RuntimeDyld resolves both symbols with a single call to the
+  // resolver's lookup method.
+  ModuleBuilder MB(Context, "", "dummy");
+  {
+    MB.getModule()->setDataLayout(TM->createDataLayout());
+    Function *BarDecl = MB.createFunctionDecl<int32_t(void)>("bar");
+    Function *BazDecl = MB.createFunctionDecl<int32_t(void)>("baz");
+    Function *FooImpl = MB.createFunctionDecl<int32_t(void)>("foo");
+    BasicBlock *FooEntry = BasicBlock::Create(Context, "entry", FooImpl);
+    IRBuilder<> Builder(FooEntry);
+    Value *Sum = Builder.CreateAdd(Builder.CreateCall(BarDecl),
+                                   Builder.CreateCall(BazDecl));
+    Sum = Builder.CreateAdd(Sum, Builder.CreateCall(BarDecl));
+    Sum = Builder.CreateAdd(Sum, Builder.CreateCall(BazDecl));
+    Builder.CreateRet(Sum);
+  }
+  auto Obj = SimpleCompiler(*TM)(*MB.getModule());
+  std::vector<object::ObjectFile*> ObjSet;
+  ObjSet.push_back(Obj.getBinary());
+
+  SectionMemoryManagerWrapper SMMW;
+  CountingResolver Resolver;
+  auto H = ObjLayer.addObjectSet(std::move(ObjSet), &SMMW, &Resolver);
+  ObjLayer.emitAndFinalize(H);
+
+  EXPECT_EQ(1, Resolver.NumLookupCalls)
+      << "External symbols were not resolved in a single lookup";
+  EXPECT_EQ(2, Resolver.NumSymbolsLookedUp);
+  EXPECT_EQ(2, Resolver.NumFindSymbolCalls);
+}
+
 } // end anonymous namespace
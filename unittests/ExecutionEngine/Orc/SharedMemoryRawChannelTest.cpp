@@ -0,0 +1,214 @@
+//===- SharedMemoryRawChannelTest.cpp - Unit tests for the shm channel ----===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/ExecutionEngine/Orc/SharedMemoryRawChannel.h"
+#include "llvm/Config/llvm-config.h"
+#include "llvm/ExecutionEngine/Orc/RPCUtils.h"
+#include "llvm/Support/Process.h"
+#include "gtest/gtest.h"
+
+#include <thread>
+
+#ifdef LLVM_ON_UNIX
+#include <unistd.h>
+
+using namespace llvm;
+using namespace llvm::orc;
+using namespace llvm::orc::rpc;
+
+namespace {
+
+class TestRPCAPI {
+public:
+  class IntInt : public Function<IntInt, int32_t(int32_t)> {
+  public:
+    static const char *getName() { return "IntInt"; }
+  };
+
+  class Echo : public Function<Echo, std::string(std::string)> {
+  public:
+    static const char *getName() { return "Echo"; }
+  };
+};
+
+class TestRPCEndpoint : public TestRPCAPI,
+                        public SingleThreadedRPC<RawByteChannel> {
+public:
+  TestRPCEndpoint(RawByteChannel &C) : SingleThreadedRPC(C, true) {}
+};
+
+/// Both ends of a channel, in this process.
+class SharedMemoryRawChannelTest : public testing::Test {
+protected:
+  void connect(uint64_t RingSize, uint64_t HeapSize) {
+    ASSERT_EQ(0, pipe(ToExecutor));
+    ASSERT_EQ(0, pipe(ToJIT));
+    auto JITOrErr = SharedMemoryRawChannel::create(ToJIT[0], ToExecutor[1],
+                                                   RingSize, HeapSize);
+    ASSERT_TRUE(!!JITOrErr);
+    JIT = std::move(*JITOrErr);
+    auto ExecutorOrErr = SharedMemoryRawChannel::attach(
+        dup(JIT->getSharedMemoryFD()), ToExecutor[0], ToJIT[1]);
+    ASSERT_TRUE(!!ExecutorOrErr);
+    Executor = std::move(*ExecutorOrErr);
+  }
+
+  void TearDown() override {
+    JIT.reset();
+    Executor.reset();
+    for (int FD : {ToExecutor[0], ToExecutor[1], ToJIT[0], ToJIT[1]})
+      if (FD >= 0)
+        close(FD);
+  }
+
+  int ToExecutor[2] = {-1, -1};
+  int ToJIT[2] = {-1, -1};
+  std::unique_ptr<SharedMemoryRawChannel> JIT, Executor;
+};
+
+TEST_F(SharedMemoryRawChannelTest, Calls) {
+  connect(SharedMemoryRawChannel::DefaultRingSize, 0);
+  TestRPCEndpoint Client(*JIT), Server(*Executor);
+  const int32_t NumCalls = 1000;
+
+  std::thread ServerThread([&]() {
+    Server.addHandler<TestRPCAPI::IntInt>([](int32_t X) { return X + 1; });
+    // The negotiation, then the calls.
+    for (int32_t I = 0; I != NumCalls + 1; ++I)
+      EXPECT_FALSE(!!Server.handleOne()) << "Server failed to handle call";
+    // Responses are only published when the server waits for more input.
+    EXPECT_FALSE(!!Executor->send()) << "Server failed to send responses";
+  });
+
+  for (int32_t I = 0; I != NumCalls; ++I) {
+    auto Result = Client.callB<TestRPCAPI::IntInt>(I);
+    ASSERT_TRUE(!!Result) << "Call failed";
+    EXPECT_EQ(I + 1, *Result);
+  }
+
+  ServerThread.join();
+}
+
+TEST_F(SharedMemoryRawChannelTest, MessagesLargerThanRing) {
+  uint64_t RingSize = sys::Process::getPageSize();
+  connect(RingSize, 0);
+  TestRPCEndpoint Client(*JIT), Server(*Executor);
+
+  std::thread ServerThread([&]() {
+    Server.addHandler<TestRPCAPI::Echo>(
+        [](std::string S) { return std::string(S.rbegin(), S.rend()); });
+    for (unsigned I = 0; I != 3; ++I)
+      EXPECT_FALSE(!!Server.handleOne()) << "Server failed to handle call";
+    // Responses are only published when the server waits for more input.
+    EXPECT_FALSE(!!Executor->send()) << "Server failed to send responses";
+  });
+
+  // Messages wrap around the rings and must wait for space to be freed.
+  for (uint64_t Size : {RingSize * 3 + 5, RingSize - 3}) {
+    std::string Message;
+    for (uint64_t I = 0; I != Size; ++I)
+      Message += static_cast<char>('a' + I % 26);
+    auto Result = Client.callB<TestRPCAPI::Echo>(Message);
+    ASSERT_TRUE(!!Result) << "Call failed";
+    EXPECT_EQ(std::string(Message.rbegin(), Message.rend()), *Result);
+  }
+
+  ServerThread.join();
+}
+
+TEST_F(SharedMemoryRawChannelTest, BatchedCalls) {
+  connect(SharedMemoryRawChannel::DefaultRingSize, 0);
+  TestRPCEndpoint Client(*JIT), Server(*Executor);
+  const int32_t NumCalls = 100;
+
+  std::thread ServerThread([&]() {
+    Server.addHandler<TestRPCAPI::IntInt>([](int32_t X) { return X * 2; });
+    // The negotiation, the first call, then the batch.
+    for (int32_t I = 0; I != NumCalls + 2; ++I)
+      EXPECT_FALSE(!!Server.handleOne()) << "Server failed to handle call";
+    // Responses are only published when the server waits for more input.
+    EXPECT_FALSE(!!Executor->send()) << "Server failed to send responses";
+  });
+
+  // Negotiate the function before starting the batch.
+  ASSERT_FALSE(!!Client.callB<TestRPCAPI::IntInt>(0).takeError());
+
+  int32_t NumPending = 0, Sum = 0;
+  for (int32_t I = 0; I != NumCalls; ++I) {
+    ++NumPending;
+    auto Err = Client.appendCallAsync<TestRPCAPI::IntInt>(
+        [&](Expected<int32_t> Result) -> Error {
+          --NumPending;
+          if (!Result)
+            return Result.takeError();
+          Sum += *Result;
+          return Error::success();
+        },
+        I);
+    ASSERT_FALSE(!!Err) << "Failed to append call";
+  }
+  ASSERT_FALSE(!!Client.sendAppendedCalls());
+  while (NumPending != 0)
+    ASSERT_FALSE(!!Client.handleOne()) << "Failed to handle response";
+  EXPECT_EQ(NumCalls * (NumCalls - 1), Sum);
+
+  ServerThread.join();
+}
+
+TEST_F(SharedMemoryRawChannelTest, SharedHeap) {
+  uint64_t PageSize = sys::Process::getPageSize();
+  connect(SharedMemoryRawChannel::DefaultRingSize, 4 * PageSize);
+
+  auto A = Executor->allocateSharedMemory(PageSize + 1);
+  ASSERT_TRUE(!!A);
+  auto B = Executor->allocateSharedMemory(PageSize);
+  ASSERT_TRUE(!!B);
+  EXPECT_EQ(2 * PageSize, A->size());
+  auto TooBig = Executor->allocateSharedMemory(2 * PageSize);
+  EXPECT_FALSE(!!TooBig);
+  consumeError(TooBig.takeError());
+
+  // The JIT sees the executor's memory at a different address.
+  JITTargetAddress BAddr = reinterpret_cast<uintptr_t>(B->base());
+  char *Local = JIT->getLocalAddress(BAddr, PageSize);
+  ASSERT_NE(nullptr, Local);
+  EXPECT_NE(static_cast<char *>(B->base()), Local);
+  strcpy(Local, "written by the JIT");
+  EXPECT_STREQ("written by the JIT", static_cast<char *>(B->base()));
+  EXPECT_EQ(nullptr, JIT->getLocalAddress(BAddr, 3 * PageSize));
+
+  // Freed blocks are merged with their neighbours.
+  EXPECT_TRUE(Executor->releaseSharedMemory(*A));
+  EXPECT_TRUE(Executor->releaseSharedMemory(*B));
+  auto All = Executor->allocateSharedMemory(4 * PageSize);
+  ASSERT_TRUE(!!All);
+  EXPECT_TRUE(Executor->releaseSharedMemory(*All));
+
+  sys::MemoryBlock Other(&PageSize, sizeof(PageSize));
+  EXPECT_FALSE(Executor->releaseSharedMemory(Other));
+}
+
+TEST_F(SharedMemoryRawChannelTest, PeerExit) {
+  connect(SharedMemoryRawChannel::DefaultRingSize, 0);
+  JIT->setSpinCount(0);
+
+  // Once the executor is gone and its end of the pipe closed, reads fail
+  // rather than wait forever.
+  Executor.reset();
+  close(ToJIT[1]);
+  ToJIT[1] = -1;
+  char C;
+  Error Err = JIT->readBytes(&C, 1);
+  EXPECT_TRUE(!!Err);
+  consumeError(std::move(Err));
+}
+
+} // end anonymous namespace
+
+#endif // LLVM_ON_UNIX
@@ -11,12 +11,15 @@
 #include "llvm/Analysis/PostDominators.h"
 #include "llvm/AsmParser/Parser.h"
 #include "llvm/IR/Constants.h"
+#include "llvm/IR/IRBuilder.h"
 #include "llvm/IR/Instructions.h"
 #include "llvm/IR/LLVMContext.h"
 #include "llvm/IR/Module.h"
 #include "llvm/IR/LegacyPassManager.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/SourceMgr.h"
 #include "gtest/gtest.h"
+#include <random>
 
 using namespace llvm;
 
@@ -251,6 +254,222 @@ namespace llvm {
       Passes.add(P);
       Passes.run(*M);
     }
+
+    // A function whose CFG edges can be changed freely: each block ends in a
+    // switch over the argument with one case per successor, or in a return if
+    // it has no successors.
+    class CFGHolder {
+      LLVMContext Context;
+      Module M;
+      Function *F;
+      std::vector<BasicBlock *> Blocks;
+      std::vector<std::vector<BasicBlock *>> Succs;
+
+    public:
+      explicit CFGHolder(unsigned NumBlocks)
+          : M("cfg", Context), Succs(NumBlocks) {
+        F = Function::Create(
+            FunctionType::get(Type::getVoidTy(Context),
+                              {Type::getInt32Ty(Context)}, false),
+            GlobalValue::ExternalLinkage, "f", &M);
+        for (unsigned I = 0; I != NumBlocks; ++I)
+          Blocks.push_back(BasicBlock::Create(Context, "", F));
+        for (unsigned I = 0; I != NumBlocks; ++I)
+          updateTerminator(I);
+      }
+
+      Function &getFunction() { return *F; }
+      BasicBlock *getBlock(unsigned I) { return Blocks[I]; }
+      unsigned size() const { return Blocks.size(); }
+
+      bool hasEdge(unsigned From, unsigned To) const {
+        return is_contained(Succs[From], Blocks[To]);
+      }
+
+      void insertEdge(unsigned From, unsigned To) {
+        Succs[From].push_back(Blocks[To]);
+        updateTerminator(From);
+      }
+
+      void deleteEdge(unsigned From, unsigned To) {
+        Succs[From].erase(find(Succs[From], Blocks[To]));
+        updateTerminator(From);
+      }
+
+    private:
+      void updateTerminator(unsigned I) {
+        BasicBlock *BB = Blocks[I];
+        if (TerminatorInst *TI = BB->getTerminator())
+          TI->eraseFromParent();
+        IRBuilder<> Builder(BB);
+        if (Succs[I].empty()) {
+          Builder.CreateRetVoid();
+          return;
+        }
+        SwitchInst *SI = Builder.CreateSwitch(&*F->arg_begin(), Succs[I][0]);
+        for (unsigned J = 1, E = Succs[I].size(); J != E; ++J)
+          SI->addCase(Builder.getInt32(J), Succs[I][J]);
+      }
+    };
+
+    TEST(DominatorTree, InsertAndDeleteEdges) {
+      // 0 -> 1 -> 2 -> 3, and 4 is unreachable.
+      CFGHolder CFG(5);
+      CFG.insertEdge(0, 1);
+      CFG.insertEdge(1, 2);
+      CFG.insertEdge(2, 3);
+      DominatorTree DT(CFG.getFunction());
+      PostDominatorTree PDT;
+      PDT.recalculate(CFG.getFunction());
+      BasicBlock *BB0 = CFG.getBlock(0), *BB1 = CFG.getBlock(1),
+                 *BB2 = CFG.getBlock(2), *BB3 = CFG.getBlock(3),
+                 *BB4 = CFG.getBlock(4);
+
+      // The shortcut 0 -> 2 makes 0 the immediate dominator of 2.
+      CFG.insertEdge(0, 2);
+      DT.insertEdge(BB0, BB2);
+      PDT.insertEdge(BB0, BB2);
+      EXPECT_TRUE(DT.verify());
+      EXPECT_TRUE(PDT.verify());
+      EXPECT_EQ(DT.getNode(BB2)->getIDom()->getBlock(), BB0);
+      EXPECT_EQ(DT.getNode(BB3)->getLevel(), 2u);
+
+      // 4 becomes reachable through 1.
+      CFG.insertEdge(1, 4);
+      CFG.insertEdge(4, 3);
+      DT.applyUpdates({{DominatorTree::Insert, BB1, BB4},
+                       {DominatorTree::Insert, BB4, BB3}});
+      PDT.applyUpdates({{DominatorTree::Insert, BB1, BB4},
+                        {DominatorTree::Insert, BB4, BB3}});
+      EXPECT_TRUE(DT.verify());
+      EXPECT_TRUE(PDT.verify());
+      EXPECT_EQ(DT.getNode(BB4)->getIDom()->getBlock(), BB1);
+      EXPECT_EQ(PDT.getNode(BB4)->getIDom()->getBlock(), BB3);
+
+      // Without 0 -> 1, 1 and 4 are unreachable.
+      CFG.deleteEdge(0, 1);
+      DT.deleteEdge(BB0, BB1);
+      PDT.deleteEdge(BB0, BB1);
+      EXPECT_TRUE(DT.verify());
+      EXPECT_TRUE(PDT.verify());
+      EXPECT_EQ(DT.getNode(BB1), nullptr);
+      EXPECT_EQ(DT.getNode(BB4), nullptr);
+      EXPECT_EQ(DT.getNode(BB3)->getIDom()->getBlock(), BB2);
+
+      // Updates that cancel out are ignored.
+      DT.applyUpdates({{DominatorTree::Insert, BB2, BB0},
+                       {DominatorTree::Delete, BB2, BB0}});
+      EXPECT_TRUE(DT.verify());
+    }
+
+    TEST(DominatorTree, RandomUpdates) {
+      const unsigned NumBlocks = 24;
+      std::mt19937 Generator(42);
+      std::uniform_int_distribution<unsigned> RandomBlock(0, NumBlocks - 1);
+
+      CFGHolder CFG(NumBlocks);
+      for (unsigned I = 0; I != NumBlocks * 2; ++I) {
+        unsigned From = RandomBlock(Generator), To = RandomBlock(Generator);
+        if (!CFG.hasEdge(From, To))
+          CFG.insertEdge(From, To);
+      }
+      DominatorTree DT(CFG.getFunction());
+      PostDominatorTree PDT;
+      PDT.recalculate(CFG.getFunction());
+
+      for (unsigned I = 0; I != 400; ++I) {
+        unsigned From = RandomBlock(Generator), To = RandomBlock(Generator);
+        // Never add edges to the entry block.
+        if (To == 0)
+          continue;
+        BasicBlock *FromBB = CFG.getBlock(From), *ToBB = CFG.getBlock(To);
+        if (CFG.hasEdge(From, To)) {
+          CFG.deleteEdge(From, To);
+          DT.deleteEdge(FromBB, ToBB);
+          PDT.deleteEdge(FromBB, ToBB);
+        } else {
+          CFG.insertEdge(From, To);
+          DT.insertEdge(FromBB, ToBB);
+          PDT.insertEdge(FromBB, ToBB);
+        }
+        ASSERT_TRUE(DT.verify());
+        ASSERT_TRUE(PDT.verify());
+      }
+    }
+
+    TEST(DominatorTree, RandomBatchUpdates) {
+      const unsigned NumBlocks = 24;
+      std::mt19937 Generator(7);
+      std::uniform_int_distribution<unsigned> RandomBlock(0, NumBlocks - 1);
+
+      CFGHolder CFG(NumBlocks);
+      for (unsigned I = 0; I != NumBlocks * 2; ++I) {
+        unsigned From = RandomBlock(Generator), To = RandomBlock(Generator);
+        if (To != 0 && !CFG.hasEdge(From, To))
+          CFG.insertEdge(From, To);
+      }
+      DominatorTree DT(CFG.getFunction());
+      PostDominatorTree PDT;
+      PDT.recalculate(CFG.getFunction());
+
+      for (unsigned Batch = 0; Batch != 50; ++Batch) {
+        std::vector<DominatorTree::UpdateType> Updates;
+        for (unsigned I = 0; I != 8; ++I) {
+          unsigned From = RandomBlock(Generator), To = RandomBlock(Generator);
+          if (To == 0)
+            continue;
+          BasicBlock *FromBB = CFG.getBlock(From), *ToBB = CFG.getBlock(To);
+          if (CFG.hasEdge(From, To)) {
+            CFG.deleteEdge(From, To);
+            Updates.push_back({DominatorTree::Delete, FromBB, ToBB});
+          } else {
+            CFG.insertEdge(From, To);
+            Updates.push_back({DominatorTree::Insert, FromBB, ToBB});
+          }
+        }
+        DT.applyUpdates(Updates);
+        PDT.applyUpdates(Updates);
+        ASSERT_TRUE(DT.verify());
+        ASSERT_TRUE(PDT.verify());
+      }
+    }
+
+    TEST(DominatorTree, SemiNCAConstruction) {
+      auto *UseSemiNCA = static_cast<cl::opt<bool> *>(
+          cl::getRegisteredOptions()["dom-tree-semi-nca"]);
+      ASSERT_TRUE(UseSemiNCA);
+
+      for (unsigned Seed = 0; Seed != 40; ++Seed) {
+        const unsigned NumBlocks = 8 + Seed;
+        std::mt19937 Generator(Seed);
+        std::uniform_int_distribution<unsigned> RandomBlock(0, NumBlocks - 1);
+
+        // Sparse and dense CFGs, with unreachable blocks, several exits and
+        // infinite loops.
+        CFGHolder CFG(NumBlocks);
+        for (unsigned I = 0, E = NumBlocks * (1 + Seed % 3); I != E; ++I) {
+          unsigned From = RandomBlock(Generator), To = RandomBlock(Generator);
+          if (To != 0 && !CFG.hasEdge(From, To))
+            CFG.insertEdge(From, To);
+        }
+
+        *UseSemiNCA = false;
+        DominatorTree LTDT(CFG.getFunction());
+        PostDominatorTree LTPDT;
+        LTPDT.recalculate(CFG.getFunction());
+
+        *UseSemiNCA = true;
+        DominatorTree SNCADT(CFG.getFunction());
+        PostDominatorTree SNCAPDT;
+        SNCAPDT.recalculate(CFG.getFunction());
+        *UseSemiNCA = false;
+
+        EXPECT_FALSE(LTDT.compare(SNCADT));
+        EXPECT_FALSE(LTPDT.compare(SNCAPDT));
+        EXPECT_TRUE(SNCADT.verify());
+        EXPECT_TRUE(SNCAPDT.verify());
+      }
+    }
   }
 }
 
@@ -0,0 +1,172 @@
+//===- ArchiveTest.cpp - Tests for Archive.cpp ----------------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Object/Archive.h"
+#include "llvm/Support/Endian.h"
+#include "llvm/Support/Format.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+using namespace llvm::object;
+
+namespace {
+
+enum SymtabKind { GNU, GNU64, BSD, Darwin64 };
+
+const unsigned NumMembers = 16;
+
+std::string memberName(unsigned I) { return "m" + std::to_string(I) + ".o"; }
+
+void writeHeader(raw_ostream &OS, StringRef Name, uint64_t Size) {
+  OS << format("%-16s%-12d%-6d%-6d%-8o%-10d`\n", Name.str().c_str(), 0, 0, 0,
+               0644, Size);
+}
+
+template <typename T, support::endianness E>
+void write(raw_ostream &OS, T Value) {
+  char Buf[sizeof(T)];
+  support::endian::write<T, E, 1>(Buf, Value);
+  OS.write(Buf, sizeof(T));
+}
+
+/// Build an archive of NumMembers members, whose symbol table in the format
+/// Kind maps each of Syms to the member with the paired index.
+std::string
+buildArchive(SymtabKind Kind,
+             const std::vector<std::pair<std::string, unsigned>> &Syms) {
+  std::string Strtab;
+  std::vector<uint64_t> Strx;
+  for (auto &Sym : Syms) {
+    Strx.push_back(Strtab.size());
+    Strtab += Sym.first;
+    Strtab += '\0';
+  }
+  // Keep the members 2-byte aligned.
+  if (Strtab.size() % 2)
+    Strtab += '\0';
+
+  uint64_t N = Syms.size();
+  std::string Name, Prefix;
+  uint64_t Size;
+  switch (Kind) {
+  case GNU:
+    Name = "/";
+    Size = 4 + N * 4 + Strtab.size();
+    break;
+  case GNU64:
+    Name = "/SYM64/";
+    Size = 8 + N * 8 + Strtab.size();
+    break;
+  case BSD:
+    Name = "#1/16";
+    Prefix = "__.SYMDEF SORTED";
+    Size = Prefix.size() + 4 + N * 8 + 4 + Strtab.size();
+    break;
+  case Darwin64:
+    Name = "#1/16";
+    Prefix = "__.SYMDEF_64\0\0\0\0";
+    Prefix.resize(16);
+    Size = Prefix.size() + 8 + N * 16 + 8 + Strtab.size();
+    break;
+  }
+
+  // Members are headers followed by two bytes of contents.
+  uint64_t FirstMember = 8 + 60 + Size;
+  auto MemberOffset = [&](unsigned I) { return FirstMember + I * 62; };
+
+  std::string Out;
+  raw_string_ostream OS(Out);
+  OS << "!<arch>\n";
+  writeHeader(OS, Name, Size);
+  OS << Prefix;
+  switch (Kind) {
+  case GNU:
+    write<uint32_t, support::big>(OS, N);
+    for (auto &Sym : Syms)
+      write<uint32_t, support::big>(OS, MemberOffset(Sym.second));
+    break;
+  case GNU64:
+    write<uint64_t, support::big>(OS, N);
+    for (auto &Sym : Syms)
+      write<uint64_t, support::big>(OS, MemberOffset(Sym.second));
+    break;
+  case BSD:
+    write<uint32_t, support::little>(OS, N * 8);
+    for (unsigned I = 0; I != N; ++I) {
+      write<uint32_t, support::little>(OS, Strx[I]);
+      write<uint32_t, support::little>(OS, MemberOffset(Syms[I].second));
+    }
+    write<uint32_t, support::little>(OS, Strtab.size());
+    break;
+  case Darwin64:
+    write<uint64_t, support::little>(OS, N * 16);
+    for (unsigned I = 0; I != N; ++I) {
+      write<uint64_t, support::little>(OS, Strx[I]);
+      write<uint64_t, support::little>(OS, MemberOffset(Syms[I].second));
+    }
+    write<uint64_t, support::little>(OS, Strtab.size());
+    break;
+  }
+  OS << Strtab;
+
+  for (unsigned I = 0; I != NumMembers; ++I) {
+    std::string MemberName = memberName(I);
+    if (Kind == GNU || Kind == GNU64)
+      MemberName += '/';
+    writeHeader(OS, MemberName, 2);
+    OS << "xx";
+  }
+  return OS.str();
+}
+
+class ArchiveFindSymTest : public ::testing::TestWithParam<SymtabKind> {};
+
+TEST_P(ArchiveFindSymTest, FindSym) {
+  std::vector<std::pair<std::string, unsigned>> Syms;
+  for (unsigned I = 0; I != 10000; ++I)
+    Syms.push_back({"sym" + std::to_string(I), I % NumMembers});
+  // A lookup must resolve to the first member defining a symbol.
+  Syms.push_back({"dup", 3});
+  Syms.push_back({"dup", 5});
+
+  std::string Buf = buildArchive(GetParam(), Syms);
+  Expected<std::unique_ptr<Archive>> ArchiveOrErr =
+      Archive::create(MemoryBufferRef(Buf, "test.a"));
+  ASSERT_TRUE(!!ArchiveOrErr) << toString(ArchiveOrErr.takeError());
+  Archive &A = **ArchiveOrErr;
+  ASSERT_EQ(Syms.size(), A.getNumberOfSymbols());
+
+  auto ExpectMember = [&](StringRef Sym, unsigned Member) {
+    Expected<Optional<Archive::Child>> ChildOrErr = A.findSym(Sym);
+    ASSERT_TRUE(!!ChildOrErr) << toString(ChildOrErr.takeError());
+    ASSERT_TRUE(ChildOrErr->hasValue()) << Sym;
+    Expected<StringRef> NameOrErr = (*ChildOrErr)->getName();
+    ASSERT_TRUE(!!NameOrErr) << toString(NameOrErr.takeError());
+    EXPECT_EQ(memberName(Member), *NameOrErr) << Sym;
+  };
+
+  // The index is built by the first lookup and reused by the others.
+  for (unsigned Round = 0; Round != 2; ++Round)
+    for (unsigned I = 0; I < 10000; I += 7)
+      ExpectMember("sym" + std::to_string(I), I % NumMembers);
+  ExpectMember("sym9999", 9999 % NumMembers);
+  ExpectMember("dup", 3);
+
+  for (StringRef Missing : {"", "sym", "sym10000", "dup2"}) {
+    Expected<Optional<Archive::Child>> ChildOrErr = A.findSym(Missing);
+    ASSERT_TRUE(!!ChildOrErr) << toString(ChildOrErr.takeError());
+    EXPECT_FALSE(ChildOrErr->hasValue()) << Missing;
+  }
+}
+
+INSTANTIATE_TEST_CASE_P(AllSymtabKinds, ArchiveFindSymTest,
+                        ::testing::Values(GNU, GNU64, BSD, Darwin64));
+
+} // end anonymous namespace
@@ -8,6 +8,7 @@
 //===----------------------------------------------------------------------===//
 
 #include "llvm/ProfileData/Coverage/CoverageMapping.h"
+#include "llvm/ADT/StringExtras.h"
 #include "llvm/ProfileData/Coverage/CoverageMappingReader.h"
 #include "llvm/ProfileData/Coverage/CoverageMappingWriter.h"
 #include "llvm/ProfileData/InstrProfReader.h"
@@ -78,9 +79,11 @@ struct OutputFunctionCoverageData {
 
 struct CoverageMappingReaderMock : CoverageMappingReader {
   ArrayRef<OutputFunctionCoverageData> Functions;
+  bool RandomAccess;
 
-  CoverageMappingReaderMock(ArrayRef<OutputFunctionCoverageData> Functions)
-      : Functions(Functions) {}
+  CoverageMappingReaderMock(ArrayRef<OutputFunctionCoverageData> Functions,
+                            bool RandomAccess = false)
+      : Functions(Functions), RandomAccess(RandomAccess) {}
 
   Error readNextRecord(CoverageMappingRecord &Record) override {
     if (Functions.empty())
@@ -91,6 +94,25 @@ struct CoverageMappingReaderMock : CoverageMappingReader {
 
     return Error::success();
   }
+
+  size_t getNumRecords() const override {
+    return RandomAccess ? Functions.size() : 0;
+  }
+
+  Error readRecord(size_t Index, CoverageMappingRecord &Record,
+                   CoverageMappingRecordStorage &Storage) const override {
+    const OutputFunctionCoverageData &Function = Functions[Index];
+    Storage.Filenames = Function.Filenames;
+    Storage.Expressions.clear();
+    Storage.MappingRegions = Function.Regions;
+
+    Record.FunctionName = Function.Name;
+    Record.FunctionHash = Function.Hash;
+    Record.Filenames = Storage.Filenames;
+    Record.Expressions = Storage.Expressions;
+    Record.MappingRegions = Storage.MappingRegions;
+    return Error::success();
+  }
 };
 
 struct InputFunctionCoverageData {
@@ -579,6 +601,40 @@ TEST_P(CoverageMappingTest, skip_duplicate_function_record) {
   ASSERT_EQ(1U, NumFuncs);
 }
 
+TEST_P(CoverageMappingTest, random_access_load_matches_sequential_load) {
+  for (unsigned I = 0; I < 100; ++I) {
+    std::string Name = "func" + utostr(I % 80);
+    InstrProfRecord Record(Name, 0x1234, {I, I / 2});
+    NoError(ProfileWriter.addRecord(std::move(Record)));
+
+    startFunction(Name, I % 7 ? 0x1234 : 0x5678);
+    addCMR(Counter::getCounter(0), "file1", 1, 1, 9, 9);
+    addCMR(Counter::getCounter(1), "file1", 2, 1, 3, 9);
+  }
+
+  loadCoverageMapping();
+
+  CoverageMappingReaderMock CovReader(OutputFunctions, /*RandomAccess=*/true);
+  auto CoverageOrErr = CoverageMapping::load(CovReader, *ProfileReader);
+  ASSERT_TRUE(NoError(CoverageOrErr.takeError()));
+  auto &Coverage = *CoverageOrErr.get();
+
+  EXPECT_EQ(LoadedCoverage->getMismatchedCount(), Coverage.getMismatchedCount());
+  std::vector<const FunctionRecord *> Expected, Actual;
+  for (const auto &F : LoadedCoverage->getCoveredFunctions())
+    Expected.push_back(&F);
+  for (const auto &F : Coverage.getCoveredFunctions())
+    Actual.push_back(&F);
+  ASSERT_EQ(Expected.size(), Actual.size());
+  for (unsigned I = 0; I < Actual.size(); ++I) {
+    EXPECT_EQ(Expected[I]->Name, Actual[I]->Name);
+    EXPECT_EQ(Expected[I]->ExecutionCount, Actual[I]->ExecutionCount);
+    ASSERT_EQ(2U, Actual[I]->CountedRegions.size());
+    EXPECT_EQ(Expected[I]->CountedRegions[1].ExecutionCount,
+              Actual[I]->CountedRegions[1].ExecutionCount);
+  }
+}
+
 // FIXME: Use ::testing::Combine() when llvm updates its copy of googletest.
 INSTANTIATE_TEST_CASE_P(ParameterizedCovMapTest, CoverageMappingTest,
                         ::testing::Values(std::pair<bool, bool>({false, false}),
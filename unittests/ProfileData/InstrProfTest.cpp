@@ -107,11 +107,14 @@ TEST_P(MaybeSparseInstrProfTest, get_instr_prof_record) {
   ASSERT_EQ(3U, R->Counts[0]);
   ASSERT_EQ(4U, R->Counts[1]);
 
-  R = Reader->getInstrProfRecord("foo", 0x5678);
-  ASSERT_TRUE(ErrorEquals(instrprof_error::hash_mismatch, R.takeError()));
-
+  // A function missing from the profile doesn't put the reader in error.
   R = Reader->getInstrProfRecord("bar", 0x1234);
   ASSERT_TRUE(ErrorEquals(instrprof_error::unknown_function, R.takeError()));
+  ASSERT_FALSE(Reader->hasError());
+
+  R = Reader->getInstrProfRecord("foo", 0x5678);
+  ASSERT_TRUE(ErrorEquals(instrprof_error::hash_mismatch, R.takeError()));
+  ASSERT_TRUE(Reader->hasError());
 }
 
 TEST_P(MaybeSparseInstrProfTest, get_function_counts) {
@@ -140,6 +143,38 @@ TEST_P(MaybeSparseInstrProfTest, get_function_counts) {
   ASSERT_TRUE(ErrorEquals(instrprof_error::unknown_function, std::move(E2)));
 }
 
+TEST_P(MaybeSparseInstrProfTest, get_function_counter_view) {
+  InstrProfRecord Record1("foo", 0x1234, {1, 2});
+  InstrProfRecord Record2("foo", 0x1235, {3, 4, 5});
+  NoError(Writer.addRecord(std::move(Record1)));
+  NoError(Writer.addRecord(std::move(Record2)));
+  auto Profile = Writer.writeBuffer();
+  const char *ProfileStart = Profile->getBufferStart();
+  const char *ProfileEnd = Profile->getBufferEnd();
+  readProfile(std::move(Profile));
+
+  ArrayRef<support::ulittle64_t> Counts;
+  ASSERT_TRUE(NoError(Reader->getFunctionCounterView("foo", 0x1235, Counts)));
+  ASSERT_EQ(3U, Counts.size());
+  ASSERT_EQ(3U, Counts[0]);
+  ASSERT_EQ(4U, Counts[1]);
+  ASSERT_EQ(5U, Counts[2]);
+  // The counters are not copied out of the profile.
+  ASSERT_TRUE(reinterpret_cast<const char *>(Counts.begin()) >= ProfileStart &&
+              reinterpret_cast<const char *>(Counts.end()) <= ProfileEnd);
+
+  ASSERT_TRUE(NoError(Reader->getFunctionCounterView("foo", 0x1234, Counts)));
+  ASSERT_EQ(2U, Counts.size());
+  ASSERT_EQ(1U, Counts[0]);
+  ASSERT_EQ(2U, Counts[1]);
+
+  Error E1 = Reader->getFunctionCounterView("foo", 0x5678, Counts);
+  ASSERT_TRUE(ErrorEquals(instrprof_error::hash_mismatch, std::move(E1)));
+
+  Error E2 = Reader->getFunctionCounterView("bar", 0x1234, Counts);
+  ASSERT_TRUE(ErrorEquals(instrprof_error::unknown_function, std::move(E2)));
+}
+
 // Profile data is copied from general.proftext
 TEST_F(InstrProfTest, get_profile_summary) {
   InstrProfRecord Record1("func1", 0x1234, {97531});
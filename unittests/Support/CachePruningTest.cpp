@@ -0,0 +1,228 @@
+//===- CachePruningTest.cpp - Unit tests for CachePruning -----------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/CachePruning.h"
+#include "llvm/ADT/SmallString.h"
+#include "llvm/Support/Chrono.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+
+using namespace llvm;
+
+namespace {
+
+class CachePruningTest : public testing::Test {
+protected:
+  void SetUp() override {
+    ASSERT_FALSE(sys::fs::createUniqueDirectory("CachePruningTest", Dir));
+  }
+
+  void TearDown() override {
+    std::error_code EC;
+    std::vector<std::string> Files;
+    for (sys::fs::directory_iterator I(Dir, EC), E; I != E && !EC;
+         I.increment(EC))
+      Files.push_back(I->path());
+    for (const std::string &File : Files)
+      sys::fs::remove(File);
+    sys::fs::remove(Dir);
+  }
+
+  std::string getPath(StringRef Name) {
+    SmallString<128> Path(Dir);
+    sys::path::append(Path, Name);
+    return Path.str();
+  }
+
+  /// Create the file \p Name of \p Size bytes, last accessed \p Age seconds
+  /// ago.
+  void createFile(StringRef Name, size_t Size, uint64_t Age = 0) {
+    int FD;
+    ASSERT_FALSE(sys::fs::openFileForWrite(getPath(Name), FD, sys::fs::F_None));
+    raw_fd_ostream OS(FD, /*shouldClose=*/true);
+    OS << std::string(Size, 'x');
+    OS.flush();
+    sys::fs::setLastModificationAndAccessTime(
+        FD, std::chrono::system_clock::now() - std::chrono::seconds(Age));
+  }
+
+  bool exists(StringRef Name) { return sys::fs::exists(getPath(Name)); }
+
+  std::string readIndex() {
+    auto BufferOrErr = MemoryBuffer::getFile(getPath("llvmcache.index"));
+    if (!BufferOrErr)
+      return "";
+    return (*BufferOrErr)->getBuffer();
+  }
+
+  /// The access record of \p Name of \p Size bytes, accessed \p Age seconds
+  /// ago.
+  std::string record(StringRef Name, uint64_t Size, uint64_t Age) {
+    uint64_t Now = sys::toTimeT(std::chrono::system_clock::now());
+    return (Twine(Now - Age) + " " + Twine(Size) + " " + Name + "\n").str();
+  }
+
+  SmallString<128> Dir;
+};
+
+TEST_F(CachePruningTest, MaxSizeBytes) {
+  createFile("old", 200, 3000);
+  createFile("mid", 100, 2000);
+  createFile("new", 100);
+  EXPECT_TRUE(CachePruning(Dir).setMaxSizeBytes(250).prune());
+  EXPECT_FALSE(exists("old"));
+  EXPECT_TRUE(exists("mid"));
+  EXPECT_TRUE(exists("new"));
+}
+
+TEST_F(CachePruningTest, SizeOnlyDoesNotExpire) {
+  // Without an expiration, entries are only removed to meet the size limit,
+  // however old they are.
+  createFile("a", 10, 100000);
+  createFile("b", 10, 200000);
+  EXPECT_TRUE(CachePruning(Dir).setMaxSizeBytes(1000).prune());
+  EXPECT_TRUE(exists("a"));
+  EXPECT_TRUE(exists("b"));
+}
+
+TEST_F(CachePruningTest, PruningInterval) {
+  createFile("a", 10, 1000);
+  // The first pruning writes the timestamp file.
+  EXPECT_TRUE(CachePruning(Dir)
+                  .setPruningInterval(std::chrono::seconds(3600))
+                  .setEntryExpiration(std::chrono::seconds(2000))
+                  .prune());
+  EXPECT_TRUE(exists("llvmcache.timestamp"));
+  EXPECT_TRUE(exists("a"));
+
+  // The next one is skipped until the interval has elapsed, and an interval
+  // of 0 always prunes.
+  createFile("b", 10, 5000);
+  EXPECT_FALSE(CachePruning(Dir)
+                   .setPruningInterval(std::chrono::seconds(3600))
+                   .setEntryExpiration(std::chrono::seconds(2000))
+                   .prune());
+  EXPECT_TRUE(exists("b"));
+  EXPECT_TRUE(CachePruning(Dir)
+                  .setPruningInterval(std::chrono::seconds(0))
+                  .setEntryExpiration(std::chrono::seconds(2000))
+                  .prune());
+  EXPECT_TRUE(exists("a"));
+  EXPECT_FALSE(exists("b"));
+}
+
+TEST_F(CachePruningTest, NoIndex) {
+  createFile("old", 10, 1000);
+  createFile("new", 10);
+  EXPECT_TRUE(CachePruning(Dir).setEntryExpiration(std::chrono::seconds(100))
+                  .prune());
+  EXPECT_FALSE(exists("old"));
+  EXPECT_TRUE(exists("new"));
+  // Caches that don't record their accesses don't get an index.
+  EXPECT_FALSE(exists("llvmcache.index"));
+}
+
+TEST_F(CachePruningTest, Index) {
+  createFile("old", 10);
+  createFile("new", 10, 1000);
+  createFile("unlisted", 10, 1000);
+  createFile("unlisted-new", 10);
+  std::string NewRecord = record("new", 10, 0);
+  {
+    std::error_code EC;
+    raw_fd_ostream OS(getPath("llvmcache.index"), EC, sys::fs::F_None);
+    ASSERT_FALSE(EC);
+    OS << "# llvmcache index 42\n"
+       << record("old", 10, 1000) << record("new", 10, 1000)
+       << record("gone", 10, 0) << NewRecord << "12";
+  }
+
+  // The access times in the index take precedence, and files that it doesn't
+  // list are pruned by the access time from the file system.
+  EXPECT_TRUE(CachePruning(Dir).setEntryExpiration(std::chrono::seconds(100))
+                  .prune());
+  EXPECT_FALSE(exists("old"));
+  EXPECT_TRUE(exists("new"));
+  EXPECT_FALSE(exists("unlisted"));
+  EXPECT_TRUE(exists("unlisted-new"));
+
+  // The index is rewritten with the last record of each remaining entry, and
+  // drops the entries that are no longer in the directory.
+  std::string Index = readIndex();
+  StringRef Header, Records;
+  std::tie(Header, Records) = StringRef(Index).split('\n');
+  EXPECT_EQ((Twine("# llvmcache index ") + Twine(Records.size())).str(),
+            Header);
+  EXPECT_NE(StringRef::npos, Records.find(NewRecord));
+  EXPECT_NE(StringRef::npos, Records.find(" 10 unlisted-new\n"));
+  EXPECT_EQ(2u, Records.count('\n'));
+}
+
+TEST_F(CachePruningTest, CompactIndex) {
+  createFile("a", 10);
+  createFile("b", 20);
+  for (int I = 0; I != 10; ++I) {
+    CachePruning::recordAccess(Dir, "a", 10);
+    CachePruning::recordAccess(Dir, "gone", 30);
+  }
+  CachePruning::recordAccess(Dir, "b", 20);
+
+  // A single record is kept for each entry still in the directory, including
+  // those that were never recorded.
+  createFile("c", 40);
+  CachePruning::compactIndex(Dir);
+  std::string Index = readIndex();
+  EXPECT_EQ(0u, Index.find("# llvmcache index "));
+  EXPECT_NE(std::string::npos, Index.find(" 10 a\n"));
+  EXPECT_NE(std::string::npos, Index.find(" 20 b\n"));
+  EXPECT_NE(std::string::npos, Index.find(" 40 c\n"));
+  EXPECT_EQ(std::string::npos, Index.find(" gone\n"));
+  EXPECT_EQ(4, std::count(Index.begin(), Index.end(), '\n'));
+  EXPECT_TRUE(exists("a"));
+  EXPECT_TRUE(exists("b"));
+  EXPECT_TRUE(exists("c"));
+}
+
+TEST_F(CachePruningTest, IndexStartedByRecordAccess) {
+  createFile("a", 100, 1000);
+  createFile("b", 100, 2000);
+  createFile("llvmcache-tmp-1234.o", 1000);
+  CachePruning::recordAccess(Dir, "b", 100);
+  CachePruning::recordAccess(Dir, "c", 100);
+  createFile("c", 100, 3000);
+
+  // The index doesn't list "a", so its access time is taken from the file
+  // system. The least recently used entry goes first; temporary files are left
+  // alone.
+  EXPECT_TRUE(CachePruning(Dir).setMaxSizeBytes(250).prune());
+  EXPECT_FALSE(exists("a"));
+  EXPECT_TRUE(exists("b"));
+  EXPECT_TRUE(exists("c"));
+  EXPECT_TRUE(exists("llvmcache-tmp-1234.o"));
+
+  // The rewritten index lists every remaining entry.
+  std::string Index = readIndex();
+  EXPECT_EQ(0u, Index.find("# llvmcache index "));
+  EXPECT_NE(std::string::npos, Index.find(" 100 b\n"));
+  EXPECT_NE(std::string::npos, Index.find(" 100 c\n"));
+  EXPECT_EQ(std::string::npos, Index.find(" a\n"));
+
+  // Files added without being recorded are still picked up.
+  createFile("a", 100, 1000);
+  EXPECT_TRUE(CachePruning(Dir).setMaxSizeBytes(150).prune());
+  EXPECT_FALSE(exists("a"));
+  EXPECT_FALSE(exists("b"));
+  EXPECT_TRUE(exists("c"));
+}
+
+} // end anonymous namespace
@@ -0,0 +1,93 @@
+//===- unittests/Support/ParallelTest.cpp - Parallel algorithm tests ------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/Parallel.h"
+#include "gtest/gtest.h"
+
+#include <array>
+#include <atomic>
+#include <random>
+
+using namespace llvm;
+
+namespace {
+
+TEST(Parallel, sort) {
+  std::mt19937 Randomizer;
+  std::array<uint32_t, 1024 * 64> Array;
+  for (auto &I : Array)
+    I = Randomizer();
+
+  parallel_sort(std::begin(Array), std::end(Array));
+  ASSERT_TRUE(std::is_sorted(std::begin(Array), std::end(Array)));
+
+  parallel_sort(std::begin(Array), std::end(Array), std::greater<uint32_t>());
+  ASSERT_TRUE(std::is_sorted(std::begin(Array), std::end(Array),
+                             std::greater<uint32_t>()));
+}
+
+TEST(Parallel, for_each) {
+  std::vector<unsigned> Values(10000, 1);
+  parallel_for_each(Values.begin(), Values.end(), [](unsigned &V) { V *= 3; });
+  for (unsigned V : Values)
+    ASSERT_EQ(3u, V);
+
+  std::atomic<unsigned> Sum{0};
+  parallel_for_each_n(0u, 10000u, [&Sum](unsigned I) { Sum += I; });
+  ASSERT_EQ(10000u * 9999u / 2, Sum);
+
+  // Empty and single element ranges.
+  parallel_for_each(Values.begin(), Values.begin(), [](unsigned &V) { V = 0; });
+  parallel_for_each_n(5, 6, [&Values](int I) { Values[I] = 0; });
+  ASSERT_EQ(3u, Values[4]);
+  ASSERT_EQ(0u, Values[5]);
+}
+
+TEST(Parallel, transform_reduce) {
+  std::vector<std::string> Strings;
+  for (unsigned I = 0; I < 5000; ++I)
+    Strings.push_back(std::string(I % 7, 'x'));
+
+  size_t Expected = 0;
+  for (const std::string &S : Strings)
+    Expected += S.size();
+
+  size_t Total = parallel_transform_reduce(
+      Strings.begin(), Strings.end(), size_t(0), std::plus<size_t>(),
+      [](const std::string &S) { return S.size(); });
+  ASSERT_EQ(Expected, Total);
+
+  // Reduction order is preserved for non-commutative operations.
+  std::vector<unsigned> Digits;
+  for (unsigned I = 0; I < 3000; ++I)
+    Digits.push_back(I % 10);
+  std::string Concatenated = parallel_transform_reduce(
+      Digits.begin(), Digits.end(), std::string(),
+      [](std::string A, const std::string &B) { return A + B; },
+      [](unsigned D) { return std::string(1, '0' + D); });
+  ASSERT_EQ(3000u, Concatenated.size());
+  for (unsigned I = 0; I < 3000; ++I)
+    ASSERT_EQ(char('0' + I % 10), Concatenated[I]);
+}
+
+TEST(Parallel, TaskGroup) {
+  std::atomic<unsigned> Count{0};
+  {
+    parallel::TaskGroup TG;
+    for (unsigned I = 0; I < 100; ++I)
+      TG.spawn([&Count] { ++Count; });
+    TG.sync();
+    ASSERT_EQ(100u, Count);
+    for (unsigned I = 0; I < 100; ++I)
+      TG.spawn([&Count] { ++Count; });
+  }
+  ASSERT_EQ(200u, Count);
+}
+
+} // end anonymous namespace
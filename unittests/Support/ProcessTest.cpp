@@ -9,6 +9,7 @@
 
 #include "llvm/Support/Process.h"
 #include "gtest/gtest.h"
+#include <vector>
 
 #ifdef LLVM_ON_WIN32
 #include <windows.h>
@@ -26,6 +27,16 @@ TEST(ProcessTest, GetRandomNumberTest) {
   EXPECT_NE((r1 | r2), 0u);
 }
 
+TEST(ProcessTest, GetPeakResidentSetSize) {
+  size_t Before = Process::GetPeakResidentSetSize();
+  if (!Before)
+    return; // Not reported on this platform.
+  // Touch a few megabytes; the peak may only grow.
+  std::vector<char> Buffer(8 << 20, 1);
+  EXPECT_GE(Process::GetPeakResidentSetSize(), Before);
+  EXPECT_GE(Process::GetPeakResidentSetSize(), Buffer.size());
+}
+
 #ifdef _MSC_VER
 #define setenv(name, var, ignore) _putenv_s(name, var)
 #endif
@@ -164,3 +164,59 @@ TEST_F(ThreadPoolTest, PoolDestruction) {
   }
   ASSERT_EQ(5, checked_in);
 }
+
+TEST_F(ThreadPoolTest, TaskGroup) {
+  CHECK_UNSUPPORTED();
+  // Test that a group can be waited on while other tasks are still blocked.
+  ThreadPool Pool{2};
+  std::atomic_int Blocked{0};
+  std::atomic_int Grouped{0};
+  Pool.async([this, &Blocked] {
+    waitForMainThread();
+    ++Blocked;
+  });
+  {
+    ThreadPoolTaskGroup Group(Pool);
+    for (size_t i = 0; i < 5; ++i)
+      Group.async([&Grouped] { ++Grouped; });
+    Group.wait();
+    ASSERT_EQ(5, Grouped);
+  }
+  ASSERT_EQ(0, Blocked);
+  setMainThreadReady();
+  Pool.wait();
+  ASSERT_EQ(1, Blocked);
+}
+
+TEST_F(ThreadPoolTest, NestedTaskGroups) {
+  CHECK_UNSUPPORTED();
+  // Test that tasks can fork and join subtasks, even on a single thread.
+  ThreadPool Pool{1};
+  std::atomic_int checked_in{0};
+  ThreadPoolTaskGroup Outer(Pool);
+  for (size_t i = 0; i < 4; ++i) {
+    Outer.async([&Pool, &checked_in] {
+      ThreadPoolTaskGroup Inner(Pool);
+      std::atomic_int Subtasks{0};
+      for (size_t j = 0; j < 4; ++j)
+        Inner.async([&Subtasks] { ++Subtasks; });
+      Inner.wait();
+      ASSERT_EQ(4, Subtasks);
+      checked_in += Subtasks;
+    });
+  }
+  Outer.wait();
+  ASSERT_EQ(16, checked_in);
+  Pool.wait();
+}
+
+#if LLVM_ENABLE_THREADS
+TEST_F(ThreadPoolTest, WorkerThread) {
+  CHECK_UNSUPPORTED();
+  ThreadPool Pool{2};
+  std::atomic_bool InPool{false};
+  ASSERT_FALSE(Pool.isWorkerThread());
+  Pool.async([&Pool, &InPool] { InPool = Pool.isWorkerThread(); }).get();
+  ASSERT_TRUE(InPool);
+}
+#endif
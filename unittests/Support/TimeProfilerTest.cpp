@@ -0,0 +1,56 @@
+//===- unittests/Support/TimeProfilerTest.cpp - Time profiler tests -------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Support/TimeProfiler.h"
+#include "llvm/Support/raw_ostream.h"
+#include "gtest/gtest.h"
+
+using namespace llvm;
+
+namespace {
+
+TEST(TimeProfiler, Disabled) {
+  ASSERT_FALSE(timeTraceProfilerEnabled());
+  // Scopes are no-ops when the profiler is not initialized.
+  TimeTraceScope Scope("NotRecorded", [] () -> std::string {
+    ADD_FAILURE() << "Detail computed while the profiler is disabled";
+    return "";
+  });
+}
+
+TEST(TimeProfiler, Write) {
+  timeTraceProfilerInitialize(/*TimeTraceGranularity=*/0, "TimeProfilerTest");
+  ASSERT_TRUE(timeTraceProfilerEnabled());
+  {
+    TimeTraceScope Outer("Outer", "a \"quoted\" detail");
+    {
+      TimeTraceScope Inner("Inner", [] { return std::string("computed"); });
+    }
+    TimeTraceScope Recursive("Outer");
+  }
+
+  std::string Trace;
+  raw_string_ostream OS(Trace);
+  timeTraceProfilerWrite(OS);
+  OS.flush();
+  timeTraceProfilerCleanup();
+  ASSERT_FALSE(timeTraceProfilerEnabled());
+
+  EXPECT_EQ(0u, Trace.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos,
+            Trace.find("\"name\":\"Outer\",\"args\":{\"detail\":"
+                       "\"a \\\"quoted\\\" detail\"}"));
+  EXPECT_NE(std::string::npos,
+            Trace.find("\"name\":\"Inner\",\"args\":{\"detail\":\"computed\"}"));
+  // Nested instances of a name are only counted once in its total.
+  EXPECT_NE(std::string::npos, Trace.find("\"detail\":\"1 calls, "));
+  EXPECT_NE(std::string::npos, Trace.find("\"name\":\"TimeProfilerTest\""));
+}
+
+} // end anonymous namespace
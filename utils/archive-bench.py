@@ -0,0 +1,93 @@
+#!/usr/bin/env python
+"""Measure symbol lookups in archives through lli -extra-archive.
+
+This generates an archive whose members each define a number of functions,
+and a main module calling a random sample of them. lli (MCJIT) resolves every
+call by looking the callee up with Archive::findSym and loading the member
+that defines it, so the run time is dominated by the lookups when the archive
+has many symbols. The best wall time over --runs runs is printed.
+
+Give --baseline-lli to compare against another build of lli, for example one
+where findSym still scans the symbol table for every lookup. Use --format to
+pick the symbol table format that llvm-ar writes.
+"""
+
+from __future__ import print_function
+
+import os
+import random
+import subprocess
+
+import benchutil
+
+
+def write_member(out, index, num_functions):
+  for j in range(num_functions):
+    out.write('define i32 @m%d_f%d(i32 %%x) {\n' % (index, j))
+    out.write('  %%r = add i32 %%x, %d\n  ret i32 %%r\n}\n' % j)
+
+
+def write_main(out, callees):
+  for callee in callees:
+    out.write('declare i32 @%s(i32)\n' % callee)
+  out.write('\ndefine i32 @main() {\nentry:\n')
+  last = '0'
+  for i, callee in enumerate(callees):
+    out.write('  %%r%d = call i32 @%s(i32 %s)\n' % (i, callee, last))
+    last = '%%r%d' % i
+  out.write('  %%z = and i32 %s, 0\n  ret i32 %%z\n}\n' % last)
+
+
+def main():
+  parser = benchutil.make_parser(__doc__, runs=3)
+  benchutil.add_tool(parser, 'lli', baseline=True)
+  benchutil.add_tool(parser, 'llc')
+  benchutil.add_tool(parser, 'llvm-ar')
+  parser.add_argument('--format', default='gnu', choices=['gnu', 'bsd'],
+                      help='Archive format')
+  parser.add_argument('--members', type=int, default=100,
+                      help='Number of archive members')
+  parser.add_argument('--member-functions', type=int, default=1000,
+                      help='Number of functions defined by each member')
+  parser.add_argument('--calls', type=int, default=200,
+                      help='Number of archive functions called by main')
+  args = parser.parse_args()
+
+  with benchutil.temporary_directory() as tmpdir:
+    objects = []
+    for i in range(args.members):
+      source = os.path.join(tmpdir, 'm%d.ll' % i)
+      with open(source, 'w') as out:
+        write_member(out, i, args.member_functions)
+      obj = os.path.join(tmpdir, 'm%d.o' % i)
+      subprocess.check_call([args.llc, '-filetype=obj', '-relocation-model=pic',
+                             '-o', obj, source])
+      objects.append(obj)
+    archive = os.path.join(tmpdir, 'lib.a')
+    subprocess.check_call([args.llvm_ar, 'rcs', '--format=' + args.format,
+                           archive] + objects)
+
+    rng = random.Random(args.calls)
+    callees = ['m%d_f%d' % (rng.randrange(args.members),
+                            rng.randrange(args.member_functions))
+               for _ in range(args.calls)]
+    main_path = os.path.join(tmpdir, 'main.ll')
+    with open(main_path, 'w') as out:
+      write_main(out, sorted(set(callees)))
+    print('archive: %d symbols in %d members, %d lookups' %
+          (args.members * args.member_functions, args.members,
+           len(set(callees))))
+
+    times = {}
+    for name, lli in benchutil.tool_builds(args, 'lli'):
+      cmd = [lli, '-extra-archive=' + archive, main_path]
+      times[name] = benchutil.best_of(args.runs,
+                                      lambda: benchutil.wall_time(cmd))
+      benchutil.print_row('%-10s %10.3f s', name, times[name])
+    if args.baseline_lli:
+      print('speedup: %.2fx' % benchutil.speedup(times['baseline'],
+                                                  times['lli']))
+
+
+if __name__ == '__main__':
+  main()
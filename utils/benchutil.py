@@ -0,0 +1,98 @@
+"""Shared harness of the *-bench.py scripts in this directory.
+
+The scripts generate their inputs in a temporary directory, run an LLVM tool
+on them a number of times and print the best time of each configuration,
+optionally next to the time of a baseline build of the tool.
+"""
+
+from __future__ import print_function
+
+import argparse
+import contextlib
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+
+def make_parser(doc, runs):
+  """Return an argument parser describing the script with its docstring
+  \\p doc, with a --runs option defaulting to \\p runs."""
+  parser = argparse.ArgumentParser(
+      description=doc, formatter_class=argparse.RawDescriptionHelpFormatter)
+  parser.add_argument('--runs', type=int, default=runs,
+                      help='Number of runs per measurement; the best is kept')
+  return parser
+
+
+def add_tool(parser, tool, baseline=False):
+  """Add a --<tool> option giving the path to \\p tool and, if \\p baseline,
+  a --baseline-<tool> option giving the path to a build to compare with."""
+  parser.add_argument('--' + tool, default=tool, help='Path to ' + tool)
+  if baseline:
+    parser.add_argument('--baseline-' + tool,
+                        help='Path to a %s to compare with' % tool)
+
+
+def tool_builds(args, tool):
+  """Return the (name, path) pairs of the builds of \\p tool to time, the
+  baseline first if one was given."""
+  attr = tool.replace('-', '_')
+  builds = [(tool, getattr(args, attr))]
+  baseline = getattr(args, 'baseline_' + attr, None)
+  if baseline:
+    builds.insert(0, ('baseline', baseline))
+  return builds
+
+
+@contextlib.contextmanager
+def temporary_directory():
+  """Create a temporary directory, removed when leaving the context."""
+  path = tempfile.mkdtemp()
+  try:
+    yield path
+  finally:
+    shutil.rmtree(path)
+
+
+def wall_time(cmd):
+  """Run \\p cmd and return its wall time in seconds."""
+  start = time.time()
+  subprocess.check_call(cmd)
+  return time.time() - start
+
+
+def pass_wall_time(cmd, pass_names):
+  """Run \\p cmd, which must print a -time-passes report, and return the sum
+  of the wall times of the passes named \\p pass_names."""
+  output = subprocess.check_output(cmd, stderr=subprocess.STDOUT)
+  total = None
+  for line in output.decode('utf-8', 'replace').splitlines():
+    if not line.strip().endswith(tuple(pass_names)):
+      continue
+    # The wall time is the last "seconds (percentage)" column.
+    times = re.findall(r'([0-9.]+) \(\s*[0-9.]+%\)', line)
+    if times:
+      total = (total or 0.0) + float(times[-1])
+  if total is None:
+    raise RuntimeError('no timing for %s in the output of %s' %
+                       (', '.join(pass_names), ' '.join(cmd)))
+  return total
+
+
+def best_of(runs, measure):
+  """Return the lowest value that \\p measure returns over \\p runs calls."""
+  return min(measure() for _ in range(runs))
+
+
+def speedup(baseline, value):
+  """Return how many times lower \\p value is than \\p baseline."""
+  return baseline / value if value else float('inf')
+
+
+def print_row(fmt, *values):
+  """Print a row of results right away, as the next one may take a while."""
+  print(fmt % values)
+  sys.stdout.flush()
@@ -0,0 +1,108 @@
+#!/usr/bin/env python
+"""Compare the dominator tree construction algorithms.
+
+This runs opt -domtree -postdomtree -time-passes on every input, once with the
+default Lengauer-Tarjan construction and once with -dom-tree-semi-nca, and
+prints the best wall time of each algorithm over a number of runs.
+
+Inputs are either IR files given on the command line (real CFGs), or synthetic
+functions generated with --synthetic:
+
+  statemachine  A dispatcher block branching to every state, each state
+                branching to two random states and back to the dispatcher.
+  random        A chain of blocks, each also branching to a random block.
+  ladder        A ladder graph, see create_ladder_graph.py.
+"""
+
+from __future__ import print_function
+
+import os
+import random
+
+import benchutil
+
+PASS_NAMES = ('Dominator Tree Construction',
+              'Post-Dominator Tree Construction')
+
+
+def write_switch(out, default, cases):
+  out.write('  switch i32 %%x, label %%b%d [' % default)
+  for i, target in enumerate(cases):
+    out.write(' i32 %d, label %%b%d' % (i + 1, target))
+  out.write(' ]\n')
+
+
+def generate(kind, num_blocks, out):
+  rng = random.Random(num_blocks)
+  if kind == 'ladder':
+    num_blocks += num_blocks % 2
+  # The dispatcher of the state machine cannot be the entry block, which must
+  # not have predecessors.
+  out.write('define void @f(i32 %x) {\nentry:\n  br label %b0\n')
+  for i in range(num_blocks):
+    out.write('b%d:\n' % i)
+    if kind == 'statemachine':
+      if i == 0:
+        write_switch(out, 1, range(2, num_blocks))
+      elif i == num_blocks - 1:
+        out.write('  ret void\n')
+      else:
+        write_switch(out, 0, [rng.randint(1, num_blocks - 1),
+                              rng.randint(1, num_blocks - 1)])
+    elif kind == 'random':
+      if i == num_blocks - 1:
+        out.write('  ret void\n')
+      else:
+        write_switch(out, i + 1, [rng.randint(1, num_blocks - 1)])
+    else:
+      # Even blocks form the left rail and odd blocks the right rail; every
+      # left block also branches across to the right one.
+      if i >= num_blocks - 2:
+        out.write('  ret void\n' if i % 2 else '  br label %%b%d\n' % (i + 1))
+      elif i % 2:
+        out.write('  br label %%b%d\n' % (i + 2))
+      else:
+        write_switch(out, i + 2, [i + 1])
+  out.write('}\n')
+
+
+def time_opt(opt, path, extra_args, runs):
+  cmd = [opt, '-disable-output', '-domtree', '-postdomtree', '-time-passes',
+         path] + extra_args
+  return benchutil.best_of(
+      runs, lambda: benchutil.pass_wall_time(cmd, PASS_NAMES))
+
+
+def main():
+  parser = benchutil.make_parser(__doc__, runs=5)
+  parser.add_argument('inputs', nargs='*', help='IR files to benchmark')
+  benchutil.add_tool(parser, 'opt')
+  parser.add_argument('--synthetic', action='append', default=[],
+                      choices=['statemachine', 'random', 'ladder'],
+                      help='Also benchmark a generated function of this kind')
+  parser.add_argument('--blocks', type=int, action='append', default=[],
+                      help='Number of blocks of the generated functions')
+  args = parser.parse_args()
+
+  inputs = [(os.path.basename(path), path) for path in args.inputs]
+  if not inputs and not args.synthetic:
+    parser.error('no inputs; give IR files or --synthetic')
+  with benchutil.temporary_directory() as tmpdir:
+    for kind in args.synthetic:
+      for num_blocks in args.blocks or [10000]:
+        path = os.path.join(tmpdir, '%s-%d.ll' % (kind, num_blocks))
+        with open(path, 'w') as out:
+          generate(kind, num_blocks, out)
+        inputs.append(('%s (%d blocks)' % (kind, num_blocks), path))
+
+    print('%-40s %12s %12s %8s' % ('input', 'LT (s)', 'SemiNCA (s)',
+                                   'speedup'))
+    for name, path in inputs:
+      lt = time_opt(args.opt, path, [], args.runs)
+      snca = time_opt(args.opt, path, ['-dom-tree-semi-nca'], args.runs)
+      benchutil.print_row('%-40s %12.4f %12.4f %7.2fx', name, lt, snca,
+                          benchutil.speedup(lt, snca))
+
+
+if __name__ == '__main__':
+  main()
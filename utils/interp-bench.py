@@ -0,0 +1,140 @@
+#!/usr/bin/env python
+"""Compare the interpreter with and without -interpreter-predecode.
+
+This runs lli -force-interpreter on every input, once interpreting the IR
+directly and once with the pre-decoded execution mode, and prints the best wall
+time of each mode over a number of runs. Inputs must define a main function.
+
+Besides IR files given on the command line, the following synthetic programs
+can be generated with --synthetic:
+
+  fib     Naive recursive Fibonacci, dominated by calls and returns.
+  loop    Nested counting loops doing integer arithmetic on PHI nodes.
+  memory  Repeated passes over a global array, through GEPs, loads and stores.
+"""
+
+from __future__ import print_function
+
+import os
+
+import benchutil
+
+PROGRAMS = {
+    'fib': '''
+define i32 @fib(i32 %%n) {
+entry:
+  %%small = icmp slt i32 %%n, 2
+  br i1 %%small, label %%done, label %%recurse
+recurse:
+  %%n1 = sub i32 %%n, 1
+  %%n2 = sub i32 %%n, 2
+  %%f1 = call i32 @fib(i32 %%n1)
+  %%f2 = call i32 @fib(i32 %%n2)
+  %%sum = add i32 %%f1, %%f2
+  ret i32 %%sum
+done:
+  ret i32 %%n
+}
+
+define i32 @main() {
+  %%r = call i32 @fib(i32 %(size)d)
+  %%z = and i32 %%r, 0
+  ret i32 %%z
+}
+''',
+    'loop': '''
+define i32 @main() {
+entry:
+  br label %%outer
+outer:
+  %%i = phi i32 [ 0, %%entry ], [ %%i.next, %%outer.latch ]
+  %%acc = phi i32 [ 0, %%entry ], [ %%acc.inner, %%outer.latch ]
+  br label %%inner
+inner:
+  %%j = phi i32 [ 0, %%outer ], [ %%j.next, %%inner ]
+  %%a = phi i32 [ %%acc, %%outer ], [ %%a.next, %%inner ]
+  %%t = mul i32 %%j, 3
+  %%u = xor i32 %%t, %%a
+  %%a.next = add i32 %%u, %%i
+  %%j.next = add i32 %%j, 1
+  %%j.cont = icmp ult i32 %%j.next, 1000
+  br i1 %%j.cont, label %%inner, label %%outer.latch
+outer.latch:
+  %%acc.inner = phi i32 [ %%a.next, %%inner ]
+  %%i.next = add i32 %%i, 1
+  %%i.cont = icmp ult i32 %%i.next, %(size)d
+  br i1 %%i.cont, label %%outer, label %%exit
+exit:
+  %%z = and i32 %%acc.inner, 0
+  ret i32 %%z
+}
+''',
+    'memory': '''
+@array = internal global [1024 x i64] zeroinitializer
+
+define i32 @main() {
+entry:
+  br label %%pass
+pass:
+  %%p = phi i32 [ 0, %%entry ], [ %%p.next, %%pass.latch ]
+  br label %%body
+body:
+  %%i = phi i64 [ 0, %%pass ], [ %%i.next, %%body ]
+  %%addr = getelementptr [1024 x i64], [1024 x i64]* @array, i64 0, i64 %%i
+  %%old = load i64, i64* %%addr
+  %%new = add i64 %%old, %%i
+  store i64 %%new, i64* %%addr
+  %%i.next = add i64 %%i, 1
+  %%cont = icmp ult i64 %%i.next, 1024
+  br i1 %%cont, label %%body, label %%pass.latch
+pass.latch:
+  %%p.next = add i32 %%p, 1
+  %%p.cont = icmp ult i32 %%p.next, %(size)d
+  br i1 %%p.cont, label %%pass, label %%exit
+exit:
+  ret i32 0
+}
+''',
+}
+
+DEFAULT_SIZES = {'fib': 25, 'loop': 1000, 'memory': 1000}
+
+
+def time_lli(lli, path, extra_args, runs):
+  cmd = [lli, '-force-interpreter'] + extra_args + [path]
+  return benchutil.best_of(runs, lambda: benchutil.wall_time(cmd))
+
+
+def main():
+  parser = benchutil.make_parser(__doc__, runs=3)
+  parser.add_argument('inputs', nargs='*', help='IR files to benchmark')
+  benchutil.add_tool(parser, 'lli')
+  parser.add_argument('--synthetic', action='append', default=[],
+                      choices=sorted(PROGRAMS),
+                      help='Also benchmark a generated program of this kind')
+  parser.add_argument('--size', type=int,
+                      help='Problem size of the generated programs')
+  args = parser.parse_args()
+
+  inputs = [(os.path.basename(path), path) for path in args.inputs]
+  if not inputs and not args.synthetic:
+    parser.error('no inputs; give IR files or --synthetic')
+  with benchutil.temporary_directory() as tmpdir:
+    for kind in args.synthetic:
+      size = args.size or DEFAULT_SIZES[kind]
+      path = os.path.join(tmpdir, '%s-%d.ll' % (kind, size))
+      with open(path, 'w') as out:
+        out.write(PROGRAMS[kind] % {'size': size})
+      inputs.append(('%s (size %d)' % (kind, size), path))
+
+    print('%-40s %12s %12s %8s' % ('input', 'visitor (s)', 'decoded (s)',
+                                   'speedup'))
+    for name, path in inputs:
+      visitor = time_lli(args.lli, path, [], args.runs)
+      decoded = time_lli(args.lli, path, ['-interpreter-predecode'], args.runs)
+      benchutil.print_row('%-40s %12.4f %12.4f %7.2fx', name, visitor, decoded,
+                          benchutil.speedup(visitor, decoded))
+
+
+if __name__ == '__main__':
+  main()
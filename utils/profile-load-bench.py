@@ -0,0 +1,109 @@
+#!/usr/bin/env python
+"""Measure the per-TU cost of loading an indexed profile for PGO.
+
+This generates a large IR-level profile and a number of small modules whose
+functions are a random sample of the profiled ones, as a build that compiles
+many translation units against one big profile would see. Each module is then
+run through opt -pgo-instr-use -time-passes, and the wall time of the PGO use
+pass, which covers opening the profile, reading its summary and looking up
+every function, is reported per module.
+
+The generated functions do not have the CFG hashes recorded in the profile,
+so every lookup ends in a hash mismatch; this exercises the same lookup path
+as a real build without having to compute the hashes here. Use
+--hashes-per-function to give every function several records, as a profile
+merged from several versions of the code has.
+
+Give --baseline-opt to compare against another build of opt.
+"""
+
+from __future__ import print_function
+
+import os
+import random
+import subprocess
+
+import benchutil
+
+PASS_NAMES = ('PGOInstrumentationUsePass',)
+
+
+def write_profile(out, num_functions, hashes_per_function, num_counters):
+  rng = random.Random(num_functions)
+  out.write(':ir\n')
+  for i in range(num_functions):
+    for h in range(hashes_per_function):
+      out.write('f%d\n%d\n%d\n' % (i, 0x1000 + h, num_counters))
+      for _ in range(num_counters):
+        out.write('%d\n' % rng.randint(0, 1 << 20))
+      out.write('\n')
+
+
+def write_module(out, seed, num_functions, profiled_functions):
+  rng = random.Random(seed)
+  for i in rng.sample(range(profiled_functions), num_functions):
+    out.write('define i32 @f%d(i32 %%x) {\n' % i)
+    out.write('entry:\n  %c = icmp sgt i32 %x, 0\n')
+    out.write('  br i1 %c, label %then, label %else\n')
+    out.write('then:\n  ret i32 1\nelse:\n  ret i32 0\n}\n')
+
+
+def time_pgo_use(opt, profile, path, runs):
+  cmd = [opt, '-disable-output', '-pgo-instr-use', '-time-passes',
+         '-pgo-test-profile-file=' + profile, '-no-pgo-warn-mismatch', path]
+  return benchutil.best_of(
+      runs, lambda: benchutil.pass_wall_time(cmd, PASS_NAMES))
+
+
+def main():
+  parser = benchutil.make_parser(__doc__, runs=3)
+  benchutil.add_tool(parser, 'opt', baseline=True)
+  benchutil.add_tool(parser, 'llvm-profdata')
+  parser.add_argument('--profile', help='Use this indexed profile instead of '
+                      'generating one; its functions must be named f<N>')
+  parser.add_argument('--functions', type=int, default=100000,
+                      help='Number of functions in the generated profile')
+  parser.add_argument('--hashes-per-function', type=int, default=1,
+                      help='Number of records per function in the profile')
+  parser.add_argument('--counters', type=int, default=8,
+                      help='Number of counters per record')
+  parser.add_argument('--modules', type=int, default=20,
+                      help='Number of modules (translation units) to time')
+  parser.add_argument('--module-functions', type=int, default=200,
+                      help='Number of functions in each module')
+  args = parser.parse_args()
+  if args.module_functions > args.functions:
+    parser.error('--module-functions exceeds --functions')
+
+  with benchutil.temporary_directory() as tmpdir:
+    profile = args.profile
+    if not profile:
+      text = os.path.join(tmpdir, 'bench.proftext')
+      with open(text, 'w') as out:
+        write_profile(out, args.functions, args.hashes_per_function,
+                      args.counters)
+      profile = os.path.join(tmpdir, 'bench.profdata')
+      subprocess.check_call([args.llvm_profdata, 'merge', '-o', profile, text])
+    print('profile: %s (%.1f MB)' %
+          (profile, os.path.getsize(profile) / (1024.0 * 1024.0)))
+
+    modules = []
+    for i in range(args.modules):
+      path = os.path.join(tmpdir, 'tu%d.ll' % i)
+      with open(path, 'w') as out:
+        write_module(out, i, args.module_functions, args.functions)
+      modules.append(path)
+
+    totals = {}
+    for name, opt in benchutil.tool_builds(args, 'opt'):
+      times = [time_pgo_use(opt, profile, path, args.runs) for path in modules]
+      totals[name] = sum(times)
+      benchutil.print_row('%-10s per TU: mean %8.2f ms, max %8.2f ms', name,
+                          1000 * totals[name] / len(times), 1000 * max(times))
+    if args.baseline_opt:
+      print('speedup: %.2fx' % benchutil.speedup(totals['baseline'],
+                                                  totals['opt']))
+
+
+if __name__ == '__main__':
+  main()
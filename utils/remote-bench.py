@@ -0,0 +1,81 @@
+#!/usr/bin/env python
+"""Compare lli's remote JIT channels.
+
+This runs lli -remote-benchmark against lli-child-target, once talking to it
+through pipes and once through a shared memory region (-remote-shared-memory),
+and prints the best of a number of runs for each measurement: the latency of a
+call that waits for its result, the cost per call of a batch of calls whose
+results are collected together, and the throughput of uploads of code and data
+to the child.
+"""
+
+from __future__ import print_function
+
+import os
+import re
+import subprocess
+import sys
+
+import benchutil
+
+MODULE = '''
+define i32 @main() {
+  ret i32 0
+}
+'''
+
+# The measurements printed by lli, and whether a higher value is better.
+MEASUREMENTS = [('call latency', 'us', False),
+                ('batched calls', 'us per call', False),
+                ('upload throughput', 'MB/s', True)]
+
+
+def run_lli(lli, child, path, extra_args):
+  cmd = [lli, '-jit-kind=orc-mcjit', '-remote-mcjit',
+         '-mcjit-remote-process=' + child, '-remote-benchmark'] + extra_args
+  output = subprocess.check_output(cmd + [path]).decode()
+  results = {}
+  for name, _, _ in MEASUREMENTS:
+    match = re.search(r'^%s:\s+([0-9.]+)' % name, output, re.M)
+    if not match:
+      sys.exit('error: no %s in output of %s' % (name, ' '.join(cmd)))
+    results[name] = float(match.group(1))
+  return results
+
+
+def best(runs, name, higher_is_better):
+  values = [run[name] for run in runs]
+  return max(values) if higher_is_better else min(values)
+
+
+def main():
+  parser = benchutil.make_parser(__doc__, runs=3)
+  benchutil.add_tool(parser, 'lli')
+  parser.add_argument('--child', default='lli-child-target',
+                      help='Path to lli-child-target')
+  args = parser.parse_args()
+
+  with benchutil.temporary_directory() as tmpdir:
+    path = os.path.join(tmpdir, 'main.ll')
+    with open(path, 'w') as out:
+      out.write(MODULE)
+    pipes = [run_lli(args.lli, args.child, path, [])
+             for _ in range(args.runs)]
+    shared = [run_lli(args.lli, args.child, path, ['-remote-shared-memory'])
+              for _ in range(args.runs)]
+
+  print('%-30s %14s %14s %8s' % ('measurement', 'pipes', 'shared memory',
+                                 'speedup'))
+  for name, unit, higher_is_better in MEASUREMENTS:
+    fd_value = best(pipes, name, higher_is_better)
+    shm_value = best(shared, name, higher_is_better)
+    if higher_is_better:
+      speedup = benchutil.speedup(shm_value, fd_value)
+    else:
+      speedup = benchutil.speedup(fd_value, shm_value)
+    print('%-30s %14.2f %14.2f %7.2fx' % ('%s (%s)' % (name, unit), fd_value,
+                                          shm_value, speedup))
+
+
+if __name__ == '__main__':
+  main()
@@ -0,0 +1,100 @@
+#!/usr/bin/env python
+"""Measure how ThinLTO backends scale with the number of ThreadPool threads.
+
+This generates a number of modules, each with a chain of functions calling
+into the next module, writes their summaries with opt -module-summary, and
+links them with llvm-lto2 -thinlto-threads=N for every thread count given
+with --threads. Every module is one backend task of the ThreadPool, so with
+many more modules than threads this measures how the pool spreads tasks of
+uneven cost over its workers. The best wall time over --runs links and the
+speedup over the first thread count are printed for every thread count.
+
+Use --skew to make the cost of the modules uneven: module i gets
+functions * (1 + skew * i / modules) functions. Give --baseline-llvm-lto2 to
+compare against another build of llvm-lto2, for example one without the
+work-stealing ThreadPool.
+"""
+
+from __future__ import print_function
+
+import multiprocessing
+import os
+import subprocess
+
+import benchutil
+
+
+def write_module(out, index, num_modules, num_functions):
+  out.write('target datalayout = "e-m:e-i64:64-f80:128-n8:16:32:64-S128"\n')
+  out.write('target triple = "x86_64-unknown-linux-gnu"\n\n')
+  callee = 'm%d' % ((index + 1) % num_modules)
+  out.write('declare i32 @%s(i32)\n\n' % callee)
+  for j in range(num_functions):
+    out.write('define internal i32 @f%d(i32 %%x) noinline {\n' % j)
+    out.write('entry:\n  br label %loop\n')
+    out.write('loop:\n')
+    out.write('  %i = phi i32 [ 0, %entry ], [ %i.next, %loop ]\n')
+    out.write('  %a = phi i32 [ %x, %entry ], [ %a.next, %loop ]\n')
+    out.write('  %%t = mul i32 %%a, %d\n' % (j + 3))
+    out.write('  %a.next = xor i32 %t, %i\n')
+    out.write('  %i.next = add i32 %i, 1\n')
+    out.write('  %c = icmp ult i32 %i.next, %x\n')
+    out.write('  br i1 %c, label %loop, label %exit\n')
+    if j + 1 < num_functions:
+      out.write('exit:\n  %%r = call i32 @f%d(i32 %%a.next)\n' % (j + 1))
+    else:
+      out.write('exit:\n  %%r = call i32 @%s(i32 %%a.next)\n' % callee)
+    out.write('  ret i32 %r\n}\n\n')
+  out.write('define i32 @m%d(i32 %%x) {\n' % index)
+  out.write('  %r = call i32 @f0(i32 %x)\n  ret i32 %r\n}\n')
+
+
+def main():
+  parser = benchutil.make_parser(__doc__, runs=3)
+  benchutil.add_tool(parser, 'opt')
+  benchutil.add_tool(parser, 'llvm-lto2', baseline=True)
+  parser.add_argument('--modules', type=int, default=64,
+                      help='Number of modules (backend tasks)')
+  parser.add_argument('--functions', type=int, default=50,
+                      help='Number of functions in the smallest module')
+  parser.add_argument('--skew', type=float, default=3.0,
+                      help='How much larger the last module is than the first')
+  parser.add_argument('--threads', type=int, action='append',
+                      help='Thread count to time; may be repeated '
+                      '(default: 1, 2, 4, ... up to the number of CPUs)')
+  args = parser.parse_args()
+
+  threads = args.threads
+  if not threads:
+    threads = [1]
+    while threads[-1] * 2 <= multiprocessing.cpu_count():
+      threads.append(threads[-1] * 2)
+
+  with benchutil.temporary_directory() as tmpdir:
+    link_args = ['-o', os.path.join(tmpdir, 'out')]
+    for i in range(args.modules):
+      source = os.path.join(tmpdir, 'm%d.ll' % i)
+      functions = int(args.functions * (1 + args.skew * i / args.modules))
+      with open(source, 'w') as out:
+        write_module(out, i, args.modules, functions)
+      bitcode = os.path.join(tmpdir, 'm%d.o' % i)
+      subprocess.check_call([args.opt, '-module-summary', '-o', bitcode,
+                             source])
+      callee = (i + 1) % args.modules
+      link_args += [bitcode, '-r=%s,m%d,px' % (bitcode, i)]
+      if callee != i:
+        link_args.append('-r=%s,m%d,' % (bitcode, callee))
+
+    print('%-10s %8s %12s %8s' % ('tool', 'threads', 'time (s)', 'speedup'))
+    for name, llvm_lto2 in benchutil.tool_builds(args, 'llvm-lto2'):
+      first = None
+      for n in threads:
+        cmd = [llvm_lto2, '-thinlto-threads=%d' % n] + link_args
+        best = benchutil.best_of(args.runs, lambda: benchutil.wall_time(cmd))
+        first = first or best
+        benchutil.print_row('%-10s %8d %12.3f %7.2fx', name, n, best,
+                            benchutil.speedup(first, best))
+
+
+if __name__ == '__main__':
+  main()